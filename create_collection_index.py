@@ -1,13 +1,159 @@
 #!/usr/bin/python
 # -*- coding: utf-8 -*-
 
-# Index file is a simple vertical dash-separated text file in UTF8, containing per each line:
+# Text index file is a simple vertical dash-separated text file in UTF8, starting with "#version <index version>"
+# line, and containing per each line:
 # <artist> <title> <filepathfromroot> <musicpathifneeded> <type> [language]
+#
+# Binary index file (created with -b) is a versioned big-endian format:
+# "SPIVAKIX" <uint16 version> <uint16 flags> <uint32 index version>
+# <uint32 artist count> <artist string>...
+# <uint32 entry count> ( <uint32 artist index> <title> <filepathfromroot> <musicpathifneeded> <type> <language> )...
+# <SHA-1 of everything above, 20 bytes>
+# where each string is <uint32 length> followed by UTF-8 bytes. Artists are stored once in the string table.
+#
+# Index version is increased each time the index changes, and index.delta lists the changes since the
+# previous version, so the player only needs to apply those:
+# #delta <previous index version> <index version>
+# +<artist>|<title>|<filepathfromroot>|<musicpathifneeded>|<type>|[language]     (added or modified)
+# -<filepathfromroot>|<musicpathifneeded>                                       (removed)
 
-import re, os, sys, sys
+import re, os, sys, struct, hashlib
 
+BINARY_INDEX_MAGIC = b"SPIVAKIX"
+BINARY_INDEX_VERSION = 2
 
-def createIndex( src ):
+
+def packString( value ):
+    data = value.encode( "utf-8" )
+    return struct.pack( ">I", len(data) ) + data
+
+
+def unpackString( data, offset ):
+    ( length, ) = struct.unpack_from( ">I", data, offset )
+    offset += 4
+    return ( data[ offset : offset + length ].decode( "utf-8" ), offset + length )
+
+
+def indexLine( entry ):
+    ( artist, title, lyricsfile, musicfile, extension ) = entry
+    return artist + "|" + title + "|" + lyricsfile + "|" + musicfile + "|" + extension + "|"
+
+
+def readIndex( path ):
+
+    # Returns the index version and the entries of the existing index, or ( 0, [] ) if there is none
+    if not os.path.exists( path ):
+        return ( 0, list() )
+
+    data = open( path, "rb" ).read()
+    version = 0
+    entries = list()
+
+    if data.startswith( BINARY_INDEX_MAGIC ):
+        ( binversion, flags ) = struct.unpack_from( ">HH", data, len(BINARY_INDEX_MAGIC) )
+        offset = len(BINARY_INDEX_MAGIC) + 4
+
+        if binversion >= 2:
+            ( version, ) = struct.unpack_from( ">I", data, offset )
+            offset += 4
+
+        ( count, ) = struct.unpack_from( ">I", data, offset )
+        offset += 4
+        artists = list()
+
+        for i in range( count ):
+            ( artist, offset ) = unpackString( data, offset )
+            artists.append( artist )
+
+        ( count, ) = struct.unpack_from( ">I", data, offset )
+        offset += 4
+
+        for i in range( count ):
+            ( artistidx, ) = struct.unpack_from( ">I", data, offset )
+            offset += 4
+            ( title, offset ) = unpackString( data, offset )
+            ( lyricsfile, offset ) = unpackString( data, offset )
+            ( musicfile, offset ) = unpackString( data, offset )
+            ( extension, offset ) = unpackString( data, offset )
+            ( language, offset ) = unpackString( data, offset )
+            entries.append( ( artists[ artistidx ], title, lyricsfile, musicfile, extension ) )
+
+    else:
+        for line in data.decode( "utf-8" ).split( "\n" ):
+            if line.startswith( "#version " ):
+                version = int( line[9:] )
+                continue
+
+            values = line.split( "|" )
+
+            if len(values) >= 5:
+                entries.append( tuple( values[0:5] ) )
+
+    return ( version, entries )
+
+
+def writeTextIndex( out, version, entries ):
+    out.write( ("#version " + str(version) + "\n").encode( "utf-8") )
+
+    for entry in entries:
+        out.write( (indexLine( entry ) + "\n").encode( "utf-8") )
+
+
+def writeDelta( out, oldversion, oldentries, version, entries ):
+
+    # Entries are identified by their paths, as the player does
+    old = dict( ( ( e[2], e[3] ), e ) for e in oldentries )
+    new = dict( ( ( e[2], e[3] ), e ) for e in entries )
+
+    out.write( ("#delta " + str(oldversion) + " " + str(version) + "\n").encode( "utf-8") )
+
+    for key in sorted( old ):
+        if key not in new:
+            out.write( ("-" + key[0] + "|" + key[1] + "\n").encode( "utf-8") )
+
+    for entry in entries:
+        key = ( entry[2], entry[3] )
+
+        if old.get( key ) != entry:
+            out.write( ("+" + indexLine( entry ) + "\n").encode( "utf-8") )
+
+
+def writeBinaryIndex( out, version, entries ):
+
+    # Build the artist string table so repeated artists are only stored once
+    artists = dict()
+    artistlist = list()
+
+    for entry in entries:
+        if entry[0] not in artists:
+            artists[ entry[0] ] = len( artistlist )
+            artistlist.append( entry[0] )
+
+    data = bytearray( BINARY_INDEX_MAGIC )
+    data += struct.pack( ">HH", BINARY_INDEX_VERSION, 0 )
+    data += struct.pack( ">I", version )
+    data += struct.pack( ">I", len(artistlist) )
+
+    for artist in artistlist:
+        data += packString( artist )
+
+    data += struct.pack( ">I", len(entries) )
+
+    for ( artist, title, lyricsfile, musicfile, extension ) in entries:
+        data += struct.pack( ">I", artists[ artist ] )
+        data += packString( title )
+        data += packString( lyricsfile )
+        data += packString( musicfile )
+        data += packString( extension )
+        data += packString( "" )
+
+    # Trailing checksum allows the player to detect truncated or corrupted downloads
+    data += hashlib.sha1( data ).digest()
+    out.write( data )
+
+
+def createIndex( src, binary ):
 
     # Iterate through all dirs in the sourcepath
     filesfound = dict()
@@ -27,8 +173,8 @@ def createIndex( src ):
     # Lyric file extensions
     karaoke_ext_lyrics = ("cdg", "lrc", "lyric", "txt" )
     
-    # Output index file
-    out = open( os.path.join( src, "index.dat"), "wb" )
+    # Collected index entries
+    entries = list()
     
     # Use the queue-based lookup to avoid recursion
     lookupdirs = list( [ src ] )
@@ -97,13 +243,47 @@ def createIndex( src ):
                 # Ignore files which are not music with matching lyrics or standalone
                 continue
 
-            out.write( (artist + "|" + title + "|" + lyricsfile + "|" + musicfile + "|" + extension + "|\n").encode( "utf-8") )
-            
+            entries.append( ( artist, title, lyricsfile, musicfile, extension ) )
+
+    # Compare with the existing index; if nothing changed it is not rewritten, so the players see it as not modified
+    indexpath = os.path.join( src, "index.dat")
+    deltapath = os.path.join( src, "index.delta")
+    ( oldversion, oldentries ) = readIndex( indexpath )
+
+    if oldversion > 0 and sorted( oldentries ) == sorted( entries ) and binary == open( indexpath, "rb" ).read().startswith( BINARY_INDEX_MAGIC ):
+        print ("Index version", oldversion, "is up to date" )
+        return
+
+    version = oldversion + 1
+
+    # Output index file
+    out = open( indexpath, "wb" )
+
+    if binary:
+        writeBinaryIndex( out, version, entries )
+    else:
+        writeTextIndex( out, version, entries )
+
     out.close()
+
+    # Output the changes since the previous version; without it the players use the full index
+    if oldversion > 0:
+        out = open( deltapath, "wb" )
+        writeDelta( out, oldversion, oldentries, version, entries )
+        out.close()
+    elif os.path.exists( deltapath ):
+        os.remove( deltapath )
         
-    
-if len(sys.argv) < 2:
-    print ("Usage: " + sys.argv[0] + " <dir>\n")
+
+binary = False
+args = sys.argv[1:]
+
+if args and args[0] == "-b":
+    binary = True
+    args = args[1:]
+
+if len(args) < 1:
+    print ("Usage: " + sys.argv[0] + " [-b] <dir>\n\n  -b  write the compact binary index format\n")
     sys.exit(1)
     
-createIndex( sys.argv[1] )
+createIndex( args[0], binary )
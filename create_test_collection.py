@@ -0,0 +1,74 @@
+#!/usr/bin/python
+# -*- coding: utf-8 -*-
+
+# Creates a synthetic karaoke collection for benchmarking the scanner (spivak --scan-only) and the web server,
+# so the results could be compared between changes and machines. The layout is
+# <dir>/Artist <n>/Album <n>/Artist <n> - Song <n>.lrc with an empty .mp3 next to each lyrics file,
+# 10 songs per album and 3 albums per artist. Each lyrics text is different, and in one of several languages,
+# so the language detection is done for every song on the first scan.
+
+import os, sys
+
+SONGS_PER_ALBUM = 10
+ALBUMS_PER_ARTIST = 3
+
+LYRICS = (
+    ( "I walked along the river", "and the night was falling down", "you were singing in the rain", "so we danced until the morning" ),
+    ( "Ich ging am Fluss entlang", "und die Nacht kam langsam", "du hast im Regen gesungen", "wir tanzten bis zum Morgen" ),
+    ( "Je marchais le long du fleuve", "et la nuit tombait doucement", "tu chantais sous la pluie", "nous avons dansé jusqu'au matin" ),
+    ( "Caminaba junto al río", "y la noche iba cayendo", "cantabas bajo la lluvia", "bailamos hasta la mañana" ),
+)
+
+
+def lyricsText( number ):
+    lines = LYRICS[ number % len(LYRICS) ]
+    text = ""
+
+    for i in range( 0, 16 ):
+        text += "[%02d:%02d.00]%s %d\n" % ( i * 4 // 60, i * 4 % 60, lines[ i % len(lines) ], number )
+
+    return text
+
+
+def createCollection( root, songs ):
+
+    created = 0
+    artist = 0
+
+    while created < songs:
+        for album in range( 0, ALBUMS_PER_ARTIST ):
+            path = os.path.join( root, "Artist %d" % artist, "Album %d" % album )
+
+            if not os.path.isdir( path ):
+                os.makedirs( path )
+
+            for song in range( 0, SONGS_PER_ALBUM ):
+                if created >= songs:
+                    break
+
+                name = os.path.join( path, "Artist %d - Song %d" % ( artist, created ) )
+
+                out = open( name + ".lrc", "wb" )
+                out.write( lyricsText( created ).encode( "utf-8" ) )
+                out.close()
+
+                open( name + ".mp3", "wb" ).close()
+                created += 1
+
+        artist += 1
+
+    print ("Created", created, "songs of", artist, "artists in", root )
+
+
+args = sys.argv[1:]
+songs = 10000
+
+if len(args) > 1 and args[0] == "-n":
+    songs = int( args[1] )
+    args = args[2:]
+
+if len(args) < 1:
+    print ("Usage: " + sys.argv[0] + " [-n songs] <dir>\n\n  -n  number of songs to create (default 10000)\n")
+    sys.exit(1)
+
+createCollection( args[0], songs )
@@ -226,6 +226,17 @@ QString LanguageDetector::detectLanguage(const QByteArray &data)
     return 0;
 }
 
+QStringList LanguageDetector::detectLanguages( const QList<QByteArray>& data )
+{
+    QStringList langs;
+
+    // CLD2 has no batch call, but the caller saves the per-call overhead of going through the interface
+    Q_FOREACH( const QByteArray& text, data )
+        langs.push_back( detectLanguage( text ) );
+
+    return langs;
+}
+
 QStringList LanguageDetector::languages()
 {
     QStringList langs;
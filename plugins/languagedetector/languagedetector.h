@@ -25,11 +25,11 @@
 
 // Interface for libcld.so - it is 4Mb library, no need to keep it loaded all the time,
 // as it is only used during scanning (and even there it is not really necessary)
-class LanguageDetector : public QObject, public Interface_LanguageDetector
+class LanguageDetector : public QObject, public Interface_LanguageDetector, public Interface_LanguageDetectorBatch
 {
     Q_OBJECT
     Q_PLUGIN_METADATA( IID "com.ulduzsoft.Skivak.Plugin.LanguageDetector" )
-    Q_INTERFACES( Interface_LanguageDetector )
+    Q_INTERFACES( Interface_LanguageDetector Interface_LanguageDetectorBatch )
 
     public:
         LanguageDetector();
@@ -37,6 +37,9 @@ class LanguageDetector : public QObject, public Interface_LanguageDetector
         // Takes care about the language ID conversion too
         QString  detectLanguage( const QByteArray& data ) Q_DECL_OVERRIDE;
 
+        // Same for a number of texts
+        QStringList  detectLanguages( const QList<QByteArray>& data ) Q_DECL_OVERRIDE;
+
         // This returns all languages
         QStringList  languages() Q_DECL_OVERRIDE;
 };
@@ -3,6 +3,7 @@
 }
 
 
-SUBDIRS += libsonivox libkaraokelyrics plugins src
+SUBDIRS += libsonivox libkaraokelyrics plugins src tools tests
 TEMPLATE = subdirs
 src.depends = libkaraokelyrics
+tests.depends = libkaraokelyrics
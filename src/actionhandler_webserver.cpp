@@ -16,6 +16,7 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
  **************************************************************************/
 
+#include <QJsonDocument>
 #include <QNetworkConfigurationManager>
 #include <QNetworkInterface>
 #include <QNetworkSession>
@@ -26,6 +27,7 @@
 #include "actionhandler.h"
 #include "actionhandler_webserver.h"
 #include "actionhandler_webserver_socket.h"
+#include "websocketframe.h"
 #include "mainwindow.h"
 #include "eventor.h"
 #include "logger.h"
@@ -37,12 +39,29 @@ ActionHandler_WebServer::ActionHandler_WebServer( QObject * parent )
     m_listenPort = 0;
     m_networkSession = 0;
     m_httpServer = 0;
+    m_compressedOriginalBytes = 0;
+    m_compressedBytes = 0;
+    m_totalConnections = 0;
+    m_clock.start();
+
+    if ( pSettings->httpWorkerThreads > 0 )
+        m_workers.setMaxThreadCount( pSettings->httpWorkerThreads );
 
     // Everything should be owned by our thread
     moveToThread( this );
 
     // Learn when a new song is started, so we can remember this information
     connect( pEventor, &Eventor::karaokeStarted, this, &ActionHandler_WebServer::karaokeStarted, Qt::QueuedConnection );
+
+    // Same for the collection scan progress
+    connect( pEventor, &Eventor::scanCollectionStatistics, this, &ActionHandler_WebServer::scanCollectionStatistics, Qt::QueuedConnection );
+
+    // Those are pushed to the WebSocket clients, so they don't have to poll
+    connect( pEventor, &Eventor::queueChanged, this, &ActionHandler_WebServer::queueChanged, Qt::QueuedConnection );
+    connect( pEventor, &Eventor::karaokePausedResumed, this, &ActionHandler_WebServer::karaokeStateChanged, Qt::QueuedConnection );
+    connect( pEventor, &Eventor::karaokeStopped, this, &ActionHandler_WebServer::karaokeStateChanged, Qt::QueuedConnection );
+    connect( pEventor, &Eventor::karaokeParametersChanged, this, &ActionHandler_WebServer::karaokeStateChanged, Qt::QueuedConnection );
+    connect( pEventor, &Eventor::karaokeVolumeChanged, this, &ActionHandler_WebServer::karaokeVolumeChanged, Qt::QueuedConnection );
 }
 
 void ActionHandler_WebServer::run()
@@ -147,12 +166,105 @@ void ActionHandler_WebServer::sessionOpened()
 void ActionHandler_WebServer::karaokeStarted(SongQueueItem song)
 {
     m_currentSong = song;
+    karaokeStateChanged();
+}
+
+void ActionHandler_WebServer::queueChanged()
+{
+    QJsonObject event;
+    event["event"] = "queue";
+    pushEvent( event );
+}
+
+void ActionHandler_WebServer::karaokeStateChanged()
+{
+    QJsonObject event;
+    event["event"] = "status";
+    pushEvent( event );
+}
+
+void ActionHandler_WebServer::karaokeVolumeChanged( int newvalue )
+{
+    QJsonObject event;
+    event["event"] = "volume";
+    event["value"] = newvalue;
+    pushEvent( event );
+}
+
+void ActionHandler_WebServer::pushEvent( const QJsonObject &event )
+{
+    // The frame is the same for every client, so it is only built once
+    emit webSocketEvent( WebSocketFrame::build( WebSocketFrame::OPCODE_TEXT, QJsonDocument( event ).toJson( QJsonDocument::Compact ) ) );
+}
+
+void ActionHandler_WebServer::scanCollectionStatistics( QJsonObject stats )
+{
+    m_scanStatistics = stats;
+}
+
+void ActionHandler_WebServer::addCompressionStats( int originalsize, int compressedsize )
+{
+    m_compressedOriginalBytes += originalsize;
+    m_compressedBytes += compressedsize;
+
+    Logger::debug( "WebServer: compressed response %d -> %d bytes, total %lld -> %lld bytes (%d%%)",
+                   originalsize, compressedsize,
+                   m_compressedOriginalBytes, m_compressedBytes,
+                   (int) (m_compressedBytes * 100 / m_compressedOriginalBytes) );
+}
+
+QThreadPool *ActionHandler_WebServer::workerPool()
+{
+    return pSettings->httpWorkerThreads > 0 ? &m_workers : 0;
+}
+
+bool ActionHandler_WebServer::staticFile( const QString &url, WebServerStaticFile &file )
+{
+    return m_staticCache.find( pSettings->httpDocumentRoot, url, file );
 }
 
 void ActionHandler_WebServer::newHTTPconnection()
 {
-    Logger::debug( "WebServer: new HTTP connection" );
+    QTcpSocket * sock = m_httpServer->nextPendingConnection();
+    QString client = sock->peerAddress().toString();
+
+    Logger::debug( "WebServer: new HTTP connection from %s", qPrintable(client) );
+
+    // Enforce the connection limits; the client should retry later
+    if ( ( pSettings->httpMaxConnections > 0 && m_totalConnections >= (int) pSettings->httpMaxConnections )
+         || ( pSettings->httpMaxClientConnections > 0 && m_clientConnections.value( client ) >= (int) pSettings->httpMaxClientConnections ) )
+    {
+        Logger::error( "WebServer: too many connections (%d total, %d from %s), rejecting", m_totalConnections, m_clientConnections.value( client ), qPrintable(client) );
+
+        sock->write( "HTTP/1.1 503 Service Unavailable\r\n"
+                     "Retry-After: 5\r\n"
+                     "Content-Length: 0\r\n"
+                     "Connection: Close\r\n"
+                     "\r\n" );
+
+        connect( sock, &QTcpSocket::disconnected, sock, &QTcpSocket::deleteLater );
+        sock->disconnectFromHost();
+        return;
+    }
+
+    m_totalConnections++;
+    m_clientConnections[ client ]++;
 
     // Handle the new connection - it will be deleted by the connection itself via deleteLater
-    new ActionHandler_WebServer_Socket( m_httpServer->nextPendingConnection(), m_currentSong );
+    new ActionHandler_WebServer_Socket( sock, this );
+}
+
+void ActionHandler_WebServer::connectionClosed( const QString &client )
+{
+    m_totalConnections--;
+
+    if ( --m_clientConnections[ client ] <= 0 )
+        m_clientConnections.remove( client );
+}
+
+bool ActionHandler_WebServer::allowRequest( const QString &client, RequestClass reqclass, int &retryAfter )
+{
+    unsigned int rate = reqclass == REQUEST_SEARCH ? pSettings->httpSearchRateLimit : pSettings->httpApiRateLimit;
+
+    return m_rateLimiter.allow( client + "/" + QString::number( reqclass ), rate, m_clock.elapsed(), retryAfter );
 }
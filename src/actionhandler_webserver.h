@@ -19,16 +19,22 @@
 #ifndef WEBSERVER_H
 #define WEBSERVER_H
 
+#include <QHash>
 #include <QObject>
 #include <QThread>
+#include <QThreadPool>
+#include <QDateTime>
 #include <QHostInfo>
+#include <QElapsedTimer>
+#include <QJsonObject>
 
 #include "songqueue.h"
+#include "webserverratelimiter.h"
+#include "webserverstaticcache.h"
 
 class QTcpServer;
 class QNetworkSession;
 
-
 // A built-in web server running in a dedicated thread (so it doesn't block our main thread)
 class ActionHandler_WebServer : public QThread
 {
@@ -39,20 +45,82 @@ class ActionHandler_WebServer : public QThread
 
         QString webURL() const;
 
+        // Current state for the connections (only to be used from the web server thread)
+        const SongQueueItem&    currentSong() const { return m_currentSong; }
+        const QJsonObject&      scanStatistics() const { return m_scanStatistics; }
+
+        // Accounts the response compressed by a connection
+        void    addCompressionStats( int originalsize, int compressedsize );
+
+        // Looks up the static file for the URL in the document root, then in resources (see WebServerStaticCache).
+        // Returns false if not found.
+        bool    staticFile( const QString& url, WebServerStaticFile& file );
+
+        // Request classes which are rate limited separately
+        enum RequestClass
+        {
+            REQUEST_SEARCH,         // database searches and browsing
+            REQUEST_API             // other API calls
+        };
+
+        // Checks whether the client is allowed to make this request now according to the rate limits.
+        // If not, retryAfter is set to the number of seconds the client should wait.
+        bool    allowRequest( const QString& client, RequestClass reqclass, int& retryAfter );
+
+        // Must be called by the connection once it is closed, to keep track of the connection limits
+        void    connectionClosed( const QString& client );
+
+        // Pool running the slow requests (database queries) so they don't delay the others; 0 if disabled
+        QThreadPool * workerPool();
+
+    signals:
+        // An event pushed to all WebSocket clients, as a ready to send frame
+        void    webSocketEvent( QByteArray frame );
+
     private slots:
         void    dnsLookupFinished(QHostInfo hinfo);
         void    newHTTPconnection();
         void    sessionOpened();
         void    karaokeStarted(SongQueueItem song );
+        void    scanCollectionStatistics( QJsonObject stats );
+
+        // Eventor signals which are pushed to the WebSocket clients
+        void    queueChanged();
+        void    karaokeStateChanged();
+        void    karaokeVolumeChanged( int newvalue );
 
     private:
         void run();
 
+        // Pushes the event object to the WebSocket clients
+        void    pushEvent( const QJsonObject& event );
+
         unsigned short      m_listenPort;
 
         QNetworkSession *   m_networkSession;
         QTcpServer      *   m_httpServer;
         SongQueueItem       m_currentSong;
+
+        // Last collection scan statistics (empty if no scan was running)
+        QJsonObject         m_scanStatistics;
+
+        // Total sizes of the compressed responses, before and after compression
+        qint64              m_compressedOriginalBytes;
+        qint64              m_compressedBytes;
+
+        // Number of open connections per client address, and in total
+        QHash< QString, int >   m_clientConnections;
+        int                 m_totalConnections;
+
+        // Rate limits per client address and request class
+        WebServerRateLimiter    m_rateLimiter;
+        QElapsedTimer       m_clock;
+
+        // Worker threads for the slow requests
+        QThreadPool         m_workers;
+
+        // Static files cache
+        WebServerStaticCache    m_staticCache;
 };
 
 #endif // WEBSERVER_H
@@ -16,14 +16,19 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
  **************************************************************************/
 
-#include <QMimeDatabase>
-#include <QMimeType>
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QJsonParseError>
 #include <QNetworkCookie>
 #include <QHostAddress>
 #include <QCryptographicHash>
+#include <QtConcurrent>
+
+#if defined (Q_OS_LINUX)
+    #include <sys/sendfile.h>
+    #include <errno.h>
+    #include <string.h>
+#endif
 
 #include "util.h"
 #include "settings.h"
@@ -34,13 +39,70 @@
 #include "actionhandler.h"
 #include "currentstate.h"
 #include "mainwindow.h"
+#include "actionhandler_webserver.h"
 #include "actionhandler_webserver_socket.h"
+#include "websocketframe.h"
+
+// Idle connections are closed after this time; this also applies to the connections which never send a request
+static int idleTimeoutMsec()
+{
+    return ( pSettings->httpKeepAliveTimeout > 0 ? pSettings->httpKeepAliveTimeout : 15 ) * 1000;
+}
+
+// WebSocket clients are pinged if idle for this long, and disconnected if there's no reply in the same time
+static const int WEBSOCKET_PING_INTERVAL = 30000;
+
+// Appended to the client key to produce Sec-WebSocket-Accept
+static const char * WEBSOCKET_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// The only WebSocket protocol version we support (RFC 6455)
+static const char * WEBSOCKET_VERSION = "13";
+
+// Close status sent for the messages we cannot handle (we do not reassemble fragmented ones)
+static const int WEBSOCKET_CLOSE_UNSUPPORTED_DATA = 1003;
+
+// We only expect small control frames from the clients
+static const int WEBSOCKET_MAX_FRAME_SIZE = 65536;
+
+// Large files are sent in parts of this size, so only this much is buffered per connection
+static const qint64 FILE_SEND_CHUNK_SIZE = 65536;
+
+// Maximum sent at once by sendfile() before returning to the event loop, so other connections are not blocked
+static const qint64 FILE_SEND_MAX_PER_CALL = 1024 * 1024;
+
+// The streamed response is only produced further once the socket buffer is below this size
+static const qint64 STREAM_MAX_BUFFERED = 65536;
 
-ActionHandler_WebServer_Socket::ActionHandler_WebServer_Socket(QTcpSocket *httpsock, const SongQueueItem& currentSong)
+ActionHandler_WebServer_Socket::ActionHandler_WebServer_Socket( QTcpSocket *httpsock, ActionHandler_WebServer *server )
     : QObject()
 {
     m_httpsock = httpsock;
-    m_currentSong = "\"" + currentSong.title + "\" by " + currentSong.artist;
+    m_server = server;
+    m_clientAddress = httpsock->peerAddress().toString();
+    m_keepAlive = false;
+    m_closing = false;
+    m_headersHandled = false;
+    m_acceptGzip = false;
+    m_acceptDeflate = false;
+    m_webSocket = false;
+    m_pingSent = false;
+    m_workerBusy = false;
+    m_streamStarted = false;
+    m_streamUnacked = 0;
+    m_http11 = false;
+    m_sendMap = 0;
+    m_sendOffset = 0;
+    m_sendSize = 0;
+    m_fileTransfer = false;
+    m_sendCopy = false;
+    m_sendNotifier = 0;
+
+    connect( m_httpsock, &QTcpSocket::bytesWritten, this, &ActionHandler_WebServer_Socket::sendFileData );
+    connect( m_httpsock, &QTcpSocket::bytesWritten, this, &ActionHandler_WebServer_Socket::streamDataSent );
+
+    m_idleTimer.setSingleShot( true );
+    connect( &m_idleTimer, &QTimer::timeout, this, &ActionHandler_WebServer_Socket::idleTimeout );
+    m_idleTimer.start( idleTimeoutMsec() );
 
     // Autodelete the client once it is disconnected
     connect( m_httpsock, &QTcpSocket::disconnected, this, &ActionHandler_WebServer_Socket::deleteLater );
@@ -54,10 +116,18 @@ ActionHandler_WebServer_Socket::ActionHandler_WebServer_Socket(QTcpSocket *https
 
     // Command actions
     connect( this, SIGNAL(commandAction(int)), pActionHandler, SLOT(cmdAction(int)), Qt::QueuedConnection );
+
+    // Collection rescan. Connected once here, as the connection serves many requests when kept alive
+    connect( this, SIGNAL(startKaraokeScan()), pMainWindow, SLOT(karaokeDatabaseStartScan()), Qt::QueuedConnection );
 }
 
 ActionHandler_WebServer_Socket::~ActionHandler_WebServer_Socket()
 {
+    // Nobody would send the rest, so the worker should not wait for it
+    if ( m_stream )
+        m_stream->cancel();
+
+    m_server->connectionClosed( m_clientAddress );
     delete m_httpsock;
 }
 
@@ -65,51 +135,199 @@ void ActionHandler_WebServer_Socket::readyRead()
 {
     // Read the HTTP request
     m_httpRequest += m_httpsock->readAll();
+    m_idleTimer.start( m_webSocket ? WEBSOCKET_PING_INTERVAL : idleTimeoutMsec() );
+    m_pingSent = false;
 
-    // Do we have a full HTTP header at least? If not, wait for more data
-    int bodyidx = m_httpRequest.indexOf( "\r\n\r\n");
+    handlePending();
+}
+
+void ActionHandler_WebServer_Socket::handlePending()
+{
+    // Several requests might be pipelined. They're handled one by one, so the responses are sent in the same order.
+    while ( !m_closing && !m_webSocket && !m_workerBusy && !m_fileTransfer && handleRequest() )
+        ;
+
+    // Once upgraded, the rest is WebSocket frames
+    while ( !m_closing && m_webSocket && handleWebSocketFrame() )
+        ;
+}
+
+void ActionHandler_WebServer_Socket::dispatchToWorker( ActionHandler_WebServer_Stream::Handler handler, const QJsonObject &request )
+{
+    QThreadPool * pool = m_server->workerPool();
+
+    // Streaming only makes sense if the response is produced in a worker while we're sending it.
+    // Streamed responses are not compressed, since the compression needs the whole response.
+    bool streamed = pool && m_http11;
+
+    ActionHandler_WebServer_Stream * stream = new ActionHandler_WebServer_Stream( streamed );
 
-    if ( bodyidx == -1 )
+    connect( stream, &ActionHandler_WebServer_Stream::dataReady, this, &ActionHandler_WebServer_Socket::streamData );
+    connect( stream, &ActionHandler_WebServer_Stream::finished, this, &ActionHandler_WebServer_Socket::streamFinished );
+    connect( stream, &ActionHandler_WebServer_Stream::aborted, this, &ActionHandler_WebServer_Socket::streamAborted );
+
+    if ( !pool )
+    {
+        ActionHandler_WebServer_Stream::run( handler, request, stream );
         return;
+    }
+
+    m_stream = stream;
+    m_streamUnacked = 0;
+
+    // Not idle while the worker is busy
+    m_workerBusy = true;
+    m_idleTimer.stop();
+    QtConcurrent::run( pool, ActionHandler_WebServer_Stream::run, handler, request, stream );
+}
 
-    // So we have at least the header. Parse it if we haven't yet
-    if ( m_url.isEmpty() )
+void ActionHandler_WebServer_Socket::streamData( QByteArray data )
+{
+    if ( m_closing )
     {
-        QStringList header = QString::fromUtf8( m_httpRequest.left( bodyidx ) ).split( "\r\n" );
+        if ( m_stream )
+            m_stream->cancel();
 
-        // First line is formatted differently
-        QRegExp regex( "^([A-Za-z]+)\\s+(.+)\\s+HTTP/\\d\\.\\d" );
+        return;
+    }
 
-        if ( header.isEmpty() || regex.indexIn( header[0] ) == -1 )
-        {
-            // Bad method
-            sendError( 400 );
-            return;
-        }
+    if ( !m_streamStarted )
+    {
+        QByteArray header = "HTTP/1.1 200 ok\r\n"
+                  "Transfer-Encoding: chunked\r\n"
+                  "Content-Type: application/json\r\n"
+                + connectionHeader()
+                + "Expires: Thu, 01 Jan 1970 00:00:01 GMT\r\n"
+                + "\r\n";
+
+        m_httpsock->write( header );
+        m_streamStarted = true;
+    }
+
+    m_httpsock->write( QByteArray::number( data.size(), 16 ) + "\r\n" );
+    m_httpsock->write( data );
+    m_httpsock->write( "\r\n" );
+
+    m_streamUnacked += data.size();
+    streamDataSent();
+}
+
+void ActionHandler_WebServer_Socket::streamDataSent()
+{
+    if ( !m_stream || m_streamUnacked == 0 || m_httpsock->bytesToWrite() >= STREAM_MAX_BUFFERED )
+        return;
+
+    m_stream->dataSent( m_streamUnacked );
+    m_streamUnacked = 0;
+}
+
+void ActionHandler_WebServer_Socket::streamFinished( QByteArray data )
+{
+    // Only asynchronous requests block the connection
+    bool async = m_workerBusy;
+    m_workerBusy = false;
+    m_stream = 0;
+
+    if ( m_closing )
+        return;
+
+    if ( m_streamStarted )
+    {
+        if ( !data.isEmpty() )
+            streamData( data );
+
+        // Last chunk
+        m_httpsock->write( "0\r\n\r\n" );
+        m_streamStarted = false;
+        responseSent();
+    }
+    else
+        sendData( data );
+
+    // The client might have sent more requests meanwhile
+    if ( async )
+        handlePending();
+}
+
+void ActionHandler_WebServer_Socket::streamAborted()
+{
+    m_workerBusy = false;
+    m_stream = 0;
+
+    if ( m_closing )
+        return;
+
+    // Part of the response might be sent already, so the connection cannot be used anymore. The client
+    // is not reading, so there's no point to wait for the buffered data to be sent either.
+    Logger::error( "WwwServer: client %s stopped reading the response, closing", qPrintable(m_clientAddress) );
+    m_closing = true;
+    m_httpsock->abort();
+}
+
+void ActionHandler_WebServer_Socket::idleTimeout()
+{
+    // Idle WebSocket clients are fine as long as they answer pings
+    if ( m_webSocket && !m_pingSent )
+    {
+        m_pingSent = true;
+        m_httpsock->write( WebSocketFrame::build( WebSocketFrame::OPCODE_PING, QByteArray() ) );
+        m_idleTimer.start( WEBSOCKET_PING_INTERVAL );
+        return;
+    }
+
+    Logger::debug( "WebServer: closing idle connection" );
+
+    m_closing = true;
+    m_httpsock->disconnectFromHost();
+}
+
+bool ActionHandler_WebServer_Socket::handleRequest()
+{
+    // The parser takes only the current request, leaving the pipelined ones in the buffer
+    int consumed = m_parser.feed( m_httpRequest );
+    m_httpRequest.remove( 0, consumed );
+
+    if ( m_parser.hasError() )
+    {
+        Logger::error( "WebServer: invalid HTTP request, replying %d", m_parser.errorCode() );
+        sendError( m_parser.errorCode() );
+        return false;
+    }
+
+    // Do we have a full HTTP header at least? If not, wait for more data
+    if ( !m_parser.headersComplete() )
+        return false;
+
+    // So we have at least the header. Handle it if we haven't yet
+    if ( !m_headersHandled )
+    {
+        m_headersHandled = true;
 
         // Get the method and URL
-        m_method = regex.cap( 1 );
-        m_url = regex.cap( 2 );
+        m_method = QString::fromLatin1( m_parser.method() );
+        m_url = QString::fromUtf8( m_parser.url() );
 
-        // Parse the headers, get all we need
-        int content_length = 0;
-        bool requires_expect_100 = false;
+        m_http11 = m_parser.version() == "HTTP/1.1";
+        m_keepAlive = m_parser.keepAlive() && pSettings->httpKeepAliveTimeout > 0;
 
-        for ( int i = 1; i < header.size(); i++ )
-        {
-            QRegExp regex( "^([A-Za-z0-9-]+):\\s+(.+)" );
+        m_acceptGzip = false;
+        m_acceptDeflate = false;
+        m_ifNoneMatch.clear();
+        m_ifModifiedSince.clear();
+        m_webSocketKey.clear();
+        m_webSocketVersion.clear();
 
-            if ( regex.indexIn( header[i] ) == -1 )
-            {
-                Logger::error( "WebServer: bad header line %s, aborting", qPrintable(header[i]) );
-                sendError( 400 );
-                return;
-            }
+        // Get all we need from the headers
+        bool requires_expect_100 = false;
+        bool upgrade_websocket = false;
 
-            QString hdr = regex.cap( 1 );
-            QString value = regex.cap( 2 );
+        for ( int i = 0; i < m_parser.headers().size(); i++ )
+        {
+            // Names are lowercased by the parser
+            const QByteArray& hdr = m_parser.headers()[i].first;
+            QString value = QString::fromUtf8( m_parser.headers()[i].second );
 
-            if ( hdr.compare( "cookie", Qt::CaseInsensitive) == 0 )
+            if ( hdr == "cookie" )
             {
                 // Parse the cookies.
                 // Unfortunately QNetworkCookie::parseCookies does not support multiple cookies on a single line.
@@ -133,42 +351,80 @@ void ActionHandler_WebServer_Socket::readyRead()
                         m_loggedName = QByteArray::fromBase64( cookie.value() );
                 }
             }
-            else if ( hdr.compare( "content-length", Qt::CaseInsensitive) == 0 )
-                content_length = value.toInt();
-            else if ( hdr.compare( "expect", Qt::CaseInsensitive) == 0 && value.startsWith( "100") )
+            else if ( hdr == "expect" && value.startsWith( "100") )
                 requires_expect_100 = true;
-            else if ( hdr.compare( "host", Qt::CaseInsensitive ) == 0 && !pSettings->httpForceUseHost.isEmpty() )
+            else if ( hdr == "upgrade" )
+                upgrade_websocket = value.contains( "websocket", Qt::CaseInsensitive );
+            else if ( hdr == "sec-websocket-key" )
+                m_webSocketKey = value.trimmed().toLatin1();
+            else if ( hdr == "sec-websocket-version" )
+                m_webSocketVersion = value.trimmed().toLatin1();
+            else if ( hdr == "if-none-match" )
+                m_ifNoneMatch = value.toLatin1();
+            else if ( hdr == "if-modified-since" )
+                m_ifModifiedSince = value.trimmed();
+            else if ( hdr == "accept-encoding" )
+            {
+                // Something like "gzip, deflate;q=0.5, br"; only q=0 refuses the encoding
+                foreach ( QString encoding, value.split( ',' ) )
+                {
+                    QStringList params = encoding.split( ';' );
+                    QString name = params.takeFirst().trimmed();
+                    bool refused = false;
+
+                    foreach ( QString param, params )
+                    {
+                        param = param.trimmed();
+
+                        if ( param.startsWith( "q=" ) && param.mid( 2 ).toDouble() <= 0.0 )
+                            refused = true;
+                    }
+
+                    if ( name.compare( "gzip", Qt::CaseInsensitive ) == 0 )
+                        m_acceptGzip = !refused;
+                    else if ( name.compare( "deflate", Qt::CaseInsensitive ) == 0 )
+                        m_acceptDeflate = !refused;
+                }
+            }
+            else if ( hdr == "host" && !pSettings->httpForceUseHost.isEmpty() )
             {
                 // This is useful if player machine has open WiFi and is used as captive portal
                 if ( value.compare( pSettings->httpForceUseHost, Qt::CaseInsensitive ) != 0 )
                 {
+                    // The rest of the request is not read, so the connection cannot be reused
+                    m_keepAlive = false;
                     redirect( "http://" + pSettings->httpForceUseHost + "/login.html" );
-                    return;
+                    return false;
                 }
             }
         }
 
-        if ( content_length < 0 )
-        {
-            sendError( 400 );
-            return;
-        }
-
-        m_contentLength = content_length;
+        if ( !upgrade_websocket )
+            m_webSocketKey.clear();
 
         // Expect: 100 tells us that the data is not yet sent, and we need to tell the client to send it
-        if ( requires_expect_100 )
-        {
+        if ( requires_expect_100 && !m_parser.isComplete() )
             m_httpsock->write( "HTTP/1.1 100 Continue\r\n\r\n" );
-            return;
-        }
     }
 
-    // If we have content-length, ensure we got all the content
-    if ( m_contentLength > 0 && m_httpRequest.size() - (bodyidx + 4) < (int) m_contentLength )
-        return;
+    // Ensure we got all the content
+    if ( !m_parser.isComplete() )
+        return false;
 
-    QByteArray requestbody = m_httpRequest.mid( bodyidx + 4 );
+    processRequest( m_parser.body() );
+
+    // Ready for the next request
+    m_parser.reset();
+    m_headersHandled = false;
+    m_url.clear();
+    m_method.clear();
+    m_loggedName.clear();
+
+    return !m_closing;
+}
+
+void ActionHandler_WebServer_Socket::processRequest( const QByteArray& requestbody )
+{
     Logger::debug( "WwwServer: %s %s, logged: %s, body %s", qPrintable(m_method), qPrintable(m_url), qPrintable(m_loggedName), requestbody.constData() );
 
     // If we're asked for an HTML page which is not login.html,
@@ -186,6 +442,35 @@ void ActionHandler_WebServer_Socket::readyRead()
         return;
     }
 
+    // Event push channel; the clients which cannot use it poll the API instead
+    if ( m_url == "/api/events" )
+    {
+        if ( m_webSocketKey.isEmpty() || m_method.compare( "get", Qt::CaseInsensitive ) != 0 )
+        {
+            Logger::error( "WwwServer: events requested without WebSocket upgrade" );
+            sendError( 400 );
+            return;
+        }
+
+        // Events are only pushed to the logged in users, same as the pages
+        if ( m_loggedName.isEmpty() )
+        {
+            Logger::error( "WwwServer: events requested without login" );
+            sendError( 403 );
+            return;
+        }
+
+        if ( m_webSocketVersion != WEBSOCKET_VERSION )
+        {
+            Logger::error( "WwwServer: unsupported WebSocket version %s requested", m_webSocketVersion.constData() );
+            sendUpgradeRequired();
+            return;
+        }
+
+        upgradeWebSocket();
+        return;
+    }
+
     // Handle API requests
     if ( m_url.startsWith( "/api" ) )
     {
@@ -196,6 +481,17 @@ void ActionHandler_WebServer_Socket::readyRead()
             return;
         }
 
+        // Searches are expensive, so they're limited separately from the rest
+        int retryafter;
+        bool searching = m_url == "/api/search" || m_url == "/api/browse";
+
+        if ( !m_server->allowRequest( m_clientAddress, searching ? ActionHandler_WebServer::REQUEST_SEARCH : ActionHandler_WebServer::REQUEST_API, retryafter ) )
+        {
+            Logger::debug( "WwwServer: client %s exceeded the request rate for %s", qPrintable(m_clientAddress), qPrintable(m_url) );
+            sendTooManyRequests( retryafter );
+            return;
+        }
+
         // Attempt to decode the JSON from the socket
         QJsonParseError error;
         QJsonDocument document = QJsonDocument::fromJson( requestbody, &error);
@@ -255,57 +551,428 @@ void ActionHandler_WebServer_Socket::readyRead()
     }
     else
     {
+        // File serving from wwwroot or resources, via cache
+        WebServerStaticFile file;
 
-        // File serving - first look up in wwwroot
-        QFile f;
+        if ( !m_server->staticFile( m_url, file ) )
+        {
+            if ( pSettings->httpDocumentRoot.isEmpty() )
+                Logger::debug( "WebServer: requested path %s is not found in resources", qPrintable(m_url) );
+            else
+                Logger::debug( "WebServer: requested path %s is not found in resources or %s", qPrintable(m_url), qPrintable(pSettings->httpDocumentRoot) );
+
+            sendError( 404 );
+            return;
+        }
+
+        sendStaticFile( file );
+    }
+}
+
+void ActionHandler_WebServer_Socket::sendStaticFile( const WebServerStaticFile &file )
+{
+    bool notmodified = file.notModified( m_ifNoneMatch, m_ifModifiedSince );
+
+    QByteArray header = notmodified ? "HTTP/1.1 304 Not Modified\r\n" : "HTTP/1.1 200 ok\r\n";
+    header += file.validatorHeaders()
+            + "Vary: Accept-Encoding\r\n"
+            + connectionHeader();
+
+    if ( notmodified )
+    {
+        Logger::debug( "WebServer: content %s is not modified", qPrintable(m_url) );
+
+        m_httpsock->write( header + "\r\n" );
+        responseSent();
+        return;
+    }
+
+    if ( !file.inMemory )
+    {
+        header += "Content-Type: " + file.type + "\r\n"
+                + "Content-Length: " + QByteArray::number( file.size ) + "\r\n"
+                + "\r\n";
+
+        Logger::debug( "WebServer: serving content %s from disk, type %s", qPrintable(m_url), file.type.constData() );
+
+        m_httpsock->write( header );
+        startFileTransfer( file.path, file.size );
+        return;
+    }
+
+    bool compressed = m_acceptGzip
+            && !file.gzipped.isEmpty()
+            && pSettings->httpCompressMinSize > 0
+            && file.data.size() >= (int) pSettings->httpCompressMinSize;
+
+    const QByteArray& data = compressed ? file.gzipped : file.data;
+
+    if ( compressed )
+    {
+        header += "Content-Encoding: gzip\r\n";
+        m_server->addCompressionStats( file.data.size(), file.gzipped.size() );
+    }
+
+    header += "Content-Type: " + file.type + "\r\n"
+            + "Content-Length: " + QByteArray::number( data.size() ) + "\r\n"
+            + "\r\n";
+
+    Logger::debug( "WebServer: serving content %s, type %s", qPrintable(m_url), file.type.constData() );
+
+    m_httpsock->write( header );
+    m_httpsock->write( data );
+    responseSent();
+}
 
-        if ( !pSettings->httpDocumentRoot.isEmpty() )
+void ActionHandler_WebServer_Socket::startFileTransfer( const QString &path, qint64 size )
+{
+    m_sendFile.setFileName( path );
+
+    if ( !m_sendFile.open( QIODevice::ReadOnly ) )
+    {
+        // The header is sent already, so all we can do is to close the connection
+        Logger::error( "WebServer: cannot open %s: %s", qPrintable(path), qPrintable(m_sendFile.errorString()) );
+        m_closing = true;
+        m_httpsock->disconnectFromHost();
+        return;
+    }
+
+    // sendfile() doesn't need the mapping. Elsewhere not mapping is fine too, the parts would be read instead.
+#if !defined (Q_OS_LINUX)
+    m_sendMap = m_sendFile.map( 0, size );
+#endif
+    m_sendOffset = 0;
+    m_sendSize = size;
+    m_sendCopy = false;
+    m_fileTransfer = true;
+
+    // Not idle while sending
+    m_idleTimer.stop();
+
+    // Continues once the header is written
+}
+
+void ActionHandler_WebServer_Socket::sendFileData()
+{
+    if ( !m_fileTransfer || m_closing )
+        return;
+
+    // Keep only one part buffered in the socket
+    if ( m_httpsock->bytesToWrite() > 0 )
+        return;
+
+#if defined (Q_OS_LINUX)
+    if ( !m_sendCopy )
+    {
+        // Nothing is buffered, so we can send straight from the page cache to the socket
+        qint64 sent = 0;
+        bool socketFull = false;
+
+        while ( m_sendOffset < m_sendSize && sent < FILE_SEND_MAX_PER_CALL )
         {
-            f.setFileName( pSettings->httpDocumentRoot + m_url );
-            f.open( QIODevice::ReadOnly );
+            off_t offset = m_sendOffset;
+            ssize_t res = ::sendfile( m_httpsock->socketDescriptor(), m_sendFile.handle(), &offset, qMin( m_sendSize - m_sendOffset, FILE_SEND_CHUNK_SIZE ) );
+
+            if ( res > 0 )
+            {
+                m_sendOffset += res;
+                sent += res;
+                continue;
+            }
+
+            if ( res < 0 && errno == EINTR )
+                continue;
+
+            if ( res < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) )
+            {
+                socketFull = true;
+                break;
+            }
+
+            // The file got shorter, so the Content-Length we sent is wrong, and the client can only be disconnected
+            if ( res == 0 )
+            {
+                abortFileTransfer( "the file was truncated" );
+                return;
+            }
+
+            // Not supported for this file; the rest goes through the regular write
+            Logger::debug( "WebServer: sendfile() failed for %s: %s, copying the rest", qPrintable(m_sendFile.fileName()), strerror( errno ) );
+            m_sendCopy = true;
+            break;
         }
 
-        if ( !f.isOpen() )
+        if ( m_sendOffset >= m_sendSize )
         {
-            // Now look up in resources
-            f.setFileName( ":/html" + m_url );
-            f.open( QIODevice::ReadOnly );
+            finishFileTransfer();
+            return;
         }
 
-        if ( !f.isOpen() )
+        // Wait until the socket buffer has room and sendfile() again. The notifier is only enabled while
+        // QTcpSocket has nothing buffered, so its own write notifier is not active at the same time.
+        if ( socketFull )
         {
-            if ( pSettings->httpDocumentRoot.isEmpty() )
-                Logger::debug( "WebServer: requested path %s is not found in resources", qPrintable(m_url) );
-            else
-                Logger::debug( "WebServer: requested path %s is not found in resources or %s", qPrintable(m_url), qPrintable(pSettings->httpDocumentRoot) );
+            if ( !m_sendNotifier )
+            {
+                m_sendNotifier = new QSocketNotifier( m_httpsock->socketDescriptor(), QSocketNotifier::Write, this );
+                connect( m_sendNotifier, &QSocketNotifier::activated, this, &ActionHandler_WebServer_Socket::sendFileWritable );
+            }
 
-            sendError( 404 );
+            m_sendNotifier->setEnabled( true );
+            return;
+        }
+
+        // There's more to send, just let the other connections run first
+        if ( !m_sendCopy )
+        {
+            QMetaObject::invokeMethod( this, "sendFileData", Qt::QueuedConnection );
             return;
         }
+    }
+#endif
+
+    // Write a part through the socket; bytesWritten would call us again once it is sent
+    qint64 length = qMin( m_sendSize - m_sendOffset, FILE_SEND_CHUNK_SIZE );
 
-        QByteArray data = f.readAll();
-        QByteArray type = QMimeDatabase().mimeTypeForFile( f.fileName() ).name().toUtf8();
+    if ( m_sendMap )
+    {
+        // Accessing the mapping past the end of a truncated file raises SIGBUS, so check it is still there
+        if ( m_sendFile.size() < m_sendOffset + length )
+        {
+            abortFileTransfer( "the file was truncated" );
+            return;
+        }
 
-        Logger::debug( "WebServer: serving content %s from %s, type %s", qPrintable(m_url), f.fileName().startsWith( ':' ) ? "resources" : qPrintable(f.fileName()), qPrintable(type) );
-        sendData( data, type );
+        m_httpsock->write( (const char *) m_sendMap + m_sendOffset, length );
     }
+    else
+    {
+        m_sendFile.seek( m_sendOffset );
+        QByteArray data = m_sendFile.read( length );
+
+        // A short read is an error too, the file got shorter
+        if ( data.size() != length )
+        {
+            abortFileTransfer( m_sendFile.error() != QFileDevice::NoError ? m_sendFile.errorString() : "the file was truncated" );
+            return;
+        }
+
+        m_httpsock->write( data );
+    }
+
+    m_sendOffset += length;
+
+    if ( m_sendOffset >= m_sendSize )
+        finishFileTransfer();
+}
+
+void ActionHandler_WebServer_Socket::sendFileWritable()
+{
+    // Enabled again by sendFileData() if the buffer fills up again
+    m_sendNotifier->setEnabled( false );
+    sendFileData();
+}
+
+void ActionHandler_WebServer_Socket::abortFileTransfer( const QString &reason )
+{
+    // The header with Content-Length is sent already, so all we can do is to close the connection
+    Logger::error( "WebServer: error sending %s: %s", qPrintable(m_sendFile.fileName()), qPrintable(reason) );
+    m_closing = true;
+    m_httpsock->disconnectFromHost();
+    finishFileTransfer();
+}
+
+void ActionHandler_WebServer_Socket::finishFileTransfer()
+{
+    if ( m_sendNotifier )
+        m_sendNotifier->setEnabled( false );
+
+    if ( m_sendMap )
+        m_sendFile.unmap( m_sendMap );
+
+    m_sendMap = 0;
+    m_sendFile.close();
+    m_fileTransfer = false;
+
+    if ( m_closing )
+        return;
+
+    responseSent();
+
+    // The client might have sent more requests meanwhile
+    handlePending();
+}
+
+void ActionHandler_WebServer_Socket::upgradeWebSocket()
+{
+    QByteArray accept = QCryptographicHash::hash( m_webSocketKey + WEBSOCKET_GUID, QCryptographicHash::Sha1 ).toBase64();
+
+    m_httpsock->write( "HTTP/1.1 101 Switching Protocols\r\n"
+                       "Upgrade: websocket\r\n"
+                       "Connection: Upgrade\r\n"
+                       "Sec-WebSocket-Accept: " + accept + "\r\n"
+                       "\r\n" );
+
+    m_webSocket = true;
+    m_idleTimer.start( WEBSOCKET_PING_INTERVAL );
+
+    // Both live in the web server thread, so this is a direct call
+    connect( m_server, &ActionHandler_WebServer::webSocketEvent, this, &ActionHandler_WebServer_Socket::sendWebSocketEvent );
+
+    Logger::debug( "WebServer: connection upgraded to WebSocket" );
+}
+
+bool ActionHandler_WebServer_Socket::handleWebSocketFrame()
+{
+    WebSocketFrame frame;
+    int frameSize = 0;
+
+    switch ( frame.parse( m_httpRequest, WEBSOCKET_MAX_FRAME_SIZE, frameSize ) )
+    {
+        case WebSocketFrame::RESULT_INCOMPLETE:
+            return false;
+
+        case WebSocketFrame::RESULT_INVALID:
+            Logger::error( "WebServer: invalid WebSocket frame received, closing" );
+            m_closing = true;
+            m_httpsock->disconnectFromHost();
+            return false;
+
+        case WebSocketFrame::RESULT_COMPLETE:
+            break;
+    }
+
+    m_httpRequest.remove( 0, frameSize );
+
+    // Nothing we expect from the clients needs more than one frame, so fragmented messages are refused
+    if ( !frame.fin || frame.opcode == WebSocketFrame::OPCODE_CONTINUATION )
+    {
+        Logger::error( "WebServer: fragmented WebSocket message received, closing" );
+
+        QByteArray status;
+        status.append( (char) (WEBSOCKET_CLOSE_UNSUPPORTED_DATA >> 8) );
+        status.append( (char) (WEBSOCKET_CLOSE_UNSUPPORTED_DATA & 0xFF) );
+
+        m_httpsock->write( WebSocketFrame::build( WebSocketFrame::OPCODE_CLOSE, status ) );
+        m_closing = true;
+        m_httpsock->disconnectFromHost();
+        return false;
+    }
+
+    switch ( frame.opcode )
+    {
+        case WebSocketFrame::OPCODE_CLOSE:
+            // Echo the close, and we're done
+            m_httpsock->write( WebSocketFrame::build( WebSocketFrame::OPCODE_CLOSE, frame.payload.left( 2 ) ) );
+            m_closing = true;
+            m_httpsock->disconnectFromHost();
+            return false;
+
+        case WebSocketFrame::OPCODE_PING:
+            m_httpsock->write( WebSocketFrame::build( WebSocketFrame::OPCODE_PONG, frame.payload ) );
+            break;
+
+        default:
+            // Pongs, and there is nothing we expect from clients as data
+            break;
+    }
+
+    return true;
+}
+
+void ActionHandler_WebServer_Socket::sendWebSocketEvent( QByteArray frame )
+{
+    if ( !m_closing )
+        m_httpsock->write( frame );
+}
+
+void ActionHandler_WebServer_Socket::sendTooManyRequests( int retryAfter )
+{
+    QByteArray header = "HTTP/1.1 429 Too Many Requests\r\n"
+              "Retry-After: " + QByteArray::number( retryAfter ) + "\r\n"
+            + "Content-Length: 0\r\n"
+            + connectionHeader()
+            + "\r\n";
+
+    m_httpsock->write( header );
+    responseSent();
+}
+
+void ActionHandler_WebServer_Socket::sendUpgradeRequired()
+{
+    QByteArray header = "HTTP/1.1 426 Upgrade Required\r\n"
+              "Sec-WebSocket-Version: " + QByteArray( WEBSOCKET_VERSION ) + "\r\n"
+            + "Content-Length: 0\r\n"
+            + connectionHeader()
+            + "\r\n";
+
+    m_httpsock->write( header );
+    responseSent();
+}
+
+QByteArray ActionHandler_WebServer_Socket::connectionHeader() const
+{
+    return m_keepAlive ? "Connection: keep-alive\r\n" : "Connection: Close\r\n";
 }
 
 void ActionHandler_WebServer_Socket::sendError(int code)
 {
     QByteArray errormsg = "HTTP/1.0 " + QByteArray::number( code ) + " error\r\n\r\n";
 
+    // The request might not be fully read, so we cannot continue with this connection
+    m_closing = true;
     m_httpsock->write( errormsg );
     m_httpsock->flush();
     m_httpsock->disconnectFromHost();
 }
 
-void ActionHandler_WebServer_Socket::sendData(const QByteArray &data, const QByteArray &type, const QByteArray &extraheader)
+QByteArray ActionHandler_WebServer_Socket::compressData( QByteArray &data, const QByteArray &type )
+{
+    if ( pSettings->httpCompressMinSize == 0 || data.size() < (int) pSettings->httpCompressMinSize )
+        return "";
+
+    if ( !m_acceptGzip && !m_acceptDeflate )
+        return "";
+
+    if ( !WebServerStaticCache::isCompressibleType( type ) )
+        return "";
+
+    QByteArray compressed;
+    QByteArray encoding;
+
+    if ( m_acceptGzip )
+    {
+        compressed = Util::gzipCompress( data );
+        encoding = "gzip";
+    }
+    else
+    {
+        // HTTP deflate is the zlib stream, which qCompress returns after the 4-byte length
+        compressed = qCompress( data ).mid( 4 );
+        encoding = "deflate";
+    }
+
+    // Not worth it
+    if ( compressed.isEmpty() || compressed.size() >= data.size() )
+        return "";
+
+    m_server->addCompressionStats( data.size(), compressed.size() );
+    data = compressed;
+
+    return "Content-Encoding: " + encoding + "\r\n";
+}
+
+void ActionHandler_WebServer_Socket::sendData(const QByteArray &origdata, const QByteArray &type, const QByteArray &extraheader)
 {
+    QByteArray data = origdata;
+    QByteArray encodingheader = compressData( data, type );
+
     QByteArray header = "HTTP/1.1 200 ok\r\n"
               "Content-Length: " + QByteArray::number( data.length() ) + "\r\n"
             + "Content-Type: " + type + "\r\n"
-            + "Connection: Close\r\n"
+            + encodingheader
+            + "Vary: Accept-Encoding\r\n"
+            + connectionHeader()
             + "Expires: Thu, 01 Jan 1970 00:00:01 GMT\r\n";
 
     if ( !extraheader.isEmpty() )
@@ -315,6 +982,18 @@ void ActionHandler_WebServer_Socket::sendData(const QByteArray &data, const QByt
 
     m_httpsock->write( header );
     m_httpsock->write( data );
+    responseSent();
+}
+
+void ActionHandler_WebServer_Socket::responseSent()
+{
+    if ( m_keepAlive )
+    {
+        m_idleTimer.start( idleTimeoutMsec() );
+        return;
+    }
+
+    m_closing = true;
     m_httpsock->disconnectFromHost();
 }
 
@@ -323,11 +1002,13 @@ void ActionHandler_WebServer_Socket::redirect(const QString &url)
     // Redirect to the login page
     QByteArray header = "HTTP/1.1 302 Moved\r\n"
               "Location: " + url.toLatin1() + "\r\n"
-              "Expires: Thu, 01 Jan 1970 00:00:01 GMT"
+              "Content-Length: 0\r\n"
+            + connectionHeader()
+            + "Expires: Thu, 01 Jan 1970 00:00:01 GMT"
               "\r\n\r\n";
 
     m_httpsock->write( header );
-    m_httpsock->disconnectFromHost();
+    responseSent();
 }
 
 bool ActionHandler_WebServer_Socket::search( QJsonDocument& document )
@@ -339,28 +1020,54 @@ bool ActionHandler_WebServer_Socket::search( QJsonDocument& document )
 
     Logger::debug("WebServer: searching database for %s", qPrintable(obj["query"].toString()));
 
-    QList< Database_SongInfo > results;
-    QJsonArray out;
+    dispatchToWorker( &ActionHandler_WebServer_Socket::searchResults, obj );
+    return true;
+}
 
-    if ( pDatabase->search( obj["query"].toString(), results ) )
-    {
-        Q_FOREACH( const Database_SongInfo& res, results )
+class ActionHandler_WebServer_Socket::StreamResultSink : public Database_ResultSink
+{
+    public:
+        StreamResultSink( ActionHandler_WebServer_Stream * stream )
         {
-            QJsonObject rec;
+            m_stream = stream;
+        }
 
-            rec[ "id" ] = res.id;
-            rec[ "artist" ] = escapeHTML( res.artist );
-            rec[ "title"] = escapeHTML( res.title );
-            rec[ "type"] = res.type;
-            rec[ "rating"] = res.rating;
-            rec[ "language"] = escapeHTML( res.language );
+        bool    songRow( const Database_SongInfo& song )
+        {
+            writeSong( m_stream->json(), song );
+            return m_stream->rowWritten();
+        }
 
-            out.append( rec );
+        bool    artistRow( const QString& artist )
+        {
+            m_stream->json().value( escapeHTML( artist ) );
+            return m_stream->rowWritten();
         }
-    }
 
-    sendData( QJsonDocument( out ).toJson() );
-    return true;
+    private:
+        ActionHandler_WebServer_Stream * m_stream;
+};
+
+void ActionHandler_WebServer_Socket::searchResults( QJsonObject request, ActionHandler_WebServer_Stream * stream )
+{
+    JsonStreamWriter& json = stream->json();
+    StreamResultSink sink( stream );
+
+    json.beginArray();
+    pDatabase->search( request["query"].toString(), sink );
+    json.endArray();
+}
+
+void ActionHandler_WebServer_Socket::writeSong( JsonStreamWriter &json, const Database_SongInfo &song )
+{
+    json.beginObject();
+    json.member( "id", song.id );
+    json.member( "artist", escapeHTML( song.artist ) );
+    json.member( "title", escapeHTML( song.title ) );
+    json.member( "type", song.type );
+    json.member( "rating", song.rating );
+    json.member( "language", escapeHTML( song.language ) );
+    json.endObject();
 }
 
 bool ActionHandler_WebServer_Socket::addsong( QJsonDocument& document )
@@ -538,50 +1245,31 @@ bool ActionHandler_WebServer_Socket::queueControl(QJsonDocument &document)
 
 bool ActionHandler_WebServer_Socket::listDatabase(QJsonDocument &document)
 {
-    QJsonObject obj = document.object();
-    QJsonArray out;
-    QString type;
+    dispatchToWorker( &ActionHandler_WebServer_Socket::browseResults, document.object() );
+    return true;
+}
+
+void ActionHandler_WebServer_Socket::browseResults( QJsonObject obj, ActionHandler_WebServer_Stream * stream )
+{
+    JsonStreamWriter& json = stream->json();
+
+    json.beginObject();
 
     if ( obj.contains( "artist" ) )
     {
         QString artist = obj["artist"].toString();
 
-        // List songs by artist or by letter
-        if ( artist.length() == 1 )
-        {
-            QStringList artists;
-
-            pDatabase->browseArtists( artist[0], artists );
+        json.member( "type", "songs" );
+        json.name( "results" );
+        json.beginArray();
 
-            Q_FOREACH( const QString& a, artists )
-            {
-                out.append( escapeHTML( a ) );
-            }
+        // List songs by artist or by letter
+        StreamResultSink sink( stream );
 
-            type = "artists";
-        }
+        if ( artist.length() == 1 )
+            pDatabase->browseArtists( artist[0], sink );
         else
-        {
-            QList<Database_SongInfo> results;
-
-            pDatabase->browseSongs( artist, results );
-
-            Q_FOREACH( const Database_SongInfo& res, results )
-            {
-                QJsonObject rec;
-
-                rec[ "id" ] = res.id;
-                rec[ "artist" ] = escapeHTML( res.artist );
-                rec[ "title"] = escapeHTML( res.title );
-                rec[ "type"] = res.type;
-                rec[ "rating"] = res.rating;
-                rec[ "language"] = escapeHTML( res.language );
-
-                out.append( rec );
-            }
-        }
-
-        type = "songs";
+            pDatabase->browseSongs( artist, sink );
     }
     else
     {
@@ -590,20 +1278,18 @@ bool ActionHandler_WebServer_Socket::listDatabase(QJsonDocument &document)
 
         pDatabase->browseInitials( initials );
 
+        json.member( "type", "initials" );
+        json.name( "results" );
+        json.beginArray();
+
         Q_FOREACH( QChar ch, initials )
         {
-            out.append( QString(ch) );
+            json.value( QString(ch) );
         }
-
-        type = "initials";
     }
 
-    QJsonObject outobj;
-    outobj["results"] = out;
-    outobj["type"] = type;
-
-    sendData( QJsonDocument( outobj ).toJson() );
-    return true;
+    json.endArray();
+    json.endObject();
 }
 
 bool ActionHandler_WebServer_Socket::controlStatus(QJsonDocument &)
@@ -637,7 +1323,7 @@ bool ActionHandler_WebServer_Socket::controlStatus(QJsonDocument &)
         else
             outobj["voiceremoval"] = "disabled";
 
-        outobj["song"] = escapeHTML( m_currentSong );
+        outobj["song"] = escapeHTML( "\"" + m_server->currentSong().title + "\" by " + m_server->currentSong().artist );
     }
     else
         outobj["state"] = "stopped";
@@ -739,6 +1425,10 @@ bool ActionHandler_WebServer_Socket::collectionInfo(QJsonDocument &)
     outobj["artists"] = (int) pCurrentState->m_databaseArtists;
     outobj["updated"] = pCurrentState->m_databaseUpdatedDateTime;
 
+    // Only present if a collection scan has been running
+    if ( !m_server->scanStatistics().isEmpty() )
+        outobj["scan"] = m_server->scanStatistics();
+
     sendData( QJsonDocument( outobj ).toJson() );
     return true;
 }
@@ -750,9 +1440,6 @@ bool ActionHandler_WebServer_Socket::collectionControl(QJsonDocument &document)
     if ( !obj.contains( "a" ) )
         return false;
 
-    // We connect it now as we would use it only in this member
-    connect( this, SIGNAL( startKaraokeScan()), pMainWindow, SLOT(karaokeDatabaseStartScan()), Qt::QueuedConnection );
-
     QString action = obj.value( "a" ).toString();
 
     if ( action == "rescan" )
@@ -20,18 +20,29 @@
 #define ACTIONHANDLER_WEBSERVER_SOCKET_H
 
 #include <QObject>
+#include <QFile>
+#include <QTimer>
+#include <QPointer>
 #include <QTcpSocket>
+#include <QSocketNotifier>
+#include <QJsonObject>
 
 #include "songqueue.h"
+#include "httprequestparser.h"
+#include "actionhandler_webserver_stream.h"
 
 class QTcpSocket;
+class ActionHandler_WebServer;
+class WebServerStaticFile;
+class Database_SongInfo;
 
 class ActionHandler_WebServer_Socket : public QObject
 {
     Q_OBJECT
 
     public:
-        ActionHandler_WebServer_Socket( QTcpSocket * httpsock, const SongQueueItem& m_currentSong );
+        // The connection is persistent, and handles the requests until the client or idle timeout closes it
+        ActionHandler_WebServer_Socket( QTcpSocket * httpsock, ActionHandler_WebServer * server );
         ~ActionHandler_WebServer_Socket();
 
     signals:
@@ -43,8 +54,74 @@ class ActionHandler_WebServer_Socket : public QObject
 
     private slots:
         void    readyRead();
+        void    idleTimeout();
+
+        // Sends the event pushed by the web server to this WebSocket client
+        void    sendWebSocketEvent( QByteArray frame );
+
+        // Sends the next part of the large file once the socket is ready for it
+        void    sendFileData();
+
+        // The socket buffer has room again after sendfile() could not send more
+        void    sendFileWritable();
+
+        // Response parts from the worker thread, and the end of it
+        void    streamData( QByteArray data );
+        void    streamFinished( QByteArray data );
+        void    streamAborted();
+
+        // Lets the worker continue once the socket sent most of the streamed data
+        void    streamDataSent();
 
     private:
+        // Handles the request at the beginning of m_httpRequest (requests could be pipelined).
+        // Returns true if the request was handled and the next one could be handled, false
+        // if more data is needed or the connection is closing.
+        bool    handleRequest();
+
+        // Handles the received requests (or WebSocket frames) unless we're busy or closing
+        void    handlePending();
+
+        // Routes the completely received request
+        void    processRequest( const QByteArray& requestbody );
+
+        // Runs the handler producing the response in the worker pool if enabled, or right away otherwise.
+        // The following requests on this connection wait until the response is sent.
+        void    dispatchToWorker( ActionHandler_WebServer_Stream::Handler handler, const QJsonObject& request );
+
+        // Switches the connection to WebSocket protocol for the event push channel
+        void    upgradeWebSocket();
+
+        // Handles the WebSocket frame at the beginning of m_httpRequest. Returns true if
+        // the frame was handled, false if more data is needed or the connection is closing.
+        bool    handleWebSocketFrame();
+
+        // Called once the response is sent: closes the connection if not persistent
+        void    responseSent();
+
+        // Compresses the data if the client accepts it, and it is worth compressing.
+        // Returns the Content-Encoding header if compressed, or empty string otherwise.
+        QByteArray compressData( QByteArray& data, const QByteArray& type );
+
+        // Sends the static file, or 304 if the client has it cached already
+        void    sendStaticFile( const WebServerStaticFile& file );
+
+        // Starts sending the large file from disk in parts; the header is already sent
+        void    startFileTransfer( const QString& path, qint64 size );
+        void    finishFileTransfer();
+
+        // The file couldn't be sent completely; logs the reason and drops the connection
+        void    abortFileTransfer( const QString& reason );
+
+        // Replies with 429 as the client exceeded the rate limit; the connection stays usable
+        void    sendTooManyRequests( int retryAfter );
+
+        // Replies with 426 to a WebSocket upgrade with the version we do not support
+        void    sendUpgradeRequired();
+
+        // Connection header according to whether the connection is persistent
+        QByteArray connectionHeader() const;
+
         // Sends an error code, and closes the socket
         void    sendError( int code );
 
@@ -57,6 +134,16 @@ class ActionHandler_WebServer_Socket : public QObject
         bool    queueList( QJsonDocument& document );
         bool    queueControl( QJsonDocument& document );
         bool    listDatabase( QJsonDocument& document );
+
+        // Those run in the worker threads, so they must only use the request and the database
+        static void searchResults( QJsonObject request, ActionHandler_WebServer_Stream * stream );
+        static void browseResults( QJsonObject request, ActionHandler_WebServer_Stream * stream );
+
+        // Writes the song as JSON object
+        static void writeSong( JsonStreamWriter& json, const Database_SongInfo& song );
+
+        // Writes the database rows into the stream while the query is running
+        class StreamResultSink;
         bool    controlStatus( QJsonDocument& document );
         bool    controlAdjust( QJsonDocument& document );
         bool    controlAction( QJsonDocument& document );
@@ -65,7 +152,7 @@ class ActionHandler_WebServer_Socket : public QObject
         bool    settingsGet( QJsonDocument& document );
         bool    settingsSet( QJsonDocument& document );
 
-        QString escapeHTML( QString orig );
+        static QString escapeHTML( QString orig );
 
         // True if the currently logged user is a Karaoke admin
         bool    isAdministrator();
@@ -78,16 +165,69 @@ class ActionHandler_WebServer_Socket : public QObject
         void    redirect( const QString& url );
 
         QTcpSocket *    m_httpsock;
+        ActionHandler_WebServer * m_server;
+
+        // Client address, for the connection and rate limits
+        QString         m_clientAddress;
+
+        // Closes the persistent connection if no requests come in
+        QTimer          m_idleTimer;
+
+        // Whether the connection stays open after the current request, and whether it is closing
+        bool            m_keepAlive;
+        bool            m_closing;
+
+        // Whether the client accepts the compressed responses (Accept-Encoding)
+        bool            m_acceptGzip;
+        bool            m_acceptDeflate;
+
+        // Request being handled by the worker pool; the connection is busy until it is done
+        bool            m_workerBusy;
+
+        // Whether the chunked response is being sent
+        bool            m_streamStarted;
+
+        // Response being produced by the worker, and the part of it written into the socket but not yet
+        // reported as sent (the worker waits if this gets large)
+        QPointer<ActionHandler_WebServer_Stream>    m_stream;
+        qint64          m_streamUnacked;
+
+        // Large file being sent; the connection is busy until it is done. On Linux it is sent with sendfile()
+        // without copying it at all, unless it fails; elsewhere the file is memory mapped if possible.
+        QFile           m_sendFile;
+        uchar       *   m_sendMap;
+        qint64          m_sendOffset;
+        qint64          m_sendSize;
+        bool            m_fileTransfer;
+        bool            m_sendCopy;
+
+        // Waits for the socket to become writable when sendfile() fills its buffer (Linux only)
+        QSocketNotifier *   m_sendNotifier;
+
+        // Whether the client talks HTTP/1.1 (and thus supports chunked responses)
+        bool            m_http11;
+
+        // WebSocket key and version from the upgrade request, and whether the connection is upgraded
+        QByteArray      m_webSocketKey;
+        QByteArray      m_webSocketVersion;
+        bool            m_webSocket;
+
+        // Whether we sent a WebSocket ping, and haven't heard from the client since
+        bool            m_pingSent;
+
+        // Conditional request headers for the static files
+        QByteArray      m_ifNoneMatch;
+        QString         m_ifModifiedSince;
 
-        // Http request body with headers
+        // Received data not yet consumed by the parser (or WebSocket frames once upgraded)
         QByteArray      m_httpRequest;
+        HttpRequestParser   m_parser;
 
-        // Parsing header results. If url is non-empty, header is parsed
+        // Parsing header results, valid once the header is handled
+        bool            m_headersHandled;
         QString         m_url;
         QString         m_loggedName;
         QString         m_method;
-        unsigned int    m_contentLength;
-        QString         m_currentSong;
 
 };
 
@@ -0,0 +1,92 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include "actionhandler_webserver_stream.h"
+
+// Size of the parts passed to the connection when streaming
+static const int STREAM_CHUNK_SIZE = 16384;
+
+// How much data could be passed to the connection and not sent yet before the handler waits
+static const qint64 STREAM_MAX_UNSENT = STREAM_CHUNK_SIZE * 4;
+
+// How long the handler waits for a client which doesn't read anything before giving up, in milliseconds
+static const unsigned long STREAM_SEND_TIMEOUT = 30000;
+
+ActionHandler_WebServer_Stream::ActionHandler_WebServer_Stream( bool streamed )
+    : QObject()
+{
+    m_streamed = streamed;
+    m_unsent = 0;
+    m_cancelled = false;
+}
+
+void ActionHandler_WebServer_Stream::run( Handler handler, QJsonObject request, ActionHandler_WebServer_Stream *stream )
+{
+    handler( request, stream );
+
+    stream->m_sentMutex.lock();
+    bool cancelled = stream->m_cancelled;
+    stream->m_sentMutex.unlock();
+
+    if ( cancelled )
+        emit stream->aborted();
+    else
+        emit stream->finished( stream->m_json.takeData() );
+
+    // Might be called from the worker thread; the connection might be gone by now as well
+    stream->deleteLater();
+}
+
+bool ActionHandler_WebServer_Stream::rowWritten()
+{
+    if ( !m_streamed || m_json.size() < STREAM_CHUNK_SIZE )
+        return true;
+
+    QByteArray data = m_json.takeData();
+
+    m_sentMutex.lock();
+    m_unsent += data.size();
+    m_sentMutex.unlock();
+
+    emit dataReady( data );
+
+    // Do not get ahead of a slow client, so the response doesn't pile up in memory
+    QMutexLocker m( &m_sentMutex );
+
+    while ( m_unsent > STREAM_MAX_UNSENT && !m_cancelled )
+    {
+        if ( !m_sentCond.wait( &m_sentMutex, STREAM_SEND_TIMEOUT ) )
+            m_cancelled = true;
+    }
+
+    return !m_cancelled;
+}
+
+void ActionHandler_WebServer_Stream::dataSent( qint64 bytes )
+{
+    QMutexLocker m( &m_sentMutex );
+    m_unsent -= bytes;
+    m_sentCond.wakeAll();
+}
+
+void ActionHandler_WebServer_Stream::cancel()
+{
+    QMutexLocker m( &m_sentMutex );
+    m_cancelled = true;
+    m_sentCond.wakeAll();
+}
@@ -0,0 +1,84 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef ACTIONHANDLER_WEBSERVER_STREAM_H
+#define ACTIONHANDLER_WEBSERVER_STREAM_H
+
+#include <QMutex>
+#include <QObject>
+#include <QJsonObject>
+#include <QWaitCondition>
+
+#include "jsonstreamwriter.h"
+
+//
+// Passes the JSON response produced by a worker thread to the connection. If the response is streamed,
+// the data is passed in parts while it is being written, so the connection can send it right away
+// as chunked output instead of waiting for the whole response. The object lives in the connection
+// thread, and deletes itself once finished.
+//
+class ActionHandler_WebServer_Stream : public QObject
+{
+    Q_OBJECT
+
+    public:
+        ActionHandler_WebServer_Stream( bool streamed );
+
+        // Handler producing the response into the stream
+        typedef void (*Handler)( QJsonObject request, ActionHandler_WebServer_Stream * stream );
+
+        // Runs the handler and finishes the stream; this is what runs in the worker thread
+        static void run( Handler handler, QJsonObject request, ActionHandler_WebServer_Stream * stream );
+
+        // The response is written here
+        JsonStreamWriter&   json() { return m_json; }
+
+        // Should be called by the handler after each written row; passes the data if enough is accumulated.
+        // While too much of the passed data is not sent yet, waits for the client to read it. Returns false
+        // if the response is no longer needed (the connection is closed, or the client stopped reading),
+        // so the handler should stop.
+        bool    rowWritten();
+
+        // Called by the connection once the data passed via dataReady is sent (or mostly so)
+        void    dataSent( qint64 bytes );
+
+        // Called by the connection if it is closed, so the handler stops at the next row
+        void    cancel();
+
+    signals:
+        // Part of the streamed response is available (only if streamed)
+        void    dataReady( QByteArray data );
+
+        // The response is complete; the data is the rest (or all of it if not streamed)
+        void    finished( QByteArray data );
+
+        // The handler was stopped by cancel() or because the client stopped reading; the response is incomplete
+        void    aborted();
+
+    private:
+        bool                m_streamed;
+        JsonStreamWriter    m_json;
+
+        // Amount of data passed via dataReady and not sent yet, and whether the response is cancelled
+        QMutex              m_sentMutex;
+        QWaitCondition      m_sentCond;
+        qint64              m_unsent;
+        bool                m_cancelled;
+};
+
+#endif // ACTIONHANDLER_WEBSERVER_STREAM_H
@@ -1,4 +1,5 @@
 #include <QJsonValue>
+#include <QJsonArray>
 
 #include "collectionentry.h"
 
@@ -11,6 +12,7 @@ CollectionEntry::CollectionEntry()
     scanZips = false;
     lastScanned = -1;
     ignoreSSLerrors = false;
+    scanThreads = 1;
 }
 
 QJsonObject CollectionEntry::toJson() const
@@ -34,6 +36,10 @@ QJsonObject CollectionEntry::toJson() const
     out[ "detectLanguage" ] = detectLanguage;
     out[ "scanZips" ] = scanZips;
     out[ "artistTitleSeparator" ] = artistTitleSeparator;
+    out[ "scanThreads" ] = scanThreads;
+
+    if ( !artistTitlePatterns.isEmpty() )
+        out[ "artistTitlePatterns" ] = QJsonArray::fromStringList( artistTitlePatterns );
 
     if ( !defaultLanguage.isEmpty() )
         out[ "defaultLanguage" ] = defaultLanguage;
@@ -56,7 +62,13 @@ void CollectionEntry::fromJson(const QJsonObject &data)
     detectLanguage = data.value( "detectLanguage" ).toBool( false );
     scanZips = data.value( "scanZips" ).toBool( false );
     artistTitleSeparator = data.value( "artistTitleSeparator" ).toString();
+    scanThreads = data.value( "scanThreads" ).toInt( 1 );
     defaultLanguage = data.value( "defaultLanguage" ).toString();
     lastScanned = data.value( "lastScanned" ).toString("-1").toLongLong();
     ignoreSSLerrors = data.value( "ignoreSSLerrors" ).toBool( false );
+
+    artistTitlePatterns.clear();
+
+    Q_FOREACH( const QJsonValue& v, data.value( "artistTitlePatterns" ).toArray() )
+        artistTitlePatterns.push_back( v.toString() );
 }
@@ -2,6 +2,7 @@
 #define COLLECTIONENTRY_H
 
 #include <QJsonObject>
+#include <QStringList>
 #include "collectionprovider.h"
 
 class CollectionEntry
@@ -45,6 +46,14 @@ class CollectionEntry
         // Collection artist and title separator (to detect artist/title from filenames)
         QString     artistTitleSeparator;
 
+        // Patterns such as "{artist}/{skip}/{skip} - {title}" to detect artist/title from file paths
+        // (see SongPathPattern). Tried in order before the separator above, which is used if none matches.
+        QStringList artistTitlePatterns;
+
+        // Number of directories listed concurrently when scanning the collection.
+        // Values above 1 speed up the scan of network-mounted (NFS, SMB) collections a lot.
+        int         scanThreads;
+
         // Last time full scan was performed on this collection. -1 - never
         time_t      lastScanned;
 
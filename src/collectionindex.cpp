@@ -0,0 +1,166 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QDataStream>
+#include <QStringList>
+#include <QCryptographicHash>
+
+#include "collectionindex.h"
+
+// Binary collection index signature and the latest supported version (see create_collection_index.py)
+static const char BINARY_INDEX_MAGIC[] = "SPIVAKIX";
+static const int BINARY_INDEX_MAGIC_LENGTH = 8;
+static const int BINARY_INDEX_VERSION = 2;
+static const int BINARY_INDEX_CHECKSUM_LENGTH = 20;
+
+
+// Reads a length-prefixed UTF-8 string from the binary index
+static bool readIndexString( QDataStream& stream, QString& value )
+{
+    quint32 length;
+    stream >> length;
+
+    if ( stream.status() != QDataStream::Ok || length > stream.device()->bytesAvailable() )
+        return false;
+
+    QByteArray data( length, Qt::Uninitialized );
+
+    if ( stream.readRawData( data.data(), length ) != (int) length )
+        return false;
+
+    value = QString::fromUtf8( data );
+    return true;
+}
+
+bool CollectionIndex::isBinary( const QByteArray &data )
+{
+    return data.startsWith( BINARY_INDEX_MAGIC );
+}
+
+bool CollectionIndex::parseBinary( const QByteArray &data, quint32 &indexVersion, QList<Entry> &entries, QString &errmsg )
+{
+    indexVersion = 0;
+    entries.clear();
+
+    // The index ends with the SHA-1 checksum of everything before it, which we verify first
+    if ( !isBinary( data ) || data.size() < BINARY_INDEX_MAGIC_LENGTH + 4 + BINARY_INDEX_CHECKSUM_LENGTH )
+    {
+        errmsg = "index is truncated";
+        return false;
+    }
+
+    QByteArray content = QByteArray::fromRawData( data.constData(), data.size() - BINARY_INDEX_CHECKSUM_LENGTH );
+
+    if ( QCryptographicHash::hash( content, QCryptographicHash::Sha1 ) != data.right( BINARY_INDEX_CHECKSUM_LENGTH ) )
+    {
+        errmsg = "checksum mismatch";
+        return false;
+    }
+
+    QDataStream stream( content );
+    stream.setByteOrder( QDataStream::BigEndian );
+    stream.skipRawData( BINARY_INDEX_MAGIC_LENGTH );
+
+    quint16 version, flags;
+    stream >> version >> flags;
+
+    if ( version > BINARY_INDEX_VERSION )
+    {
+        errmsg = QString( "version %1 is not supported" ).arg( version );
+        return false;
+    }
+
+    // Version 2 adds the index version
+    quint32 indexver = 0;
+
+    if ( version >= 2 )
+        stream >> indexver;
+
+    // Artist string table
+    quint32 count;
+    stream >> count;
+
+    // Each string takes at least four bytes, which protects us from allocating based on a bogus count
+    if ( stream.status() != QDataStream::Ok || count > stream.device()->bytesAvailable() / 4 )
+    {
+        errmsg = "invalid artist table";
+        return false;
+    }
+
+    QStringList artists;
+    artists.reserve( count );
+
+    for ( quint32 i = 0; i < count; i++ )
+    {
+        QString artist;
+
+        if ( !readIndexString( stream, artist ) )
+        {
+            errmsg = "invalid artist table";
+            return false;
+        }
+
+        artists.push_back( artist );
+    }
+
+    // Entries; each takes at least 24 bytes (artist index and five strings)
+    stream >> count;
+
+    if ( stream.status() != QDataStream::Ok || count > stream.device()->bytesAvailable() / 24 )
+    {
+        errmsg = "invalid entry count";
+        return false;
+    }
+
+    QList<Entry> parsed;
+    parsed.reserve( count );
+
+    for ( quint32 i = 0; i < count; i++ )
+    {
+        quint32 artistidx;
+        Entry entry;
+
+        stream >> artistidx;
+
+        if ( stream.status() != QDataStream::Ok
+             || artistidx >= (quint32) artists.size()
+             || !readIndexString( stream, entry.title )
+             || !readIndexString( stream, entry.filePath )
+             || !readIndexString( stream, entry.musicPath )
+             || !readIndexString( stream, entry.type )
+             || !readIndexString( stream, entry.language ) )
+        {
+            errmsg = QString( "invalid entry %1" ).arg( i );
+            return false;
+        }
+
+        entry.artist = artists[ artistidx ];
+        parsed.push_back( entry );
+    }
+
+    // Anything left means the counts do not match the content
+    if ( !stream.atEnd() )
+    {
+        errmsg = "unexpected data after the entries";
+        return false;
+    }
+
+    indexVersion = indexver;
+    entries = parsed;
+    return true;
+}
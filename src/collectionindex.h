@@ -0,0 +1,54 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef COLLECTIONINDEX_H
+#define COLLECTIONINDEX_H
+
+#include <QList>
+#include <QString>
+#include <QByteArray>
+
+//
+// Reads the binary collection index (index.dat created by create_collection_index.py -b). The index is
+// parsed completely and its checksum verified before anything is returned, so a truncated or corrupted
+// download is rejected as a whole. Does not depend on the rest of the player, so it could be tested alone.
+//
+class CollectionIndex
+{
+    public:
+        // Index entry; paths are relative to the collection root
+        class Entry
+        {
+            public:
+                QString     artist;
+                QString     title;
+                QString     filePath;
+                QString     musicPath;
+                QString     type;
+                QString     language;
+        };
+
+        // Whether the data looks like the binary index (has its signature)
+        static bool isBinary( const QByteArray& data );
+
+        // Parses the binary index. Returns false and sets errmsg if the index is truncated, corrupted
+        // or of unsupported version. indexVersion is set to the index version (0 if not present).
+        static bool parseBinary( const QByteArray& data, quint32& indexVersion, QList<Entry>& entries, QString& errmsg );
+};
+
+#endif // COLLECTIONINDEX_H
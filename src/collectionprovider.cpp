@@ -1,3 +1,6 @@
+#include <QTimer>
+#include <QEventLoop>
+
 #include "settings.h"
 #include "collectionprovider.h"
 #include "collectionproviderfs.h"
@@ -7,6 +10,9 @@ CollectionProvider::CollectionProvider(int id, QObject *parent)
     : QObject( parent )
 {
     collectionID = id;
+    m_waitLoop = 0;
+    m_waitAbort = 0;
+    m_waitDone = false;
 }
 
 CollectionProvider::~CollectionProvider()
@@ -58,6 +64,83 @@ void CollectionProvider::download(int id, const QString &url, QIODevice *local)
     retrieveMultiple( id, urls, files );
 }
 
+QString CollectionProvider::downloadAndWait( const QString &url, QIODevice *local, const QAtomicInt *abort )
+{
+    m_waitDone = false;
+    m_waitError.clear();
+    m_waitAbort = abort;
+
+    connect( this, SIGNAL(finished(int,QString)), this, SLOT(waitFinished(int,QString)) );
+
+    download( 1, url, local );
+
+    // Some providers are always synchronous, so we might be done already
+    if ( !m_waitDone )
+    {
+        QEventLoop loop;
+        m_waitLoop = &loop;
+
+        // The abort flag is not a signal, so it is checked periodically
+        QTimer abortTimer;
+        connect( &abortTimer, SIGNAL(timeout()), this, SLOT(waitCheckAbort()) );
+
+        if ( abort )
+            abortTimer.start( 100 );
+
+        loop.exec( QEventLoop::ExcludeUserInputEvents );
+        m_waitLoop = 0;
+    }
+
+    disconnect( this, SIGNAL(finished(int,QString)), this, SLOT(waitFinished(int,QString)) );
+    m_waitAbort = 0;
+
+    return m_waitError;
+}
+
+void CollectionProvider::waitFinished( int, QString errmsg )
+{
+    m_waitDone = true;
+    m_waitError = errmsg;
+
+    if ( m_waitLoop )
+        m_waitLoop->quit();
+}
+
+void CollectionProvider::waitCheckAbort()
+{
+    if ( !m_waitAbort || m_waitAbort->load() == 0 || m_waitDone )
+        return;
+
+    // Normally this results in finished() with error, but not every provider can be cancelled
+    cancel();
+
+    if ( !m_waitDone )
+        waitFinished( 0, tr("Download is cancelled") );
+}
+
+void CollectionProvider::cancel()
+{
+}
+
+void CollectionProvider::setValidators( const QString &, const QString & )
+{
+}
+
+bool CollectionProvider::notModified() const
+{
+    return false;
+}
+
+QString CollectionProvider::etag() const
+{
+    return QString();
+}
+
+QString CollectionProvider::lastModified() const
+{
+    return QString();
+}
+
 void CollectionProvider::downloadAll(int id, const QList<QString> &urls, QList<QIODevice *> locals)
 {
     retrieveMultiple( id, urls, locals );
@@ -4,6 +4,9 @@
 #include <QThread>
 #include <QObject>
 #include <QIODevice>
+#include <QAtomicInt>
+
+class QEventLoop;
 
 // The role of the provider class is to provide the data files for the player.
 // Player can only play files which are stored locally, but some collections
@@ -46,10 +49,36 @@ class CollectionProvider : public QObject
         // all files are downloaded.
         void    downloadAll( int id, const QList<QString>& urls, QList<QIODevice *> locals );
 
+        // Same as download() but returns once the file is retrieved, with an empty string if succeed,
+        // or the error message. Runs an event loop in the calling thread (which must be the provider
+        // thread) while waiting, so the wait doesn't use CPU. If abort flag is provided and becomes
+        // non-zero, the download is cancelled. The finished() signal is still emitted.
+        QString downloadAndWait( const QString& url, QIODevice * local, const QAtomicInt * abort = 0 );
+
+        // Aborts the download in progress, if any. finished() is emitted with an error.
+        // Default implementation does nothing (synchronous providers are never in progress).
+        virtual void cancel();
+
+        // Conditional retrieval: the next download() only retrieves the file if it was modified since the
+        // version identified by those validators (etag() and lastModified() from the previous download).
+        // If it was not, finished() is emitted without error and notModified() returns true.
+        // Default implementation ignores the validators (the file is always retrieved).
+        virtual void    setValidators( const QString& etag, const QString& lastModified );
+        virtual bool    notModified() const;
+
+        // Validators of the last retrieved file; empty if not supported or not provided
+        virtual QString etag() const;
+        virtual QString lastModified() const;
+
     signals:
         void    finished( int id, QString errormsg );
         void    progress( int id, int percentage );
 
+    private slots:
+        // Used by downloadAndWait
+        void    waitFinished( int id, QString errmsg );
+        void    waitCheckAbort();
+
     protected:
         // Makes the files available locally (for example by downloading it) from
         // those URLs, and store them in the provided QIODevices.
@@ -63,6 +92,13 @@ class CollectionProvider : public QObject
 
         // Collection ID which the collection was created with. -1 if it was created without ID.
         int     collectionID;
+
+    private:
+        // State of downloadAndWait
+        QEventLoop        * m_waitLoop;
+        const QAtomicInt  * m_waitAbort;
+        bool                m_waitDone;
+        QString             m_waitError;
 };
 
 #endif // COLLECTIONPROVIDER_H
@@ -9,6 +9,11 @@ CollectionProviderHTTP::CollectionProviderHTTP(int id, QObject *parent)
     : CollectionProvider(id, parent), m_qnam(parent)
 {
     m_credentialsSent = false;
+    m_notModified = false;
+
+    // Connected once, as the provider is used for several downloads
+    connect( &m_qnam, &QNetworkAccessManager::authenticationRequired, this, &CollectionProviderHTTP::httpAuthenticationRequired );
+    connect( &m_qnam, &QNetworkAccessManager::sslErrors, this, &CollectionProviderHTTP::httpsslErrors );
 }
 
 bool CollectionProviderHTTP::isLocalProvider() const
@@ -27,7 +32,13 @@ void CollectionProviderHTTP::retrieveMultiple(int id, const QList<QString> &urls
     if ( files.size() != urls.size() )
         abort();
 
+    // The previous download's requests refer to its devices, which may be gone by now
+    cleanup();
+
     m_id = id;
+    m_notModified = false;
+    m_replyETag.clear();
+    m_replyLastModified.clear();
 
     for ( int i = 0; i < files.size(); i++ )
     {
@@ -39,25 +50,76 @@ void CollectionProviderHTTP::retrieveMultiple(int id, const QList<QString> &urls
         reqdata.bytesTotal = 0;
         reqdata.finished = false;
 
+        QNetworkRequest request( QUrl(urls[i]) );
+
+        // Validators only make sense for a single file
+        if ( files.size() == 1 )
+        {
+            if ( !m_requestETag.isEmpty() )
+                request.setRawHeader( "If-None-Match", m_requestETag.toUtf8() );
+
+            if ( !m_requestLastModified.isEmpty() )
+                request.setRawHeader( "If-Modified-Since", m_requestLastModified.toUtf8() );
+        }
+
         // This starts the request and uses the main event loop
-        reqdata.reply = m_qnam.get( QNetworkRequest( QUrl(urls[i]) ) );
+        reqdata.reply = m_qnam.get( request );
 
         m_state[ reqdata.reply ] = reqdata;
 
         connect( reqdata.reply, &QNetworkReply::finished, this, &CollectionProviderHTTP::httpFinished);
         connect( reqdata.reply, &QIODevice::readyRead, this, &CollectionProviderHTTP::httpReadyRead);
         connect( reqdata.reply, &QNetworkReply::downloadProgress, this, &CollectionProviderHTTP::httpProgress );
-        connect( &m_qnam, &QNetworkAccessManager::authenticationRequired, this, &CollectionProviderHTTP::httpAuthenticationRequired );
-        connect( &m_qnam, &QNetworkAccessManager::sslErrors, this, &CollectionProviderHTTP::httpsslErrors );
 
         Logger::debug( "Initiating download for %s into %p (nr %p)", qPrintable( reqdata.url), reqdata.file, reqdata.reply);
     }
+
+    // Validators only apply to the download they were set for
+    m_requestETag.clear();
+    m_requestLastModified.clear();
+}
+
+void CollectionProviderHTTP::cancel()
+{
+    // abort() emits finished() for the reply with OperationCanceledError, which reports the error
+    Q_FOREACH( const RequestData& d, m_state.values() )
+    {
+        if ( !d.finished )
+            d.reply->abort();
+    }
+}
+
+void CollectionProviderHTTP::setValidators( const QString &etag, const QString &lastModified )
+{
+    m_requestETag = etag;
+    m_requestLastModified = lastModified;
+}
+
+bool CollectionProviderHTTP::notModified() const
+{
+    return m_notModified;
+}
+
+QString CollectionProviderHTTP::etag() const
+{
+    return m_replyETag;
+}
+
+QString CollectionProviderHTTP::lastModified() const
+{
+    return m_replyLastModified;
 }
 
 void CollectionProviderHTTP::cleanup()
 {
     Q_FOREACH( const RequestData& d, m_state )
     {
+        // Nothing from the old replies may reach their devices or the state of the new download
+        disconnect( d.reply, 0, this, 0 );
+
+        if ( !d.finished )
+            d.reply->abort();
+
         d.reply->deleteLater();
     }
 
@@ -90,6 +152,18 @@ void CollectionProviderHTTP::httpFinished()
     // Non-error - set the finished flag
     m_state[ reply ].finished = true;
 
+    // 304 is only returned for the conditional request, which is always a single file; the file is left empty
+    if ( reply->attribute( QNetworkRequest::HttpStatusCodeAttribute ).toInt() == 304 )
+    {
+        Logger::debug( "HTTP file %s was not modified", qPrintable( m_state[ reply ].url ) );
+        m_notModified = true;
+    }
+    else
+    {
+        m_replyETag = QString::fromUtf8( reply->rawHeader( "ETag" ) );
+        m_replyLastModified = QString::fromUtf8( reply->rawHeader( "Last-Modified" ) );
+    }
+
     m_state[ reply ].file->close();
     // Is everything finished?
     Q_FOREACH( const RequestData& d, m_state )
@@ -24,6 +24,15 @@ class CollectionProviderHTTP : public CollectionProvider
         // Returns the provider type
         virtual Type type() const;
 
+        // Aborts all the requests in progress
+        virtual void cancel();
+
+        // Conditional retrieval via If-None-Match/If-Modified-Since (only for a single file)
+        virtual void    setValidators( const QString& etag, const QString& lastModified );
+        virtual bool    notModified() const;
+        virtual QString etag() const;
+        virtual QString lastModified() const;
+
     protected:
         // Implemented in subclasses. Should download one or more files syncrhonously,
         // and return when everything is downloaded. With non-zero ID should also
@@ -55,6 +64,13 @@ class CollectionProviderHTTP : public CollectionProvider
         QNetworkAccessManager m_qnam;
         QMap< QNetworkReply *, RequestData >  m_state;
         bool    m_credentialsSent;
+
+        // Validators sent with the request, and those received with the reply
+        QString m_requestETag;
+        QString m_requestLastModified;
+        QString m_replyETag;
+        QString m_replyLastModified;
+        bool    m_notModified;
 };
 
 #endif // COLLECTIONPROVIDERHTTP_H
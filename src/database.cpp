@@ -38,6 +38,30 @@ static const int CURRENT_DB_SCHEMA_VERSION = 1;
 Database * pDatabase;
 
 
+// Collects the rows for the queries returning the lists
+class Database_SongListSink : public Database_ResultSink
+{
+    public:
+        Database_SongListSink( QList<Database_SongInfo>& results ) : m_results( results ) {}
+
+        bool    songRow( const Database_SongInfo& song ) { m_results.append( song ); return true; }
+
+    private:
+        QList<Database_SongInfo>&   m_results;
+};
+
+class Database_ArtistListSink : public Database_ResultSink
+{
+    public:
+        Database_ArtistListSink( QStringList& artists ) : m_artists( artists ) {}
+
+        bool    artistRow( const QString& artist ) { m_artists.append( artist ); return true; }
+
+    private:
+        QStringList&    m_artists;
+};
+
+
 Database::Database(QObject *parent)
     : QObject( parent )
 {
@@ -103,6 +127,33 @@ bool Database::songByPath(const QString &path, Database_SongInfo &info)
     return true;
 }
 
+bool Database::knownSongs( QHash<QString, SongDatabaseScanner::KnownSongEntry> &songs )
+{
+    Database_Statement stmt;
+
+    songs.clear();
+
+    if ( !stmt.prepare( m_sqlitedb, "SELECT rowid, path, strftime('%s', added), artist, title, type, language, collectionid FROM songs" ) )
+        return false;
+
+    while ( stmt.step() == SQLITE_ROW )
+    {
+        SongDatabaseScanner::KnownSongEntry entry;
+
+        entry.id = stmt.columnInt64( 0 );
+        entry.added = stmt.columnInt64( 2 );
+        entry.collectionId = stmt.columnInt( 7 );
+
+        // Same check as the scanner did with songByPath
+        entry.complete = !stmt.columnText( 3 ).isEmpty() && !stmt.columnText( 4 ).isEmpty()
+                        && !stmt.columnText( 5 ).isEmpty() && !stmt.columnText( 6 ).isEmpty();
+
+        songs.insert( stmt.columnText( 1 ), entry );
+    }
+
+    return true;
+}
+
 void Database::updatePlayedSong(int id, int newdelay, int newrating)
 {
     if ( execute( "BEGIN TRANSACTION" ) )
@@ -142,39 +193,71 @@ bool Database::browseArtists(const QChar &artistInitial, QStringList &artists)
 {
     artists.clear();
 
+    Database_ArtistListSink sink( artists );
+    return browseArtists( artistInitial, sink );
+}
+
+bool Database::browseArtists( const QChar &artistInitial, Database_ResultSink &sink )
+{
     Database_Statement stmt;
 
     if ( !stmt.prepare( m_sqlitedb, "SELECT DISTINCT(artist) FROM songs WHERE artist LIKE ? ORDER BY artist", QStringList() << QString("%1%%") .arg(artistInitial) ) )
         return false;
 
+    bool found = false;
+
     while ( stmt.step() == SQLITE_ROW )
-        artists.append( stmt.columnText(0) );
+    {
+        found = true;
+
+        if ( !sink.artistRow( stmt.columnText(0) ) )
+            break;
+    }
 
-    return !artists.empty();
+    return found;
 }
 
 bool Database::browseSongs(const QString &artist, QList<Database_SongInfo> &results)
 {
     results.clear();
 
+    Database_SongListSink sink( results );
+    return browseSongs( artist, sink );
+}
+
+bool Database::browseSongs( const QString &artist, Database_ResultSink &sink )
+{
     Database_Statement stmt;
 
     if ( !stmt.prepareSongQuery( m_sqlitedb, "WHERE artist=? ORDER BY title", QStringList() << artist ) )
         return false;
 
+    bool found = false;
+
     while ( stmt.step() == SQLITE_ROW )
-        results.append( stmt.getRowSongInfo() );
+    {
+        found = true;
 
-    return !results.empty();
+        if ( !sink.songRow( stmt.getRowSongInfo() ) )
+            break;
+    }
+
+    return found;
 }
 
-bool Database::updateDatabase(const QList<SongDatabaseScanner::SongDatabaseEntry> entries)
+bool Database::updateDatabase(const QList<SongDatabaseScanner::SongDatabaseEntry> entries, const QAtomicInt *abort)
 {
     if ( !execute( "BEGIN TRANSACTION" ) )
         return false;
 
     Q_FOREACH( const SongDatabaseScanner::SongDatabaseEntry& e, entries )
     {
+        if ( abort && abort->load() )
+        {
+            execute( "ROLLBACK TRANSACTION" );
+            return false;
+        }
+
         // We use a separate search field since sqlite is not necessary built with full Unicode support (nor we want it to be)
         QString search = e.artist.toUpper() + " " + e.title.toUpper();
         QString path = e.filePath;
@@ -197,6 +280,29 @@ bool Database::updateDatabase(const QList<SongDatabaseScanner::SongDatabaseEntry
     return execute( "COMMIT TRANSACTION" );
 }
 
+bool Database::removeSongs( const QStringList &paths, const QAtomicInt *abort )
+{
+    if ( !execute( "BEGIN TRANSACTION" ) )
+        return false;
+
+    Q_FOREACH( const QString& path, paths )
+    {
+        if ( abort && abort->load() )
+        {
+            execute( "ROLLBACK TRANSACTION" );
+            return false;
+        }
+
+        if ( !execute( "DELETE FROM songs WHERE path=?", QStringList() << path ) )
+        {
+            execute( "ROLLBACK TRANSACTION" );
+            return false;
+        }
+    }
+
+    return execute( "COMMIT TRANSACTION" );
+}
+
 bool Database::updateLastScan()
 {
     return execute( "UPDATE settings SET lastupdated=DATETIME()" );
@@ -248,7 +354,7 @@ qint64 Database::getArtistCount() const
     return 0;
 }
 
-bool Database::cleanupCollections()
+bool Database::cleanupCollections(const QAtomicInt *abort)
 {
     Database_Statement stmt;
 
@@ -260,6 +366,13 @@ bool Database::cleanupCollections()
 
     while ( stmt.step() == SQLITE_ROW )
     {
+        // Checking the files could take a while on network filesystems
+        if ( abort && abort->load() )
+        {
+            execute( "ROLLBACK TRANSACTION" );
+            return false;
+        }
+
         int colid = stmt.columnInt( 2 );
 
         // If collection exists but not a filesystem we skip the check
@@ -368,6 +481,12 @@ bool Database::search(const QString &substr, QList<Database_SongInfo> &results,
 {
     results.clear();
 
+    Database_SongListSink sink( results );
+    return search( substr, sink, limit );
+}
+
+bool Database::search( const QString &substr, Database_ResultSink &sink, unsigned int limit )
+{
     Database_Statement stmt;
 
     // Tokenize and process the search substring
@@ -391,16 +510,17 @@ bool Database::search(const QString &substr, QList<Database_SongInfo> &results,
     if ( !stmt.prepareSongQuery( m_sqlitedb, query, searchdata ) )
         return false;
 
+    bool found = false;
+
     while ( stmt.step() == SQLITE_ROW )
     {
-        Database_SongInfo info = stmt.getRowSongInfo();
-        results.append( info );
+        found = true;
 
-        if ( --limit == 0 )
+        if ( !sink.songRow( stmt.getRowSongInfo() ) || --limit == 0 )
             break;
     }
 
-    return !results.empty();
+    return found;
 }
 
 QJsonObject Database::getSongParams(int id)
@@ -27,6 +27,7 @@
 
 #include "songdatabasescanner.h"
 #include "database_songinfo.h"
+#include "database_resultsink.h"
 
 
 struct sqlite3;
@@ -48,12 +49,18 @@ class Database : public QObject
         // Search for a substring in artists and titles
         bool    search( const QString& substr, QList<Database_SongInfo>& results, unsigned int limit = 1000 );
 
+        // Same, but each row is passed to the sink as soon as it is read (see Database_ResultSink)
+        bool    search( const QString& substr, Database_ResultSink& sink, unsigned int limit = 1000 );
+
         // Queries the song by ID
         bool    songById( int id, Database_SongInfo& info );
 
         // Queries the song by path
         bool    songByPath( const QString& path, Database_SongInfo& info );
 
+        // Retrieves all songs in the database mapped by path in a single query (for collection scan)
+        bool    knownSongs( QHash<QString, SongDatabaseScanner::KnownSongEntry>& songs );
+
         // Updates the song playing stats and delay
         void    updatePlayedSong( int id, int newdelay, int newrating );
 
@@ -62,10 +69,18 @@ class Database : public QObject
         bool    browseArtists( const QChar& artistInitial, QStringList& artists );
         bool    browseSongs( const QString& artist, QList<Database_SongInfo>& results );
 
-        // Add/update database entries from the list in a single transaction
-        bool    updateDatabase( const QList<SongDatabaseScanner::SongDatabaseEntry> entries );
+        // Same as above, but each row is passed to the sink as soon as it is read (see Database_ResultSink)
+        bool    browseArtists( const QChar& artistInitial, Database_ResultSink& sink );
+        bool    browseSongs( const QString& artist, Database_ResultSink& sink );
+
+        // Add/update database entries from the list in a single transaction.
+        // If abort flag is provided and becomes non-zero, the transaction is rolled back and false is returned
+        bool    updateDatabase( const QList<SongDatabaseScanner::SongDatabaseEntry> entries, const QAtomicInt * abort = 0 );
         bool    updateLastScan();
 
+        // Removes the songs by their database paths (such as listed by the collection index delta)
+        bool    removeSongs( const QStringList& paths, const QAtomicInt * abort = 0 );
+
         // Empty the database
         bool    clearDatabase();
 
@@ -73,7 +88,8 @@ class Database : public QObject
         void    resetLastDatabaseUpdate();
 
         // Goes through all collections and removes the songs which are missing from disk. Takes a while, run in a separate thread!
-        bool    cleanupCollections();
+        // Could be aborted the same way as updateDatabase
+        bool    cleanupCollections( const QAtomicInt * abort = 0 );
 
         // Gets the database information to current state
         void    getDatabaseCurrentState();
@@ -0,0 +1,40 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef DATABASE_RESULTSINK_H
+#define DATABASE_RESULTSINK_H
+
+#include <QString>
+
+#include "database_songinfo.h"
+
+//
+// Receives the query results row by row while the statement is being stepped through, so they could be
+// processed (such as sent to a web client) without collecting all of them first. Each call returns false
+// to stop the query; the rows not needed are then not read at all.
+//
+class Database_ResultSink
+{
+    public:
+        virtual ~Database_ResultSink() {}
+
+        virtual bool    songRow( const Database_SongInfo& song ) { Q_UNUSED( song ); return true; }
+        virtual bool    artistRow( const QString& artist ) { Q_UNUSED( artist ); return true; }
+};
+
+#endif // DATABASE_RESULTSINK_H
@@ -21,6 +21,7 @@
 
 #include <QObject>
 #include <QString>
+#include <QJsonObject>
 
 #include "songqueue.h"
 
@@ -140,6 +141,10 @@ class Eventor : public QObject
         // Scan in progress, details update
         void    scanCollectionProgress( QString progressinfo );
 
+        // Scan in progress, structured statistics update: counters, queue depths, per-stage timing,
+        // processing rate and ETA. Also sent once the scan is finished, with "running" set to false.
+        void    scanCollectionStatistics( QJsonObject stats );
+
         // Scan finished (either completed or aborted)
         void    scanCollectionFinished();
 
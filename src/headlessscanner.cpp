@@ -0,0 +1,245 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QGuiApplication>
+#include <QCommandLineParser>
+
+#include <stdio.h>
+
+#include "headlessscanner.h"
+#include "songdatabasescanner.h"
+#include "pluginmanager.h"
+#include "actionhandler.h"
+#include "currentstate.h"
+#include "database.h"
+#include "settings.h"
+#include "eventor.h"
+#include "logger.h"
+
+// Exit codes
+static const int EXIT_SCAN_COMPLETED = 0;
+static const int EXIT_SCAN_FAILED = 1;
+static const int EXIT_INVALID_ARGUMENTS = 2;
+static const int EXIT_SCAN_HAD_FAILURES = 3;
+
+// How often the progress is printed, in milliseconds
+static const int PROGRESS_PRINT_INTERVAL = 2000;
+
+
+HeadlessScanner::HeadlessScanner()
+    : QObject()
+{
+    connect( pEventor, &Eventor::scanCollectionStatistics, this, &HeadlessScanner::scanCollectionStatistics, Qt::QueuedConnection );
+    connect( pEventor, &Eventor::scanCollectionFinished, this, &HeadlessScanner::scanCollectionFinished, Qt::QueuedConnection );
+}
+
+int HeadlessScanner::run( int argc, char *argv[] )
+{
+    // The lyrics are measured with the font metrics while scanning, which need the GUI application,
+    // but not the display
+    if ( qgetenv( "QT_QPA_PLATFORM" ).isEmpty() )
+        qputenv( "QT_QPA_PLATFORM", "offscreen" );
+
+    QGuiApplication a( argc, argv );
+
+    // Same as the player so the same settings and database are used by default
+    QCoreApplication::setOrganizationName("ulduzsoft");
+    QCoreApplication::setOrganizationDomain("ulduzsoft.com");
+    QCoreApplication::setApplicationName("spivak");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription( "Scans the karaoke collections into the song database without starting the player" );
+    parser.addHelpOption();
+
+    const QCommandLineOption scanOnlyOption(
+                "scan-only",
+                "Scan the collections and exit"
+                );
+
+    const QCommandLineOption collectionsOption(
+                "collections",
+                "JSON file with the collection definitions (player config file, or an array of collections). "
+                "If not specified, the collections from the player configuration are scanned.",
+                "file"
+                );
+
+    const QCommandLineOption databaseOption(
+                "database",
+                "Song database file to create or update instead of the player database",
+                "file"
+                );
+
+    parser.addOption( scanOnlyOption );
+    parser.addOption( collectionsOption );
+    parser.addOption( databaseOption );
+    parser.process( a );
+
+    Logger::init();
+
+    // Those are required by the scanner and the database
+    pEventor = new Eventor( 0 );
+    pSettings = new Settings();
+    pActionHandler = new ActionHandler();
+    pCurrentState = new CurrentState( 0 );
+    pDatabase = new Database( 0 );
+    pPluginManager = new PluginManager();
+
+    if ( parser.isSet( collectionsOption ) && !loadCollections( parser.value( collectionsOption ) ) )
+        return EXIT_INVALID_ARGUMENTS;
+
+    // Separate database should not share the checkpoint and index state with the player database
+    if ( parser.isSet( databaseOption ) )
+    {
+        pSettings->songdbFilename = parser.value( databaseOption );
+        pSettings->scanCheckpointFilename = pSettings->songdbFilename + ".checkpoint";
+        pSettings->scanIndexStateFilename = pSettings->songdbFilename + ".indexstate";
+    }
+
+    if ( pSettings->collections.isEmpty() )
+    {
+        fprintf( stderr, "No collections to scan\n" );
+        return EXIT_INVALID_ARGUMENTS;
+    }
+
+    if ( !pDatabase->init() )
+    {
+        fprintf( stderr, "Cannot open the song database %s\n", qPrintable( pSettings->songdbFilename ) );
+        return EXIT_SCAN_FAILED;
+    }
+
+    printf( "Scanning %d collections into %s\n", pSettings->collections.size(), qPrintable( pSettings->songdbFilename ) );
+
+    HeadlessScanner headless;
+    SongDatabaseScanner * scanner = new SongDatabaseScanner();
+
+    if ( !scanner->startScan() )
+    {
+        fprintf( stderr, "Collection scan cannot be started as the language detection plugin couldn't be loaded\n" );
+        scanner->stopAndDelete();
+        return EXIT_SCAN_FAILED;
+    }
+
+    int ret = a.exec();
+
+    // If some thread is stuck, it is left running and killed when the process exits
+    scanner->stopAndDelete();
+    return ret;
+}
+
+bool HeadlessScanner::loadCollections( const QString &filename )
+{
+    QFile file( filename );
+
+    if ( !file.open( QIODevice::ReadOnly ) )
+    {
+        fprintf( stderr, "Cannot open %s: %s\n", qPrintable( filename ), qPrintable( file.errorString() ) );
+        return false;
+    }
+
+    QJsonParseError error;
+    QJsonDocument document = QJsonDocument::fromJson( file.readAll(), &error );
+
+    if ( error.error != QJsonParseError::NoError )
+    {
+        fprintf( stderr, "Invalid JSON in %s: %s\n", qPrintable( filename ), qPrintable( error.errorString() ) );
+        return false;
+    }
+
+    // Either the array of collections, or the config file containing it
+    QJsonArray colarray = document.isArray() ? document.array() : document.object().value( "collection" ).toArray();
+
+    pSettings->collections.clear();
+
+    Q_FOREACH( const QJsonValue& v, colarray )
+    {
+        CollectionEntry entry;
+        entry.fromJson( v.toObject() );
+
+        if ( entry.rootPath.isEmpty() )
+        {
+            fprintf( stderr, "Collection %d in %s has no root path\n", entry.id, qPrintable( filename ) );
+            return false;
+        }
+
+        pSettings->collections[ entry.id ] = entry;
+    }
+
+    return true;
+}
+
+void HeadlessScanner::scanCollectionStatistics( QJsonObject stats )
+{
+    m_stats = stats;
+
+    if ( !stats["running"].toBool() || ( m_lastPrinted.isValid() && m_lastPrinted.elapsed() < PROGRESS_PRINT_INTERVAL ) )
+        return;
+
+    m_lastPrinted.start();
+
+    QJsonObject queues = stats["queues"].toObject();
+
+    printf( "%5ds: %d directories, %d found, %d processed, %d submitted, %.1f files/s, queues %d/%d, ETA %ds\n",
+            stats["elapsed"].toInt(),
+            stats["directories"].toInt(),
+            stats["found"].toInt(),
+            stats["processed"].toInt(),
+            stats["submitted"].toInt(),
+            stats["rate"].toDouble(),
+            queues["processing"].toInt(),
+            queues["submitting"].toInt(),
+            stats["eta"].toInt() );
+
+    fflush( stdout );
+}
+
+void HeadlessScanner::scanCollectionFinished()
+{
+    printSummary();
+
+    // Some collections or songs are missing from the database, which should not look like a successful scan
+    qApp->exit( m_stats["failures"].toInt() > 0 ? EXIT_SCAN_HAD_FAILURES : EXIT_SCAN_COMPLETED );
+}
+
+void HeadlessScanner::printSummary()
+{
+    QJsonObject stages = m_stats["stages"].toObject();
+    QJsonObject queues = m_stats["queues"].toObject();
+    int hits = m_stats["languageCacheHits"].toInt();
+    int lookups = hits + m_stats["languageCacheMisses"].toInt();
+
+    printf( "Scan completed in %d seconds\n", m_stats["elapsed"].toInt() );
+    printf( "  Directories scanned:    %d\n", m_stats["directories"].toInt() );
+    printf( "  Karaoke files found:    %d\n", m_stats["found"].toInt() );
+    printf( "  Files processed:        %d\n", m_stats["processed"].toInt() );
+    printf( "  Files submitted:        %d\n", m_stats["submitted"].toInt() );
+    printf( "  Failures:               %d\n", m_stats["failures"].toInt() );
+    printf( "  Average rate:           %.1f files/s\n", m_stats["rate"].toDouble() );
+    printf( "  Enumeration time:       %.0f ms\n", stages["enumerating"].toDouble() );
+    printf( "  Parsing time:           %.0f ms\n", stages["parsing"].toDouble() );
+    printf( "  Language detection:     %.0f ms\n", stages["language"].toDouble() );
+    printf( "  Database submission:    %.0f ms\n", stages["submitting"].toDouble() );
+    printf( "  Largest queue sizes:    processing %d, submitting %d\n", queues["processingPeak"].toInt(), queues["submittingPeak"].toInt() );
+
+    if ( lookups > 0 )
+        printf( "  Language cache hits:    %d of %d (%d%%)\n", hits, lookups, hits * 100 / lookups );
+
+    fflush( stdout );
+}
@@ -0,0 +1,57 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef HEADLESSSCANNER_H
+#define HEADLESSSCANNER_H
+
+#include <QObject>
+#include <QJsonObject>
+#include <QElapsedTimer>
+
+//
+// Runs the collection scan without the GUI (spivak --scan-only), so the database could be built
+// or refreshed on a server, and the scanner performance could be measured. Prints the scan
+// progress and the final statistics to stdout.
+//
+class HeadlessScanner : public QObject
+{
+    Q_OBJECT
+
+    public:
+        HeadlessScanner();
+
+        // Creates the application and performs the scan; returns the process exit code
+        static int  run( int argc, char *argv[] );
+
+    private slots:
+        void    scanCollectionStatistics( QJsonObject stats );
+        void    scanCollectionFinished();
+
+    private:
+        // Reads the collection definitions from a JSON file, either the player config file,
+        // or the array of collections in the same format. Returns false on error.
+        static bool loadCollections( const QString& filename );
+
+        void    printSummary();
+
+        // Last received statistics, and when the progress was last printed
+        QJsonObject     m_stats;
+        QElapsedTimer   m_lastPrinted;
+};
+
+#endif // HEADLESSSCANNER_H
@@ -11,6 +11,13 @@ var backToLetter = false;
 // For confirmation dialog
 var confirmDialogCallback = null;
 
+// WebSocket event channel; null if not connected, and we have to poll
+var eventChannel = null;
+
+// Pending update timers, so the event-triggered updates don't start extra polling chains
+var queueUpdateTimer = null;
+var statusUpdateTimer = null;
+
 
 
 // https://stackoverflow.com/questions/6234773/can-i-escape-html-special-chars-in-javascript
@@ -39,6 +46,12 @@ function runAPI( url, params, cfunc )
                 
                 cfunc(xhttp);
             }
+            else if ( xhttp.status == 429 )
+            {
+                // Rate limited; the server tells us when to retry
+                var retry = parseInt( xhttp.getResponseHeader( "Retry-After" ) ) || 1;
+                setTimeout( function() { runAPI( url, params, cfunc ) }, retry * 1000 );
+            }
             else
             {
                 if ( document.getElementById( "error" ) != null )
@@ -55,6 +68,49 @@ function runAPI( url, params, cfunc )
     xhttp.send( JSON.stringify( params ) );
 }
 
+// Opens the WebSocket event channel, so the server tells us about the changes instead of us polling
+function openEventChannel()
+{
+    if ( !( "WebSocket" in window ) )
+        return;
+
+    var ws = new WebSocket( ( location.protocol === "https:" ? "wss://" : "ws://" ) + location.host + "/api/events" );
+
+    ws.onopen = function()
+    {
+        eventChannel = ws;
+    };
+
+    ws.onmessage = function( msg )
+    {
+        var event = JSON.parse( msg.data );
+
+        if ( event.event === "queue" && currentTab === 'queue' )
+            updateSingerQueue();
+        else if ( event.event === "status" && currentTab === 'control' )
+            soundControlUpdate();
+        else if ( event.event === "volume" && currentTab === 'control' )
+            document.getElementById( "value_volume" ).innerHTML = event.value + "%";
+    };
+
+    ws.onclose = function()
+    {
+        // Fall back to polling, and try to reconnect later
+        var polling = ( eventChannel === null );
+        eventChannel = null;
+
+        if ( !polling )
+        {
+            if ( currentTab === 'queue' )
+                updateSingerQueue();
+            else if ( currentTab === 'control' )
+                soundControlUpdate();
+        }
+
+        setTimeout( function() { openEventChannel() }, 10000 );
+    };
+}
+
 // This function is called if a button is pressed in dialog. value is true if "yes" and false if "no"
 function confirmDialogButton( value )
 {
@@ -355,8 +411,11 @@ function receivedSingerQueue( xhttp )
         
     document.getElementById( "queuedata" ).innerHTML = list;
     
-    if ( currentTab === 'queue' )
-        setTimeout( function() { updateSingerQueue() }, 2000 );
+    // With the event channel we're told when the queue changes
+    clearTimeout( queueUpdateTimer );
+
+    if ( currentTab === 'queue' && eventChannel === null )
+        queueUpdateTimer = setTimeout( function() { updateSingerQueue() }, 2000 );
 }
 
 // Removes a song from the singer queue
@@ -425,8 +484,11 @@ function soundControlUpdateReceived( xhttp )
         document.getElementById( "soundstatus" ).innerHTML = "Player stopped";
     }
 
-    if ( currentTab === 'control' )
-        setTimeout( function() { soundControlUpdate() }, 500 );
+    // With the event channel we're told when the state changes, and only need to poll for the song position
+    clearTimeout( statusUpdateTimer );
+
+    if ( currentTab === 'control' && ( eventChannel === null || obj.state == "playing" ) )
+        statusUpdateTimer = setTimeout( function() { soundControlUpdate() }, eventChannel === null ? 500 : 5000 );
 }
 
 function soundControlUpdate()
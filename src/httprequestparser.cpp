@@ -0,0 +1,367 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <string.h>
+
+#include "httprequestparser.h"
+
+// Token characters (RFC 7230), used in method and header names
+static bool isTokenChar( char ch )
+{
+    if ( ( ch >= 'a' && ch <= 'z' ) || ( ch >= 'A' && ch <= 'Z' ) || ( ch >= '0' && ch <= '9' ) )
+        return true;
+
+    return ch != 0 && strchr( "!#$%&'*+-.^_`|~", ch ) != 0;
+}
+
+static bool isToken( const QByteArray& str )
+{
+    if ( str.isEmpty() )
+        return false;
+
+    for ( int i = 0; i < str.size(); i++ )
+        if ( !isTokenChar( str[i] ) )
+            return false;
+
+    return true;
+}
+
+HttpRequestParser::HttpRequestParser( int maxHeaderSize, int maxBodySize )
+{
+    m_maxHeaderSize = maxHeaderSize;
+    m_maxBodySize = maxBodySize;
+
+    reset();
+}
+
+void HttpRequestParser::reset()
+{
+    m_state = STATE_REQUEST_LINE;
+    m_errorCode = 0;
+    m_headerSize = 0;
+    m_remaining = 0;
+
+    m_line.clear();
+    m_method.clear();
+    m_url.clear();
+    m_version.clear();
+    m_body.clear();
+    m_headers.clear();
+}
+
+int HttpRequestParser::feed( const QByteArray &data )
+{
+    int offset = 0;
+
+    while ( offset < data.size() && m_state != STATE_COMPLETE && m_state != STATE_ERROR )
+    {
+        switch ( m_state )
+        {
+            case STATE_REQUEST_LINE:
+                if ( readLine( data, offset ) )
+                {
+                    // Empty lines before the request line should be ignored (RFC 7230 3.5)
+                    if ( !m_line.isEmpty() && parseRequestLine() )
+                        m_state = STATE_HEADERS;
+
+                    m_line.clear();
+                }
+                break;
+
+            case STATE_HEADERS:
+                if ( readLine( data, offset ) )
+                {
+                    if ( m_line.isEmpty() )
+                        headersDone();
+                    else
+                        parseHeaderLine();
+
+                    m_line.clear();
+                }
+                break;
+
+            case STATE_BODY:
+            case STATE_CHUNK_DATA:
+            {
+                int size = (int) qMin( m_remaining, (qint64) ( data.size() - offset ) );
+
+                m_body.append( data.constData() + offset, size );
+                m_remaining -= size;
+                offset += size;
+
+                if ( m_remaining == 0 )
+                    m_state = m_state == STATE_BODY ? STATE_COMPLETE : STATE_CHUNK_END;
+                break;
+            }
+
+            case STATE_CHUNK_SIZE:
+                if ( readLine( data, offset ) )
+                {
+                    parseChunkSize();
+                    m_line.clear();
+                }
+                break;
+
+            case STATE_CHUNK_END:
+                // Chunk data is followed by CRLF
+                if ( readLine( data, offset ) )
+                {
+                    if ( !m_line.isEmpty() )
+                        setError( 400 );
+                    else
+                        m_state = STATE_CHUNK_SIZE;
+
+                    m_line.clear();
+                }
+                break;
+
+            case STATE_TRAILERS:
+                // Trailer fields are not used, just skip them up to the empty line
+                if ( readLine( data, offset ) )
+                {
+                    if ( m_line.isEmpty() )
+                        m_state = STATE_COMPLETE;
+
+                    m_line.clear();
+                }
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    return offset;
+}
+
+QByteArray HttpRequestParser::header( const QByteArray &lowercasename ) const
+{
+    QByteArray value;
+
+    for ( int i = 0; i < m_headers.size(); i++ )
+    {
+        if ( m_headers[i].first != lowercasename )
+            continue;
+
+        if ( !value.isEmpty() )
+            value += ", ";
+
+        value += m_headers[i].second;
+    }
+
+    return value;
+}
+
+bool HttpRequestParser::keepAlive() const
+{
+    QByteArray connection = header( "connection" ).toLower();
+
+    if ( connection.contains( "close" ) )
+        return false;
+
+    return m_version == "HTTP/1.1" || connection.contains( "keep-alive" );
+}
+
+bool HttpRequestParser::readLine( const QByteArray &data, int &offset )
+{
+    int end = data.indexOf( '\n', offset );
+    int size = ( end == -1 ? data.size() : end ) - offset;
+
+    // The size limit applies to all the lines before the body, including the chunk sizes and trailers
+    m_headerSize += size + ( end == -1 ? 0 : 1 );
+
+    if ( m_headerSize > m_maxHeaderSize )
+    {
+        setError( m_state == STATE_REQUEST_LINE ? 414 : 431 );
+        return false;
+    }
+
+    m_line.append( data.constData() + offset, size );
+
+    if ( end == -1 )
+    {
+        offset = data.size();
+        return false;
+    }
+
+    offset = end + 1;
+
+    // Lines end with CRLF, but a bare LF is accepted as well
+    if ( m_line.endsWith( '\r' ) )
+        m_line.chop( 1 );
+
+    return true;
+}
+
+bool HttpRequestParser::parseRequestLine()
+{
+    // method SP request-target SP HTTP-version
+    int first = m_line.indexOf( ' ' );
+    int last = m_line.lastIndexOf( ' ' );
+
+    if ( first <= 0 || last <= first + 1 )
+    {
+        setError( 400 );
+        return false;
+    }
+
+    m_method = m_line.left( first );
+    m_url = m_line.mid( first + 1, last - first - 1 );
+    m_version = m_line.mid( last + 1 );
+
+    if ( !isToken( m_method ) || m_url.contains( ' ' ) )
+    {
+        setError( 400 );
+        return false;
+    }
+
+    if ( m_version != "HTTP/1.1" && m_version != "HTTP/1.0" )
+    {
+        setError( m_version.startsWith( "HTTP/" ) ? 505 : 400 );
+        return false;
+    }
+
+    return true;
+}
+
+bool HttpRequestParser::parseHeaderLine()
+{
+    // Obsolete line folding is not supported (RFC 7230 3.2.4 allows rejecting it)
+    if ( m_line[0] == ' ' || m_line[0] == '\t' )
+    {
+        setError( 400 );
+        return false;
+    }
+
+    int colon = m_line.indexOf( ':' );
+
+    if ( colon <= 0 )
+    {
+        setError( 400 );
+        return false;
+    }
+
+    QByteArray name = m_line.left( colon ).toLower();
+
+    // No whitespace is allowed between the name and colon, so the token check covers it
+    if ( !isToken( name ) )
+    {
+        setError( 400 );
+        return false;
+    }
+
+    m_headers.append( qMakePair( name, m_line.mid( colon + 1 ).trimmed() ) );
+    return true;
+}
+
+bool HttpRequestParser::headersDone()
+{
+    QByteArray encoding = header( "transfer-encoding" ).toLower();
+
+    if ( !encoding.isEmpty() )
+    {
+        // Chunked must be the final encoding; we do not support any others
+        if ( encoding != "chunked" )
+        {
+            setError( 501 );
+            return false;
+        }
+
+        m_state = STATE_CHUNK_SIZE;
+        return true;
+    }
+
+    QByteArray length = header( "content-length" );
+
+    if ( length.isEmpty() )
+    {
+        m_state = STATE_COMPLETE;
+        return true;
+    }
+
+    // Only digits; the multiple headers must have the same value
+    QList<QByteArray> values = length.split( ',' );
+    bool ok = false;
+    qint64 size = values[0].trimmed().toLongLong( &ok );
+
+    for ( int i = 0; i < values.size() && ok; i++ )
+    {
+        QByteArray v = values[i].trimmed();
+
+        for ( int c = 0; c < v.size(); c++ )
+            if ( v[c] < '0' || v[c] > '9' )
+                ok = false;
+
+        if ( v.toLongLong() != size )
+            ok = false;
+    }
+
+    if ( !ok || values[0].trimmed().isEmpty() )
+    {
+        setError( 400 );
+        return false;
+    }
+
+    if ( size > m_maxBodySize )
+    {
+        setError( 413 );
+        return false;
+    }
+
+    m_remaining = size;
+    m_state = size > 0 ? STATE_BODY : STATE_COMPLETE;
+    return true;
+}
+
+bool HttpRequestParser::parseChunkSize()
+{
+    // Chunk extensions after ';' are ignored
+    QByteArray hex = m_line;
+    int semicolon = hex.indexOf( ';' );
+
+    if ( semicolon != -1 )
+        hex.truncate( semicolon );
+
+    hex = hex.trimmed();
+
+    bool ok = false;
+    qint64 size = hex.toLongLong( &ok, 16 );
+
+    // Prevent overflow by limiting the digits
+    if ( !ok || hex.isEmpty() || hex.size() > 15 || size < 0 )
+    {
+        setError( 400 );
+        return false;
+    }
+
+    if ( m_body.size() + size > m_maxBodySize )
+    {
+        setError( 413 );
+        return false;
+    }
+
+    m_remaining = size;
+    m_state = size > 0 ? STATE_CHUNK_DATA : STATE_TRAILERS;
+    return true;
+}
+
+void HttpRequestParser::setError( int code )
+{
+    m_state = STATE_ERROR;
+    m_errorCode = code;
+}
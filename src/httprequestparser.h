@@ -0,0 +1,114 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef HTTPREQUESTPARSER_H
+#define HTTPREQUESTPARSER_H
+
+#include <QList>
+#include <QPair>
+#include <QByteArray>
+
+//
+// Incremental HTTP/1.x request parser. The data is fed as it comes from the socket, in pieces of any size;
+// the parser consumes only the current request, so the pipelined requests which follow remain with the caller.
+// Supports Content-Length and chunked request bodies, and enforces the header and body size limits.
+//
+class HttpRequestParser
+{
+    public:
+        enum State
+        {
+            STATE_REQUEST_LINE,
+            STATE_HEADERS,
+            STATE_BODY,
+            STATE_CHUNK_SIZE,
+            STATE_CHUNK_DATA,
+            STATE_CHUNK_END,
+            STATE_TRAILERS,
+            STATE_COMPLETE,
+            STATE_ERROR
+        };
+
+        HttpRequestParser( int maxHeaderSize = 16384, int maxBodySize = 1048576 );
+
+        // Prepares for the next request
+        void    reset();
+
+        // Parses the data, and returns the number of bytes consumed. Stops once the request is complete or on error.
+        int     feed( const QByteArray& data );
+
+        State   state() const { return m_state; }
+
+        // True once all the headers are received (the body might still be pending)
+        bool    headersComplete() const { return m_state > STATE_HEADERS && m_state != STATE_ERROR; }
+        bool    isComplete() const { return m_state == STATE_COMPLETE; }
+        bool    hasError() const { return m_state == STATE_ERROR; }
+
+        // HTTP status code to reply with on error
+        int     errorCode() const { return m_errorCode; }
+
+        const QByteArray&   method() const { return m_method; }
+        const QByteArray&   url() const { return m_url; }
+        const QByteArray&   version() const { return m_version; }   // such as HTTP/1.1
+        const QByteArray&   body() const { return m_body; }
+
+        // Headers in order received, names are lowercased
+        const QList< QPair<QByteArray, QByteArray> >& headers() const { return m_headers; }
+
+        // Returns the header value (multiple headers with the same name are joined by comma), or empty if none
+        QByteArray header( const QByteArray& lowercasename ) const;
+
+        // Whether the client wants the connection kept open after this request: HTTP/1.1 connections are
+        // persistent unless the client sends "Connection: close", HTTP/1.0 ones only with "Connection: keep-alive"
+        bool    keepAlive() const;
+
+    private:
+        // Accumulates the line from data starting at offset; returns true once the full line is in m_line
+        bool    readLine( const QByteArray& data, int& offset );
+
+        // Line handlers for the current state; return false on error
+        bool    parseRequestLine();
+        bool    parseHeaderLine();
+        bool    parseChunkSize();
+
+        // Called once the empty line after headers is received
+        bool    headersDone();
+
+        void    setError( int code );
+
+        State           m_state;
+        int             m_errorCode;
+
+        int             m_maxHeaderSize;
+        int             m_maxBodySize;
+
+        // Current incomplete line, and total header size so far
+        QByteArray      m_line;
+        int             m_headerSize;
+
+        // Remaining body/chunk bytes
+        qint64          m_remaining;
+
+        QByteArray      m_method;
+        QByteArray      m_url;
+        QByteArray      m_version;
+        QByteArray      m_body;
+        QList< QPair<QByteArray, QByteArray> >  m_headers;
+};
+
+#endif // HTTPREQUESTPARSER_H
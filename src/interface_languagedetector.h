@@ -21,6 +21,7 @@
 
 #include <QString>
 #include <QByteArray>
+#include <QList>
 #include <QStringList>
 #include <QtPlugin>
 
@@ -38,4 +39,18 @@ class Interface_LanguageDetector
 
 Q_DECLARE_INTERFACE( Interface_LanguageDetector, IID_InterfaceLanguageDetector )
 
+// Optional batch detection, which the detector plugins may export in addition to Interface_LanguageDetector.
+// It is a separate interface so the detectors built without it still load, and are called one text at a time.
+class Interface_LanguageDetectorBatch
+{
+    public:
+        // Detects the language for a number of texts in a single call; returns the list of the same size
+        // in the same order (an entry is empty if the language couldn't be detected)
+        virtual QStringList  detectLanguages( const QList<QByteArray>& data ) = 0;
+};
+
+#define IID_InterfaceLanguageDetectorBatch  "com.ulduzsoft.Skivak.Plugin.LanguageDetectorBatch"
+
+Q_DECLARE_INTERFACE( Interface_LanguageDetectorBatch, IID_InterfaceLanguageDetectorBatch )
+
 #endif // PLUGIN_LANGUAGEDETECTOR_H
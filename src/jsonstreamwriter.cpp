@@ -0,0 +1,127 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include "jsonstreamwriter.h"
+
+JsonStreamWriter::JsonStreamWriter()
+{
+    m_afterName = false;
+}
+
+void JsonStreamWriter::beginArray()
+{
+    separator();
+    m_data.append( '[' );
+    m_empty.append( true );
+}
+
+void JsonStreamWriter::endArray()
+{
+    m_data.append( ']' );
+    m_empty.removeLast();
+}
+
+void JsonStreamWriter::beginObject()
+{
+    separator();
+    m_data.append( '{' );
+    m_empty.append( true );
+}
+
+void JsonStreamWriter::endObject()
+{
+    m_data.append( '}' );
+    m_empty.removeLast();
+}
+
+void JsonStreamWriter::name( const char *key )
+{
+    separator();
+    m_data.append( '"' );
+    m_data.append( key );
+    m_data.append( "\":" );
+    m_afterName = true;
+}
+
+void JsonStreamWriter::value( const QString &str )
+{
+    separator();
+
+    QString escaped;
+    escaped.reserve( str.length() + 2 );
+    escaped.append( '"' );
+
+    for ( int i = 0; i < str.length(); i++ )
+    {
+        QChar ch = str[i];
+
+        if ( ch == '"' )
+            escaped.append( "\\\"" );
+        else if ( ch == '\\' )
+            escaped.append( "\\\\" );
+        else if ( ch == '\n' )
+            escaped.append( "\\n" );
+        else if ( ch == '\r' )
+            escaped.append( "\\r" );
+        else if ( ch == '\t' )
+            escaped.append( "\\t" );
+        else if ( ch.unicode() < 0x20 )
+            escaped.append( QString( "\\u%1" ).arg( ch.unicode(), 4, 16, QChar('0') ) );
+        else
+            escaped.append( ch );
+    }
+
+    escaped.append( '"' );
+    m_data.append( escaped.toUtf8() );
+}
+
+void JsonStreamWriter::value( int num )
+{
+    separator();
+    m_data.append( QByteArray::number( num ) );
+}
+
+void JsonStreamWriter::value( bool val )
+{
+    separator();
+    m_data.append( val ? "true" : "false" );
+}
+
+QByteArray JsonStreamWriter::takeData()
+{
+    QByteArray data = m_data;
+    m_data.clear();
+    return data;
+}
+
+void JsonStreamWriter::separator()
+{
+    if ( m_afterName )
+    {
+        m_afterName = false;
+        return;
+    }
+
+    if ( m_empty.isEmpty() )
+        return;
+
+    if ( !m_empty.last() )
+        m_data.append( ',' );
+
+    m_empty.last() = false;
+}
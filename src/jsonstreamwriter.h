@@ -0,0 +1,72 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef JSONSTREAMWRITER_H
+#define JSONSTREAMWRITER_H
+
+#include <QVector>
+#include <QString>
+#include <QByteArray>
+
+//
+// Writes compact JSON text directly into a buffer, without building a QJsonDocument first.
+// This is used for the large responses, which could be taken out and sent in parts while
+// they're being written. The caller is responsible for calling begin/end in proper order.
+//
+class JsonStreamWriter
+{
+    public:
+        JsonStreamWriter();
+
+        void    beginArray();
+        void    endArray();
+        void    beginObject();
+        void    endObject();
+
+        // Writes the object member name; must be followed by a value or begin*()
+        void    name( const char * key );
+
+        void    value( const QString& str );
+        void    value( const char * str ) { value( QString::fromUtf8( str ) ); }
+        void    value( int num );
+        void    value( bool val );
+
+        // Convenience for object members
+        void    member( const char * key, const QString& str ) { name( key ); value( str ); }
+        void    member( const char * key, int num ) { name( key ); value( num ); }
+
+        // Size of the data written and not yet taken
+        int     size() const { return m_data.size(); }
+
+        // Takes out the data written so far
+        QByteArray takeData();
+
+    private:
+        // Writes the comma if this is not the first value in the current array/object
+        void    separator();
+
+        QByteArray      m_data;
+
+        // For each nesting level, whether it has no values yet
+        QVector<bool>   m_empty;
+
+        // Whether the name was just written, so no separator is needed before the value
+        bool            m_afterName;
+};
+
+#endif // JSONSTREAMWRITER_H
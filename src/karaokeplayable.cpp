@@ -32,6 +32,7 @@ KaraokePlayable::KaraokePlayable(const QString &baseFile, QTextCodec *filenameDe
 {
     m_baseFile = baseFile;
     m_filenameDecoder = filenameDecoder;
+    m_cancelFlag = 0;
 }
 
 
@@ -53,6 +54,16 @@ KaraokePlayable *KaraokePlayable::create(const QString &baseFile, QTextCodec *fi
     return obj;
 }
 
+void KaraokePlayable::setCancelFlag( const QAtomicInt *flag )
+{
+    m_cancelFlag = flag;
+}
+
+bool KaraokePlayable::isCancelled() const
+{
+    return m_cancelFlag && m_cancelFlag->load() != 0;
+}
+
 bool KaraokePlayable::parse()
 {
     // Init typically loads and parses the file for compound formats
@@ -21,6 +21,7 @@
 
 #include <QString>
 #include <QIODevice>
+#include <QAtomicInt>
 
 // Base class encapsulating various Karaoke song objects such as:
 //
@@ -52,6 +53,10 @@ class KaraokePlayable
         // Opens the object as QIODevice, which the caller must delete after it is not used anymore.
         QIODevice * openObject( const QString& object );
 
+        // If set, the long operations (parsing, extraction) check this flag periodically,
+        // and fail as soon as it becomes non-zero. Used to abort collection scan quickly.
+        void        setCancelFlag( const QAtomicInt * flag );
+
         // Must be reimplemented in subclass.
         // Should return true if the file is a compound object (i.e. ZIP), i.e. enumerate returns files IN the object, not NEXT to it
         virtual bool        isCompound() const = 0;
@@ -85,6 +90,9 @@ class KaraokePlayable
         // Converts filename from archive to the Unicode string
         QString decodeFilename( const QByteArray& filename );
 
+        // True if the operation was cancelled via cancel flag
+        bool    isCancelled() const;
+
         KaraokePlayable( const QString& baseFile, QTextCodec *filenameDecoder );
 
         // Must be reimplemented in subclass.
@@ -104,6 +112,9 @@ class KaraokePlayable
 
         // Text decoder for filenames
         QTextCodec* m_filenameDecoder;
+
+        // Cancel flag (could be null)
+        const QAtomicInt *  m_cancelFlag;
 };
 
 #endif // KARAOKEOBJECT_H
@@ -113,6 +113,7 @@ bool KaraokePlayable_KFN::extract(const QString &object, QIODevice *out )
 void KaraokePlayable_KFN::parseOldKarafunFile()
 {
     m_kfnZip = new KaraokePlayable_ZIP( m_baseFile, m_filenameDecoder );
+    m_kfnZip->setCancelFlag( m_cancelFlag );
 
     if ( !m_kfnZip->init() )
         throw QString( "Invalid ZIP file" );
@@ -168,6 +169,10 @@ void KaraokePlayable_KFN::parseNewKarafunFile()
 
     for ( quint32 i = 0; i < totalFiles; i++ )
     {
+        // A corrupted file could have a huge directory
+        if ( isCancelled() )
+            throw QString("cancelled");
+
         Entry entry;
 
         entry.filename = readString( readDword() );
@@ -248,6 +253,12 @@ bool KaraokePlayable_KFN::extractNew(int entryidx, QIODevice *out)
         {
             char buf[32768];
 
+            if ( isCancelled() )
+            {
+                m_errorMsg = "cancelled";
+                return false;
+            }
+
             int toread = qMin( (int) sizeof(buf), entry.length_in - offset );
 
             if ( m_file.read( buf, toread ) != toread )
@@ -273,6 +284,13 @@ bool KaraokePlayable_KFN::extractNew(int entryidx, QIODevice *out)
 
     while ( total_in < entry.length_in )
     {
+        if ( isCancelled() )
+        {
+            m_errorMsg = "cancelled";
+            mbedtls_aes_free( &aesctx );
+            return false;
+        }
+
         int toRead = qMin( (unsigned int)  sizeof(buffer), (unsigned int) entry.length_in - total_in );
         int bytesRead = m_file.read( buffer, toRead );
 
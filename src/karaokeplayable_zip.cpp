@@ -158,6 +158,13 @@ bool KaraokePlayable_ZIP::extract(const QString &object, QIODevice *out)
 
     while ( offset < fileinfo.size )
     {
+        if ( isCancelled() )
+        {
+            m_errorMsg = "cancelled";
+            zip_fclose( zgh );
+            return false;
+        }
+
         int toread = qMin( (qint64) sizeof(buf), (qint64) fileinfo.size - offset );
         int ret = zip_fread( zgh, buf, toread );
 
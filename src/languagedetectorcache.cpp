@@ -0,0 +1,134 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QMutexLocker>
+#include <QCryptographicHash>
+
+#include "languagedetectorcache.h"
+#include "settings.h"
+#include "logger.h"
+#include "util.h"
+
+static const int LANGUAGE_CACHE_VERSION = 1;
+
+
+LanguageDetectorCache::LanguageDetectorCache()
+{
+    m_modified = false;
+}
+
+void LanguageDetectorCache::load()
+{
+    QMutexLocker m( &m_mutex );
+
+    m_cache.clear();
+    m_modified = false;
+
+    QFile fin( cacheFile() );
+
+    if ( !fin.open( QIODevice::ReadOnly ) )
+        return;
+
+    QDataStream dts( &fin );
+    QString header;
+    int version;
+
+    dts >> header >> version;
+
+    if ( header != "LANGUAGECACHE" || version != LANGUAGE_CACHE_VERSION )
+    {
+        Logger::debug( "LanguageDetectorCache: cache file %s is not valid, ignored", qPrintable( fin.fileName() ) );
+        return;
+    }
+
+    QHash<QByteArray, QString> cache;
+    dts >> cache;
+
+    if ( dts.status() != QDataStream::Ok )
+    {
+        Logger::error( "LanguageDetectorCache: cache file %s is corrupted, ignored", qPrintable( fin.fileName() ) );
+        return;
+    }
+
+    m_cache = cache;
+    Logger::debug( "LanguageDetectorCache: loaded %d cached languages", m_cache.size() );
+}
+
+void LanguageDetectorCache::save()
+{
+    QMutexLocker m( &m_mutex );
+
+    if ( !m_modified )
+        return;
+
+    QDir().mkpath( pSettings->cacheDir );
+    QSaveFile fout( cacheFile() );
+
+    if ( !fout.open( QIODevice::WriteOnly ) )
+    {
+        Logger::error( "LanguageDetectorCache: cannot store the cache: %s", qPrintable( fout.errorString() ) );
+        return;
+    }
+
+    QDataStream dts( &fout );
+    dts << QString("LANGUAGECACHE");
+    dts << (int) LANGUAGE_CACHE_VERSION;
+    dts << m_cache;
+
+    if ( fout.commit() )
+        m_modified = false;
+}
+
+QByteArray LanguageDetectorCache::key( const QByteArray &text )
+{
+    return QCryptographicHash::hash( text, QCryptographicHash::Md5 );
+}
+
+bool LanguageDetectorCache::lookup( const QByteArray &key, QString &language )
+{
+    QMutexLocker m( &m_mutex );
+
+    QHash<QByteArray, QString>::const_iterator it = m_cache.constFind( key );
+
+    if ( it == m_cache.constEnd() )
+    {
+        m_misses++;
+        return false;
+    }
+
+    m_hits++;
+    language = it.value();
+    return true;
+}
+
+void LanguageDetectorCache::insert( const QByteArray &key, const QString &language )
+{
+    QMutexLocker m( &m_mutex );
+
+    m_cache[ key ] = language;
+    m_modified = true;
+}
+
+QString LanguageDetectorCache::cacheFile() const
+{
+    return pSettings->cacheDir + Util::separator() + "languages.cache";
+}
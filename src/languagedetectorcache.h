@@ -0,0 +1,66 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef LANGUAGEDETECTORCACHE_H
+#define LANGUAGEDETECTORCACHE_H
+
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QByteArray>
+#include <QAtomicInt>
+
+//
+// Caches the language detection results between the collection scans, so the lyrics which did not change
+// are not sent to the language detector again. Results are keyed by the hash of the lyrics text, so the
+// renamed or touched files are also handled. Thread-safe as used from several processing threads.
+//
+class LanguageDetectorCache
+{
+    public:
+        LanguageDetectorCache();
+
+        // Loads and stores the cache file (in cache directory)
+        void    load();
+        void    save();
+
+        // Returns the key for the lyrics text
+        static QByteArray key( const QByteArray& text );
+
+        // Looks up the language for the key; returns false if not cached
+        bool    lookup( const QByteArray& key, QString& language );
+
+        // Stores the detected language for the key
+        void    insert( const QByteArray& key, const QString& language );
+
+        // Lookup statistics
+        int     hits() const { return m_hits.load(); }
+        int     misses() const { return m_misses.load(); }
+
+    private:
+        QString     cacheFile() const;
+
+        QMutex                      m_mutex;
+        QHash<QByteArray, QString>  m_cache;
+        bool                        m_modified;
+
+        QAtomicInt                  m_hits;
+        QAtomicInt                  m_misses;
+};
+
+#endif // LANGUAGEDETECTORCACHE_H
@@ -22,7 +22,10 @@
 #include <QRect>
 #include <QScreen>
 
+#include <string.h>
+
 #include "actionhandler.h"
+#include "headlessscanner.h"
 #include "mainwindow.h"
 #include "logger.h"
 #include "crashhandler.h"
@@ -32,6 +35,13 @@
 
 int main(int argc, char *argv[])
 {
+    // Headless collection scan needs no display nor widgets, so it is checked before QApplication is created
+    for ( int i = 1; i < argc; i++ )
+    {
+        if ( !strcmp( argv[i], "--scan-only" ) )
+            return HeadlessScanner::run( argc, argv );
+    }
+
     QApplication a(argc, argv);
 
 #if defined (USE_BREAKPAD)
@@ -191,10 +191,7 @@ MainWindow::~MainWindow()
     setScreensaverSuppression( false );
 
     if ( m_songScanner )
-    {
-        m_songScanner->stopScan();
-        delete m_songScanner;
-    }
+        m_songScanner->stopAndDelete();
 
     delete m_queueKaraokeWindow;
     delete m_queueMusicWindow;
@@ -413,8 +410,7 @@ void MainWindow::karaokeDatabaseAbortScan()
     // This will emit finished() but since it is queued, it will return before it gets anywhere
     if ( m_songScanner )
     {
-        m_songScanner->stopScan();
-        delete m_songScanner;
+        m_songScanner->stopAndDelete();
         m_songScanner = 0;
     }
 }
@@ -463,8 +459,12 @@ void MainWindow::scanCollectionProgress( QString progressinfo )
 void MainWindow::scanCollectionFinished()
 {
     statusbar->showMessage( "Collection scan finished", 5000 );
-    delete m_songScanner;
-    m_songScanner = 0;
+
+    if ( m_songScanner )
+    {
+        m_songScanner->stopAndDelete();
+        m_songScanner = 0;
+    }
 }
 
 void MainWindow::generateCrash()
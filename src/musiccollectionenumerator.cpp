@@ -0,0 +1,220 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QDir>
+#include <QFile>
+#include <QFuture>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QtConcurrent>
+
+#include "musiccollectionenumerator.h"
+#include "settings.h"
+#include "logger.h"
+#include "util.h"
+
+static const int MUSIC_CACHE_VERSION = 1;
+
+
+QStringList MusicCollectionEnumerator::enumerate( const QStringList &directories, const QStringList &extensions )
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    DirectoryCache cache = loadCache( extensions );
+
+    // Each root directory is enumerated in its own thread, as they are likely on different disks or shares
+    QThreadPool pool;
+    pool.setMaxThreadCount( qMax( directories.size(), 1 ) );
+
+    QList< QFuture<DirectoryCache> > futures;
+
+    Q_FOREACH( const QString& root, directories )
+        futures.push_back( QtConcurrent::run( &pool, &MusicCollectionEnumerator::enumerateRoot, root, extensions, cache ) );
+
+    DirectoryCache updated;
+    QStringList files;
+
+    for ( int i = 0; i < directories.size(); i++ )
+    {
+        DirectoryCache result = futures[i].result();
+
+        // A root might also be a file
+        if ( result.isEmpty() )
+        {
+            QFileInfo finfo( directories[i] );
+
+            if ( finfo.isFile() )
+                files.push_back( finfo.absoluteFilePath() );
+
+            continue;
+        }
+
+        // Collect the files in the same order as Util::enumerateDirectory does
+        QStringList paths;
+        paths << QFileInfo( directories[i] ).absoluteFilePath();
+
+        while ( !paths.isEmpty() )
+        {
+            QString current = paths.takeFirst();
+            DirectoryCache::const_iterator it = result.constFind( current );
+
+            if ( it == result.constEnd() )
+                continue;
+
+            files += it->files;
+            paths += it->subdirs;
+
+            updated.insert( it.key(), it.value() );
+        }
+    }
+
+    saveCache( extensions, updated );
+
+    Logger::debug( "MusicCollectionEnumerator: %d music files found in %d directories in %d ms",
+                   files.size(), updated.size(), (int) timer.elapsed() );
+
+    return files;
+}
+
+MusicCollectionEnumerator::DirectoryCache MusicCollectionEnumerator::enumerateRoot( const QString &root, const QStringList &extensions, const DirectoryCache &cache )
+{
+    DirectoryCache result;
+    int listed = 0;
+
+    // We do not use recursion, and use the queue-like list instead
+    QStringList paths;
+    paths << QFileInfo( root ).absoluteFilePath();
+
+    while ( !paths.isEmpty() )
+    {
+        QString current = paths.takeFirst();
+        QFileInfo finfo( current );
+
+        // Skip non-existing paths (might come from settings)
+        if ( !finfo.isDir() )
+            continue;
+
+        qint64 modified = finfo.lastModified().toMSecsSinceEpoch();
+
+        // Adding, removing or renaming an entry changes the directory modification time,
+        // so if it is the same, the directory content is the same
+        DirectoryCache::const_iterator it = cache.constFind( current );
+
+        if ( it != cache.constEnd() && it->modified == modified )
+        {
+            result.insert( current, it.value() );
+            paths += it->subdirs;
+            continue;
+        }
+
+        DirectoryEntry entry;
+        entry.modified = modified;
+        listed++;
+
+        Q_FOREACH( const QFileInfo& fi, QDir( current ).entryInfoList( QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot ) )
+        {
+            if ( fi.isDir() )
+            {
+                entry.subdirs.push_back( fi.absoluteFilePath() );
+                continue;
+            }
+
+            if ( extensions.contains( fi.suffix(), Qt::CaseInsensitive ) )
+                entry.files.push_back( fi.absoluteFilePath() );
+        }
+
+        result.insert( current, entry );
+        paths += entry.subdirs;
+    }
+
+    Logger::debug( "MusicCollectionEnumerator: %s has %d directories, %d of them changed", qPrintable( root ), result.size(), listed );
+    return result;
+}
+
+MusicCollectionEnumerator::DirectoryCache MusicCollectionEnumerator::loadCache( const QStringList &extensions )
+{
+    DirectoryCache cache;
+    QFile fin( cacheFile() );
+
+    if ( !fin.open( QIODevice::ReadOnly ) )
+        return cache;
+
+    QDataStream dts( &fin );
+    QString header;
+    int version, count;
+    QStringList cachedExtensions;
+
+    dts >> header >> version;
+
+    if ( header != "MUSICCOLLECTIONCACHE" || version != MUSIC_CACHE_VERSION )
+        return cache;
+
+    dts >> cachedExtensions >> count;
+
+    if ( cachedExtensions != extensions )
+        return cache;
+
+    for ( int i = 0; i < count && dts.status() == QDataStream::Ok; i++ )
+    {
+        QString path;
+        DirectoryEntry entry;
+
+        dts >> path >> entry.modified >> entry.subdirs >> entry.files;
+        cache.insert( path, entry );
+    }
+
+    if ( dts.status() != QDataStream::Ok )
+    {
+        Logger::error( "MusicCollectionEnumerator: cache file %s is corrupted, ignored", qPrintable( fin.fileName() ) );
+        cache.clear();
+    }
+
+    return cache;
+}
+
+void MusicCollectionEnumerator::saveCache( const QStringList &extensions, const DirectoryCache &cache )
+{
+    QDir().mkpath( pSettings->cacheDir );
+    QSaveFile fout( cacheFile() );
+
+    if ( !fout.open( QIODevice::WriteOnly ) )
+    {
+        Logger::error( "MusicCollectionEnumerator: cannot store the cache: %s", qPrintable( fout.errorString() ) );
+        return;
+    }
+
+    QDataStream dts( &fout );
+    dts << QString("MUSICCOLLECTIONCACHE");
+    dts << (int) MUSIC_CACHE_VERSION;
+    dts << extensions;
+    dts << cache.size();
+
+    for ( DirectoryCache::const_iterator it = cache.constBegin(); it != cache.constEnd(); ++it )
+        dts << it.key() << it->modified << it->subdirs << it->files;
+
+    fout.commit();
+}
+
+QString MusicCollectionEnumerator::cacheFile()
+{
+    return pSettings->cacheDir + Util::separator() + "musiccollection.cache";
+}
@@ -0,0 +1,62 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef MUSICCOLLECTIONENUMERATOR_H
+#define MUSICCOLLECTIONENUMERATOR_H
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+//
+// Enumerates the music files in the music collection directories. The directories are enumerated in parallel,
+// and the results are cached together with the directory modification times, so the next enumeration only
+// needs to list the directories which changed (the rest only need a stat() call).
+//
+class MusicCollectionEnumerator
+{
+    public:
+        // Returns the music files from all the directories (and their subdirectories) with one of the extensions.
+        // Takes a while, so is supposed to run in a separate thread.
+        static QStringList enumerate( const QStringList& directories, const QStringList& extensions );
+
+    private:
+        MusicCollectionEnumerator();
+
+        // Cached directory content
+        class DirectoryEntry
+        {
+            public:
+                qint64      modified;   // directory modification time, msec since epoch
+                QStringList subdirs;    // full paths, sorted
+                QStringList files;      // matching files only, full paths, sorted
+        };
+
+        typedef QHash< QString, DirectoryEntry > DirectoryCache;
+
+        // Enumerates a single root directory, reusing the unchanged directories from cache,
+        // and returns the content of all directories under it
+        static DirectoryCache enumerateRoot( const QString& root, const QStringList& extensions, const DirectoryCache& cache );
+
+        // The cache is only valid for the same extensions
+        static DirectoryCache loadCache( const QStringList& extensions );
+        static void saveCache( const QStringList& extensions, const DirectoryCache& cache );
+        static QString cacheFile();
+};
+
+#endif // MUSICCOLLECTIONENUMERATOR_H
@@ -18,6 +18,7 @@
 
 #include <QSettings>
 #include <QTimer>
+#include <QtConcurrent>
 
 #include "settings.h"
 #include "musiccollectionmanager.h"
@@ -27,6 +28,7 @@
 #include "eventor.h"
 #include "logger.h"
 #include "util.h"
+#include "musiccollectionenumerator.h"
 
 MusicCollectionManager * pMusicCollectionMgr;
 
@@ -39,10 +41,13 @@ MusicCollectionManager::MusicCollectionManager( QObject *parent )
 
     m_supportedExtensions << "mp3" << "ogg" << "flac" << "wav" << "wma";
     connect( pEventor, &Eventor::settingsChangedMusic, this, &MusicCollectionManager::initCollection );
+    connect( &m_enumerator, &QFutureWatcher<QStringList>::finished, this, &MusicCollectionManager::collectionEnumerated );
 }
 
 MusicCollectionManager::~MusicCollectionManager()
 {
+    // The enumeration cannot be interrupted, but we should not exit while it writes the cache
+    m_enumerator.waitForFinished();
     delete m_player;
 }
 
@@ -93,6 +98,7 @@ void MusicCollectionManager::initCollection()
     // If we had the collection but now disabled it, remove the player
     if ( pSettings->musicCollections.isEmpty() )
     {
+        m_musicDirectories.clear();
         delete m_player;
         m_player = 0;
 
@@ -116,8 +122,30 @@ void MusicCollectionManager::initCollection()
 
     m_musicDirectories = pSettings->musicCollections;
 
-    // Find the music files
-    Util::enumerateDirectory( m_musicDirectories[0], supportedExtensions(), m_musicFiles );
+    // Find the music files in background, as it takes a while for large collections. If the enumeration
+    // is already running, it is restarted for the new directories once finished.
+    if ( !m_enumerator.isRunning() )
+    {
+        m_enumeratingDirectories = m_musicDirectories;
+        m_enumerator.setFuture( QtConcurrent::run( &MusicCollectionEnumerator::enumerate, m_enumeratingDirectories, supportedExtensions() ) );
+    }
+}
+
+void MusicCollectionManager::collectionEnumerated()
+{
+    // Settings were changed while we were enumerating
+    if ( m_enumeratingDirectories != m_musicDirectories )
+    {
+        if ( !m_musicDirectories.isEmpty() )
+        {
+            m_enumeratingDirectories = m_musicDirectories;
+            m_enumerator.setFuture( QtConcurrent::run( &MusicCollectionEnumerator::enumerate, m_enumeratingDirectories, supportedExtensions() ) );
+        }
+
+        return;
+    }
+
+    m_musicFiles = m_enumerator.result();
     Logger::debug( "Music collection: %d music files found", m_musicFiles.size() );
 
     // If there are no music files, disable the player
@@ -156,6 +184,8 @@ void MusicCollectionManager::initCollection()
     // Notifications
     connect( pEventor, &Eventor::karaokeStarted, this, &MusicCollectionManager::karaokeStarted );
     connect( pEventor, &Eventor::karaokeStopped, this, &MusicCollectionManager::karaokeStopped );
+
+    emit pEventor->musicQueueChanged();
 }
 
 void MusicCollectionManager::start()
@@ -20,6 +20,8 @@
 #define MUSICCOLLECTIONMANAGER_H
 
 #include <QObject>
+#include <QStringList>
+#include <QFutureWatcher>
 
 #include "songqueue.h"
 #include "mediaplayer.h"
@@ -78,6 +80,9 @@ class MusicCollectionManager : public QObject
         // Player loaded the song
         void    songLoaded();
 
+        // Music files enumeration is finished
+        void    collectionEnumerated();
+
     private:
         // Volume setter
         void    setVolume( int percentage, bool notify = true );
@@ -88,6 +93,10 @@ class MusicCollectionManager : public QObject
         // Original music directories from settings
         QStringList     m_musicDirectories;
 
+        // Enumerates the music files in background, and the directories it is enumerating
+        QFutureWatcher<QStringList> m_enumerator;
+        QStringList     m_enumeratingDirectories;
+
         // Songs (files and files from directories) sorted according to settings
         QStringList     m_musicFiles;
 
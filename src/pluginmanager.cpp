@@ -57,6 +57,15 @@ Interface_LanguageDetector *PluginManager::loadLanguageDetector()
     return loadPlugin<Interface_LanguageDetector>( langplugin );
 }
 
+Interface_LanguageDetectorBatch *PluginManager::languageDetectorBatch()
+{
+    // The plugin is loaded already, so this just returns the same instance; not unloaded if the interface is not there
+    QPluginLoader loader( pluginFile( langplugin ) );
+    QObject * instance = loader.instance();
+
+    return instance ? qobject_cast< Interface_LanguageDetectorBatch * > (instance) : 0;
+}
+
 void PluginManager::releaseLanguageDetector()
 {
     pPluginManager->releasePlugin( langplugin );
@@ -77,11 +86,8 @@ void PluginManager::releasePlugin(const QString &name)
         loader.unload();
 }
 
-template <class T> T *PluginManager::loadPlugin(const char *name)
+QString PluginManager::pluginFile( const char *name ) const
 {
-    if ( !pPluginManager )
-        pPluginManager = new PluginManager();
-
 #if defined (Q_OS_WIN)
     const char * pluginextension = ".dll";
 #elif defined (Q_OS_MAC)
@@ -90,7 +96,15 @@ template <class T> T *PluginManager::loadPlugin(const char *name)
     const char * pluginextension = ".so";
 #endif
 
-    QString path = pPluginManager->m_pluginPath + QDir::separator() + name + pluginextension;
+    return m_pluginPath + QDir::separator() + name + pluginextension;
+}
+
+template <class T> T *PluginManager::loadPlugin(const char *name)
+{
+    if ( !pPluginManager )
+        pPluginManager = new PluginManager();
+
+    QString path = pPluginManager->pluginFile( name );
     Logger::debug( "PluginManager: attempting to load plugin %s from %s", name, qPrintable( path ));
     QPluginLoader loader( path );
 
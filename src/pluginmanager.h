@@ -34,6 +34,9 @@ class PluginManager
         Interface_LanguageDetector * loadLanguageDetector();
         void releaseLanguageDetector();
 
+        // Batch interface of the loaded language detector, or null if it doesn't support it
+        Interface_LanguageDetectorBatch * languageDetectorBatch();
+
         // This plugin is only loaded, no unload
         Interface_MediaPlayerPlugin * loadPitchChanger();
 
@@ -44,6 +47,9 @@ class PluginManager
 
         void    releasePlugin( const QString& name );
 
+        // Full path to the plugin library
+        QString pluginFile( const char * name ) const;
+
         QString     m_pluginPath;
 };
 
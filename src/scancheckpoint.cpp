@@ -0,0 +1,143 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+
+#include "scancheckpoint.h"
+
+// Scan checkpoint file version
+static const int CHECKPOINT_VERSION = 3;
+
+
+ScanCheckpoint::ScanCheckpoint()
+{
+    collectionId = -1;
+}
+
+bool ScanCheckpoint::save( const QString &filename, QString &errmsg ) const
+{
+    QSaveFile fout( filename );
+
+    if ( !fout.open( QIODevice::WriteOnly ) )
+    {
+        errmsg = fout.errorString();
+        return false;
+    }
+
+    QDataStream dts( &fout );
+    dts << QString("SCANCHECKPOINT");
+    dts << (int) CHECKPOINT_VERSION;
+    dts << collections;
+    dts << completedCollections;
+    dts << collectionId;
+    dts << frontier;
+    dts << pendingEntries.size();
+
+    Q_FOREACH( const SongDatabaseScanner::SongDatabaseEntry& entry, pendingEntries )
+    {
+        dts << entry.colidx << entry.artist << entry.title << entry.filePath << entry.musicPath
+            << entry.type << entry.language << entry.flags;
+    }
+
+    dts << indexStates.size();
+
+    for ( QMap<int, SongDatabaseScanner::IndexState>::const_iterator it = indexStates.begin(); it != indexStates.end(); ++it )
+        dts << it.key() << it->version << it->etag << it->lastModified;
+
+    dts << indexRemovedPaths;
+
+    if ( !fout.commit() )
+    {
+        errmsg = fout.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+bool ScanCheckpoint::load( const QString &filename, QString &errmsg )
+{
+    errmsg.clear();
+
+    QFile fin( filename );
+
+    if ( !fin.open( QIODevice::ReadOnly ) )
+        return false;
+
+    QDataStream dts( &fin );
+    QString header;
+    int version;
+
+    dts >> header;
+
+    if ( header != "SCANCHECKPOINT" )
+    {
+        errmsg = "not a scan checkpoint";
+        return false;
+    }
+
+    dts >> version;
+
+    if ( version != CHECKPOINT_VERSION )
+    {
+        errmsg = QString( "unsupported version %1" ).arg( version );
+        return false;
+    }
+
+    int pending;
+
+    dts >> collections >> completedCollections >> collectionId >> frontier >> pending;
+
+    pendingEntries.clear();
+
+    for ( int i = 0; i < pending && dts.status() == QDataStream::Ok; i++ )
+    {
+        SongDatabaseScanner::SongDatabaseEntry entry;
+
+        dts >> entry.colidx >> entry.artist >> entry.title >> entry.filePath >> entry.musicPath
+            >> entry.type >> entry.language >> entry.flags;
+
+        pendingEntries.insert( entry.filePath, entry );
+    }
+
+    int states = 0;
+    dts >> states;
+
+    indexStates.clear();
+
+    for ( int i = 0; i < states && dts.status() == QDataStream::Ok; i++ )
+    {
+        int id;
+        SongDatabaseScanner::IndexState state;
+
+        dts >> id >> state.version >> state.etag >> state.lastModified;
+        indexStates[ id ] = state;
+    }
+
+    dts >> indexRemovedPaths;
+
+    if ( dts.status() != QDataStream::Ok || !dts.atEnd() )
+    {
+        errmsg = "checkpoint is corrupted";
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,67 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef SCANCHECKPOINT_H
+#define SCANCHECKPOINT_H
+
+#include <QMap>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QByteArray>
+
+#include "songdatabasescanner.h"
+
+//
+// Collection scan checkpoint: the directories not yet enumerated and the entries found but not yet
+// stored in the database, so an interrupted scan could continue instead of restarting. This is a copy
+// of the scanner state, so it could be written without blocking the scanner threads.
+//
+class ScanCheckpoint
+{
+    public:
+        ScanCheckpoint();
+
+        // Scan settings of each collection by collection ID (see SongDatabaseScanner::collectionScanSettings);
+        // the checkpoint is only valid if they did not change
+        QMap<int, QByteArray>   collections;
+
+        // Collections enumerated completely, and the one being enumerated (-1 if none)
+        QList<int>              completedCollections;
+        int                     collectionId;
+
+        // Directories of that collection which are still to be enumerated
+        QStringList             frontier;
+
+        // Entries which were found but not yet stored in the database, mapped by file path
+        QHash<QString, SongDatabaseScanner::SongDatabaseEntry>  pendingEntries;
+
+        // Index state of the collections scanned through their index files, and the paths removed by the index
+        // deltas; both are only applied when the scan completes, so they must survive the resume too
+        QMap<int, SongDatabaseScanner::IndexState>  indexStates;
+        QStringList             indexRemovedPaths;
+
+        // Stores the checkpoint. QSaveFile is used, so if we crash while writing, the previous one stays intact.
+        bool    save( const QString& filename, QString& errmsg ) const;
+
+        // Loads the checkpoint. Returns false if there is none, or if it is invalid (then errmsg is set).
+        bool    load( const QString& filename, QString& errmsg );
+};
+
+#endif // SCANCHECKPOINT_H
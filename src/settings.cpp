@@ -46,6 +46,8 @@ Settings::Settings()
 
     songdbFilename = m_appDataPath + "karaoke.db";
     queueFilename = m_appDataPath + "queue.dat";
+    scanCheckpointFilename = m_appDataPath + "scan.checkpoint";
+    scanIndexStateFilename = m_appDataPath + "index.state";
 
     // Create the application data dir if it doesn't exist
     if ( !QFile::exists( m_appDataPath ) )
@@ -151,6 +153,12 @@ QJsonObject Settings::toJson()
     out[ "database/PathReplacementPrefixFrom"] = songPathReplacementFrom;
     out[ "database/PathReplacementPrefixTo"] = songPathReplacementTo;
 
+    out[ "scanner/ProcessingQueueLimit"] = (int) scannerProcessingQueueLimit;
+    out[ "scanner/SubmittingQueueLimit"] = (int) scannerSubmittingQueueLimit;
+    out[ "scanner/LowPriority"] = scannerLowPriority;
+    out[ "scanner/PauseWhilePlaying"] = scannerPauseWhilePlaying;
+    out[ "scanner/DiskOrder"] = scannerDiskOrder;
+
     // LIRC
     out[ "lirc/Enable"] = lircEnabled;
     out[ "lirc/DevicePath"] = lircDevicePath;
@@ -172,6 +180,13 @@ QJsonObject Settings::toJson()
         out[ "http/DocumentRoot"] = httpDocumentRoot;
 
     out[ "http/ForceUseHostname"] = httpForceUseHost;
+    out[ "http/KeepAliveTimeout"] = (int) httpKeepAliveTimeout;
+    out[ "http/CompressMinSize"] = (int) httpCompressMinSize;
+    out[ "http/WorkerThreads"] = (int) httpWorkerThreads;
+    out[ "http/MaxConnections"] = (int) httpMaxConnections;
+    out[ "http/MaxClientConnections"] = (int) httpMaxClientConnections;
+    out[ "http/SearchRateLimit"] = (int) httpSearchRateLimit;
+    out[ "http/ApiRateLimit"] = (int) httpApiRateLimit;
 
     out[ "misc/DialogAutoCloseTimer" ] = dialogAutoCloseTimer;
 
@@ -230,6 +245,12 @@ void Settings::fromJson(const QJsonObject &data)
     songPathReplacementFrom = data.value( "database/PathReplacementPrefixFrom" ).toString();
     songPathReplacementTo = data.value( "database/PathReplacementPrefixTo" ).toString();
 
+    scannerProcessingQueueLimit = data.value( "scanner/ProcessingQueueLimit" ).toInt( 5000 );
+    scannerSubmittingQueueLimit = data.value( "scanner/SubmittingQueueLimit" ).toInt( 2000 );
+    scannerLowPriority = data.value( "scanner/LowPriority" ).toBool( true );
+    scannerPauseWhilePlaying = data.value( "scanner/PauseWhilePlaying" ).toBool( false );
+    scannerDiskOrder = data.value( "scanner/DiskOrder" ).toBool( false );
+
     lircDevicePath = data.value( "lirc/DevicePath" ).toString();
     lircMappingFile = data.value( "lirc/MappingFile" ).toString();
     lircEnabled = data.value( "lirc/Enable" ).toBool( false );
@@ -241,6 +262,13 @@ void Settings::fromJson(const QJsonObject &data)
     httpEnableAddQueue = data.value( "http/EnableAddQueue" ).toBool( false );
     httpAccessCode = data.value( "http/SecureAccessCode" ).toString();
     httpForceUseHost = data.value( "http/ForceUseHostname" ).toString();
+    httpKeepAliveTimeout = data.value( "http/KeepAliveTimeout" ).toInt( 15 );
+    httpCompressMinSize = data.value( "http/CompressMinSize" ).toInt( 1024 );
+    httpWorkerThreads = data.value( "http/WorkerThreads" ).toInt( 2 );
+    httpMaxConnections = data.value( "http/MaxConnections" ).toInt( 256 );
+    httpMaxClientConnections = data.value( "http/MaxClientConnections" ).toInt( 16 );
+    httpSearchRateLimit = data.value( "http/SearchRateLimit" ).toInt( 5 );
+    httpApiRateLimit = data.value( "http/ApiRateLimit" ).toInt( 20 );
 
     // Encoding
     fallbackEncoding = data.value( "advanced/FallbackEncoding" ).toString( "UTF-8" );
@@ -97,6 +97,28 @@ class Settings
         // Songs database
         QString         songdbFilename;
 
+        // Collection scanner progress, used to resume an interrupted scan
+        QString         scanCheckpointFilename;
+
+        // Versions and HTTP validators of the collection indexes stored in the songs database,
+        // used to only download and apply the index changes
+        QString         scanIndexStateFilename;
+
+        // Maximum number of entries waiting in the collection scanner queues; when the queue
+        // is full the previous stage waits (so the directory scan cannot outrun the processing)
+        unsigned int    scannerProcessingQueueLimit;
+        unsigned int    scannerSubmittingQueueLimit;
+
+        // If true, collection scanner runs with the lowest CPU and I/O priority
+        bool            scannerLowPriority;
+
+        // If true, collection scanner pauses while a karaoke song is playing
+        bool            scannerPauseWhilePlaying;
+
+        // If true, collection scanner reads the files directory by directory in their on-disk order,
+        // which is much faster for the collections on spinning disks
+        bool            scannerDiskOrder;
+
         // LIRC path
         bool            lircEnabled;
         QString         lircDevicePath;
@@ -110,6 +132,23 @@ class Settings
         QString         httpAccessCode;
         QString         httpForceUseHost;
 
+        // How long (in seconds) an idle persistent connection is kept open; 0 disables persistent connections
+        unsigned int    httpKeepAliveTimeout;
+
+        // Responses smaller than this (in bytes) are sent uncompressed; 0 disables the compression
+        unsigned int    httpCompressMinSize;
+
+        // Number of threads running the database queries for the web server; 0 runs them in the web server thread
+        unsigned int    httpWorkerThreads;
+
+        // Connection limits, in total and per client address
+        unsigned int    httpMaxConnections;
+        unsigned int    httpMaxClientConnections;
+
+        // Requests per second allowed per client address for searches/browsing and for other API calls; 0 is unlimited
+        unsigned int    httpSearchRateLimit;
+        unsigned int    httpApiRateLimit;
+
         // Fallback encoding to use if automatic detection failed
         QString         fallbackEncoding;
 
@@ -228,7 +228,7 @@ SettingsDialog::SettingsDialog(QWidget *parent) :
     {
         ui->boxMusicEnable->setChecked(true);
 
-        ui->leMusicPath->setText( pSettings->musicCollections[0] );
+        ui->leMusicPath->setText( pSettings->musicCollections.join( "; " ) );
 
         if ( pSettings->musicCollectionCrossfadeTime > 0 )
         {
@@ -407,7 +407,11 @@ void SettingsDialog::browseMusicPath()
     if ( e.isEmpty() )
         return;
 
-    ui->leMusicPath->setText( e );
+    // Add to the existing directories
+    if ( ui->leMusicPath->text().trimmed().isEmpty() )
+        ui->leMusicPath->setText( e );
+    else
+        ui->leMusicPath->setText( ui->leMusicPath->text().trimmed() + "; " + e );
 }
 
 void SettingsDialog::startUpdateDatabase()
@@ -800,8 +804,14 @@ void SettingsDialog::accept()
             return;
         }
 
+        // Several directories are separated by semicolon
         pSettings->musicCollections.clear();
-        pSettings->musicCollections.push_back( ui->leMusicPath->text() );
+
+        Q_FOREACH( const QString& path, ui->leMusicPath->text().split( ';', QString::SkipEmptyParts ) )
+        {
+            if ( !path.trimmed().isEmpty() )
+                pSettings->musicCollections.push_back( path.trimmed() );
+        }
 
         if ( ui->boxMusicCrossfade->isChecked() )
             pSettings->musicCollectionCrossfadeTime = ui->spinMusicCrossfadeDelay->value();
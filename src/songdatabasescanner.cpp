@@ -17,12 +17,16 @@
  **************************************************************************/
 
 #include <QDir>
+#include <QDirIterator>
+#include <QThreadPool>
+#include <QtConcurrent>
 #include <QMap>
 #include <QBuffer>
 #include <QFileInfo>
 #include <QThread>
 #include <QDateTime>
-#include <QApplication>
+#include <QDataStream>
+#include <QSaveFile>
 
 #include "logger.h"
 #include "karaokeplayable.h"
@@ -31,8 +35,37 @@
 #include "playerlyricstext.h"
 #include "pluginmanager.h"
 #include "collectionprovider.h"
+#include "collectionindex.h"
+#include "scancheckpoint.h"
+#include "settings.h"
 #include "eventor.h"
+#include "currentstate.h"
 #include "util.h"
+#include "threadwaiter.h"
+
+
+// Index state file version
+static const int INDEX_STATE_VERSION = 1;
+
+// How often the scan checkpoint is stored (in progress update timer ticks)
+static const int CHECKPOINT_INTERVAL_TICKS = 10;
+
+// How many lyrics are sent to the language detector at once
+static const int LANGUAGE_DETECTION_BATCH = 32;
+
+// How many entries are submitted into the database in a single transaction
+static const int ENTRIES_TO_UPDATE = 200;
+
+// How long (in milliseconds) stopScan waits for all the threads to stop before leaving them running
+static const int SCAN_STOP_TIMEOUT = 5000;
+
+// Formats the scan duration or ETA in seconds as h:mm:ss (scans could take hours)
+static QString durationToString( int seconds )
+{
+    return QString( "%1:%2:%3" ).arg( seconds / 3600 )
+                                .arg( (seconds / 60) % 60, 2, 10, QChar('0') )
+                                .arg( seconds % 60, 2, 10, QChar('0') );
+}
 
 
 class SongDatabaseScannerWorkerThread : public QThread
@@ -54,6 +87,11 @@ class SongDatabaseScannerWorkerThread : public QThread
 
         void run()
         {
+            // Scanning is a background job, and should not make playback stutter. The submitter is not lowered,
+            // as it holds the database transaction which the player and the web server threads wait for.
+            if ( pSettings->scannerLowPriority && m_type != THREAD_SUBMITTER )
+                Util::lowerCurrentThreadPriority();
+
             switch ( m_type )
             {
                 case THREAD_SCANNER:
@@ -77,6 +115,24 @@ class SongDatabaseScannerWorkerThread : public QThread
             }
         }
 
+        const char * typeName() const
+        {
+            switch ( m_type )
+            {
+                case THREAD_SCANNER:
+                    return "scanner";
+
+                case THREAD_PROCESSOR:
+                    return "processor";
+
+                case THREAD_SUBMITTER:
+                    return "submitter";
+
+                default:
+                    return "cleanup";
+            }
+        }
+
     private:
         SongDatabaseScanner * m_scanner;
         Type                  m_type;
@@ -88,7 +144,20 @@ SongDatabaseScanner::SongDatabaseScanner(QObject *parent)
     : QObject(parent)
 {
     m_langDetector = 0;
-    m_providerStatus = -1;
+    m_langDetectorBatch = 0;
+    m_scanCollectionId = -1;
+    m_checkpointEnabled = false;
+    m_checkpointTicks = 0;
+    m_stat_processingRate = 0.0;
+    m_stat_processingQueuePeak = 0;
+    m_stat_submittingQueuePeak = 0;
+    m_stat_rateLastProcessed = 0;
+    m_stat_rateLastUpdate = 0;
+    m_processingQueueLimit = 0;
+    m_diskOrder = false;
+    m_submittingQueueLimit = 0;
+    m_pausedThreads = 0;
+    m_karaokePlaying = false;
 
     m_updateTimer.setInterval( 500 );
     m_updateTimer.setTimerType( Qt::CoarseTimer );
@@ -98,8 +167,18 @@ SongDatabaseScanner::SongDatabaseScanner(QObject *parent)
 
 SongDatabaseScanner::~SongDatabaseScanner()
 {
-    if ( !m_threadPool.isEmpty() )
-        stopScan();
+    // The threads use the scanner, so it cannot be freed while any of them is still running.
+    // This only waits without a limit if the scanner is deleted directly instead of stopAndDelete()
+    if ( !m_threadPool.isEmpty() && !stopScan() )
+    {
+        Q_FOREACH( QThread * thread, m_threadPool )
+            thread->wait();
+
+        qDeleteAll( m_threadPool );
+        m_threadPool.clear();
+    }
+
+    m_checkpointWriter.waitForFinished();
 
     if ( m_langDetector )
         pPluginManager->releaseLanguageDetector();
@@ -110,6 +189,31 @@ bool SongDatabaseScanner::startScan()
     // Make a copy in case the settings change during scanning
     m_collection = pSettings->collections;
 
+    // The submitter waits for a full batch before submitting, so the queue must be able to hold it
+    m_processingQueueLimit = qMax( (int) pSettings->scannerProcessingQueueLimit, 1 );
+    m_submittingQueueLimit = qMax( (int) pSettings->scannerSubmittingQueueLimit, ENTRIES_TO_UPDATE * 2 );
+    m_diskOrder = pSettings->scannerDiskOrder;
+
+    // Compile the artist/title patterns once, as they are used for every file
+    m_pathPatterns.clear();
+
+    for ( QMap<int,CollectionEntry>::const_iterator it = m_collection.begin();
+          it != m_collection.end();
+          ++it )
+    {
+        Q_FOREACH( const QString& pattern, it->artistTitlePatterns )
+        {
+            SongPathPattern compiled;
+            QString errmsg;
+
+            if ( compiled.compile( pattern, errmsg ) )
+                m_pathPatterns[ it.key() ].push_back( compiled );
+            else
+                Logger::error( "SongDatabaseScanner: invalid artist/title pattern %s for collection %s: %s, ignored",
+                               qPrintable( pattern ), qPrintable( it->name ), qPrintable( errmsg ) );
+        }
+    }
+
     // Do we need the language detector?
     bool need_lang_detector = false;
 
@@ -130,6 +234,9 @@ bool SongDatabaseScanner::startScan()
             Logger::debug( "Failed to load the language detection library, language detection is not available" );
             return false;
         }
+
+        m_langDetectorBatch = pPluginManager->languageDetectorBatch();
+        m_langCache.load();
     }
 
     // Create the directory scanner thread
@@ -151,7 +258,27 @@ bool SongDatabaseScanner::startScan()
 
     m_finishScanning = 0;
 
+    // The player state is only tracked here in the main thread; the scanner threads wait on m_karaokePlayingCond
+    if ( pSettings->scannerPauseWhilePlaying )
+    {
+        m_karaokePlaying = pCurrentState->playerState != CurrentState::PLAYERSTATE_STOPPED;
+
+        connect( pEventor, SIGNAL(karaokeStarted(SongQueueItem)), this, SLOT(karaokePlaybackStarted()) );
+        connect( pEventor, SIGNAL(karaokeStopped()), this, SLOT(karaokePlaybackStopped()) );
+        connect( pEventor, SIGNAL(karaokeFinished()), this, SLOT(karaokePlaybackStopped()) );
+    }
+
+    // Continue the previous scan if it was interrupted (after the index state, as it restores the pending part of it)
+    loadIndexState();
+    loadCheckpoint();
+
+    // From now on there is something to resume if we're interrupted
+    m_checkpointMutex.lock();
+    m_checkpointEnabled = true;
+    m_checkpointMutex.unlock();
+
     // Start the update timer
+    m_stat_scanTimer.start();
     m_updateTimer.start();
 
     // Emit the Started signal
@@ -164,20 +291,91 @@ bool SongDatabaseScanner::startScan()
     return true;
 }
 
-void SongDatabaseScanner::stopScan()
-{  
+bool SongDatabaseScanner::stopScan()
+{
     // Signal all running threads to stop
     m_abortScanning = 1;
     m_finishScanning = 1;
 
-    // Wait for all them and clean them up
+    // Wake up those waiting on queues
+    m_processingQueueMutex.lock();
+    m_processingQueueCond.wakeAll();
+    m_processingQueueNotFullCond.wakeAll();
+    m_processingQueueMutex.unlock();
+
+    m_submittingQueueMutex.lock();
+    m_submittingQueueCond.wakeAll();
+    m_submittingQueueNotFullCond.wakeAll();
+    m_submittingQueueMutex.unlock();
+
+    m_karaokePlayingMutex.lock();
+    m_karaokePlayingCond.wakeAll();
+    m_karaokePlayingMutex.unlock();
+
+    // Wait for all them and clean them up. All the long operations check the abort flag, so this
+    // should not take long; if it does, something is blocked outside our control (such as a hung network mount),
+    // and those threads are left running rather than blocking the caller
+    QElapsedTimer timer;
+    timer.start();
+
+    QList< QThread * > running = ThreadWaiter::waitAll( m_threadPool, SCAN_STOP_TIMEOUT );
+
+    Q_FOREACH( QThread * thread, m_threadPool )
+    {
+        if ( running.contains( thread ) )
+            Logger::error( "SongDatabaseScanner: %s thread is still running %d ms after abort, leaving it to finish",
+                           static_cast<SongDatabaseScannerWorkerThread*>( thread )->typeName(), (int) timer.elapsed() );
+        else
+            delete thread;
+    }
+
+    m_threadPool = running;
+
+    if ( running.isEmpty() )
+        Logger::debug( "SongDatabaseScanner: scan aborted in %d ms", (int) timer.elapsed() );
+
+    // The stopped threads left their work in the checkpoint, so it is consistent now (whatever the remaining
+    // ones are doing stays pending there too); the periodic one must not overwrite it
+    m_checkpointWriter.waitForFinished();
+
+    ScanCheckpoint checkpoint;
+
+    if ( takeCheckpoint( checkpoint ) )
+        writeCheckpoint( checkpoint );
+
+    return running.isEmpty();
+}
+
+void SongDatabaseScanner::stopAndDelete()
+{
+    if ( m_threadPool.isEmpty() || stopScan() )
+    {
+        delete this;
+        return;
+    }
+
+    // Some threads are blocked and still use the scanner, so it is deleted once the last one finishes
+    Q_FOREACH( QThread * thread, m_threadPool )
+        connect( thread, SIGNAL(finished()), this, SLOT(stoppedThreadFinished()), Qt::QueuedConnection );
+
+    // In case they finished before being connected
+    stoppedThreadFinished();
+}
+
+void SongDatabaseScanner::stoppedThreadFinished()
+{
     Q_FOREACH( QThread * thread, m_threadPool )
     {
-        thread->wait();
-        delete thread;
+        if ( !thread->isFinished() )
+            return;
     }
 
+    Logger::debug( "SongDatabaseScanner: remaining scan threads finished" );
+
+    qDeleteAll( m_threadPool );
     m_threadPool.clear();
+
+    deleteLater();
 }
 
 void SongDatabaseScanner::updateScanProgress()
@@ -186,14 +384,47 @@ void SongDatabaseScanner::updateScanProgress()
     if ( m_finishScanning )
         m_updateTimer.stop();
 
-    QString progress = tr("Collection scan: %1 directories scanned, %2 karaoke files found, %3 processed, %4 submitted")
-                                .arg( m_stat_directoriesScanned )
-                                .arg( m_stat_karaokeFilesFound )
-                                .arg( m_stat_karaokeFilesProcessed )
-                                .arg( m_stat_karaokeFilesSubmitted );
+    // Update the rolling processing rate; smoothed so the ETA does not jump around
+    qint64 now = m_stat_scanTimer.elapsed();
+    int processed = m_stat_karaokeFilesProcessed.load();
+
+    if ( now > m_stat_rateLastUpdate )
+    {
+        double rate = (processed - m_stat_rateLastProcessed) * 1000.0 / (now - m_stat_rateLastUpdate);
+
+        if ( m_stat_rateLastUpdate == 0 )
+            m_stat_processingRate = rate;
+        else
+            m_stat_processingRate = m_stat_processingRate * 0.8 + rate * 0.2;
+
+        m_stat_rateLastProcessed = processed;
+        m_stat_rateLastUpdate = now;
+    }
+
+    QJsonObject stats = scanStatistics( m_finishScanning == 0 );
+    int eta = stats["eta"].toInt();
+
+    QString progress = tr("Collection scan: %1 directories scanned, %2 karaoke files found, %3 processed, %4 submitted, %5 files/s, ETA %6")
+                                .arg( m_stat_directoriesScanned.load() )
+                                .arg( m_stat_karaokeFilesFound.load() )
+                                .arg( processed )
+                                .arg( m_stat_karaokeFilesSubmitted.load() )
+                                .arg( m_stat_processingRate, 0, 'f', 1 )
+                                .arg( eta < 0 ? tr("unknown") : durationToString( eta ) );
+
+    if ( m_pausedThreads.load() > 0 )
+        progress = tr("Collection scan is paused while karaoke is playing");
 
     // If m_stringProgress is non-empty it overrides the progress
     emit pEventor->scanCollectionProgress( m_stringProgress.isEmpty() ? progress : m_stringProgress );
+    emit pEventor->scanCollectionStatistics( stats );
+
+    // Periodically store the checkpoint so we do not start from scratch if interrupted
+    if ( ++m_checkpointTicks >= CHECKPOINT_INTERVAL_TICKS )
+    {
+        m_checkpointTicks = 0;
+        saveCheckpoint();
+    }
 }
 
 void SongDatabaseScanner::providerFinished(int, QString errmsg)
@@ -201,14 +432,10 @@ void SongDatabaseScanner::providerFinished(int, QString errmsg)
     if ( !errmsg.isEmpty() )
     {
         Logger::debug( "SongDatabaseScanner: couldn't retrieve the index file: %s", qPrintable( errmsg ) );
-        m_providerStatus = 1;
         m_stringProgress = errmsg;
     }
     else
-    {
-        m_providerStatus = 0;
         m_stringProgress.clear();
-    }
 }
 
 void SongDatabaseScanner::providerProgress(int , int percentage)
@@ -216,6 +443,82 @@ void SongDatabaseScanner::providerProgress(int , int percentage)
     m_stringProgress = tr("Downloading index... %1%" ).arg( percentage );
 }
 
+int SongDatabaseScanner::downloadCollectionFile( CollectionProvider *provider, const QString &url, QByteArray &data )
+{
+    data.clear();
+
+    QBuffer buf( &data );
+    buf.open( QIODevice::WriteOnly );
+
+    // This waits in the event loop of this thread, and the download is cancelled if we're aborted
+    QString errmsg = provider->downloadAndWait( url, &buf, &m_finishScanning );
+
+    if ( m_finishScanning != 0 )
+        return -1;
+
+    return errmsg.isEmpty() ? 0 : 1;
+}
+
+bool SongDatabaseScanner::scanCollectionIndex( const CollectionEntry &col, CollectionProvider *provider, bool ignoreState )
+{
+    IndexState state;
+
+    if ( !ignoreState )
+        state = m_indexState.value( col.id );
+
+    QByteArray indexdata;
+
+    // If we know which index version is in the database, we only need the changes since then.
+    // If the delta is not available or does not start from our version, the full index is used.
+    if ( state.version > 0 )
+    {
+        int status = downloadCollectionFile( provider, col.rootPath + "/index.delta", indexdata );
+
+        if ( status < 0 )
+            return false;
+
+        quint32 version;
+
+        if ( status == 0 && parseCollectionIndexDelta( col, indexdata, state.version, version ) )
+        {
+            state.version = version;
+            indexStateUpdated( col.id, state );
+            return true;
+        }
+    }
+
+    // Only download the full index if it changed since we used it
+    provider->setValidators( state.etag, state.lastModified );
+
+    int status = downloadCollectionFile( provider, col.rootPath + "/index.dat", indexdata );
+
+    if ( status != 0 )
+        return false;
+
+    if ( provider->notModified() )
+    {
+        Logger::debug( "SongDatabaseScanner: collection index for %s was not modified, skipped", qPrintable( col.name ) );
+        return true;
+    }
+
+    Logger::debug( "SongDatabaseScanner: successfully downloaded the collection index");
+
+    // Parse the index file and send it directly into submission thread
+    quint32 version;
+
+    if ( parseCollectionIndex( col, indexdata, version ) )
+    {
+        state.version = version;
+        state.etag = provider->etag();
+        state.lastModified = provider->lastModified();
+        indexStateUpdated( col.id, state );
+    }
+    else
+        m_stat_failures++;
+
+    return true;
+}
+
 void SongDatabaseScanner::scanCollectionsThread()
 {
     qint64 lastupdate = pDatabase->lastDatabaseUpdate() * 1000;
@@ -226,6 +529,46 @@ void SongDatabaseScanner::scanCollectionsThread()
         Logger::debug( "SongDatabaseScanner: collection thread will ignore the timestamps earlier than %s",
                        qPrintable( QDateTime::fromMSecsSinceEpoch( lastupdate ).toString( "yyyy-MM-dd hh:mm:ss") ) );
 
+    // Load all the known songs at once before anything is queued for processing
+    QElapsedTimer timer;
+    timer.start();
+
+    if ( !pDatabase->knownSongs( m_knownSongs ) )
+        Logger::error( "SongDatabaseScanner: failed to load the known songs, all files will be processed" );
+    else
+        Logger::debug( "SongDatabaseScanner: loaded %d known songs in %d ms", m_knownSongs.size(), (int) timer.elapsed() );
+
+    // Collections which have songs in the database, and whether the database was reset since the last scan
+    QSet<int> knownCollections;
+
+    for ( QHash<QString, KnownSongEntry>::const_iterator it = m_knownSongs.constBegin(); it != m_knownSongs.constEnd(); ++it )
+        knownCollections.insert( it->collectionId );
+
+    bool fullrescan = lastupdate == 0;
+
+    // If we are resuming the scan, requeue the entries which were found but not stored in the database.
+    // Those which were already processed only need to be submitted.
+    m_scanFrontierMutex.lock();
+    QStringList resumedFrontier = m_scanFrontier;
+    m_scanFrontierMutex.unlock();
+
+    m_checkpointMutex.lock();
+    QList<SongDatabaseEntry> resumedEntries = m_scanPendingEntries.values();
+    int resumedCollectionId = m_scanCollectionId;
+    m_checkpointMutex.unlock();
+
+    if ( !resumedEntries.isEmpty() || !m_scanCompletedCollections.isEmpty() )
+        Logger::debug( "SongDatabaseScanner: resuming the scan, %d collections completed, %d directories and %d entries pending",
+                       m_scanCompletedCollections.size(), resumedFrontier.size(), resumedEntries.size() );
+
+    Q_FOREACH( const SongDatabaseEntry& entry, resumedEntries )
+    {
+        if ( entry.type.isEmpty() )
+            addProcessing( entry );
+        else
+            addSubmitting( entry );
+    }
+
     for ( QMap<int,CollectionEntry>::const_iterator it = m_collection.begin();
           it != m_collection.end();
           ++it )
@@ -233,42 +576,58 @@ void SongDatabaseScanner::scanCollectionsThread()
         if ( m_finishScanning != 0 )
             break;
 
+        // Skip the collections enumerated before the scan was interrupted
+        if ( m_scanCompletedCollections.contains( it->id ) )
+        {
+            Logger::debug( "SongDatabaseScanner: collection %s was completed before, skipped", qPrintable( it->name ) );
+            continue;
+        }
+
+        m_checkpointMutex.lock();
+        m_scanCollectionId = it->id;
+        m_checkpointMutex.unlock();
+
         m_stringProgress.clear();
         Logger::debug( "SongDatabaseScanner: scanning collection %s", qPrintable( it->name ) );
 
+        // Continue enumerating the interrupted collection from where we stopped
+        if ( it->id == resumedCollectionId && !resumedFrontier.isEmpty() )
+        {
+            m_scanFrontierMutex.lock();
+            m_scanFrontier = resumedFrontier;
+            m_scanFrontierMutex.unlock();
+
+            enumerateCollection( *it );
+            continue;
+        }
+
         // Find the collection provider for this type
         CollectionProvider * provider = CollectionProvider::createProviderForID( it->id );
 
         if ( !provider )
+        {
+            Logger::error( "Skipped collection %s: no provider for this collection type", qPrintable( it->name ) );
+            m_stat_failures++;
             continue;
+        }
 
         connect( provider, SIGNAL(finished(int,QString)), this, SLOT(providerFinished(int,QString)) );
         connect( provider, SIGNAL(progress(int,int)), this, SLOT(providerProgress(int,int)) );
 
-        m_providerStatus = -1;
+        // The stored index state is only valid if the songs it describes are still in the database
+        bool indexed = scanCollectionIndex( *it, provider, fullrescan || !knownCollections.contains( it->id ) );
 
-        // Download the index file into this array
-        QByteArray indexdata;
-        QBuffer buf( &indexdata );
-        buf.open( QIODevice::WriteOnly );
-
-        // Initiate the download and wait until finished signal is issued
-        provider->download( 1, it->rootPath + "/index.dat", &buf );
-
-        // Some providers are always synchronous so check it first
-        while ( m_providerStatus == -1 )
+        if ( m_finishScanning != 0 )
         {
-            qApp->processEvents( QEventLoop::ExcludeUserInputEvents, 500 );
+            delete provider;
+            break;
         }
 
-        // If for this collection we already have the index file, just use it
-        if ( m_providerStatus == 0 )
+        // If for this collection we have the index file, we're done with it
+        if ( indexed )
         {
-            Logger::debug( "SongDatabaseScanner: successfully downloaded the collection index");
-
-            // Parse the index file and send it directly into submission thread
-            parseCollectionIndex( *it, indexdata );
             delete provider;
+            collectionCompleted( it->id );
             continue;
         }
 
@@ -279,116 +638,222 @@ void SongDatabaseScanner::scanCollectionsThread()
             delete provider;
             Logger::error( "Skipped collection %s: provider is not local and no index found",
                            qPrintable( it->name) );
+            m_stat_failures++;
             continue;
         }
 
-        // We do not use recursion, and use the queue-like list instead
-        QStringList paths;
-        paths << it->rootPath;
+        delete provider;
 
-        // And enumerate all the paths
-        while ( !paths.isEmpty() )
-        {
-            m_stat_directoriesScanned++;
-            QString current = paths.takeFirst();
-            QFileInfo finfo( current );
+        m_scanFrontierMutex.lock();
+        m_scanFrontier.clear();
+        m_scanFrontier << it->rootPath;
+        m_scanFrontierMutex.unlock();
+
+        enumerateCollection( *it );
+    }
+
+    // All done - put an entry with an empty path and wake all threads
+    addProcessing( SongDatabaseEntry() );
+    m_processingQueueCond.wakeAll();
+
+    Logger::debug( "SongDatabaseScanner: scanCollectionsThread finished" );
+}
+
+void SongDatabaseScanner::enumerateCollection( const CollectionEntry& collection )
+{
+    // Each directory listing on network filesystems is a round trip, so several directories are listed concurrently.
+    // The calling thread only waits here.
+    int threads = qMax( collection.scanThreads, 1 );
+    QThreadPool pool;
+    pool.setMaxThreadCount( threads );
+
+    for ( int i = 0; i < threads; i++ )
+        QtConcurrent::run( &pool, this, &SongDatabaseScanner::enumerateDirectories, collection );
+
+    pool.waitForDone();
+
+    // Only mark the collection completed if it was not aborted in the middle
+    if ( m_finishScanning == 0 )
+        collectionCompleted( collection.id );
+}
+
+void SongDatabaseScanner::enumerateDirectories( const CollectionEntry& collection )
+{
+    // Pool threads do not inherit the priority of the scanner thread
+    if ( pSettings->scannerLowPriority )
+        Util::lowerCurrentThreadPriority();
 
-            if ( m_finishScanning != 0 )
+    // We do not use recursion, and use the queue-like frontier list instead (which is also stored in checkpoint)
+    while ( m_finishScanning == 0 )
+    {
+        // The directory stays active until all its entries are queued (and thus pending),
+        // so the checkpoint never loses anything in between
+        m_scanFrontierMutex.lock();
+
+        if ( m_scanFrontier.isEmpty() )
+        {
+            // If nobody else is enumerating, we're done
+            if ( m_scanActiveDirectories.isEmpty() )
+            {
+                m_scanFrontierMutex.unlock();
                 break;
+            }
 
-            // Skip non-existing paths (might come from settings)
-            if ( !finfo.exists() )
-                continue;
+            // Otherwise wait for more directories (with timeout to check for abort)
+            m_scanFrontierCond.wait( &m_scanFrontierMutex, 500 );
+            m_scanFrontierMutex.unlock();
+            continue;
+        }
+
+        QString current = m_scanFrontier.takeFirst();
+        m_scanActiveDirectories.insert( current );
+        m_scanFrontierMutex.unlock();
+
+        waitWhilePlaying();
+
+        m_stat_directoriesScanned++;
 
-            // We assume the situation where we have several lyrics for a single music is more prevalent
-            QMap< QString, QString > musicFiles, lyricFiles;
-            bool modtime_checked = true;
+        QElapsedTimer timer;
+        timer.start();
+
+        // We assume the situation where we have several lyrics for a single music is more prevalent
+        QMap< QString, QString > musicFiles, lyricFiles;
+        QList<SongDatabaseEntry> foundEntries;
+        QStringList foundDirectories;
+
+        QStringList files;
+        listDirectory( current, foundDirectories, files );
+
+        Q_FOREACH( const QString& filepath, files )
+        {
+            QString filename = filepath.mid( filepath.lastIndexOf( '/' ) + 1 );
 
-            Q_FOREACH( QFileInfo fi, QDir( current ).entryInfoList( QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot, QDir::DirsFirst ) )
+            if ( KaraokePlayable::isSupportedCompleteFile( filename ) )
             {
-                // Re-add directories into the list
-                if ( fi.isDir() )
-                {
-                    paths.push_back( fi.absoluteFilePath() );
+                // We only add zip files if enabled for this collection
+                if ( filename.endsWith( ".zip", Qt::CaseInsensitive) && !collection.scanZips )
                     continue;
-                }
-
-                // If we're here this means the directory also has files. Those we will only check for if the parent directory
-                // has been modified after the last update
-                //FIXME! thisdoesn't seem right
-                if ( !modtime_checked )
-                {
-                    if ( lastupdate > 0 && QFileInfo( current ).lastModified().toMSecsSinceEpoch() < lastupdate )
-                        break;
-
-                    modtime_checked = true;
-                }
-
-                // No more directories in this dir, but we have files
-                if ( KaraokePlayable::isSupportedCompleteFile( fi.fileName()) )
-                {
-                    // We only add zip files if enabled for this collection
-                    if ( fi.fileName().endsWith( ".zip", Qt::CaseInsensitive) && !it->scanZips )
-                        continue;
-
-                    // Schedule for processing right away
-                    SongDatabaseEntry entry;
-                    entry.filePath = fi.absoluteFilePath();
-                    entry.colidx = it->id;
-                    entry.language = it->defaultLanguage;
-
-                    addProcessing( entry );
-                }
-                else if ( KaraokePlayable::isSupportedMusicFile( fi.fileName()) )
-                {
-                    // Music is mapped basename -> file
-                    musicFiles[ fi.baseName() ] = fi.fileName();
-                }
-                else if ( KaraokePlayable::isSupportedLyricFile( fi.fileName()) )
-                {
-                    // But lyric is mapped file -> basename
-                    lyricFiles[ fi.fileName() ] = fi.baseName();
-                }
-                else
-                    Logger::debug( "SongDatabaseScanner: unknown file %s, skipping", qPrintable( fi.absoluteFilePath() ) );
+
+                // Schedule for processing right away
+                SongDatabaseEntry entry;
+                entry.filePath = filepath;
+                entry.colidx = collection.id;
+                entry.language = collection.defaultLanguage;
+
+                foundEntries.push_back( entry );
+            }
+            else if ( KaraokePlayable::isSupportedMusicFile( filename ) )
+            {
+                // Music is mapped basename -> file
+                musicFiles[ QFileInfo( filename ).baseName() ] = filename;
+            }
+            else if ( KaraokePlayable::isSupportedLyricFile( filename ) )
+            {
+                // But lyric is mapped file -> basename
+                lyricFiles[ filename ] = QFileInfo( filename ).baseName();
             }
+            else
+                Logger::debug( "SongDatabaseScanner: unknown file %s, skipping", qPrintable( filepath ) );
+        }
 
-            // Try to see if we have all matched music-lyric files - and move them to completeFiles
-            while ( !lyricFiles.isEmpty() )
+        // Try to see if we have all matched music-lyric files - and move them to completeFiles
+        while ( !lyricFiles.isEmpty() )
+        {
+            QString lyric = lyricFiles.firstKey();
+            QString lyricbase = lyricFiles.take( lyric );
+
+            if ( musicFiles.contains( lyricbase ) )
             {
-                QString lyric = lyricFiles.firstKey();
-                QString lyricbase = lyricFiles.take( lyric );
-
-                if ( musicFiles.contains( lyricbase ) )
-                {
-                    // And we have a complete song
-                    SongDatabaseEntry entry;
-                    entry.filePath = current + Util::separator() + lyric;
-                    entry.musicPath = musicFiles[ lyricbase ];
-                    entry.colidx = it->id;
-                    entry.language = it->defaultLanguage;
-
-                    addProcessing( entry );
-                }
-                else
-                    Logger::debug( "SongDatabaseScanner: WARNING no music found for lyric file %s", qPrintable( current + Util::separator() + lyric) );
+                // And we have a complete song
+                SongDatabaseEntry entry;
+                entry.filePath = current + Util::separator() + lyric;
+                entry.musicPath = musicFiles[ lyricbase ];
+                entry.colidx = collection.id;
+                entry.language = collection.defaultLanguage;
+
+                foundEntries.push_back( entry );
             }
+            else
+                Logger::debug( "SongDatabaseScanner: WARNING no music found for lyric file %s", qPrintable( current + Util::separator() + lyric) );
+        }
+
+        // Files are read in their on-disk order, so the disk doesn't need to seek back and forth
+        QList< SongDatabaseEntry > orderedEntries;
+
+        if ( m_diskOrder )
+        {
+            QStringList paths;
+
+            Q_FOREACH( const SongDatabaseEntry& entry, foundEntries )
+                paths.push_back( entry.filePath );
+
+            Q_FOREACH( int index, Util::diskOrder( paths ) )
+                orderedEntries.push_back( foundEntries[ index ] );
+        }
+
+        m_stat_usecEnumerating.fetchAndAddRelaxed( timer.nsecsElapsed() / 1000 );
+
+        if ( m_diskOrder )
+            addProcessingDirectory( orderedEntries );
+        else
+        {
+            Q_FOREACH( const SongDatabaseEntry& entry, foundEntries )
+                addProcessing( entry );
         }
+
+        // If we're aborted in the middle, the directory stays active and will be enumerated again on resume
+        if ( m_finishScanning != 0 )
+            break;
+
+        m_scanFrontierMutex.lock();
+        m_scanActiveDirectories.remove( current );
+        m_scanFrontier.append( foundDirectories );
+        m_scanFrontierMutex.unlock();
+
+        // Either there are new directories to list, or we might be done
+        m_scanFrontierCond.wakeAll();
     }
+}
 
-    // All done - put an entry with an empty path and wake all threads
-    addProcessing( SongDatabaseEntry() );
-    m_processingQueueCond.wakeAll();
+void SongDatabaseScanner::listDirectory( const QString &path, QStringList &directories, QStringList &files )
+{
+    // QDirIterator is used instead of entryInfoList as it doesn't sort, and only needs the file type
+    // (which is provided by the directory listing itself on most platforms, without stat() per file).
+    // Non-existing paths (which might come from settings) just produce no entries.
+    QDirIterator it( path, QDir::Dirs | QDir::Files | QDir::NoDotAndDotDot );
 
-    Logger::debug( "SongDatabaseScanner: scanCollectionsThread finished" );
+    // Large directories on network filesystems take a while, so check for abort as we go
+    while ( it.hasNext() && m_finishScanning == 0 )
+    {
+        it.next();
+
+        if ( it.fileInfo().isDir() )
+            directories.push_back( it.filePath() );
+        else
+            files.push_back( it.filePath() );
+    }
+}
+
+void SongDatabaseScanner::collectionCompleted( int id )
+{
+    QMutexLocker f( &m_scanFrontierMutex );
+    QMutexLocker m( &m_checkpointMutex );
+
+    m_scanCompletedCollections.push_back( id );
+    m_scanCollectionId = -1;
+    m_scanFrontier.clear();
+    m_scanActiveDirectories.clear();
 }
 
 void SongDatabaseScanner::cleanupThread()
 {
     Logger::debug( "SongDatabaseScanner: cleanup thread started" );
 
-    if ( !pDatabase->cleanupCollections() )
+    if ( !pDatabase->cleanupCollections( &m_abortScanning ) && !m_abortScanning )
+    {
         Logger::error( "SongDatabaseScanner: database cleanup failed with error" );
+        m_stat_failures++;
+    }
 
     // If m_threadsRunning was 1 when this thread finished, this is the last one before the submitting thread
     if ( m_threadsRunning.fetchAndAddAcquire( -1 ) == 1 )
@@ -408,6 +873,10 @@ void SongDatabaseScanner::processingThread()
 {
     Logger::debug( "SongDatabaseScanner: procesing thread started" );
 
+    // Entries waiting for the language detection, and their lyrics
+    QList<SongDatabaseEntry> detectEntries;
+    QList<QByteArray> detectTexts;
+
     while ( m_finishScanning == 0 )
     {
         // Wait until there are more entries in processing queue
@@ -416,6 +885,14 @@ void SongDatabaseScanner::processingThread()
         // Someone else might have taken our item
         if ( m_processingQueue.isEmpty() )
         {
+            // Do not keep the batch waiting while we sleep
+            if ( !detectEntries.isEmpty() )
+            {
+                m_processingQueueMutex.unlock();
+                detectLanguages( detectEntries, detectTexts );
+                continue;
+            }
+
             m_processingQueueCond.wait( &m_processingQueueMutex );
 
             // Since we're woken up here, our mutex is now locked
@@ -433,130 +910,239 @@ void SongDatabaseScanner::processingThread()
             break;
         }
 
-        // Take our item and let others do work
-        SongDatabaseEntry entry = m_processingQueue.takeFirst();
-        m_processingQueueMutex.unlock();
-
-        m_stat_karaokeFilesProcessed++;
-
-        // Query the database to see what, if anything we already have for this path
-        Database_SongInfo info;
+        // Take our item and let others do work. In disk order mode we take the whole directory,
+        // so the directories are not read by several threads at once.
+        QList<SongDatabaseEntry> entries;
+        entries.push_back( m_processingQueue.takeFirst() );
 
-        if ( pDatabase->songByPath( entry.filePath, info ) )
+        if ( m_diskOrder )
         {
-            // We have the song, does it have all the information?
-            if ( !info.artist.isEmpty() && !info.title.isEmpty() && !info.type.isEmpty() && info.language != 0 )
-            {
-                // Is it up-to-date?
-                if ( QFileInfo(entry.filePath).lastModified() <= QDateTime::fromMSecsSinceEpoch( info.added * 1000LL ) )
-                {
-                    Logger::debug( "SongDatabaseScanner: file %s has all the info and is up-to-date, skipped", qPrintable(entry.filePath) );
-                    continue;
-                }
+            QString directory = QFileInfo( entries.first().filePath ).path();
 
-                Logger::debug( "SongDatabaseScanner: file %s has all the info but is not up-to-date", qPrintable(entry.filePath) );
-            }
+            while ( !m_processingQueue.isEmpty()
+                    && !m_processingQueue.first().filePath.isEmpty()
+                    && QFileInfo( m_processingQueue.first().filePath ).path() == directory )
+                entries.push_back( m_processingQueue.takeFirst() );
         }
 
-        // Detecting the lyrics type
-        int p = entry.filePath.lastIndexOf( '.' );
-
-        if ( p == -1 )
-            continue;
+        m_processingQueueMutex.unlock();
+        m_processingQueueNotFullCond.wakeAll();
 
-        // Just use the uppercase extension
-        entry.type = entry.filePath.mid( p + 1 ).toUpper();
+        // The rest of the entries stay pending if we're aborted
+        for ( int i = 0; i < entries.size() && !m_abortScanning; i++ )
+            processQueuedEntry( entries[i], detectEntries, detectTexts );
+    }
 
-        // Read the karaoke file unless it is a video file
-        if ( !KaraokePlayable::isVideoFile( entry.filePath ) )
-        {
-            QScopedPointer<KaraokePlayable> karaoke( KaraokePlayable::create( entry.filePath ) );
+    // Finish the last batch unless aborted (those entries are still pending in the checkpoint)
+    if ( !m_abortScanning && !detectEntries.isEmpty() )
+        detectLanguages( detectEntries, detectTexts );
 
-            if ( !karaoke || !karaoke->parse() )
-            {
-                Logger::debug( "SongDatabaseScanner: WARNING ignoring file %s as it cannot be parsed", qPrintable(entry.filePath) );
-                continue;
-            }
+    // If m_threadsRunning was 1 when this thread finished, this is the last one before the submitting thread
+    if ( m_threadsRunning.fetchAndAddAcquire( -1 ) == 1 )
+    {
+        // Signal that no more data would be submitted - shut down
+        Logger::debug( "SongDatabaseScanner: last procesing thread finished, signaling the submitter to shut down" );
+        m_finishScanning = 1;
 
-            // For non-CDG files we can do the artist/title and language detection from source
-            if ( !karaoke->lyricObject().endsWith( ".cdg", Qt::CaseInsensitive ) && m_collection[entry.colidx].detectLanguage && m_langDetector )
-            {
-                // Get the pointer to the device the lyrics are stored in (will be deleted after the pointer out-of-scoped)
-                QScopedPointer<QIODevice> lyricDevice( karaoke->openObject( karaoke->lyricObject() ) );
+        // In case the submitter is waiting in condition
+        m_submittingQueueCond.wakeAll();
+    }
+    else
+        Logger::debug( "SongDatabaseScanner: procesing thread finished" );
+}
 
-                if ( lyricDevice == 0 )
-                {
-                    Logger::debug( "SongDatabaseScanner: WARNING cannot open lyric file %s in karaoke file %s", qPrintable( karaoke->lyricObject() ), qPrintable(entry.filePath) );
-                    continue;
-                }
+void SongDatabaseScanner::processQueuedEntry( SongDatabaseEntry& entry, QList<SongDatabaseEntry>& detectEntries, QList<QByteArray>& detectTexts )
+{
+    waitWhilePlaying();
 
-                QScopedPointer<PlayerLyricsText> lyrics( new PlayerLyricsText( "", "" ) );
+    m_stat_karaokeFilesProcessed++;
 
-                if ( !lyrics->load( lyricDevice.data(), karaoke->lyricObject() ) )
-                {
-                    if ( karaoke->lyricObject() != entry.filePath )
-                        Logger::debug( "SongDatabaseScanner: karaoke file %s contains invalid lyrics %s", qPrintable(entry.filePath), qPrintable( karaoke->lyricObject() ) );
-                    else
-                        Logger::debug( "SongDatabaseScanner: lyrics file %s cannot be loaded", qPrintable(entry.filePath) );
+    // Entries which are not submitted are done with
+    QByteArray lyricsText;
 
-                    continue;
-                }
+    if ( !processEntry( entry, lyricsText ) )
+    {
+        // If processing failed due to abort, the entry is still pending
+        if ( !m_abortScanning )
+            pendingEntryDone( entry.filePath );
 
-                // Detect the language
-                QString lyricsText = lyrics->exportAsText();
-                entry.language = m_langDetector->detectLanguage( lyricsText.toUtf8() );
+        return;
+    }
 
-                // Fill up the artist/title if we detected them
-                if ( lyrics->properties().contains( LyricsLoader::PROP_ARTIST ) )
-                    entry.artist = lyrics->properties()[ LyricsLoader::PROP_ARTIST ];
+    if ( lyricsText.isEmpty() )
+    {
+        addSubmitting( entry );
+        return;
+    }
 
-                if ( lyrics->properties().contains( LyricsLoader::PROP_TITLE ) )
-                    entry.title = lyrics->properties()[ LyricsLoader::PROP_TITLE ];
+    // We need to know the language; maybe we have seen those lyrics before
+    if ( m_langCache.lookup( LanguageDetectorCache::key( lyricsText ), entry.language ) )
+    {
+        addSubmitting( entry );
+        return;
+    }
+
+    detectEntries.push_back( entry );
+    detectTexts.push_back( lyricsText );
+
+    if ( detectEntries.size() >= LANGUAGE_DETECTION_BATCH )
+        detectLanguages( detectEntries, detectTexts );
+}
+
+void SongDatabaseScanner::detectLanguages( QList<SongDatabaseEntry>& entries, QList<QByteArray>& texts )
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QStringList languages;
+
+    if ( m_langDetectorBatch )
+        languages = m_langDetectorBatch->detectLanguages( texts );
+    else
+    {
+        Q_FOREACH( const QByteArray& text, texts )
+            languages.push_back( m_langDetector->detectLanguage( text ) );
+    }
+
+    m_stat_usecDetectingLanguage.fetchAndAddRelaxed( timer.nsecsElapsed() / 1000 );
+
+    for ( int i = 0; i < entries.size(); i++ )
+    {
+        entries[i].language = languages.value( i );
+        m_langCache.insert( LanguageDetectorCache::key( texts[i] ), entries[i].language );
+
+        addSubmitting( entries[i] );
+    }
+
+    entries.clear();
+    texts.clear();
+}
+
+bool SongDatabaseScanner::processEntry( SongDatabaseEntry& entry, QByteArray& lyricsText )
+{
+    // See what, if anything we already have for this path (the database stores the replaced path)
+    QHash<QString, KnownSongEntry>::const_iterator known = m_knownSongs.constFind( pSettings->replacePath( entry.filePath ) );
 
-                if ( lyrics->properties().contains( LyricsLoader::PROP_LYRIC_SOURCE ) )
-                    entry.type += "/" + lyrics->properties()[ LyricsLoader::PROP_LYRIC_SOURCE ];
+    if ( known != m_knownSongs.constEnd() )
+    {
+        // We have the song, does it have all the information?
+        if ( known->complete )
+        {
+            // Is it up-to-date?
+            if ( QFileInfo(entry.filePath).lastModified() <= QDateTime::fromMSecsSinceEpoch( known->added * 1000LL ) )
+            {
+                Logger::debug( "SongDatabaseScanner: file %s has all the info and is up-to-date, skipped", qPrintable(entry.filePath) );
+                return false;
             }
+
+            Logger::debug( "SongDatabaseScanner: file %s has all the info but is not up-to-date", qPrintable(entry.filePath) );
         }
+    }
+
+    // Detecting the lyrics type
+    int p = entry.filePath.lastIndexOf( '.' );
+
+    if ( p == -1 )
+        return false;
+
+    // Just use the uppercase extension
+    entry.type = entry.filePath.mid( p + 1 ).toUpper();
+
+    // Read the karaoke file unless it is a video file
+    if ( !KaraokePlayable::isVideoFile( entry.filePath ) )
+    {
+        QElapsedTimer timer;
+        timer.start();
 
-        // Get the artist/title from path according to settings
-        if ( !guessArtistandTitle( entry.filePath, m_collection[entry.colidx].artistTitleSeparator, entry.artist, entry.title ) )
+        QScopedPointer<KaraokePlayable> karaoke( KaraokePlayable::create( entry.filePath ) );
+
+        // Large compound files take a while to read, so let them abort as well
+        if ( karaoke )
+            karaoke->setCancelFlag( &m_abortScanning );
+
+        bool parsed = karaoke && karaoke->parse();
+
+        m_stat_usecParsing.fetchAndAddRelaxed( timer.nsecsElapsed() / 1000 );
+
+        if ( !parsed )
         {
-            Logger::debug( "SongDatabaseScanner: failed to detect artist/title for file %s, skipped", qPrintable(entry.filePath) );
-            continue;
+            Logger::debug( "SongDatabaseScanner: WARNING ignoring file %s as it cannot be parsed", qPrintable(entry.filePath) );
+            return false;
         }
 
-        Logger::debug( "SongDatabaseScanner: added/updated song %s by %s, type %s, language %s, file %s",
-                       qPrintable(entry.title),
-                       qPrintable(entry.artist),
-                       qPrintable(entry.type),
-                       entry.language.isEmpty() ? "---" : qPrintable(entry.language),
-                       qPrintable(entry.filePath) );
+        // For non-CDG files we can do the artist/title and language detection from source
+        if ( !karaoke->lyricObject().endsWith( ".cdg", Qt::CaseInsensitive ) && m_collection[entry.colidx].detectLanguage && m_langDetector )
+        {
+            // Get the pointer to the device the lyrics are stored in (will be deleted after the pointer out-of-scoped)
+            QScopedPointer<QIODevice> lyricDevice( karaoke->openObject( karaoke->lyricObject() ) );
+
+            if ( lyricDevice == 0 )
+            {
+                Logger::debug( "SongDatabaseScanner: WARNING cannot open lyric file %s in karaoke file %s", qPrintable( karaoke->lyricObject() ), qPrintable(entry.filePath) );
+                return false;
+            }
+
+            QScopedPointer<PlayerLyricsText> lyrics( new PlayerLyricsText( "", "" ) );
 
-        // entry.colidx has different meaning in the database - fix it before adding
-        entry.colidx = m_collection[ entry.colidx ].id;
+            if ( !lyrics->load( lyricDevice.data(), karaoke->lyricObject() ) )
+            {
+                if ( karaoke->lyricObject() != entry.filePath )
+                    Logger::debug( "SongDatabaseScanner: karaoke file %s contains invalid lyrics %s", qPrintable(entry.filePath), qPrintable( karaoke->lyricObject() ) );
+                else
+                    Logger::debug( "SongDatabaseScanner: lyrics file %s cannot be loaded", qPrintable(entry.filePath) );
 
-        // and prepare for submission
-        addSubmitting( entry );
+                return false;
+            }
+
+            // The language is detected by the caller, so it could be batched
+            lyricsText = lyrics->exportAsText().toUtf8();
+
+            // Fill up the artist/title if we detected them
+            if ( lyrics->properties().contains( LyricsLoader::PROP_ARTIST ) )
+                entry.artist = lyrics->properties()[ LyricsLoader::PROP_ARTIST ];
+
+            if ( lyrics->properties().contains( LyricsLoader::PROP_TITLE ) )
+                entry.title = lyrics->properties()[ LyricsLoader::PROP_TITLE ];
+
+            if ( lyrics->properties().contains( LyricsLoader::PROP_LYRIC_SOURCE ) )
+                entry.type += "/" + lyrics->properties()[ LyricsLoader::PROP_LYRIC_SOURCE ];
+        }
     }
 
-    // If m_threadsRunning was 1 when this thread finished, this is the last one before the submitting thread
-    if ( m_threadsRunning.fetchAndAddAcquire( -1 ) == 1 )
+    // Get the artist/title from path according to settings: try the patterns first, and then the separator
+    bool matched = false;
+
+    Q_FOREACH( const SongPathPattern& pattern, m_pathPatterns.value( entry.colidx ) )
     {
-        // Signal that no more data would be submitted - shut down
-        Logger::debug( "SongDatabaseScanner: last procesing thread finished, signaling the submitter to shut down" );
-        m_finishScanning = 1;
+        if ( pattern.match( entry.filePath, entry.artist, entry.title ) )
+        {
+            matched = true;
+            break;
+        }
+    }
 
-        // In case the submitter is waiting in condition
-        m_submittingQueueCond.wakeAll();
+    if ( !matched && !guessArtistandTitle( entry.filePath, m_collection[entry.colidx].artistTitleSeparator, entry.artist, entry.title ) )
+    {
+        Logger::debug( "SongDatabaseScanner: failed to detect artist/title for file %s, skipped", qPrintable(entry.filePath) );
+        return false;
     }
-    else
-        Logger::debug( "SongDatabaseScanner: procesing thread finished" );
+
+    Logger::debug( "SongDatabaseScanner: added/updated song %s by %s, type %s, language %s, file %s",
+                   qPrintable(entry.title),
+                   qPrintable(entry.artist),
+                   qPrintable(entry.type),
+                   !lyricsText.isEmpty() ? "(to detect)" : entry.language.isEmpty() ? "---" : qPrintable(entry.language),
+                   qPrintable(entry.filePath) );
+
+    // entry.colidx has different meaning in the database - fix it before adding
+    entry.colidx = m_collection[ entry.colidx ].id;
+
+    // and prepare for submission
+    return true;
 }
 
 void SongDatabaseScanner::submittingThread()
 {
-    const int ENTRIES_TO_UPDATE = 200;
-
     Logger::debug( "SongDatabaseScanner: submitting thread started" );
 
     while ( m_finishScanning == 0 )
@@ -573,9 +1159,22 @@ void SongDatabaseScanner::submittingThread()
             QList<SongDatabaseEntry> copy = m_submittingQueue;
             m_submittingQueue.clear();
             m_submittingQueueMutex.unlock();
+            m_submittingQueueNotFullCond.wakeAll();
 
             // Now update at our own pace
-            pDatabase->updateDatabase( copy );
+            QElapsedTimer timer;
+            timer.start();
+
+            // If aborted in the middle, the batch is rolled back and entries stay pending
+            if ( pDatabase->updateDatabase( copy, &m_abortScanning ) )
+            {
+                Q_FOREACH( const SongDatabaseEntry& entry, copy )
+                    pendingEntryDone( entry.filePath );
+            }
+            else if ( !m_abortScanning )
+                submissionFailed( copy.size() );
+
+            m_stat_usecSubmitting.fetchAndAddRelaxed( timer.nsecsElapsed() / 1000 );
 
             // and straight away into the loop (no falling through into wait, mutex is not locked)
             continue;
@@ -585,12 +1184,60 @@ void SongDatabaseScanner::submittingThread()
         m_submittingQueueMutex.unlock();
     }
 
-    // Submit the rest, if any
-    if ( !m_submittingQueue.isEmpty() )
-        pDatabase->updateDatabase( m_submittingQueue );
+    // Submit the rest, if any (when aborted, they're kept in the checkpoint instead)
+    if ( !m_submittingQueue.isEmpty() && !m_abortScanning )
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        if ( pDatabase->updateDatabase( m_submittingQueue, &m_abortScanning ) )
+        {
+            Q_FOREACH( const SongDatabaseEntry& entry, m_submittingQueue )
+                pendingEntryDone( entry.filePath );
+        }
+        else if ( !m_abortScanning )
+            submissionFailed( m_submittingQueue.size() );
+
+        m_stat_usecSubmitting.fetchAndAddRelaxed( timer.nsecsElapsed() / 1000 );
+    }
+
+    // Detection results are valid even if the scan was aborted
+    if ( m_langDetector )
+        m_langCache.save();
 
     if ( !m_abortScanning )
     {
+        // Entries removed from the collection indexes go last, so the index state is only stored if they're gone.
+        // They stay in the checkpoint until then.
+        m_checkpointMutex.lock();
+        QStringList removed = m_indexRemovedPaths;
+        m_checkpointMutex.unlock();
+
+        if ( removed.isEmpty() || pDatabase->removeSongs( removed, &m_abortScanning ) )
+        {
+            m_checkpointMutex.lock();
+            m_indexRemovedPaths.clear();
+            m_checkpointMutex.unlock();
+
+            saveIndexState();
+        }
+        else
+        {
+            Logger::error( "SongDatabaseScanner: failed to remove the songs deleted from the collection indexes" );
+            m_stat_failures++;
+        }
+    }
+
+    // Final statistics, so the clients do not keep showing the scan in progress
+    QJsonObject stats = scanStatistics( false );
+    logScanSummary( stats );
+    emit pEventor->scanCollectionStatistics( stats );
+
+    if ( !m_abortScanning )
+    {
+        // Scan is completed, nothing to resume
+        removeCheckpoint();
+
         pDatabase->updateLastScan();
         pDatabase->getDatabaseCurrentState();
         emit pEventor->scanCollectionFinished();
@@ -601,13 +1248,53 @@ void SongDatabaseScanner::submittingThread()
         Logger::debug( "SongDatabaseScanner: submitter thread finished, scan aborted" );
 }
 
-void SongDatabaseScanner::parseCollectionIndex( const CollectionEntry& col, const QByteArray &indexdata)
+// Parses the text index line <artist>|<title>|<filepathfromroot>|<musicpathifneeded>|<type>[|language]
+static bool parseIndexLine( const CollectionEntry& col, const QString& line, SongDatabaseScanner::SongDatabaseEntry& dbe )
+{
+    QStringList values = line.split( '|' );
+
+    if ( values.size() < 5 )
+        return false;
+
+    dbe.colidx = col.id;
+    dbe.artist = values[0];
+    dbe.title = values[1];
+    dbe.filePath = col.rootPath + "/" + values[2];
+    dbe.musicPath.clear();
+
+    if ( !values[3].isEmpty() )
+        dbe.musicPath = col.rootPath + "/" + values[3];
+
+    dbe.type = values[4];
+    dbe.language.clear();
+    dbe.flags = 0;
+
+    if ( values.size() > 5 )
+        dbe.language = values[5];
+
+    return true;
+}
+
+bool SongDatabaseScanner::parseCollectionIndex( const CollectionEntry& col, const QByteArray &indexdata, quint32& version )
 {
+    version = 0;
+
+    // Binary index is detected by its signature
+    if ( CollectionIndex::isBinary( indexdata ) )
+    {
+        if ( parseCollectionIndexBinary( col, indexdata, version ) )
+            return true;
+
+        Logger::error( "SongDatabaseScanner: binary collection index for %s is corrupted, ignored", qPrintable( col.name ) );
+        return false;
+    }
+
     // Index file is a simple vertical dash-separated text file in UTF8, containing per each line:
     // <artist> <title> <filepathfromroot> <musicpathifneeded> <type> [language]
     // filepathfromroot must contain path of lyrics (for music+lyric file)
     // or the complete file (if video or zip). In former case musicpathifneeded
     // should contain the music file, otherwise it should be empty.
+    // The optional first line "#version <number>" contains the index version (see parseCollectionIndexDelta)
     QStringList entries = QString::fromUtf8( indexdata ).split( "\n" );
 
     Q_FOREACH( const QString& entry, entries )
@@ -616,54 +1303,574 @@ void SongDatabaseScanner::parseCollectionIndex( const CollectionEntry& col, cons
         if ( entry.trimmed().isEmpty() )
             continue;
 
+        if ( entry.startsWith( "#version " ) )
+        {
+            version = entry.mid( 9 ).trimmed().toUInt();
+            continue;
+        }
+
         // Parse it
-        QStringList values = entry.split( '|' );
+        SongDatabaseEntry dbe;
 
-        if ( values.size() < 5 )
+        if ( !parseIndexLine( col, entry, dbe ) )
         {
             Logger::error( "SongDatabaseScanner: Invalid line in the collection index: %s",
                            qPrintable( entry) );
             continue;
         }
 
+        addSubmitting( dbe );
+    }
+
+    Logger::error( "SongDatabaseScanner: added %d entries via index file", entries.size() );
+    return true;
+}
+
+bool SongDatabaseScanner::parseCollectionIndexDelta( const CollectionEntry &col, const QByteArray &deltadata, quint32 fromVersion, quint32 &toVersion )
+{
+    // Delta index is a text file in UTF8 listing the index changes between two versions:
+    // #delta <fromversion> <toversion>
+    // +<artist>|<title>|<filepathfromroot>|<musicpathifneeded>|<type>|[language]
+    // -<filepathfromroot>|<musicpathifneeded>
+    // Added and modified entries are listed as +, and removed ones (or those whose paths changed) as -.
+    QStringList lines = QString::fromUtf8( deltadata ).split( "\n" );
+    QStringList header = lines.isEmpty() ? QStringList() : lines.takeFirst().trimmed().split( ' ' );
+
+    if ( header.size() != 3 || header[0] != "#delta" )
+    {
+        Logger::error( "SongDatabaseScanner: collection index delta for %s is invalid, ignored", qPrintable( col.name ) );
+        return false;
+    }
+
+    quint32 from = header[1].toUInt(), to = header[2].toUInt();
+
+    // Nothing changed since our version
+    if ( to == fromVersion )
+    {
+        Logger::debug( "SongDatabaseScanner: collection index for %s is at version %u already, skipped", qPrintable( col.name ), to );
+        toVersion = to;
+        return true;
+    }
+
+    // The delta doesn't start at our version, the full index is needed
+    if ( from != fromVersion )
+    {
+        Logger::debug( "SongDatabaseScanner: collection index delta for %s is from version %u, we have %u",
+                       qPrintable( col.name ), from, fromVersion );
+        return false;
+    }
+
+    // Parse everything first, so an invalid delta doesn't leave a partial submission
+    QList<SongDatabaseEntry> added;
+    QStringList removed;
+
+    Q_FOREACH( const QString& line, lines )
+    {
+        if ( line.trimmed().isEmpty() )
+            continue;
+
+        if ( line.startsWith( '+' ) )
+        {
+            SongDatabaseEntry dbe;
+
+            if ( !parseIndexLine( col, line.mid( 1 ), dbe ) )
+                return false;
+
+            added.push_back( dbe );
+        }
+        else if ( line.startsWith( '-' ) )
+        {
+            QStringList values = line.mid( 1 ).split( '|' );
+
+            if ( values.size() < 2 )
+                return false;
+
+            // Database path of the entry, same as in Database::updateDatabase
+            QString path = col.rootPath + "/" + values[0];
+
+            if ( col.type != CollectionProvider::TYPE_FILESYSTEM && !values[1].isEmpty() )
+                path += "|" + col.rootPath + "/" + values[1];
+
+            removed.push_back( path );
+        }
+        else
+            return false;
+    }
+
+    Q_FOREACH( const SongDatabaseEntry& dbe, added )
+        addSubmitting( dbe );
+
+    // Removed entries are deleted once everything is submitted
+    m_checkpointMutex.lock();
+    m_indexRemovedPaths += removed;
+    m_checkpointMutex.unlock();
+
+    Logger::debug( "SongDatabaseScanner: applied collection index delta for %s from version %u to %u, %d entries added, %d removed",
+                   qPrintable( col.name ), from, to, added.size(), removed.size() );
+
+    toVersion = to;
+    return true;
+}
+
+bool SongDatabaseScanner::parseCollectionIndexBinary( const CollectionEntry &col, const QByteArray &indexdata, quint32& indexVersion )
+{
+    // Parse everything first, so a corrupted index doesn't leave a partial submission
+    QList<CollectionIndex::Entry> entries;
+    QString errmsg;
+
+    if ( !CollectionIndex::parseBinary( indexdata, indexVersion, entries, errmsg ) )
+    {
+        Logger::error( "SongDatabaseScanner: binary collection index: %s", qPrintable( errmsg ) );
+        return false;
+    }
+
+    Q_FOREACH( const CollectionIndex::Entry& entry, entries )
+    {
         SongDatabaseEntry dbe;
         dbe.colidx = col.id;
-        dbe.artist = values[0];
-        dbe.title = values[1];
-        dbe.filePath = col.rootPath + "/" + values[2];
-
-        if ( !values[3].isEmpty() )
-            dbe.musicPath = col.rootPath + "/" + values[3];
+        dbe.artist = entry.artist;
+        dbe.title = entry.title;
+        dbe.filePath = col.rootPath + "/" + entry.filePath;
 
-        dbe.type = values[4];
+        if ( !entry.musicPath.isEmpty() )
+            dbe.musicPath = col.rootPath + "/" + entry.musicPath;
 
-        if ( values.size() > 5 )
-            dbe.language = values[5];
+        dbe.type = entry.type;
+        dbe.language = entry.language;
+        dbe.flags = 0;
 
         addSubmitting( dbe );
     }
 
-    Logger::error( "SongDatabaseScanner: added %d entries via index file", entries.size() );
+    Logger::debug( "SongDatabaseScanner: added %d entries via binary index file", entries.size() );
+    return true;
 }
 
 void SongDatabaseScanner::addProcessing(const SongDatabaseScanner::SongDatabaseEntry &entry)
 {
+    // Empty path is the end-of-queue marker, not an entry
+    if ( !entry.filePath.isEmpty() )
+    {
+        m_checkpointMutex.lock();
+        m_scanPendingEntries.insert( entry.filePath, entry );
+        m_checkpointMutex.unlock();
+    }
+
     m_stat_karaokeFilesFound++;
     m_processingQueueMutex.lock();
+
+    // Wait until the processing threads catch up; the end-of-queue marker is always added
+    while ( !entry.filePath.isEmpty() && m_processingQueue.size() >= m_processingQueueLimit && m_finishScanning == 0 )
+        m_processingQueueNotFullCond.wait( &m_processingQueueMutex );
+
     m_processingQueue.push_back( entry );
+
+    if ( !entry.filePath.isEmpty() )
+        m_stat_processingQueuePeak = qMax( m_stat_processingQueuePeak, m_processingQueue.size() );
+
+    m_processingQueueMutex.unlock();
+    m_processingQueueCond.wakeOne();
+}
+
+void SongDatabaseScanner::addProcessingDirectory( const QList<SongDatabaseEntry> &entries )
+{
+    if ( entries.isEmpty() )
+        return;
+
+    m_checkpointMutex.lock();
+
+    Q_FOREACH( const SongDatabaseEntry& entry, entries )
+        m_scanPendingEntries.insert( entry.filePath, entry );
+
+    m_checkpointMutex.unlock();
+
+    m_stat_karaokeFilesFound.fetchAndAddRelaxed( entries.size() );
+    m_processingQueueMutex.lock();
+
+    // The directory is queued at once (so the queue may exceed the limit by the directory size)
+    while ( m_processingQueue.size() >= m_processingQueueLimit && m_finishScanning == 0 )
+        m_processingQueueNotFullCond.wait( &m_processingQueueMutex );
+
+    m_processingQueue += entries;
+    m_stat_processingQueuePeak = qMax( m_stat_processingQueuePeak, m_processingQueue.size() );
     m_processingQueueMutex.unlock();
     m_processingQueueCond.wakeOne();
 }
 
 void SongDatabaseScanner::addSubmitting(const SongDatabaseScanner::SongDatabaseEntry &entry)
 {
+    // Replaces the unprocessed entry, so on resume it would only need to be submitted
+    m_checkpointMutex.lock();
+    m_scanPendingEntries.insert( entry.filePath, entry );
+    m_checkpointMutex.unlock();
+
     m_stat_karaokeFilesSubmitted++;
     m_submittingQueueMutex.lock();
+
+    // Wait until the submitter catches up
+    while ( m_submittingQueue.size() >= m_submittingQueueLimit && m_finishScanning == 0 )
+        m_submittingQueueNotFullCond.wait( &m_submittingQueueMutex );
+
     m_submittingQueue.push_back( entry );
+    m_stat_submittingQueuePeak = qMax( m_stat_submittingQueuePeak, m_submittingQueue.size() );
     m_submittingQueueMutex.unlock();
     m_submittingQueueCond.wakeOne();
 }
 
+QJsonObject SongDatabaseScanner::scanStatistics( bool running )
+{
+    QJsonObject stats, queues, stages;
+
+    m_processingQueueMutex.lock();
+    queues["processing"] = m_processingQueue.size();
+    queues["processingPeak"] = m_stat_processingQueuePeak;
+    m_processingQueueMutex.unlock();
+
+    m_submittingQueueMutex.lock();
+    queues["submitting"] = m_submittingQueue.size();
+    queues["submittingPeak"] = m_stat_submittingQueuePeak;
+    m_submittingQueueMutex.unlock();
+
+    // Stage times are in milliseconds
+    stages["enumerating"] = (double) (m_stat_usecEnumerating.load() / 1000);
+    stages["parsing"] = (double) (m_stat_usecParsing.load() / 1000);
+    stages["language"] = (double) (m_stat_usecDetectingLanguage.load() / 1000);
+    stages["submitting"] = (double) (m_stat_usecSubmitting.load() / 1000);
+
+    qint64 elapsed = m_stat_scanTimer.isValid() ? m_stat_scanTimer.elapsed() : 0;
+    int found = m_stat_karaokeFilesFound.load();
+    int processed = m_stat_karaokeFilesProcessed.load();
+
+    // While running the rolling rate is used, and the overall average once done
+    double rate = running ? m_stat_processingRate : ( elapsed > 0 ? processed * 1000.0 / elapsed : 0.0 );
+
+    // ETA is only for the files found so far, as we do not know how many are still to be found.
+    // -1 means unknown (we haven't processed anything yet)
+    int eta = -1;
+
+    if ( !running )
+        eta = 0;
+    else if ( rate > 0.0 )
+        eta = (int) ( qMax( found - processed, 0 ) / rate );
+
+    stats["running"] = running;
+    stats["paused"] = m_pausedThreads.load() > 0;
+    stats["aborted"] = m_abortScanning.load() != 0;
+    stats["elapsed"] = (double) (elapsed / 1000);
+    stats["directories"] = m_stat_directoriesScanned.load();
+    stats["found"] = found;
+    stats["processed"] = processed;
+    stats["submitted"] = m_stat_karaokeFilesSubmitted.load();
+    stats["failures"] = m_stat_failures.load();
+    stats["rate"] = rate;
+    stats["eta"] = eta;
+    stats["queues"] = queues;
+    stats["stages"] = stages;
+    stats["languageCacheHits"] = m_langCache.hits();
+    stats["languageCacheMisses"] = m_langCache.misses();
+
+    return stats;
+}
+
+void SongDatabaseScanner::submissionFailed( int entries )
+{
+    // The entries stay pending in the checkpoint, so they are submitted again if the scan is resumed
+    Logger::error( "SongDatabaseScanner: failed to store %d entries in the database", entries );
+    m_stat_failures++;
+}
+
+void SongDatabaseScanner::logScanSummary( const QJsonObject& stats )
+{
+    QJsonObject stages = stats["stages"].toObject();
+
+    Logger::debug( "SongDatabaseScanner: scan %s in %s: %d directories scanned, %d karaoke files found, %d processed, %d submitted, %.1f files/s, %d failures",
+                   stats["aborted"].toBool() ? "aborted" : "completed",
+                   qPrintable( durationToString( stats["elapsed"].toInt() ) ),
+                   stats["directories"].toInt(),
+                   stats["found"].toInt(),
+                   stats["processed"].toInt(),
+                   stats["submitted"].toInt(),
+                   stats["rate"].toDouble(),
+                   stats["failures"].toInt() );
+
+    Logger::debug( "SongDatabaseScanner: time spent (ms, all threads): enumerating %.0f, parsing %.0f, language detection %.0f, database submission %.0f",
+                   stages["enumerating"].toDouble(),
+                   stages["parsing"].toDouble(),
+                   stages["language"].toDouble(),
+                   stages["submitting"].toDouble() );
+
+    QJsonObject queues = stats["queues"].toObject();
+
+    Logger::debug( "SongDatabaseScanner: largest queue sizes: processing %d (limit %d), submitting %d (limit %d)",
+                   queues["processingPeak"].toInt(),
+                   m_processingQueueLimit,
+                   queues["submittingPeak"].toInt(),
+                   m_submittingQueueLimit );
+
+    int hits = stats["languageCacheHits"].toInt();
+    int lookups = hits + stats["languageCacheMisses"].toInt();
+
+    if ( lookups > 0 )
+        Logger::debug( "SongDatabaseScanner: language detection cache hit rate %d%% (%d of %d)", hits * 100 / lookups, hits, lookups );
+}
+
+void SongDatabaseScanner::waitWhilePlaying()
+{
+    if ( !pSettings->scannerPauseWhilePlaying )
+        return;
+
+    QMutexLocker m( &m_karaokePlayingMutex );
+
+    if ( !m_karaokePlaying || m_finishScanning != 0 )
+        return;
+
+    m_pausedThreads++;
+
+    while ( m_karaokePlaying && m_finishScanning == 0 )
+        m_karaokePlayingCond.wait( &m_karaokePlayingMutex );
+
+    m_pausedThreads--;
+}
+
+void SongDatabaseScanner::karaokePlaybackStarted()
+{
+    QMutexLocker m( &m_karaokePlayingMutex );
+    m_karaokePlaying = true;
+}
+
+void SongDatabaseScanner::karaokePlaybackStopped()
+{
+    QMutexLocker m( &m_karaokePlayingMutex );
+    m_karaokePlaying = false;
+    m_karaokePlayingCond.wakeAll();
+}
+
+void SongDatabaseScanner::pendingEntryDone( const QString &path )
+{
+    QMutexLocker m( &m_checkpointMutex );
+    m_scanPendingEntries.remove( path );
+}
+
+QMap<int, QByteArray> SongDatabaseScanner::collectionScanSettings() const
+{
+    QMap<int, QByteArray> settings;
+
+    for ( QMap<int,CollectionEntry>::const_iterator it = m_collection.begin(); it != m_collection.end(); ++it )
+    {
+        QByteArray data;
+        QDataStream dts( &data, QIODevice::WriteOnly );
+
+        dts << (int) it->type << it->rootPath << it->detectLanguage << it->defaultLanguage << it->scanZips
+            << it->artistTitleSeparator << it->artistTitlePatterns;
+
+        settings[ it->id ] = data;
+    }
+
+    return settings;
+}
+
+void SongDatabaseScanner::loadCheckpoint()
+{
+    QMutexLocker f( &m_scanFrontierMutex );
+    QMutexLocker m( &m_checkpointMutex );
+
+    m_scanFrontier.clear();
+    m_scanActiveDirectories.clear();
+    m_scanCompletedCollections.clear();
+    m_scanPendingEntries.clear();
+    m_scanCollectionId = -1;
+
+    ScanCheckpoint checkpoint;
+    QString errmsg;
+
+    if ( !checkpoint.load( pSettings->scanCheckpointFilename, errmsg ) )
+    {
+        if ( !errmsg.isEmpty() )
+            Logger::error( "SongDatabaseScanner: scan checkpoint is invalid (%s), starting from scratch", qPrintable( errmsg ) );
+
+        return;
+    }
+
+    // The checkpoint is only valid for the same collections scanned with the same settings
+    if ( checkpoint.collections != collectionScanSettings() )
+    {
+        Logger::debug( "SongDatabaseScanner: collections changed since the scan checkpoint, starting from scratch" );
+        return;
+    }
+
+    m_scanCompletedCollections = checkpoint.completedCollections;
+    m_scanCollectionId = checkpoint.collectionId;
+    m_scanFrontier = checkpoint.frontier;
+    m_scanPendingEntries = checkpoint.pendingEntries;
+    m_indexStateUpdated = checkpoint.indexStates;
+    m_indexRemovedPaths = checkpoint.indexRemovedPaths;
+
+    Logger::debug( "SongDatabaseScanner: loaded scan checkpoint with %d directories, %d entries and %d index removals pending",
+                   m_scanFrontier.size(), m_scanPendingEntries.size(), m_indexRemovedPaths.size() );
+}
+
+bool SongDatabaseScanner::takeCheckpoint( ScanCheckpoint &checkpoint )
+{
+    // Only copy under the lock (the containers are implicitly shared, so this is cheap);
+    // the scanner threads are not waiting while the checkpoint is written
+    QSet<QString> active;
+
+    m_scanFrontierMutex.lock();
+    m_checkpointMutex.lock();
+
+    if ( !m_checkpointEnabled )
+    {
+        m_checkpointMutex.unlock();
+        m_scanFrontierMutex.unlock();
+        return false;
+    }
+
+    checkpoint.completedCollections = m_scanCompletedCollections;
+    checkpoint.collectionId = m_scanCollectionId;
+    checkpoint.frontier = m_scanFrontier;
+    checkpoint.pendingEntries = m_scanPendingEntries;
+    checkpoint.indexStates = m_indexStateUpdated;
+    checkpoint.indexRemovedPaths = m_indexRemovedPaths;
+    active = m_scanActiveDirectories;
+
+    m_checkpointMutex.unlock();
+    m_scanFrontierMutex.unlock();
+
+    // Directories being enumerated right now are stored as not enumerated
+    QStringList frontier = active.toList();
+    frontier += checkpoint.frontier;
+
+    checkpoint.frontier = frontier;
+    checkpoint.collections = collectionScanSettings();
+    return true;
+}
+
+void SongDatabaseScanner::saveCheckpoint()
+{
+    // This is called by the progress timer; a slow disk should not block it, nor should the writes pile up
+    if ( m_checkpointWriter.isRunning() )
+        return;
+
+    ScanCheckpoint checkpoint;
+
+    if ( takeCheckpoint( checkpoint ) )
+        m_checkpointWriter = QtConcurrent::run( this, &SongDatabaseScanner::writeCheckpoint, checkpoint );
+}
+
+void SongDatabaseScanner::writeCheckpoint( const ScanCheckpoint &checkpoint )
+{
+    QMutexLocker m( &m_checkpointFileMutex );
+
+    // The scan might have completed (and the checkpoint removed) since the copy was taken
+    m_checkpointMutex.lock();
+    bool enabled = m_checkpointEnabled;
+    m_checkpointMutex.unlock();
+
+    if ( !enabled )
+        return;
+
+    QString errmsg;
+
+    if ( !checkpoint.save( pSettings->scanCheckpointFilename, errmsg ) )
+        Logger::error( "SongDatabaseScanner: cannot store scan checkpoint: %s", qPrintable( errmsg ) );
+}
+
+void SongDatabaseScanner::loadIndexState()
+{
+    QMutexLocker m( &m_checkpointMutex );
+
+    m_indexState.clear();
+    m_indexStateUpdated.clear();
+    m_indexRemovedPaths.clear();
+
+    QFile fin( pSettings->scanIndexStateFilename );
+
+    if ( !fin.open( QIODevice::ReadOnly ) )
+        return;
+
+    QDataStream dts( &fin );
+    QString header;
+    int version, count;
+
+    dts >> header >> version;
+
+    if ( header != "INDEXSTATE" || version != INDEX_STATE_VERSION )
+        return;
+
+    dts >> count;
+
+    QMap<int, IndexState> states;
+
+    for ( int i = 0; i < count && dts.status() == QDataStream::Ok; i++ )
+    {
+        int id;
+        QString root;
+        IndexState state;
+
+        dts >> id >> root >> state.version >> state.etag >> state.lastModified;
+
+        // Only valid for the same collection root
+        if ( m_collection.contains( id ) && m_collection[id].rootPath == root )
+            states[ id ] = state;
+    }
+
+    if ( dts.status() != QDataStream::Ok )
+    {
+        Logger::error( "SongDatabaseScanner: collection index state is corrupted, full indexes will be used" );
+        return;
+    }
+
+    m_indexState = states;
+}
+
+void SongDatabaseScanner::saveIndexState()
+{
+    QMutexLocker m( &m_checkpointMutex );
+
+    if ( m_indexStateUpdated.isEmpty() )
+        return;
+
+    for ( QMap<int, IndexState>::const_iterator it = m_indexStateUpdated.begin(); it != m_indexStateUpdated.end(); ++it )
+        m_indexState[ it.key() ] = it.value();
+
+    m_indexStateUpdated.clear();
+
+    QSaveFile fout( pSettings->scanIndexStateFilename );
+
+    if ( !fout.open( QIODevice::WriteOnly ) )
+    {
+        Logger::error( "SongDatabaseScanner: cannot store collection index state: %s", qPrintable( fout.errorString() ) );
+        return;
+    }
+
+    QDataStream dts( &fout );
+    dts << QString("INDEXSTATE");
+    dts << (int) INDEX_STATE_VERSION;
+    dts << m_indexState.size();
+
+    for ( QMap<int, IndexState>::const_iterator it = m_indexState.begin(); it != m_indexState.end(); ++it )
+        dts << it.key() << m_collection.value( it.key() ).rootPath << it->version << it->etag << it->lastModified;
+
+    fout.commit();
+}
+
+void SongDatabaseScanner::indexStateUpdated( int id, const IndexState &state )
+{
+    QMutexLocker m( &m_checkpointMutex );
+    m_indexStateUpdated[ id ] = state;
+}
+
+void SongDatabaseScanner::removeCheckpoint()
+{
+    QMutexLocker f( &m_checkpointFileMutex );
+
+    m_checkpointMutex.lock();
+    m_checkpointEnabled = false;
+    m_checkpointMutex.unlock();
+
+    QFile::remove( pSettings->scanCheckpointFilename );
+}
+
 bool SongDatabaseScanner::guessArtistandTitle( const QString& filePath, const QString& separator, QString& artist, QString& title )
 {
     if ( separator != "/" )
@@ -20,18 +20,29 @@
 #define SONGDATABASESCANNER_H
 
 #include <QMap>
+#include <QSet>
+#include <QHash>
 #include <QQueue>
 #include <QTimer>
 #include <QObject>
 #include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QJsonObject>
 #include <QWaitCondition>
 #include <QMutex>
+#include <QFuture>
 #include <QDateTime>
 
 #include "collectionentry.h"
+#include "languagedetectorcache.h"
+#include "songpathpattern.h"
 
 class SongDatabaseScannerWorkerThread;
 class Interface_LanguageDetector;
+class Interface_LanguageDetectorBatch;
+class CollectionProvider;
+class ScanCheckpoint;
 
 class SongDatabaseScanner : public QObject
 {
@@ -54,20 +65,60 @@ class SongDatabaseScanner : public QObject
                 int         flags;
         };
 
+        // The song already in the database, to decide whether the file needs to be processed again
+        class KnownSongEntry
+        {
+            public:
+                qint64      id;
+                qint64      added;      // when the song was added/updated, in seconds since epoch
+                int         collectionId;
+                bool        complete;   // artist, title, type and language are all present
+        };
+
+        // The collection index which is in the database, so the next scan only needs to apply the changes
+        class IndexState
+        {
+            public:
+                IndexState() : version( 0 ) {}
+
+                quint32     version;        // index version, 0 if unknown
+                QString     etag;           // validators of the full index file (see CollectionProvider::setValidators)
+                QString     lastModified;
+        };
+
         // Find out the artist and title from lyrics, music or file path.
         static bool    guessArtistandTitle(const QString &filepath , const QString &separator, QString &artist, QString &title);
 
     public slots:
         bool    startScan();
-        void    stopScan();
+
+        // Aborts the scan, waiting up to SCAN_STOP_TIMEOUT for the threads to stop. Returns false if some
+        // threads are still blocked; those are left running, so the scanner must not be deleted directly.
+        bool    stopScan();
+
+        // Stops the scan and deletes the scanner, or schedules it to be deleted once the threads
+        // which did not stop in time are finished
+        void    stopAndDelete();
 
     private slots:
         void    updateScanProgress();
 
+        // A thread left running by stopAndDelete() finished
+        void    stoppedThreadFinished();
+
+        // Karaoke playback started or stopped, so the threads paused while playing are resumed
+        void    karaokePlaybackStarted();
+        void    karaokePlaybackStopped();
+
         // Those slots is used when downloading index using the provider
         void    providerFinished( int id, QString errmsg );
         void    providerProgress( int id, int percentage );
 
+    protected:
+        // Lists the directory: the paths of its subdirectories and files. Stops early (with partial results) if
+        // the scan is aborted. This is the only place the collection directories are read during enumeration.
+        virtual void listDirectory( const QString& path, QStringList& directories, QStringList& files );
+
     private:
         friend class SongDatabaseScannerWorkerThread;
 
@@ -75,6 +126,14 @@ class SongDatabaseScanner : public QObject
         // and does not read any files nor accesses the database.
         void    scanCollectionsThread();
 
+        // Enumerates the directories in m_scanFrontier of the local collection until there are none left,
+        // using collection.scanThreads threads running enumerateDirectories()
+        void    enumerateCollection( const CollectionEntry& collection );
+        void    enumerateDirectories( const CollectionEntry& collection );
+
+        // Marks the collection as enumerated completely
+        void    collectionCompleted( int id );
+
         // This thread scans the database and cleans up the entries if the files were removed from disk
         void    cleanupThread();
 
@@ -86,31 +145,185 @@ class SongDatabaseScanner : public QObject
         // This thread submits the new entries into the database.
         void    submittingThread();
 
-        // Parses the collection index file to skip enumerator and processor
-        void    parseCollectionIndex(const CollectionEntry &col, const QByteArray& indexdata );
+        // Reads the lyrics/artist/title/language for the entry. Returns true if the entry should be submitted
+        // into the database, and false if it is up-to-date or cannot be used.
+        // If the language needs to be detected, lyricsText is set to the lyrics (the entry is not ready to submit yet).
+        bool    processEntry( SongDatabaseEntry& entry, QByteArray& lyricsText );
+
+        // Processes the entry taken from the processing queue, and submits it (or adds to the language detection batch)
+        void    processQueuedEntry( SongDatabaseEntry& entry, QList<SongDatabaseEntry>& detectEntries, QList<QByteArray>& detectTexts );
+
+        // Detects the languages for the batch of entries, and submits them. Both lists are cleared.
+        void    detectLanguages( QList<SongDatabaseEntry>& entries, QList<QByteArray>& texts );
+
+        // Downloads the collection file via provider, waiting (without using CPU) until it is done. Returns 0 if succeed,
+        // 1 if failed (such as the file doesn't exist), and -1 if the scan was aborted.
+        int     downloadCollectionFile( CollectionProvider * provider, const QString& url, QByteArray& data );
+
+        // Retrieves the collection index and submits its entries. Only the changes since the index version
+        // stored in m_indexState are applied if possible (unless ignoreState is true).
+        // Returns false if the collection has no index (and needs to be enumerated) or the scan was aborted.
+        bool    scanCollectionIndex( const CollectionEntry& col, CollectionProvider * provider, bool ignoreState );
+
+        // Parses the collection index file to skip enumerator and processor. Both the text and
+        // binary index formats are supported; the format is detected by the file signature.
+        // Returns false if the index is corrupted; version is set to the index version (0 if not present)
+        bool    parseCollectionIndex( const CollectionEntry &col, const QByteArray& indexdata, quint32& version );
+
+        // Parses the binary collection index; returns false if the index is corrupted
+        bool    parseCollectionIndexBinary( const CollectionEntry &col, const QByteArray& indexdata, quint32& indexVersion );
+
+        // Applies the collection index delta if it starts at fromVersion (or just returns true if the delta
+        // ends at fromVersion, as nothing changed). Returns false if the delta cannot be used.
+        bool    parseCollectionIndexDelta( const CollectionEntry &col, const QByteArray& deltadata, quint32 fromVersion, quint32& toVersion );
 
         // Producer-consumer implementation of processing queue
         QMutex                      m_processingQueueMutex;
         QWaitCondition              m_processingQueueCond;
         QQueue<SongDatabaseEntry>   m_processingQueue;
 
-        // Adding an entry into the processing queue
+        // Signaled when an entry is taken from the processing queue, and the maximum queue size
+        QWaitCondition              m_processingQueueNotFullCond;
+        int                         m_processingQueueLimit;
+
+        // Adding an entry into the processing queue; waits if the queue is full
         void    addProcessing( const SongDatabaseEntry& entry );
 
+        // Adding all the entries of a directory together (in disk order mode); waits if the queue is full
+        void    addProcessingDirectory( const QList<SongDatabaseEntry>& entries );
+
+        // If true, processing threads take the whole directories from the queue (see Settings::scannerDiskOrder)
+        bool                        m_diskOrder;
+
         // Producer-consumer implementation of database submitting queue
         QMutex                      m_submittingQueueMutex;
         QWaitCondition              m_submittingQueueCond;
         QList<SongDatabaseEntry>    m_submittingQueue;
 
-        // Adding an entry into the submitting queue
+        // Signaled when the submitting queue is taken, and the maximum queue size
+        QWaitCondition              m_submittingQueueNotFullCond;
+        int                         m_submittingQueueLimit;
+
+        // Adding an entry into the submitting queue; waits if the queue is full
         void    addSubmitting( const SongDatabaseEntry& entry );
 
+        // Scan checkpoint: stores the directories not yet enumerated and the entries found but not yet
+        // stored in the database, so an interrupted scan could continue instead of restarting.
+        // Checkpoint is saved periodically and on abort, and removed once the scan is completed.
+        void    loadCheckpoint();
+        void    removeCheckpoint();
+
+        // Starts writing the checkpoint in a pool thread, unless the previous one is still being written
+        void    saveCheckpoint();
+
+        // Copies the checkpoint data; returns false if no checkpoint is needed (the scan is not running or completed)
+        bool    takeCheckpoint( ScanCheckpoint& checkpoint );
+
+        // Writes the checkpoint copy; does not block the scanner threads
+        void    writeCheckpoint( const ScanCheckpoint& checkpoint );
+
+        // Scan settings of each collection which affect the scan results (the checkpoint is only valid for the same)
+        QMap<int, QByteArray>   collectionScanSettings() const;
+
+        // Index state is loaded when the scan starts, and stored once the scan is completed
+        // (so an interrupted scan applies the same index changes again)
+        void    loadIndexState();
+        void    saveIndexState();
+
+        // Records the index state of the collection once its index is submitted
+        void    indexStateUpdated( int id, const IndexState& state );
+
+        // If enabled, waits while karaoke is playing (or until the scan is aborted)
+        void    waitWhilePlaying();
+
+        // Number of threads paused by waitWhilePlaying
+        QAtomicInt                  m_pausedThreads;
+
+        // Whether karaoke is playing, updated from the Eventor signals; waitWhilePlaying waits on the condition
+        QMutex                      m_karaokePlayingMutex;
+        QWaitCondition              m_karaokePlayingCond;
+        bool                        m_karaokePlaying;
+
+        // Entry is no longer pending (skipped or stored in the database)
+        void    pendingEntryDone( const QString& path );
+
+        // Protects the directory frontier below. The enumerating threads only use this one, so they do not
+        // contend with the other threads updating the checkpoint data. If both are locked, this one goes first.
+        QMutex                      m_scanFrontierMutex;
+
+        // Directories which are still to be enumerated for the collection being scanned,
+        // and those being enumerated right now (they are stored in checkpoint as not enumerated)
+        QStringList                 m_scanFrontier;
+        QSet<QString>               m_scanActiveDirectories;
+
+        // Signaled when a directory enumeration is finished (so the frontier might have changed)
+        QWaitCondition              m_scanFrontierCond;
+
+        // Protects all the checkpoint data below
+        QMutex                      m_checkpointMutex;
+
+        // Collection being enumerated (-1 if none), and those which are enumerated completely
+        int                         m_scanCollectionId;
+        QList<int>                  m_scanCompletedCollections;
+
+        // Entries which were found but not yet stored in the database, mapped by file path
+        QHash<QString, SongDatabaseEntry> m_scanPendingEntries;
+
+        // Database paths of the entries removed from the collection indexes, deleted once the scan is completed
+        QStringList                 m_indexRemovedPaths;
+
+        // Collection index states stored from the previous scan, and those updated by this scan (collection ID as a key)
+        QMap<int, IndexState>       m_indexState;
+        QMap<int, IndexState>       m_indexStateUpdated;
+
+        // True once the scan is started, and false again once it is completed and the checkpoint is not needed anymore
+        bool                        m_checkpointEnabled;
+
+        // Periodic checkpoint being written in background
+        QFuture<void>               m_checkpointWriter;
+
+        // Serializes the checkpoint writes and its removal, so a late write does not bring back the removed checkpoint
+        QMutex                      m_checkpointFileMutex;
+
+        // Progress update timer ticks since the last checkpoint
+        int                         m_checkpointTicks;
+
         // Scan runtime statistics
         QAtomicInt                  m_stat_directoriesScanned;
         QAtomicInt                  m_stat_karaokeFilesFound;
         QAtomicInt                  m_stat_karaokeFilesProcessed;
         QAtomicInt                  m_stat_karaokeFilesSubmitted;
 
+        // Collections which could not be downloaded or indexed, and database updates which failed
+        QAtomicInt                  m_stat_failures;
+
+        // Time spent in each scan stage (in microseconds, summed over all threads running this stage)
+        QAtomicInteger<qint64>      m_stat_usecEnumerating;
+        QAtomicInteger<qint64>      m_stat_usecParsing;
+        QAtomicInteger<qint64>      m_stat_usecDetectingLanguage;
+        QAtomicInteger<qint64>      m_stat_usecSubmitting;
+
+        // Time since the scan started
+        QElapsedTimer               m_stat_scanTimer;
+
+        // Largest number of entries the queues had (protected by the queue mutexes), to see how the limits work out
+        int                         m_stat_processingQueuePeak;
+        int                         m_stat_submittingQueuePeak;
+
+        // Rolling processing rate (files per second), updated by the progress update timer
+        double                      m_stat_processingRate;
+        int                         m_stat_rateLastProcessed;
+        qint64                      m_stat_rateLastUpdate;
+
+        // Builds the structured scan statistics (as sent via Eventor::scanCollectionStatistics)
+        QJsonObject scanStatistics( bool running );
+
+        // Records the failure to store a batch of entries in the database
+        void    submissionFailed( int entries );
+
+        // Writes the scan statistics summary into the log
+        void    logScanSummary( const QJsonObject& stats );
+
         // A flag to abort scanning; is also used to finish scans (so true doesn't indicate stopScan)
         QAtomicInt                  m_finishScanning;
 
@@ -120,9 +333,22 @@ class SongDatabaseScanner : public QObject
         // Copy of collection for scanning
         QMap<int,CollectionEntry>   m_collection;
 
+        // Compiled artist/title path patterns for each collection (same keys as m_collection)
+        QMap<int, QList<SongPathPattern> >  m_pathPatterns;
+
+        // Songs already in the database mapped by their database path; loaded in a single query when
+        // the scan starts, and is read-only afterwards (so processing threads do not query the database)
+        QHash<QString, KnownSongEntry>  m_knownSongs;
+
         // An optional plugin (auto-loaded) to detect the lyric language
         Interface_LanguageDetector    *       m_langDetector;
 
+        // Its batch interface, if supported
+        Interface_LanguageDetectorBatch   *   m_langDetectorBatch;
+
+        // Language detection results from the previous scans
+        LanguageDetectorCache       m_langCache;
+
         // Thread pool of scanners
         QList< QThread * >          m_threadPool;
 
@@ -132,9 +358,6 @@ class SongDatabaseScanner : public QObject
         // Scan information update timer
         QTimer                      m_updateTimer;
 
-        // Used in tracking the collection provider; 0 means done/succeed, 1 done/error
-        int                         m_providerStatus;
-
         // If non-empty contains the progress (from a provider)
         QString                     m_stringProgress;
 };
@@ -0,0 +1,117 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include "songpathpattern.h"
+
+SongPathPattern::SongPathPattern()
+{
+}
+
+bool SongPathPattern::compile( const QString &pattern, QString &errorMsg )
+{
+    QString regex;
+    bool hasArtist = false, hasTitle = false;
+    int pos = 0;
+
+    while ( pos < pattern.length() )
+    {
+        int start = pattern.indexOf( '{', pos );
+
+        if ( start == -1 )
+        {
+            regex += QRegularExpression::escape( pattern.mid( pos ) );
+            break;
+        }
+
+        int end = pattern.indexOf( '}', start );
+
+        if ( end == -1 )
+        {
+            errorMsg = "unterminated placeholder";
+            return false;
+        }
+
+        regex += QRegularExpression::escape( pattern.mid( pos, start - pos ) );
+
+        QString placeholder = pattern.mid( start + 1, end - start - 1 );
+
+        // Non-greedy so the literal separators (such as " - ") split at the first occurrence
+        if ( placeholder == "artist" && !hasArtist )
+        {
+            regex += "(?<artist>[^/]+?)";
+            hasArtist = true;
+        }
+        else if ( placeholder == "title" && !hasTitle )
+        {
+            regex += "(?<title>[^/]+?)";
+            hasTitle = true;
+        }
+        else if ( placeholder == "skip" )
+            regex += "[^/]*?";
+        else
+        {
+            errorMsg = QString( "invalid or duplicate placeholder {%1}" ).arg( placeholder );
+            return false;
+        }
+
+        pos = end + 1;
+    }
+
+    if ( !hasArtist || !hasTitle )
+    {
+        errorMsg = "both {artist} and {title} must be present";
+        return false;
+    }
+
+    // Match the end of the path starting at the directory boundary
+    m_regex.setPattern( "(?:^|/)" + regex + "$" );
+
+    if ( !m_regex.isValid() )
+    {
+        errorMsg = m_regex.errorString();
+        return false;
+    }
+
+    m_regex.optimize();
+    m_pattern = pattern;
+    return true;
+}
+
+bool SongPathPattern::match( const QString &filePath, QString &artist, QString &title ) const
+{
+    QString path = filePath;
+
+    // Windows paths in indexes
+    path.replace( '\\', '/' );
+
+    // Trim the extension, but not a dot in the directory name
+    int p = path.lastIndexOf( '.' );
+
+    if ( p != -1 && p > path.lastIndexOf( '/' ) )
+        path.truncate( p );
+
+    QRegularExpressionMatch m = m_regex.match( path );
+
+    if ( !m.hasMatch() )
+        return false;
+
+    artist = m.captured( "artist" ).trimmed();
+    title = m.captured( "title" ).trimmed();
+
+    return !artist.isEmpty() && !title.isEmpty();
+}
@@ -0,0 +1,56 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef SONGPATHPATTERN_H
+#define SONGPATHPATTERN_H
+
+#include <QString>
+#include <QRegularExpression>
+
+//
+// User-defined pattern to get the artist and title from the song path, such as "{artist}/{skip}/{skip} - {title}".
+// The pattern is matched against the end of the path with the extension removed, and may contain:
+//
+//   {artist}   - the artist name (required)
+//   {title}    - the song title (required)
+//   {skip}     - any text which is ignored (such as album name or track number)
+//
+// Everything else is matched literally. Placeholders never match across directories,
+// so "/" in the pattern always matches the directory separator.
+//
+// Patterns are compiled into regular expressions once (when the scan starts), as they are applied to every file.
+//
+class SongPathPattern
+{
+    public:
+        SongPathPattern();
+
+        // Compiles the pattern; returns false and sets errorMsg if the pattern is invalid
+        bool    compile( const QString& pattern, QString& errorMsg );
+
+        // Matches the path against the pattern; returns true and fills artist and title if matched
+        bool    match( const QString& filePath, QString& artist, QString& title ) const;
+
+        QString pattern() const { return m_pattern; }
+
+    private:
+        QString             m_pattern;
+        QRegularExpression  m_regex;
+};
+
+#endif // SONGPATHPATTERN_H
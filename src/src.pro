@@ -67,7 +67,20 @@ SOURCES += main.cpp\
     collectionproviderfs.cpp \
     collectionproviderhttp.cpp \
     songqueueitem.cpp \
-    songqueueitemretriever.cpp
+    songqueueitemretriever.cpp \
+    languagedetectorcache.cpp \
+    headlessscanner.cpp \
+    songpathpattern.cpp \
+    musiccollectionenumerator.cpp \
+    jsonstreamwriter.cpp \
+    actionhandler_webserver_stream.cpp \
+    httprequestparser.cpp \
+    collectionindex.cpp \
+    scancheckpoint.cpp \
+    threadwaiter.cpp \
+    webserverratelimiter.cpp \
+    websocketframe.cpp \
+    webserverstaticcache.cpp
 
 HEADERS  += mainwindow.h \
     settings.h \
@@ -129,7 +142,21 @@ HEADERS  += mainwindow.h \
     collectionproviderfs.h \
     collectionproviderhttp.h \
     songqueueitem.h \
-    songqueueitemretriever.h
+    songqueueitemretriever.h \
+    languagedetectorcache.h \
+    headlessscanner.h \
+    songpathpattern.h \
+    musiccollectionenumerator.h \
+    jsonstreamwriter.h \
+    actionhandler_webserver_stream.h \
+    httprequestparser.h \
+    collectionindex.h \
+    scancheckpoint.h \
+    threadwaiter.h \
+    webserverratelimiter.h \
+    database_resultsink.h \
+    websocketframe.h \
+    webserverstaticcache.h
 
 FORMS    += mainwindow.ui \
     playerwidget.ui \
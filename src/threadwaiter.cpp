@@ -0,0 +1,40 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QElapsedTimer>
+
+#include "threadwaiter.h"
+
+
+QList< QThread * > ThreadWaiter::waitAll( const QList< QThread * >& threads, int timeout )
+{
+    QList< QThread * > running;
+    QElapsedTimer timer;
+    timer.start();
+
+    Q_FOREACH( QThread * thread, threads )
+    {
+        // Once the deadline passed, only check whether the remaining ones have finished too
+        qint64 remaining = qMax( (qint64) timeout - timer.elapsed(), (qint64) 0 );
+
+        if ( !thread->wait( (unsigned long) remaining ) )
+            running.push_back( thread );
+    }
+
+    return running;
+}
@@ -0,0 +1,37 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef THREADWAITER_H
+#define THREADWAITER_H
+
+#include <QList>
+#include <QThread>
+
+//
+// Waits for a group of threads to finish within a single deadline, instead of giving each of them
+// the full timeout. Used to stop the scanner threads after they have been asked to abort.
+//
+class ThreadWaiter
+{
+    public:
+        // Waits up to timeout milliseconds in total for all the threads to finish.
+        // Returns the threads which are still running when the deadline passed (empty if all finished).
+        static QList< QThread * >   waitAll( const QList< QThread * >& threads, int timeout );
+};
+
+#endif // THREADWAITER_H
@@ -23,12 +23,35 @@
 #include <QCryptographicHash>
 #include <QFileInfo>
 #include <QByteArray>
+#include <QThread>
+#include <QMultiMap>
 
 #include "util.h"
 #include "logger.h"
 
 #include "uchardet/uchardet.h"
 
+#if defined (Q_OS_LINUX)
+    #include <unistd.h>
+    #include <sys/syscall.h>
+    #include <sys/resource.h>
+
+    #include <fcntl.h>
+    #include <string.h>
+    #include <sys/ioctl.h>
+    #include <linux/fs.h>
+    #include <linux/fiemap.h>
+
+    // Not provided by glibc headers, see linux/ioprio.h
+    #define IOPRIO_CLASS_SHIFT      13
+    #define IOPRIO_CLASS_IDLE       3
+    #define IOPRIO_WHO_PROCESS      1
+#endif
+
+#if defined (Q_OS_UNIX)
+    #include <sys/stat.h>
+#endif
+
 
 QTextCodec * Util::detectEncoding( const QByteArray &data )
 {
@@ -77,6 +100,170 @@ QString Util::tickToString(qint64 tickvalue)
     return ct.toString( "mm:ss" );
 }
 
+void Util::lowerCurrentThreadPriority()
+{
+#if defined (Q_OS_LINUX)
+    // QThread priorities are ignored for the normal Linux scheduler, so use per-thread nice value instead.
+    // On Linux both setpriority and ioprio_set apply to a single thread when given a thread ID.
+    pid_t tid = syscall( SYS_gettid );
+
+    if ( setpriority( PRIO_PROCESS, tid, 19 ) != 0 )
+        Logger::debug( "Failed to lower the CPU priority of thread %d", (int) tid );
+
+    if ( syscall( SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT ) != 0 )
+        Logger::debug( "Failed to set the idle I/O priority of thread %d", (int) tid );
+#else
+    QThread::currentThread()->setPriority( QThread::LowestPriority );
+#endif
+}
+
+bool Util::filePhysicalOffset( const QString &filename, quint64& offset )
+{
+#if defined (Q_OS_LINUX)
+    // Physical offset of the first extent; only needs the file to be opened, not read
+    int fd = open( QFile::encodeName( filename ).constData(), O_RDONLY );
+
+    if ( fd < 0 )
+        return false;
+
+    // Room for a single extent (as quint64 for alignment)
+    quint64 buf[ (sizeof(struct fiemap) + sizeof(struct fiemap_extent)) / sizeof(quint64) + 1 ];
+    memset( buf, 0, sizeof(buf) );
+
+    struct fiemap * fm = (struct fiemap *) buf;
+    fm->fm_length = FIEMAP_MAX_OFFSET;
+    fm->fm_extent_count = 1;
+
+    bool mapped = ioctl( fd, FS_IOC_FIEMAP, fm ) == 0 && fm->fm_mapped_extents > 0;
+    close( fd );
+
+    if ( mapped )
+        offset = fm->fm_extents[0].fe_physical;
+
+    return mapped;
+#else
+    Q_UNUSED( filename );
+    Q_UNUSED( offset );
+    return false;
+#endif
+}
+
+bool Util::fileInode( const QString &filename, quint64& inode )
+{
+#if defined (Q_OS_UNIX)
+    struct stat st;
+
+    if ( stat( QFile::encodeName( filename ).constData(), &st ) != 0 )
+        return false;
+
+    inode = st.st_ino;
+    return true;
+#else
+    Q_UNUSED( filename );
+    Q_UNUSED( inode );
+    return false;
+#endif
+}
+
+QList<int> Util::diskOrder( const QStringList &files )
+{
+    // Physical offsets and inode numbers are not comparable to each other, so a single key is used
+    // for all the files: the physical offset if it is known for all of them, otherwise the inode number
+    // (inodes are allocated close to their data by most filesystems), otherwise the original order.
+    QMultiMap< quint64, int > ordered;
+    bool usable = true;
+
+    for ( int i = 0; i < files.size() && usable; i++ )
+    {
+        quint64 offset;
+        usable = filePhysicalOffset( files[i], offset );
+
+        if ( usable )
+            ordered.insert( offset, i );
+    }
+
+    if ( !usable )
+    {
+        ordered.clear();
+        usable = true;
+
+        for ( int i = 0; i < files.size() && usable; i++ )
+        {
+            quint64 inode;
+            usable = fileInode( files[i], inode );
+
+            if ( usable )
+                ordered.insert( inode, i );
+        }
+    }
+
+    if ( !usable )
+    {
+        QList<int> unchanged;
+
+        for ( int i = 0; i < files.size(); i++ )
+            unchanged.push_back( i );
+
+        return unchanged;
+    }
+
+    return ordered.values();
+}
+
+// CRC32 lookup table for gzip
+class GzipCrcTable
+{
+    public:
+        GzipCrcTable()
+        {
+            for ( quint32 i = 0; i < 256; i++ )
+            {
+                quint32 c = i;
+
+                for ( int k = 0; k < 8; k++ )
+                    c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+
+                value[i] = c;
+            }
+        }
+
+        quint32 value[256];
+};
+
+QByteArray Util::gzipCompress( const QByteArray &data )
+{
+    static const GzipCrcTable crctable;
+
+    // qCompress returns 4 bytes of the original length followed by the zlib stream, which is
+    // a 2-byte header, raw deflate data and 4-byte Adler-32. gzip needs just the deflate data.
+    QByteArray zlibdata = qCompress( data );
+
+    if ( zlibdata.size() < 10 )
+        return QByteArray();
+
+    quint32 crc = 0xFFFFFFFF;
+    const unsigned char * p = (const unsigned char *) data.constData();
+
+    for ( int i = 0; i < data.size(); i++ )
+        crc = crctable.value[ (crc ^ p[i]) & 0xFF ] ^ (crc >> 8);
+
+    crc ^= 0xFFFFFFFF;
+
+    // Header: magic, deflate, no flags, no mtime, no extra flags, unknown OS
+    static const char header[10] = { '\x1F', '\x8B', 8, 0, 0, 0, 0, 0, 0, '\xFF' };
+    QByteArray out( header, sizeof(header) );
+    out.append( zlibdata.constData() + 6, zlibdata.size() - 10 );
+
+    // Trailer is CRC32 and the original size, both little-endian
+    quint32 trailer[2] = { crc, (quint32) data.size() };
+
+    for ( int i = 0; i < 2; i++ )
+        for ( int b = 0; b < 4; b++ )
+            out.append( (char) ((trailer[i] >> (b * 8)) & 0xFF) );
+
+    return out;
+}
+
 void Util::enumerateDirectory(const QString &rootPaths, const QStringList &extensions, QStringList &files)
 {
     files.clear();
@@ -19,7 +19,9 @@
 #ifndef UTIL_H
 #define UTIL_H
 
+#include <QList>
 #include <QString>
+#include <QStringList>
 #include <QTextCodec>
 
 #include "settings.h"
@@ -51,8 +53,24 @@ class Util
         // Convert ticks (int64 ms) to a proper time string
         static QString tickToString( qint64 tickvalue );
 
+        // Lowers the CPU (and on Linux, I/O) priority of the calling thread, so the background
+        // work such as collection scan doesn't affect the playback
+        static void lowerCurrentThreadPriority();
+
+        // Returns the order (as indexes into files) in which the files should be read with less seeking:
+        // by the physical offset where supported (Linux FIEMAP), otherwise by the inode number. The same key
+        // is used for all the files; if it cannot be found for any of them, the original order is kept.
+        static QList<int> diskOrder( const QStringList& files );
+
+        // Compresses the data into gzip (RFC 1952) format, using the zlib bundled with Qt via qCompress
+        static QByteArray gzipCompress( const QByteArray& data );
+
     private:
         Util();
+
+        // The keys used by diskOrder; return false if not available for this file
+        static bool filePhysicalOffset( const QString& filename, quint64& offset );
+        static bool fileInode( const QString& filename, quint64& inode );
 };
 
 #endif // UTIL_H
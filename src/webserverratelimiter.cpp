@@ -0,0 +1,81 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtMath>
+
+#include "webserverratelimiter.h"
+
+// Buckets idle for this long (in milliseconds) are full again, so they're dropped
+static const qint64 BUCKET_IDLE_TIMEOUT = 60000;
+
+
+WebServerRateLimiter::WebServerRateLimiter()
+{
+    m_lastCleanup = 0;
+}
+
+bool WebServerRateLimiter::allow( const QString &key, unsigned int rate, qint64 now, int &retryAfter )
+{
+    if ( rate == 0 )
+        return true;
+
+    // Forget the buckets which are full again, so they don't accumulate
+    if ( now - m_lastCleanup > BUCKET_IDLE_TIMEOUT )
+    {
+        for ( QHash< QString, Bucket >::iterator it = m_buckets.begin(); it != m_buckets.end(); )
+        {
+            if ( now - it.value().lastRefill > BUCKET_IDLE_TIMEOUT )
+                it = m_buckets.erase( it );
+            else
+                ++it;
+        }
+
+        m_lastCleanup = now;
+    }
+
+    double burst = rate * 2;
+    QHash< QString, Bucket >::iterator it = m_buckets.find( key );
+
+    if ( it == m_buckets.end() )
+    {
+        Bucket bucket;
+        bucket.tokens = burst;
+        bucket.lastRefill = now;
+
+        it = m_buckets.insert( key, bucket );
+    }
+
+    Bucket& bucket = it.value();
+
+    bucket.tokens = qMin( burst, bucket.tokens + ( now - bucket.lastRefill ) * rate / 1000.0 );
+    bucket.lastRefill = now;
+
+    if ( bucket.tokens >= 1.0 )
+    {
+        bucket.tokens -= 1.0;
+        return true;
+    }
+
+    retryAfter = qMax( 1, qCeil( ( 1.0 - bucket.tokens ) / rate ) );
+    return false;
+}
+
+int WebServerRateLimiter::buckets() const
+{
+    return m_buckets.size();
+}
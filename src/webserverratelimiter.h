@@ -0,0 +1,55 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef WEBSERVERRATELIMITER_H
+#define WEBSERVERRATELIMITER_H
+
+#include <QHash>
+#include <QString>
+
+//
+// Limits the request rate of the web server clients with token buckets. The time is passed by the caller
+// (in milliseconds, from any monotonic clock), so the limiter doesn't need to know where it comes from.
+// Not thread-safe; the web server only uses it from its own thread.
+//
+class WebServerRateLimiter
+{
+    public:
+        WebServerRateLimiter();
+
+        // Checks whether the client identified by key is allowed to make one more request at the time now,
+        // with the rate in requests per second (0 means unlimited). Bursts up to two seconds worth of requests
+        // are allowed. If not allowed, retryAfter is set to the number of seconds the client should wait.
+        bool    allow( const QString& key, unsigned int rate, qint64 now, int& retryAfter );
+
+        // Number of clients tracked; the buckets idle for a minute are dropped
+        int     buckets() const;
+
+    private:
+        class Bucket
+        {
+            public:
+                double      tokens;
+                qint64      lastRefill;
+        };
+
+        QHash< QString, Bucket >    m_buckets;
+        qint64                      m_lastCleanup;
+};
+
+#endif // WEBSERVERRATELIMITER_H
@@ -0,0 +1,176 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QMimeDatabase>
+#include <QFileInfo>
+#include <QLocale>
+#include <QFile>
+
+#include "webserverstaticcache.h"
+#include "logger.h"
+#include "util.h"
+
+// RFC 7231 date format, always in GMT
+static const char * HTTP_DATE_FORMAT = "ddd, dd MMM yyyy hh:mm:ss 'GMT'";
+
+
+bool WebServerStaticFile::notModified( const QByteArray &ifNoneMatch, const QString &ifModifiedSince ) const
+{
+    if ( !ifNoneMatch.isEmpty() )
+        return ifNoneMatch.trimmed() == "*" || ifNoneMatch.contains( etag );
+
+    if ( !ifModifiedSince.isEmpty() )
+    {
+        QDateTime since = WebServerStaticCache::fromHttpDate( ifModifiedSince );
+        return since.isValid() && lastModified.toTime_t() <= since.toTime_t();
+    }
+
+    return false;
+}
+
+QByteArray WebServerStaticFile::validatorHeaders() const
+{
+    // HTML pages are always revalidated, so the updated pages are picked up right away
+    return "ETag: " + etag + "\r\n"
+            + "Last-Modified: " + WebServerStaticCache::toHttpDate( lastModified ) + "\r\n"
+            + "Cache-Control: " + ( type == "text/html" ? "no-cache" : "max-age=3600" ) + "\r\n";
+}
+
+
+WebServerStaticCache::WebServerStaticCache( const QString &resourceRoot, qint64 maxMemoryFileSize )
+{
+    m_resourceRoot = resourceRoot;
+    m_maxMemoryFileSize = maxMemoryFileSize;
+}
+
+bool WebServerStaticCache::find( const QString &documentRoot, const QString &url, WebServerStaticFile &file )
+{
+    // First look up in wwwroot
+    if ( !documentRoot.isEmpty() )
+    {
+        QFileInfo finfo( documentRoot + url );
+
+        if ( finfo.isFile() )
+            return load( finfo.filePath(), finfo.lastModified().toUTC(), finfo.size(), false, file );
+    }
+
+    // Now look up in resources; they do not change while we're running, and have no modification time of their own
+    QString path = m_resourceRoot + url;
+
+    if ( m_files.contains( path ) )
+    {
+        file = m_files[ path ];
+        return true;
+    }
+
+    QFileInfo finfo( path );
+
+    if ( !finfo.isFile() )
+        return false;
+
+    return load( path, QFileInfo( QCoreApplication::applicationFilePath() ).lastModified().toUTC(), finfo.size(), true, file );
+}
+
+bool WebServerStaticCache::isCompressibleType( const QByteArray &type )
+{
+    return type.startsWith( "text/" )
+            || type.startsWith( "application/json" )
+            || type.startsWith( "application/javascript" )
+            || type.startsWith( "application/xml" )
+            || type.startsWith( "image/svg+xml" );
+}
+
+QByteArray WebServerStaticCache::toHttpDate( const QDateTime &date )
+{
+    return QLocale::c().toString( date.toUTC(), HTTP_DATE_FORMAT ).toLatin1();
+}
+
+QDateTime WebServerStaticCache::fromHttpDate( const QString &date )
+{
+    QDateTime parsed = QLocale::c().toDateTime( date.trimmed(), HTTP_DATE_FORMAT );
+    parsed.setTimeSpec( Qt::UTC );
+
+    return parsed;
+}
+
+bool WebServerStaticCache::load( const QString &path, const QDateTime &lastModified, qint64 size, bool resource, WebServerStaticFile &file )
+{
+    // HTTP dates have one second precision
+    QDateTime modified = QDateTime::fromTime_t( lastModified.toTime_t() ).toUTC();
+
+    if ( m_files.contains( path ) )
+    {
+        const WebServerStaticFile& cached = m_files[ path ];
+
+        if ( cached.lastModified == modified && cached.size == size )
+        {
+            file = cached;
+            return true;
+        }
+
+        m_files.remove( path );
+    }
+
+    file.path = path;
+    file.lastModified = modified;
+    file.size = size;
+    file.gzipped.clear();
+    file.data.clear();
+
+    // Large files are only looked up here, the content is sent straight from disk. Resources are always
+    // loaded, as they might be compressed.
+    if ( size > m_maxMemoryFileSize && !resource )
+    {
+        if ( !QFileInfo( path ).isReadable() )
+            return false;
+
+        // No content hash without reading it all; size and modification time identify the version well enough
+        file.inMemory = false;
+        file.type = QMimeDatabase().mimeTypeForFile( path, QMimeDatabase::MatchExtension ).name().toUtf8();
+        file.etag = "\"" + QByteArray::number( size, 16 ) + "-" + QByteArray::number( (qint64) modified.toTime_t(), 16 ) + "\"";
+        m_files[ path ] = file;
+
+        Logger::debug( "WebServer: static file %s is served from disk, type %s, %lld bytes", qPrintable(path), file.type.constData(), (long long) size );
+        return true;
+    }
+
+    QFile f( path );
+
+    if ( !f.open( QIODevice::ReadOnly ) )
+        return false;
+
+    file.inMemory = true;
+    file.data = f.readAll();
+    file.type = QMimeDatabase().mimeTypeForFile( path ).name().toUtf8();
+    file.etag = "\"" + QCryptographicHash::hash( file.data, QCryptographicHash::Sha1 ).toHex().left( 16 ) + "\"";
+
+    if ( isCompressibleType( file.type ) )
+    {
+        QByteArray compressed = Util::gzipCompress( file.data );
+
+        if ( !compressed.isEmpty() && compressed.size() < file.data.size() )
+            file.gzipped = compressed;
+    }
+
+    m_files[ path ] = file;
+
+    Logger::debug( "WebServer: loaded static file %s, type %s, %d bytes", qPrintable(path), file.type.constData(), file.data.size() );
+    return true;
+}
@@ -0,0 +1,80 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef WEBSERVERSTATICCACHE_H
+#define WEBSERVERSTATICCACHE_H
+
+#include <QHash>
+#include <QString>
+#include <QDateTime>
+#include <QByteArray>
+
+// A static file (from the document root or resources) with everything needed to serve it precomputed
+class WebServerStaticFile
+{
+    public:
+        QString     path;           // where it is loaded from
+        bool        inMemory;       // false for the large files, which are sent from disk
+        QByteArray  data;
+        QByteArray  gzipped;        // empty if not worth compressing
+        QByteArray  type;
+        QByteArray  etag;           // quoted, as sent in the header
+        QDateTime   lastModified;   // UTC
+        qint64      size;           // of the source file, to detect the changes along with lastModified
+
+        // Whether the client copy is still valid according to the If-None-Match and If-Modified-Since
+        // request headers (empty if not sent). If-None-Match takes precedence, as in RFC 7232.
+        bool        notModified( const QByteArray& ifNoneMatch, const QString& ifModifiedSince ) const;
+
+        // ETag, Last-Modified and Cache-Control headers, each followed by CRLF
+        QByteArray  validatorHeaders() const;
+};
+
+//
+// Cache of the static files served by the web server, by the path they're loaded from. The files are looked up
+// in the document root first, then in resources. The document root files are reloaded once changed; the large ones
+// are only looked up, and sent from disk. Not thread-safe; the web server only uses it from its own thread.
+//
+class WebServerStaticCache
+{
+    public:
+        // Files larger than maxMemoryFileSize are not kept in memory (unless in resources)
+        WebServerStaticCache( const QString& resourceRoot = ":/html", qint64 maxMemoryFileSize = 1024 * 1024 );
+
+        // Looks up the file for the URL; documentRoot may be empty. Returns false if not found.
+        bool    find( const QString& documentRoot, const QString& url, WebServerStaticFile& file );
+
+        // Whether the content of this MIME type is worth compressing (images, audio and such are already compressed)
+        static bool isCompressibleType( const QByteArray& type );
+
+        // Conversion from/to the HTTP date format, such as "Sun, 06 Nov 1994 08:49:37 GMT".
+        // fromHttpDate returns an invalid QDateTime if the date cannot be parsed.
+        static QByteArray   toHttpDate( const QDateTime& date );
+        static QDateTime    fromHttpDate( const QString& date );
+
+    private:
+        // Loads the file into the cache unless it is already there and not changed
+        bool    load( const QString& path, const QDateTime& lastModified, qint64 size, bool resource, WebServerStaticFile& file );
+
+        QString     m_resourceRoot;
+        qint64      m_maxMemoryFileSize;
+
+        QHash< QString, WebServerStaticFile >   m_files;
+};
+
+#endif // WEBSERVERSTATICCACHE_H
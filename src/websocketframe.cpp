@@ -0,0 +1,109 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include "websocketframe.h"
+
+WebSocketFrame::WebSocketFrame()
+{
+    fin = false;
+    opcode = OPCODE_CONTINUATION;
+}
+
+WebSocketFrame::Result WebSocketFrame::parse( const QByteArray &data, int maxPayloadSize, int &frameSize )
+{
+    if ( data.size() < 2 )
+        return RESULT_INCOMPLETE;
+
+    const unsigned char * hdr = (const unsigned char *) data.constData();
+    bool masked = (hdr[1] & 0x80) != 0;
+    quint64 length = hdr[1] & 0x7F;
+    int offset = 2;
+
+    if ( length == 126 )
+    {
+        if ( data.size() < 4 )
+            return RESULT_INCOMPLETE;
+
+        length = (hdr[2] << 8) | hdr[3];
+        offset = 4;
+    }
+    else if ( length == 127 )
+    {
+        if ( data.size() < 10 )
+            return RESULT_INCOMPLETE;
+
+        // The most significant bit must be 0
+        if ( hdr[2] & 0x80 )
+            return RESULT_INVALID;
+
+        length = 0;
+
+        for ( int i = 0; i < 8; i++ )
+            length = (length << 8) | hdr[2 + i];
+
+        offset = 10;
+    }
+
+    // Clients must mask their frames. The length is checked before it is narrowed, so it can't wrap.
+    if ( !masked || maxPayloadSize < 0 || length > (quint64) maxPayloadSize )
+        return RESULT_INVALID;
+
+    int size = offset + 4 + (int) length;
+
+    if ( data.size() < size )
+        return RESULT_INCOMPLETE;
+
+    const unsigned char * mask = hdr + offset;
+
+    payload = data.mid( offset + 4, (int) length );
+
+    for ( int i = 0; i < payload.size(); i++ )
+        payload[i] = payload[i] ^ mask[ i % 4 ];
+
+    fin = (hdr[0] & 0x80) != 0;
+    opcode = hdr[0] & 0x0F;
+    frameSize = size;
+    return RESULT_COMPLETE;
+}
+
+QByteArray WebSocketFrame::build( int opcode, const QByteArray &payload )
+{
+    QByteArray frame;
+
+    // Always the final fragment
+    frame.append( (char) (0x80 | opcode) );
+
+    if ( payload.size() < 126 )
+        frame.append( (char) payload.size() );
+    else if ( payload.size() < 65536 )
+    {
+        frame.append( (char) 126 );
+        frame.append( (char) ((payload.size() >> 8) & 0xFF) );
+        frame.append( (char) (payload.size() & 0xFF) );
+    }
+    else
+    {
+        frame.append( (char) 127 );
+
+        for ( int i = 7; i >= 0; i-- )
+            frame.append( (char) (((quint64) payload.size() >> (i * 8)) & 0xFF) );
+    }
+
+    frame.append( payload );
+    return frame;
+}
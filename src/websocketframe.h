@@ -0,0 +1,62 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef WEBSOCKETFRAME_H
+#define WEBSOCKETFRAME_H
+
+#include <QByteArray>
+
+//
+// WebSocket (RFC 6455) framing: parses the masked frames sent by clients, and builds the unmasked server ones.
+// Fragmented messages are reported as such and left to the caller, since nothing we expect needs them.
+//
+class WebSocketFrame
+{
+    public:
+        // Frame opcodes we use
+        enum
+        {
+            OPCODE_CONTINUATION = 0x00,
+            OPCODE_TEXT = 0x01,
+            OPCODE_CLOSE = 0x08,
+            OPCODE_PING = 0x09,
+            OPCODE_PONG = 0x0A
+        };
+
+        enum Result
+        {
+            RESULT_INCOMPLETE,  // more data is needed
+            RESULT_COMPLETE,    // the frame is parsed
+            RESULT_INVALID      // not masked, or the payload is too large; the connection should be closed
+        };
+
+        WebSocketFrame();
+
+        // Parses the client frame at the start of data, with the payload up to maxPayloadSize. Once complete,
+        // the frame is filled with unmasked payload, and frameSize is set to the number of bytes it took.
+        Result  parse( const QByteArray& data, int maxPayloadSize, int& frameSize );
+
+        // Builds an unmasked (server to client) frame, always the final fragment
+        static QByteArray build( int opcode, const QByteArray& payload );
+
+        bool        fin;
+        int         opcode;
+        QByteArray  payload;
+};
+
+#endif // WEBSOCKETFRAME_H
@@ -0,0 +1,8 @@
+include(../tests.pri)
+
+TARGET = tst_collectionindex
+
+SOURCES += tst_collectionindex.cpp \
+    ../../src/collectionindex.cpp
+
+HEADERS += ../../src/collectionindex.h
@@ -0,0 +1,325 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtTest>
+#include <QDataStream>
+#include <QCryptographicHash>
+
+#include "collectionindex.h"
+
+//
+// Round-trip and corruption tests for the binary collection index. The index is built here the same way
+// create_collection_index.py -b does it; index_v2.dat is the actual output of the script.
+//
+class TestCollectionIndex : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void    parsesGeneratorOutput();
+        void    roundTrip();
+        void    roundTripVersion1();
+        void    textIndexIsNotBinary();
+        void    rejectsTruncated();
+        void    rejectsCorrupted();
+        void    rejectsInconsistentContent_data();
+        void    rejectsInconsistentContent();
+        void    rejectsUnsupportedVersion();
+
+    private:
+        // Builds the index content without the checksum
+        static QByteArray buildContent( const QList<CollectionIndex::Entry>& entries, quint16 version, quint32 indexVersion );
+
+        // Appends the checksum to the content
+        static QByteArray withChecksum( const QByteArray& content );
+
+        static QList<CollectionIndex::Entry> sampleEntries();
+        static void writeString( QDataStream& stream, const QString& value );
+};
+
+
+void TestCollectionIndex::writeString( QDataStream &stream, const QString &value )
+{
+    QByteArray data = value.toUtf8();
+    stream << (quint32) data.size();
+    stream.writeRawData( data.constData(), data.size() );
+}
+
+QByteArray TestCollectionIndex::buildContent( const QList<CollectionIndex::Entry> &entries, quint16 version, quint32 indexVersion )
+{
+    QStringList artists;
+
+    Q_FOREACH( const CollectionIndex::Entry& entry, entries )
+    {
+        if ( !artists.contains( entry.artist ) )
+            artists.push_back( entry.artist );
+    }
+
+    QByteArray content;
+    QDataStream stream( &content, QIODevice::WriteOnly );
+    stream.setByteOrder( QDataStream::BigEndian );
+
+    stream.writeRawData( "SPIVAKIX", 8 );
+    stream << version << (quint16) 0;
+
+    if ( version >= 2 )
+        stream << indexVersion;
+
+    stream << (quint32) artists.size();
+
+    Q_FOREACH( const QString& artist, artists )
+        writeString( stream, artist );
+
+    stream << (quint32) entries.size();
+
+    Q_FOREACH( const CollectionIndex::Entry& entry, entries )
+    {
+        stream << (quint32) artists.indexOf( entry.artist );
+        writeString( stream, entry.title );
+        writeString( stream, entry.filePath );
+        writeString( stream, entry.musicPath );
+        writeString( stream, entry.type );
+        writeString( stream, entry.language );
+    }
+
+    return content;
+}
+
+QByteArray TestCollectionIndex::withChecksum( const QByteArray &content )
+{
+    return content + QCryptographicHash::hash( content, QCryptographicHash::Sha1 );
+}
+
+QList<CollectionIndex::Entry> TestCollectionIndex::sampleEntries()
+{
+    QList<CollectionIndex::Entry> entries;
+
+    // Separators, non-ASCII text and empty fields must survive as they are
+    const char * data[][6] = {
+        { "ABBA", "Waterloo", "ABBA/Waterloo.cdg", "ABBA/Waterloo.mp3", "mp3", "" },
+        { "ABBA", "Mamma Mia", "ABBA/Mamma Mia.kfn", "", "kfn", "English" },
+        { "Кино", "Группа крови | live", "Кино/Группа крови | live.zip", "", "zip", "Russian" },
+        { "AC/DC", "T.N.T.", "AC|DC/T.N.T..mp4", "", "mp4", "" },
+        { "", "", "untitled.mid", "", "mid", "" }
+    };
+
+    for ( unsigned int i = 0; i < sizeof(data) / sizeof(data[0]); i++ )
+    {
+        CollectionIndex::Entry entry;
+        entry.artist = QString::fromUtf8( data[i][0] );
+        entry.title = QString::fromUtf8( data[i][1] );
+        entry.filePath = QString::fromUtf8( data[i][2] );
+        entry.musicPath = QString::fromUtf8( data[i][3] );
+        entry.type = QString::fromUtf8( data[i][4] );
+        entry.language = QString::fromUtf8( data[i][5] );
+        entries.push_back( entry );
+    }
+
+    return entries;
+}
+
+void TestCollectionIndex::parsesGeneratorOutput()
+{
+    QFile file( QFINDTESTDATA( "index_v2.dat" ) );
+    QVERIFY( file.open( QIODevice::ReadOnly ) );
+
+    QByteArray data = file.readAll();
+    QVERIFY( CollectionIndex::isBinary( data ) );
+
+    quint32 indexVersion;
+    QList<CollectionIndex::Entry> entries;
+    QString errmsg;
+
+    QVERIFY2( CollectionIndex::parseBinary( data, indexVersion, entries, errmsg ), qPrintable( errmsg ) );
+    QCOMPARE( indexVersion, (quint32) 1 );
+    QCOMPARE( entries.size(), 4 );
+
+    QCOMPARE( entries[0].artist, QString::fromUtf8( "Кино" ) );
+    QCOMPARE( entries[0].title, QString::fromUtf8( "Группа крови | live" ) );
+    QCOMPARE( entries[0].filePath, QString::fromUtf8( "Кино/Группа крови | live.zip" ) );
+    QCOMPARE( entries[0].type, QString( "zip" ) );
+
+    QCOMPARE( entries[3].artist, QString( "ABBA" ) );
+    QCOMPARE( entries[3].title, QString( "Waterloo" ) );
+    QCOMPARE( entries[3].filePath, QString( "ABBA/Waterloo.cdg" ) );
+    QCOMPARE( entries[3].musicPath, QString( "ABBA/Waterloo.mp3" ) );
+    QCOMPARE( entries[3].type, QString( "mp3" ) );
+    QVERIFY( entries[3].language.isEmpty() );
+}
+
+void TestCollectionIndex::roundTrip()
+{
+    QList<CollectionIndex::Entry> source = sampleEntries();
+    QByteArray data = withChecksum( buildContent( source, 2, 42 ) );
+
+    quint32 indexVersion;
+    QList<CollectionIndex::Entry> entries;
+    QString errmsg;
+
+    QVERIFY2( CollectionIndex::parseBinary( data, indexVersion, entries, errmsg ), qPrintable( errmsg ) );
+    QCOMPARE( indexVersion, (quint32) 42 );
+    QCOMPARE( entries.size(), source.size() );
+
+    for ( int i = 0; i < source.size(); i++ )
+    {
+        QCOMPARE( entries[i].artist, source[i].artist );
+        QCOMPARE( entries[i].title, source[i].title );
+        QCOMPARE( entries[i].filePath, source[i].filePath );
+        QCOMPARE( entries[i].musicPath, source[i].musicPath );
+        QCOMPARE( entries[i].type, source[i].type );
+        QCOMPARE( entries[i].language, source[i].language );
+    }
+
+    // Empty index is valid too
+    QVERIFY2( CollectionIndex::parseBinary( withChecksum( buildContent( QList<CollectionIndex::Entry>(), 2, 1 ) ), indexVersion, entries, errmsg ), qPrintable( errmsg ) );
+    QVERIFY( entries.isEmpty() );
+}
+
+void TestCollectionIndex::roundTripVersion1()
+{
+    // The first format version has no index version
+    QList<CollectionIndex::Entry> source = sampleEntries();
+
+    quint32 indexVersion;
+    QList<CollectionIndex::Entry> entries;
+    QString errmsg;
+
+    QVERIFY2( CollectionIndex::parseBinary( withChecksum( buildContent( source, 1, 0 ) ), indexVersion, entries, errmsg ), qPrintable( errmsg ) );
+    QCOMPARE( indexVersion, (quint32) 0 );
+    QCOMPARE( entries.size(), source.size() );
+    QCOMPARE( entries.last().filePath, source.last().filePath );
+}
+
+void TestCollectionIndex::textIndexIsNotBinary()
+{
+    QVERIFY( !CollectionIndex::isBinary( "#version 3\nABBA|Waterloo|ABBA/Waterloo.cdg|ABBA/Waterloo.mp3|mp3|\n" ) );
+    QVERIFY( !CollectionIndex::isBinary( QByteArray() ) );
+}
+
+void TestCollectionIndex::rejectsTruncated()
+{
+    QByteArray data = withChecksum( buildContent( sampleEntries(), 2, 7 ) );
+
+    quint32 indexVersion;
+    QList<CollectionIndex::Entry> entries;
+    QString errmsg;
+
+    // Every possible truncation of a download must be rejected, and nothing returned
+    for ( int size = 0; size < data.size(); size++ )
+    {
+        entries.clear();
+
+        if ( CollectionIndex::parseBinary( data.left( size ), indexVersion, entries, errmsg ) )
+            QFAIL( qPrintable( QString( "index truncated to %1 bytes was accepted" ).arg( size ) ) );
+
+        QVERIFY( entries.isEmpty() );
+        QCOMPARE( indexVersion, (quint32) 0 );
+    }
+}
+
+void TestCollectionIndex::rejectsCorrupted()
+{
+    QByteArray data = withChecksum( buildContent( sampleEntries(), 2, 7 ) );
+
+    quint32 indexVersion;
+    QList<CollectionIndex::Entry> entries;
+    QString errmsg;
+
+    // A single flipped bit anywhere, including the checksum itself
+    for ( int i = 0; i < data.size(); i++ )
+    {
+        for ( int bit = 0; bit < 8; bit++ )
+        {
+            QByteArray corrupted = data;
+            corrupted[i] = corrupted[i] ^ (char) (1 << bit);
+
+            if ( CollectionIndex::parseBinary( corrupted, indexVersion, entries, errmsg ) )
+                QFAIL( qPrintable( QString( "index with bit %1 of byte %2 flipped was accepted" ).arg( bit ).arg( i ) ) );
+
+            QVERIFY( entries.isEmpty() );
+        }
+    }
+
+    // Extra data appended to a valid index
+    QVERIFY( !CollectionIndex::parseBinary( data + "x", indexVersion, entries, errmsg ) );
+}
+
+void TestCollectionIndex::rejectsInconsistentContent_data()
+{
+    // The content is damaged before the checksum is calculated, so only the parser could detect it.
+    // Offsets are for the two-entry index built in rejectsInconsistentContent.
+    QTest::addColumn<int>( "offset" );
+    QTest::addColumn<QByteArray>( "value" );
+
+    // Header is 16 bytes, followed by the artist count, and the one-artist string table "A"
+    QTest::newRow("huge artist count") << 16 << QByteArray( "\xff\xff\xff\xff", 4 );
+    QTest::newRow("artist count too large") << 16 << QByteArray( "\x00\x00\x00\x05", 4 );
+    QTest::newRow("artist string length beyond end") << 20 << QByteArray( "\x7f\x00\x00\x00", 4 );
+    QTest::newRow("huge entry count") << 25 << QByteArray( "\xff\xff\xff\xff", 4 );
+    QTest::newRow("entry count too large") << 25 << QByteArray( "\x00\x00\x00\x03", 4 );
+    QTest::newRow("entry count too small") << 25 << QByteArray( "\x00\x00\x00\x01", 4 );
+    QTest::newRow("artist index out of range") << 29 << QByteArray( "\x00\x00\x00\x01", 4 );
+    QTest::newRow("title length beyond end") << 33 << QByteArray( "\x00\x01\x00\x00", 4 );
+}
+
+void TestCollectionIndex::rejectsInconsistentContent()
+{
+    QFETCH( int, offset );
+    QFETCH( QByteArray, value );
+
+    QList<CollectionIndex::Entry> source;
+    CollectionIndex::Entry entry;
+    entry.artist = "A";
+    entry.title = "T";
+    entry.filePath = "A/T.kfn";
+    entry.type = "kfn";
+    source << entry << entry;
+
+    QByteArray content = buildContent( source, 2, 1 );
+
+    // Make sure the offsets above are still right
+    QCOMPARE( content.mid( 16, 4 ), QByteArray( "\x00\x00\x00\x01", 4 ) );
+    QCOMPARE( content.mid( 25, 4 ), QByteArray( "\x00\x00\x00\x02", 4 ) );
+
+    content.replace( offset, value.size(), value );
+
+    quint32 indexVersion;
+    QList<CollectionIndex::Entry> entries;
+    QString errmsg;
+
+    QVERIFY( !CollectionIndex::parseBinary( withChecksum( content ), indexVersion, entries, errmsg ) );
+    QVERIFY( entries.isEmpty() );
+    QVERIFY( !errmsg.isEmpty() );
+}
+
+void TestCollectionIndex::rejectsUnsupportedVersion()
+{
+    QByteArray content = buildContent( sampleEntries(), 2, 1 );
+    content[9] = 3;
+
+    quint32 indexVersion;
+    QList<CollectionIndex::Entry> entries;
+    QString errmsg;
+
+    QVERIFY( !CollectionIndex::parseBinary( withChecksum( content ), indexVersion, entries, errmsg ) );
+    QVERIFY( errmsg.contains( "version" ) );
+}
+
+QTEST_APPLESS_MAIN(TestCollectionIndex)
+
+#include "tst_collectionindex.moc"
@@ -0,0 +1,15 @@
+include(../tests.pri)
+
+TARGET = tst_collectionproviderhttp
+
+# The settings header needs the GUI module, and the logger the widgets
+QT += gui widgets network
+
+SOURCES += tst_collectionproviderhttp.cpp \
+    ../../src/collectionprovider.cpp \
+    ../../src/collectionproviderfs.cpp \
+    ../../src/collectionproviderhttp.cpp \
+    ../../src/logger.cpp
+
+HEADERS += ../../src/collectionprovider.h \
+    ../../src/collectionproviderhttp.h
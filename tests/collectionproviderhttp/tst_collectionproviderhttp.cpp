@@ -0,0 +1,505 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtTest>
+#include <QMap>
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QPointer>
+#include <QThread>
+#include <QTimer>
+
+#if defined (Q_OS_UNIX)
+    #include <sys/resource.h>
+#endif
+
+#include "collectionproviderhttp.h"
+#include "settings.h"
+#include "logger.h"
+
+// The provider only uses the settings for the authentication and SSL, which are not tested here
+Settings * pSettings;
+
+
+//
+// Local stand-in for the collection web server. Serves the index files with their validators,
+// and answers the conditional requests the same way a web server does.
+//
+class IndexServer : public QObject
+{
+    Q_OBJECT
+
+    public:
+        class Request
+        {
+            public:
+                QString     path;
+                QString     ifNoneMatch;
+                QString     ifModifiedSince;
+        };
+
+        IndexServer()
+        {
+            replyDelay = 0;
+            connect( &m_server, SIGNAL(newConnection()), this, SLOT(newConnection()) );
+        }
+
+        bool    start() { return m_server.listen( QHostAddress::LocalHost ); }
+
+        QString url( const QString& path ) const
+        {
+            return QString( "http://127.0.0.1:%1/%2" ).arg( m_server.serverPort() ).arg( path );
+        }
+
+        // Publishes a new version of the file (with the new validators), or removes it if the content is empty
+        void    publish( const QString& path, const QByteArray& content, const QString& etag, const QString& lastModified )
+        {
+            if ( content.isEmpty() )
+            {
+                m_files.remove( path );
+                return;
+            }
+
+            File file;
+            file.content = content;
+            file.etag = etag;
+            file.lastModified = lastModified;
+            m_files[ path ] = file;
+        }
+
+        QList<Request>  requests;
+
+        // Replies are held for this long (in milliseconds), like a slow server would
+        int             replyDelay;
+
+    private slots:
+        void    newConnection()
+        {
+            while ( m_server.hasPendingConnections() )
+            {
+                QTcpSocket * socket = m_server.nextPendingConnection();
+                connect( socket, SIGNAL(readyRead()), this, SLOT(readyRead()) );
+                connect( socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()) );
+            }
+        }
+
+        void    readyRead()
+        {
+            QTcpSocket * socket = (QTcpSocket *) sender();
+            QByteArray& data = m_received[ socket ];
+
+            data += socket->readAll();
+
+            int end = data.indexOf( "\r\n\r\n" );
+
+            if ( end == -1 )
+                return;
+
+            QList<QByteArray> lines = data.left( end ).split( '\n' );
+            m_received.remove( socket );
+
+            Request request;
+            request.path = QString::fromUtf8( lines.takeFirst().split( ' ' ).value( 1 ) ).mid( 1 );
+
+            Q_FOREACH( const QByteArray& line, lines )
+            {
+                int colon = line.indexOf( ':' );
+                QByteArray name = line.left( colon ).trimmed().toLower();
+                QString value = QString::fromUtf8( line.mid( colon + 1 ).trimmed() );
+
+                if ( name == "if-none-match" )
+                    request.ifNoneMatch = value;
+                else if ( name == "if-modified-since" )
+                    request.ifModifiedSince = value;
+            }
+
+            requests.push_back( request );
+
+            QByteArray reply;
+
+            if ( !m_files.contains( request.path ) )
+            {
+                reply = "HTTP/1.1 404 Not Found\r\nContent-Length: 9\r\nConnection: close\r\n\r\nnot found";
+            }
+            else
+            {
+                const File& file = m_files[ request.path ];
+
+                // If-None-Match takes precedence, as in RFC 7232
+                bool modified = request.ifNoneMatch.isEmpty() ?
+                            request.ifModifiedSince.isEmpty() || request.ifModifiedSince != file.lastModified
+                          : request.ifNoneMatch != file.etag;
+
+                QByteArray validators = "ETag: " + file.etag.toUtf8() + "\r\nLast-Modified: " + file.lastModified.toUtf8() + "\r\n";
+
+                if ( !modified )
+                    reply = "HTTP/1.1 304 Not Modified\r\n" + validators + "Connection: close\r\n\r\n";
+                else
+                    reply = "HTTP/1.1 200 OK\r\n" + validators + "Content-Length: " + QByteArray::number( file.content.size() )
+                            + "\r\nConnection: close\r\n\r\n" + file.content;
+            }
+
+            if ( replyDelay > 0 )
+            {
+                QTimer * timer = new QTimer( this );
+                timer->setSingleShot( true );
+                connect( timer, SIGNAL(timeout()), this, SLOT(sendDelayed()) );
+
+                Delayed delayed;
+                delayed.socket = socket;
+                delayed.reply = reply;
+                m_delayed[ timer ] = delayed;
+
+                timer->start( replyDelay );
+                return;
+            }
+
+            socket->write( reply );
+            socket->disconnectFromHost();
+        }
+
+        void    sendDelayed()
+        {
+            QTimer * timer = (QTimer *) sender();
+            Delayed delayed = m_delayed.take( timer );
+            timer->deleteLater();
+
+            // The client might have given up already
+            if ( !delayed.socket || delayed.socket->state() != QAbstractSocket::ConnectedState )
+                return;
+
+            delayed.socket->write( delayed.reply );
+            delayed.socket->disconnectFromHost();
+        }
+
+    private:
+        class File
+        {
+            public:
+                QByteArray  content;
+                QString     etag;
+                QString     lastModified;
+        };
+
+        class Delayed
+        {
+            public:
+                QPointer<QTcpSocket>    socket;
+                QByteArray              reply;
+        };
+
+        QTcpServer  m_server;
+        QMap< QString, File >   m_files;
+        QMap< QTimer *, Delayed >   m_delayed;
+        QMap< QTcpSocket *, QByteArray >    m_received;
+};
+
+
+//
+// Sets the abort flag after a delay, from another thread like MainWindow::karaokeDatabaseAbortScan does
+//
+class AbortThread : public QThread
+{
+    public:
+        AbortThread( QAtomicInt * flag, int delay ) : m_flag( flag ), m_delay( delay ) {}
+
+    protected:
+        void run()
+        {
+            QThread::msleep( m_delay );
+            m_flag->store( 1 );
+        }
+
+    private:
+        QAtomicInt *    m_flag;
+        int             m_delay;
+};
+
+// CPU time used by the process so far, in milliseconds; -1 if not known on this platform
+static qint64 processCpuTime()
+{
+#if defined (Q_OS_UNIX)
+    struct rusage usage;
+
+    if ( getrusage( RUSAGE_SELF, &usage ) != 0 )
+        return -1;
+
+    return ( usage.ru_utime.tv_sec + usage.ru_stime.tv_sec ) * 1000LL
+            + ( usage.ru_utime.tv_usec + usage.ru_stime.tv_usec ) / 1000;
+#else
+    return -1;
+#endif
+}
+
+
+class TestCollectionProviderHTTP : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void    initTestCase();
+        void    init();
+        void    fullIndexReturnsValidators();
+        void    unmodifiedIndexIsNotDownloaded();
+        void    modifiedIndexIsDownloaded();
+        void    deltaAfterNotModified();
+        void    missingDeltaFallsBackToFullIndex();
+        void    slowDownloadDoesNotUseCpu();
+        void    abortCancelsSlowDownload();
+        void    abortBeforeDownload();
+
+    private:
+        // Downloads the file the same way SongDatabaseScanner::downloadCollectionFile does
+        QString download( CollectionProvider * provider, const QString& path, QByteArray& data );
+
+        IndexServer m_server;
+};
+
+static const char * INDEX_V1 = "#version 1\nArtist A|Title A|a.lrc|a.mp3|LRC|English\n";
+static const char * INDEX_V2 = "#version 2\nArtist A|Title A|a.lrc|a.mp3|LRC|English\nArtist B|Title B|b.lrc|b.mp3|LRC|German\n";
+static const char * DELTA_V1_V2 = "#delta 1 2\n+Artist B|Title B|b.lrc|b.mp3|LRC|German\n";
+
+static const char * MODIFIED_V1 = "Sat, 17 Oct 2026 10:00:00 GMT";
+static const char * MODIFIED_V2 = "Sun, 18 Oct 2026 12:30:00 GMT";
+
+
+void TestCollectionProviderHTTP::initTestCase()
+{
+    Logger::init();
+    QVERIFY( m_server.start() );
+}
+
+void TestCollectionProviderHTTP::init()
+{
+    m_server.requests.clear();
+    m_server.replyDelay = 0;
+    m_server.publish( "index.dat", INDEX_V1, "\"v1\"", MODIFIED_V1 );
+    m_server.publish( "index.delta", QByteArray(), QString(), QString() );
+}
+
+QString TestCollectionProviderHTTP::download( CollectionProvider *provider, const QString &path, QByteArray &data )
+{
+    data.clear();
+
+    QBuffer buf( &data );
+    buf.open( QIODevice::WriteOnly );
+
+    return provider->downloadAndWait( m_server.url( path ), &buf );
+}
+
+void TestCollectionProviderHTTP::fullIndexReturnsValidators()
+{
+    CollectionProviderHTTP provider( -1, 0 );
+    QByteArray data;
+
+    QCOMPARE( download( &provider, "index.dat", data ), QString() );
+    QCOMPARE( data, QByteArray( INDEX_V1 ) );
+    QVERIFY( !provider.notModified() );
+    QCOMPARE( provider.etag(), QString( "\"v1\"" ) );
+    QCOMPARE( provider.lastModified(), QString( MODIFIED_V1 ) );
+
+    // No validators were set, so the request was not conditional
+    QCOMPARE( m_server.requests.size(), 1 );
+    QVERIFY( m_server.requests[0].ifNoneMatch.isEmpty() );
+    QVERIFY( m_server.requests[0].ifModifiedSince.isEmpty() );
+}
+
+void TestCollectionProviderHTTP::unmodifiedIndexIsNotDownloaded()
+{
+    CollectionProviderHTTP provider( -1, 0 );
+    QByteArray data;
+
+    provider.setValidators( "\"v1\"", MODIFIED_V1 );
+
+    QCOMPARE( download( &provider, "index.dat", data ), QString() );
+    QVERIFY( provider.notModified() );
+    QVERIFY( data.isEmpty() );
+
+    QCOMPARE( m_server.requests.size(), 1 );
+    QCOMPARE( m_server.requests[0].ifNoneMatch, QString( "\"v1\"" ) );
+    QCOMPARE( m_server.requests[0].ifModifiedSince, QString( MODIFIED_V1 ) );
+}
+
+void TestCollectionProviderHTTP::modifiedIndexIsDownloaded()
+{
+    CollectionProviderHTTP provider( -1, 0 );
+    QByteArray data;
+
+    m_server.publish( "index.dat", INDEX_V2, "\"v2\"", MODIFIED_V2 );
+    provider.setValidators( "\"v1\"", MODIFIED_V1 );
+
+    QCOMPARE( download( &provider, "index.dat", data ), QString() );
+    QVERIFY( !provider.notModified() );
+    QCOMPARE( data, QByteArray( INDEX_V2 ) );
+    QCOMPARE( provider.etag(), QString( "\"v2\"" ) );
+    QCOMPARE( provider.lastModified(), QString( MODIFIED_V2 ) );
+}
+
+void TestCollectionProviderHTTP::deltaAfterNotModified()
+{
+    // The same provider is used for all the downloads of a collection, so nothing may leak between them
+    CollectionProviderHTTP provider( -1, 0 );
+    QByteArray data;
+
+    provider.setValidators( "\"v1\"", MODIFIED_V1 );
+
+    QCOMPARE( download( &provider, "index.dat", data ), QString() );
+    QVERIFY( provider.notModified() );
+
+    // The index changed, and the delta from our version is published
+    m_server.publish( "index.dat", INDEX_V2, "\"v2\"", MODIFIED_V2 );
+    m_server.publish( "index.delta", DELTA_V1_V2, "\"d2\"", MODIFIED_V2 );
+
+    QCOMPARE( download( &provider, "index.delta", data ), QString() );
+    QVERIFY( !provider.notModified() );
+    QCOMPARE( data, QByteArray( DELTA_V1_V2 ) );
+    QCOMPARE( provider.etag(), QString( "\"d2\"" ) );
+
+    // The validators were only for the first download
+    QCOMPARE( m_server.requests.size(), 2 );
+    QVERIFY( m_server.requests[1].ifNoneMatch.isEmpty() );
+    QVERIFY( m_server.requests[1].ifModifiedSince.isEmpty() );
+}
+
+void TestCollectionProviderHTTP::missingDeltaFallsBackToFullIndex()
+{
+    // Same sequence as SongDatabaseScanner::scanCollectionIndex with a known index version: the delta
+    // is not available, so the full index is downloaded if it was modified
+    CollectionProviderHTTP provider( -1, 0 );
+    QByteArray data;
+
+    m_server.publish( "index.dat", INDEX_V2, "\"v2\"", MODIFIED_V2 );
+
+    QVERIFY( !download( &provider, "index.delta", data ).isEmpty() );
+
+    provider.setValidators( "\"v1\"", MODIFIED_V1 );
+
+    QCOMPARE( download( &provider, "index.dat", data ), QString() );
+    QVERIFY( !provider.notModified() );
+    QCOMPARE( data, QByteArray( INDEX_V2 ) );
+    QCOMPARE( provider.etag(), QString( "\"v2\"" ) );
+
+    // And the next scan finds it unchanged
+    provider.setValidators( provider.etag(), provider.lastModified() );
+
+    QCOMPARE( download( &provider, "index.dat", data ), QString() );
+    QVERIFY( provider.notModified() );
+    QVERIFY( data.isEmpty() );
+
+    QCOMPARE( m_server.requests.size(), 3 );
+    QVERIFY( m_server.requests[0].ifNoneMatch.isEmpty() );
+    QCOMPARE( m_server.requests[1].ifNoneMatch, QString( "\"v1\"" ) );
+    QCOMPARE( m_server.requests[2].ifNoneMatch, QString( "\"v2\"" ) );
+}
+
+void TestCollectionProviderHTTP::slowDownloadDoesNotUseCpu()
+{
+    if ( processCpuTime() < 0 )
+        QSKIP( "the process CPU time is not available on this platform" );
+
+    CollectionProviderHTTP provider( -1, 0 );
+    QByteArray data;
+
+    m_server.replyDelay = 1500;
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 cpustart = processCpuTime();
+
+    QCOMPARE( download( &provider, "index.dat", data ), QString() );
+
+    qint64 cpu = processCpuTime() - cpustart;
+    qint64 elapsed = timer.elapsed();
+
+    qDebug( "Slow download: %lld ms waited, %lld ms CPU used", (long long) elapsed, (long long) cpu );
+
+    QCOMPARE( data, QByteArray( INDEX_V1 ) );
+    QVERIFY( elapsed >= 1400 );
+
+    // Spinning in processEvents would use the CPU all the time; the event loop only wakes up for the events
+    QVERIFY2( cpu * 10 < elapsed, "the download wait is using CPU" );
+}
+
+void TestCollectionProviderHTTP::abortCancelsSlowDownload()
+{
+    CollectionProviderHTTP provider( -1, 0 );
+    QAtomicInt abort( 0 );
+    QByteArray data;
+
+    // The server would take way longer than the test is willing to wait
+    m_server.replyDelay = 30000;
+
+    QBuffer buf( &data );
+    buf.open( QIODevice::WriteOnly );
+
+    AbortThread aborter( &abort, 300 );
+
+    QElapsedTimer timer;
+    timer.start();
+    qint64 cpustart = processCpuTime();
+
+    aborter.start();
+    QString errmsg = provider.downloadAndWait( m_server.url( "index.dat" ), &buf, &abort );
+
+    qint64 cpu = processCpuTime() - cpustart;
+    qint64 elapsed = timer.elapsed();
+    aborter.wait();
+
+    qDebug( "Aborted download: returned after %lld ms, %lld ms CPU used", (long long) elapsed, (long long) cpu );
+
+    QVERIFY( !errmsg.isEmpty() );
+    QVERIFY( data.isEmpty() );
+
+    // The flag is checked every 100ms
+    QVERIFY( elapsed >= 300 );
+    QVERIFY2( elapsed < 1500, "the download was not cancelled in time" );
+
+    if ( cpustart >= 0 )
+        QVERIFY2( cpu * 5 < elapsed, "the download wait is using CPU" );
+
+    // The provider is usable again after the cancellation
+    m_server.replyDelay = 0;
+
+    QCOMPARE( download( &provider, "index.dat", data ), QString() );
+    QCOMPARE( data, QByteArray( INDEX_V1 ) );
+}
+
+void TestCollectionProviderHTTP::abortBeforeDownload()
+{
+    // The scan could be aborted just before the download starts
+    CollectionProviderHTTP provider( -1, 0 );
+    QAtomicInt abort( 1 );
+    QByteArray data;
+
+    m_server.replyDelay = 30000;
+
+    QBuffer buf( &data );
+    buf.open( QIODevice::WriteOnly );
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QVERIFY( !provider.downloadAndWait( m_server.url( "index.dat" ), &buf, &abort ).isEmpty() );
+    QVERIFY2( timer.elapsed() < 1000, "the download was not cancelled in time" );
+}
+
+QTEST_GUILESS_MAIN(TestCollectionProviderHTTP)
+
+#include "tst_collectionproviderhttp.moc"
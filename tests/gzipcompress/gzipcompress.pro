@@ -0,0 +1,18 @@
+include(../tests.pri)
+
+TARGET = tst_gzipcompress
+
+# The settings header needs the GUI module, and the logger the widgets
+QT += gui widgets
+
+SOURCES += tst_gzipcompress.cpp \
+    ../../src/util.cpp \
+    ../../src/logger.cpp
+
+HEADERS += ../../src/util.h
+
+INCLUDEPATH += $$PWD/../.. $$PWD/../../extralibs/include
+
+# The output is decoded with the system zlib, the same way the browsers do
+CONFIG += link_pkgconfig
+PKGCONFIG += uchardet zlib
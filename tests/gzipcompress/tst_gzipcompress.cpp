@@ -0,0 +1,235 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtTest>
+#include <QElapsedTimer>
+
+#include <zlib.h>
+
+#include "util.h"
+
+// Util only uses the settings for the cache directory, which is not tested here
+Settings * pSettings;
+
+
+class TestGzipCompress : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void    roundTrip_data();
+        void    roundTrip();
+        void    headerAndTrailer();
+        void    emptyInput();
+        void    searchResult();
+
+    private:
+        // Decodes a gzip stream with zlib; returns false with the zlib error if it is not valid,
+        // or if there is anything after the end of the gzip member
+        static bool gunzip( const QByteArray& gzip, QByteArray& out, QString& error );
+
+        // JSON the way /api/search replies it
+        static QByteArray searchJson( int rows );
+};
+
+bool TestGzipCompress::gunzip( const QByteArray &gzip, QByteArray &out, QString &error )
+{
+    z_stream stream;
+    memset( &stream, 0, sizeof(stream) );
+
+    // 16 + MAX_WBITS decodes gzip only, with the header and trailer checks
+    if ( inflateInit2( &stream, 16 + MAX_WBITS ) != Z_OK )
+    {
+        error = "inflateInit2 failed";
+        return false;
+    }
+
+    stream.next_in = (Bytef *) gzip.constData();
+    stream.avail_in = gzip.size();
+
+    char buffer[16384];
+    int ret;
+
+    out.clear();
+
+    do
+    {
+        stream.next_out = (Bytef *) buffer;
+        stream.avail_out = sizeof(buffer);
+
+        ret = inflate( &stream, Z_NO_FLUSH );
+
+        if ( ret != Z_OK && ret != Z_STREAM_END )
+        {
+            error = QString( "inflate error %1: %2" ).arg( ret ).arg( stream.msg ? stream.msg : "" );
+            inflateEnd( &stream );
+            return false;
+        }
+
+        out.append( buffer, sizeof(buffer) - stream.avail_out );
+    }
+    while ( ret != Z_STREAM_END && stream.avail_in > 0 );
+
+    int leftover = stream.avail_in;
+    inflateEnd( &stream );
+
+    if ( ret != Z_STREAM_END )
+    {
+        error = "truncated stream";
+        return false;
+    }
+
+    if ( leftover > 0 )
+    {
+        error = QString( "%1 bytes after the end of stream" ).arg( leftover );
+        return false;
+    }
+
+    return true;
+}
+
+QByteArray TestGzipCompress::searchJson( int rows )
+{
+    static const char * artists[] = { "The Beatles", "ABBA", "Queen", "Frank Sinatra", "Adele", "Elvis Presley", "Madonna", "Nirvana" };
+    static const char * languages[] = { "English", "Swedish", "Spanish", "" };
+
+    QByteArray json = "[";
+
+    for ( int i = 0; i < rows; i++ )
+    {
+        if ( i > 0 )
+            json += ",";
+
+        json += "{\"id\":" + QByteArray::number( 1000 + i * 7 )
+                + ",\"artist\":\"" + artists[ i % 8 ]
+                + "\",\"title\":\"Song number " + QByteArray::number( i * 31 % 997 )
+                + "\",\"type\":\"" + ( i % 3 ? "cdg" : "mp3" )
+                + "\",\"rating\":" + QByteArray::number( i % 5 )
+                + ",\"language\":\"" + languages[ i % 4 ] + "\"}";
+    }
+
+    return json + "]";
+}
+
+void TestGzipCompress::roundTrip_data()
+{
+    QTest::addColumn<QByteArray>("data");
+
+    QByteArray allbytes;
+
+    for ( int i = 0; i < 256; i++ )
+        allbytes.append( (char) i );
+
+    // Random data doesn't compress, but still must be a valid stream
+    QByteArray random;
+    qsrand( 42 );
+
+    for ( int i = 0; i < 100000; i++ )
+        random.append( (char) (qrand() & 0xFF) );
+
+    QTest::newRow("one byte") << QByteArray( "a" );
+    QTest::newRow("short text") << QByteArray( "Hello, world!\n" );
+    QTest::newRow("all byte values") << allbytes;
+    QTest::newRow("nul bytes") << QByteArray( 70000, '\0' );
+    QTest::newRow("random") << random;
+    QTest::newRow("repetitive 4MB") << QByteArray( "karaoke " ).repeated( 512 * 1024 );
+    QTest::newRow("search json") << searchJson( 1000 );
+    QTest::newRow("utf-8 text") << QString::fromUtf8( "Песня на русском — 日本語の歌 — çàé\n" ).repeated( 200 ).toUtf8();
+}
+
+void TestGzipCompress::roundTrip()
+{
+    QFETCH( QByteArray, data );
+
+    QByteArray compressed = Util::gzipCompress( data );
+    QByteArray decoded;
+    QString error;
+
+    QVERIFY( !compressed.isEmpty() );
+    QVERIFY2( gunzip( compressed, decoded, error ), qPrintable( error ) );
+    QCOMPARE( decoded.size(), data.size() );
+    QVERIFY( decoded == data );
+}
+
+void TestGzipCompress::headerAndTrailer()
+{
+    QByteArray data = searchJson( 10 );
+    QByteArray compressed = Util::gzipCompress( data );
+
+    QVERIFY( compressed.size() > 18 );
+
+    // Magic, deflate, no flags, so the browsers don't have to skip any optional fields
+    QCOMPARE( (unsigned char) compressed[0], (unsigned char) 0x1F );
+    QCOMPARE( (unsigned char) compressed[1], (unsigned char) 0x8B );
+    QCOMPARE( (int) compressed[2], 8 );
+    QCOMPARE( (int) compressed[3], 0 );
+
+    // Trailer: CRC32 and the original size, little-endian
+    quint32 crc = 0, size = 0;
+
+    for ( int b = 3; b >= 0; b-- )
+    {
+        crc = (crc << 8) | (unsigned char) compressed[ compressed.size() - 8 + b ];
+        size = (size << 8) | (unsigned char) compressed[ compressed.size() - 4 + b ];
+    }
+
+    QCOMPARE( crc, (quint32) crc32( 0L, (const Bytef *) data.constData(), data.size() ) );
+    QCOMPARE( size, (quint32) data.size() );
+
+    // A corrupted byte in the middle must be caught by the decoder
+    QByteArray corrupted = compressed;
+    corrupted[ corrupted.size() / 2 ] = corrupted[ corrupted.size() / 2 ] ^ 0x55;
+
+    QByteArray decoded;
+    QString error;
+    QVERIFY( !gunzip( corrupted, decoded, error ) || decoded != data );
+
+    // As must the truncated one
+    QVERIFY( !gunzip( compressed.left( compressed.size() - 4 ), decoded, error ) );
+}
+
+void TestGzipCompress::emptyInput()
+{
+    // Nothing to gain from compressing nothing; the callers send such data as is
+    QVERIFY( Util::gzipCompress( QByteArray() ).isEmpty() );
+}
+
+void TestGzipCompress::searchResult()
+{
+    QByteArray data = searchJson( 1000 );
+    QByteArray compressed;
+
+    const int runs = 50;
+    QElapsedTimer timer;
+    timer.start();
+
+    for ( int i = 0; i < runs; i++ )
+        compressed = Util::gzipCompress( data );
+
+    double usec = timer.nsecsElapsed() / 1000.0 / runs;
+
+    qDebug( "1000-row search result: %d bytes, gzip %d bytes (%.1f%%), %.0f us to compress",
+            data.size(), compressed.size(), compressed.size() * 100.0 / data.size(), usec );
+
+    // Repetitive JSON, which compresses several times
+    QVERIFY2( compressed.size() * 4 < data.size(), "compressed search result is larger than expected" );
+}
+
+QTEST_APPLESS_MAIN(TestGzipCompress)
+
+#include "tst_gzipcompress.moc"
@@ -0,0 +1,10 @@
+include(../tests.pri)
+
+TARGET = tst_httppipelining
+
+QT += network
+
+SOURCES += tst_httppipelining.cpp \
+    ../../src/httprequestparser.cpp
+
+HEADERS += ../../src/httprequestparser.h
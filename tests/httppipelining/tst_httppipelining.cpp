@@ -0,0 +1,449 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtTest>
+#include <QMap>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include "httprequestparser.h"
+
+
+//
+// Server side of the socket pair. Handles the connection data the same way ActionHandler_WebServer_Socket does:
+// the parser takes one request at a time, the rest stays in the buffer, and every request is answered in order
+// with the body describing what was parsed. The connection is closed when the request doesn't keep it alive.
+//
+class PipelineServer : public QObject
+{
+    Q_OBJECT
+
+    public:
+        class Request
+        {
+            public:
+                int         connection;
+                QByteArray  method;
+                QByteArray  url;
+                QByteArray  body;
+        };
+
+        PipelineServer()
+        {
+            connections = 0;
+            bytesReceived = 0;
+
+            connect( &m_server, SIGNAL(newConnection()), this, SLOT(newConnection()) );
+        }
+
+        ~PipelineServer()
+        {
+            qDeleteAll( m_connections );
+        }
+
+        bool    start() { return m_server.listen( QHostAddress::LocalHost ); }
+        quint16 port() const { return m_server.serverPort(); }
+
+        int             connections;
+        qint64          bytesReceived;
+        QList<Request>  requests;
+
+    private:
+        class Connection
+        {
+            public:
+                int                 id;
+                HttpRequestParser   parser;
+                QByteArray          buffer;
+                bool                closing;
+        };
+
+    private slots:
+        void    newConnection()
+        {
+            while ( m_server.hasPendingConnections() )
+            {
+                QTcpSocket * socket = m_server.nextPendingConnection();
+
+                Connection * conn = new Connection();
+                conn->id = ++connections;
+                conn->closing = false;
+                m_connections[ socket ] = conn;
+
+                connect( socket, SIGNAL(readyRead()), this, SLOT(readyRead()) );
+                connect( socket, SIGNAL(disconnected()), this, SLOT(disconnected()) );
+            }
+        }
+
+        void    readyRead()
+        {
+            QTcpSocket * socket = (QTcpSocket *) sender();
+            Connection * conn = m_connections.value( socket );
+            QByteArray data = socket->readAll();
+
+            bytesReceived += data.size();
+
+            if ( !conn || conn->closing )
+                return;
+
+            conn->buffer += data;
+
+            while ( true )
+            {
+                int consumed = conn->parser.feed( conn->buffer );
+                conn->buffer.remove( 0, consumed );
+
+                if ( conn->parser.hasError() )
+                {
+                    reply( socket, conn->parser.errorCode(), "error", false );
+                    conn->closing = true;
+                    socket->disconnectFromHost();
+                    return;
+                }
+
+                if ( !conn->parser.isComplete() )
+                    return;
+
+                Request request;
+                request.connection = conn->id;
+                request.method = conn->parser.method();
+                request.url = conn->parser.url();
+                request.body = conn->parser.body();
+                requests.push_back( request );
+
+                bool keepalive = conn->parser.keepAlive();
+                reply( socket, 200, request.method + " " + request.url + "\n" + request.body, keepalive );
+                conn->parser.reset();
+
+                if ( !keepalive )
+                {
+                    conn->closing = true;
+                    socket->disconnectFromHost();
+                    return;
+                }
+            }
+        }
+
+        void    disconnected()
+        {
+            QTcpSocket * socket = (QTcpSocket *) sender();
+
+            delete m_connections.take( socket );
+            socket->deleteLater();
+        }
+
+    private:
+        void    reply( QTcpSocket * socket, int code, const QByteArray& body, bool keepalive )
+        {
+            socket->write( "HTTP/1.1 " + QByteArray::number( code ) + " x\r\n"
+                           + "Content-Length: " + QByteArray::number( body.size() ) + "\r\n"
+                           + ( keepalive ? "Connection: keep-alive\r\n" : "Connection: Close\r\n" )
+                           + "\r\n"
+                           + body );
+        }
+
+        QTcpServer  m_server;
+        QMap< QTcpSocket *, Connection * >  m_connections;
+};
+
+
+//
+// Client side: collects the responses, which are all sent with Content-Length
+//
+class PipelineClient
+{
+    public:
+        class Response
+        {
+            public:
+                int         code;
+                bool        keepAlive;
+                QByteArray  body;
+        };
+
+        void    connectTo( quint16 port )
+        {
+            socket.connectToHost( QHostAddress::LocalHost, port );
+        }
+
+        bool    isConnected() const { return socket.state() == QAbstractSocket::ConnectedState; }
+
+        // Reads whatever arrived and returns the number of complete responses so far
+        int     responseCount()
+        {
+            m_buffer += socket.readAll();
+
+            while ( true )
+            {
+                int end = m_buffer.indexOf( "\r\n\r\n" );
+
+                if ( end == -1 )
+                    break;
+
+                QList<QByteArray> lines = m_buffer.left( end ).split( '\n' );
+                Response response;
+                int length = 0;
+
+                response.code = lines.takeFirst().split( ' ' ).value( 1 ).toInt();
+                response.keepAlive = false;
+
+                Q_FOREACH( const QByteArray& line, lines )
+                {
+                    int colon = line.indexOf( ':' );
+                    QByteArray name = line.left( colon ).trimmed().toLower();
+                    QByteArray value = line.mid( colon + 1 ).trimmed().toLower();
+
+                    if ( name == "content-length" )
+                        length = value.toInt();
+                    else if ( name == "connection" )
+                        response.keepAlive = value == "keep-alive";
+                }
+
+                if ( m_buffer.size() < end + 4 + length )
+                    break;
+
+                response.body = m_buffer.mid( end + 4, length );
+                m_buffer.remove( 0, end + 4 + length );
+                responses.push_back( response );
+            }
+
+            return responses.size();
+        }
+
+        QTcpSocket      socket;
+        QList<Response> responses;
+
+    private:
+        QByteArray      m_buffer;
+};
+
+
+class TestHttpPipelining : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void    init();
+        void    cleanup();
+
+        void    pipelinedInOneWrite();
+        void    pipelinedInSplitWrites();
+        void    connectionCloseEndsPipeline();
+        void    http10ClosesUnlessKeepAlive();
+        void    invalidRequestEndsPipeline();
+        void    pollingReusesConnection();
+
+    private:
+        static QByteArray   get( const QByteArray& url, const QByteArray& extraheaders = QByteArray(), const QByteArray& version = "HTTP/1.1" );
+        static QByteArray   post( const QByteArray& url, const QByteArray& body );
+        static QByteArray   postChunked( const QByteArray& url, const QList<QByteArray>& chunks );
+
+        // The requests a web UI client would pipeline, with the expected response bodies
+        QByteArray  mixedRequests( QList<QByteArray> &expected ) const;
+
+        void        verifyResponses( const QList<QByteArray> &expected );
+
+        PipelineServer *    m_server;
+        PipelineClient *    m_client;
+};
+
+QByteArray TestHttpPipelining::get( const QByteArray &url, const QByteArray &extraheaders, const QByteArray &version )
+{
+    return "GET " + url + " " + version + "\r\nHost: localhost\r\n" + extraheaders + "\r\n";
+}
+
+QByteArray TestHttpPipelining::post( const QByteArray &url, const QByteArray &body )
+{
+    return "POST " + url + " HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/json\r\n"
+            + "Content-Length: " + QByteArray::number( body.size() ) + "\r\n\r\n"
+            + body;
+}
+
+QByteArray TestHttpPipelining::postChunked( const QByteArray &url, const QList<QByteArray> &chunks )
+{
+    QByteArray request = "POST " + url + " HTTP/1.1\r\nHost: localhost\r\nTransfer-Encoding: chunked\r\n\r\n";
+
+    Q_FOREACH( const QByteArray& chunk, chunks )
+        request += QByteArray::number( chunk.size(), 16 ) + "\r\n" + chunk + "\r\n";
+
+    return request + "0\r\n\r\n";
+}
+
+QByteArray TestHttpPipelining::mixedRequests( QList<QByteArray> &expected ) const
+{
+    QByteArray data;
+
+    data += get( "/api/control/status" );
+    expected.push_back( "GET /api/control/status\n" );
+
+    data += get( "/api/queue/list", "Connection: keep-alive\r\n" );
+    expected.push_back( "GET /api/queue/list\n" );
+
+    data += post( "/api/queue/add", "{\"id\":12345,\"singer\":\"Anna\"}" );
+    expected.push_back( "POST /api/queue/add\n{\"id\":12345,\"singer\":\"Anna\"}" );
+
+    data += postChunked( "/api/search", QList<QByteArray>() << "{\"query\":" << "\"Yesterday\"" << "}" );
+    expected.push_back( "POST /api/search\n{\"query\":\"Yesterday\"}" );
+
+    data += get( "/api/control/status", "Accept-Encoding: gzip\r\n" );
+    expected.push_back( "GET /api/control/status\n" );
+
+    return data;
+}
+
+void TestHttpPipelining::verifyResponses( const QList<QByteArray> &expected )
+{
+    QTRY_COMPARE( m_client->responseCount(), expected.size() );
+
+    for ( int i = 0; i < expected.size(); i++ )
+    {
+        QCOMPARE( m_client->responses[i].code, 200 );
+        QCOMPARE( m_client->responses[i].body, expected[i] );
+    }
+
+    // All on the same connection
+    QCOMPARE( m_server->connections, 1 );
+    QCOMPARE( m_server->requests.size(), expected.size() );
+
+    Q_FOREACH( const PipelineServer::Request& request, m_server->requests )
+        QCOMPARE( request.connection, 1 );
+}
+
+void TestHttpPipelining::init()
+{
+    m_server = new PipelineServer();
+    QVERIFY( m_server->start() );
+
+    m_client = new PipelineClient();
+    m_client->connectTo( m_server->port() );
+    QTRY_VERIFY( m_client->isConnected() );
+}
+
+void TestHttpPipelining::cleanup()
+{
+    delete m_client;
+    delete m_server;
+}
+
+void TestHttpPipelining::pipelinedInOneWrite()
+{
+    QList<QByteArray> expected;
+
+    m_client->socket.write( mixedRequests( expected ) );
+    verifyResponses( expected );
+
+    // The client asked for nothing else, so the connection stays open for the next poll
+    QVERIFY( m_client->isConnected() );
+    QVERIFY( m_client->responses.last().keepAlive );
+}
+
+void TestHttpPipelining::pipelinedInSplitWrites()
+{
+    QList<QByteArray> expected;
+    QByteArray data = mixedRequests( expected );
+    int chunk = 1;
+
+    // Segments of 1 to 13 bytes cut through the request lines, the headers, the chunk sizes and the boundaries
+    // between requests. Each segment is received before the next one is sent, so they're not merged on the way.
+    for ( int offset = 0; offset < data.size(); offset += chunk, chunk = chunk % 13 + 1 )
+    {
+        m_client->socket.write( data.mid( offset, chunk ) );
+        QTRY_COMPARE( m_server->bytesReceived, (qint64) qMin( offset + chunk, data.size() ) );
+    }
+
+    verifyResponses( expected );
+    QVERIFY( m_client->isConnected() );
+}
+
+void TestHttpPipelining::connectionCloseEndsPipeline()
+{
+    // The request after the one with Connection: close must not be handled
+    m_client->socket.write( get( "/api/control/status" )
+                            + get( "/api/queue/list", "Connection: close\r\n" )
+                            + get( "/api/control/status" ) );
+
+    QTRY_VERIFY( !m_client->isConnected() );
+    QCOMPARE( m_client->responseCount(), 2 );
+
+    QVERIFY( m_client->responses[0].keepAlive );
+    QVERIFY( !m_client->responses[1].keepAlive );
+    QCOMPARE( m_client->responses[1].body, QByteArray( "GET /api/queue/list\n" ) );
+    QCOMPARE( m_server->requests.size(), 2 );
+}
+
+void TestHttpPipelining::http10ClosesUnlessKeepAlive()
+{
+    m_client->socket.write( get( "/a", "Connection: Keep-Alive\r\n", "HTTP/1.0" )
+                            + get( "/b", "Connection: keep-alive\r\n", "HTTP/1.0" ) );
+
+    QTRY_COMPARE( m_client->responseCount(), 2 );
+    QVERIFY( m_client->isConnected() );
+
+    m_client->socket.write( get( "/c", QByteArray(), "HTTP/1.0" ) + get( "/d", QByteArray(), "HTTP/1.0" ) );
+
+    QTRY_VERIFY( !m_client->isConnected() );
+    QCOMPARE( m_client->responseCount(), 3 );
+    QVERIFY( !m_client->responses[2].keepAlive );
+    QCOMPARE( m_client->responses[2].body, QByteArray( "GET /c\n" ) );
+}
+
+void TestHttpPipelining::invalidRequestEndsPipeline()
+{
+    m_client->socket.write( get( "/api/control/status" ) + "BROKEN\r\n\r\n" + get( "/api/control/status" ) );
+
+    QTRY_VERIFY( !m_client->isConnected() );
+    QCOMPARE( m_client->responseCount(), 2 );
+    QCOMPARE( m_client->responses[0].code, 200 );
+    QCOMPARE( m_client->responses[1].code, 400 );
+    QCOMPARE( m_server->requests.size(), 1 );
+}
+
+void TestHttpPipelining::pollingReusesConnection()
+{
+    // A phone polling the status and the queue: with keep-alive all polls go over the connection it opened
+    const int polls = 50;
+
+    for ( int i = 0; i < polls; i++ )
+    {
+        m_client->socket.write( get( i % 4 == 3 ? "/api/queue/list" : "/api/control/status" ) );
+        QTRY_COMPARE( m_client->responseCount(), i + 1 );
+    }
+
+    QCOMPARE( m_server->connections, 1 );
+    QVERIFY( m_client->isConnected() );
+
+    // Same polls from a client which closes the connection each time, as every client did before keep-alive
+    for ( int i = 0; i < polls; i++ )
+    {
+        PipelineClient client;
+        client.connectTo( m_server->port() );
+        QTRY_VERIFY( client.isConnected() );
+
+        client.socket.write( get( "/api/control/status", "Connection: close\r\n" ) );
+
+        QTRY_COMPARE( client.responseCount(), 1 );
+        QTRY_VERIFY( !client.isConnected() );
+    }
+
+    QCOMPARE( m_server->connections, 1 + polls );
+    qDebug( "%d polls: 1 connection with keep-alive, %d without", polls, polls );
+}
+
+QTEST_GUILESS_MAIN(TestHttpPipelining)
+
+#include "tst_httppipelining.moc"
@@ -0,0 +1,8 @@
+include(../tests.pri)
+
+TARGET = tst_httprequestparser
+
+SOURCES += tst_httprequestparser.cpp \
+    ../../src/httprequestparser.cpp
+
+HEADERS += ../../src/httprequestparser.h
@@ -0,0 +1,351 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtTest>
+
+#include "httprequestparser.h"
+
+// Limits used for the parsers in the tests, small enough so the fuzzed input hits them
+static const int MAX_HEADER_SIZE = 512;
+static const int MAX_BODY_SIZE = 256;
+
+// The codes the parser is allowed to reply with
+static const int VALID_ERROR_CODES[] = { 400, 413, 414, 431, 501, 505 };
+
+//
+// Everything the parser produced for the input, so the results of feeding it in different ways could be compared
+//
+class ParseResult
+{
+    public:
+        HttpRequestParser::State    state;
+        int             errorCode;
+        int             consumed;
+        QByteArray      method;
+        QByteArray      url;
+        QByteArray      version;
+        QByteArray      body;
+        QList< QPair<QByteArray, QByteArray> >  headers;
+
+        bool operator == ( const ParseResult& other ) const
+        {
+            // How much is consumed before the error is found depends on where the data is split
+            if ( state == HttpRequestParser::STATE_ERROR || other.state == HttpRequestParser::STATE_ERROR )
+                return state == other.state && errorCode == other.errorCode;
+
+            return state == other.state && consumed == other.consumed && method == other.method && url == other.url
+                    && version == other.version && body == other.body && headers == other.headers;
+        }
+
+        QString toString() const
+        {
+            return QString( "state %1 error %2 consumed %3 %4 %5 %6 body %7 bytes, %8 headers" )
+                    .arg( state ).arg( errorCode ).arg( consumed )
+                    .arg( QString::fromLatin1( method ) ).arg( QString::fromLatin1( url ) ).arg( QString::fromLatin1( version ) )
+                    .arg( body.size() ).arg( headers.size() );
+        }
+};
+
+// Feeds the data split at the given offsets (ascending), the same way the connection does as the data arrives
+static ParseResult parseSplit( const QByteArray& data, const QList<int>& splits )
+{
+    HttpRequestParser parser( MAX_HEADER_SIZE, MAX_BODY_SIZE );
+    ParseResult result;
+    int start = 0;
+
+    result.consumed = 0;
+
+    for ( int i = 0; i <= splits.size(); i++ )
+    {
+        int end = i < splits.size() ? splits[i] : data.size();
+        QByteArray segment = data.mid( start, end - start );
+        int consumed = parser.feed( segment );
+
+        if ( consumed < 0 || consumed > segment.size() )
+            qFatal( "feed() consumed %d of %d bytes", consumed, segment.size() );
+
+        result.consumed += consumed;
+        start = end;
+
+        // The rest belongs to the next request
+        if ( parser.isComplete() || parser.hasError() )
+            break;
+
+        if ( consumed != segment.size() )
+            qFatal( "feed() stopped at %d of %d bytes while the request is incomplete", consumed, segment.size() );
+    }
+
+    result.state = parser.state();
+    result.errorCode = parser.errorCode();
+    result.method = parser.method();
+    result.url = parser.url();
+    result.version = parser.version();
+    result.body = parser.body();
+    result.headers = parser.headers();
+    return result;
+}
+
+static ParseResult parseWhole( const QByteArray& data )
+{
+    return parseSplit( data, QList<int>() );
+}
+
+// Random split offsets; the fixed seed keeps the failures reproducible
+static QList<int> randomSplits( int size )
+{
+    QList<int> splits;
+
+    for ( int offset = qrand() % 8; offset < size; offset += 1 + qrand() % 12 )
+        splits.push_back( offset );
+
+    return splits;
+}
+
+// Valid and invalid requests covering all the parser states
+static QList<QByteArray> corpus()
+{
+    QList<QByteArray> requests;
+
+    requests << "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"
+             << "GET /index.html HTTP/1.0\r\n\r\n"
+             << "\r\n\r\nGET /leading/empty/lines HTTP/1.1\r\n\r\n"
+             << "GET /bare/lf HTTP/1.1\nHost: x\nAccept-Encoding: gzip, deflate\n\n"
+             << "POST /api/search HTTP/1.1\r\nContent-Type: application/json\r\nContent-Length: 17\r\n\r\n{\"query\":\"love\"}\n"
+             << "POST /api/login HTTP/1.1\r\nContent-Length: 5\r\nContent-Length: 5\r\n\r\nhello"
+             << "POST /api/x HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhello\r\n6;ext=1\r\n world\r\n0\r\nTrailer: yes\r\n\r\n"
+             << "POST /api/x HTTP/1.1\r\nTransfer-Encoding: Chunked\r\n\r\n0\r\n\r\n"
+             << "GET /pipelined HTTP/1.1\r\n\r\nGET /second HTTP/1.1\r\n\r\n"
+             << "POST /pipelined HTTP/1.1\r\nContent-Length: 3\r\n\r\nabcGET /second HTTP/1.1\r\n\r\n"
+             << "GET / HTTP/2.0\r\n\r\n"
+             << "GET / FTP/1.0\r\n\r\n"
+             << "G(T / HTTP/1.1\r\n\r\n"
+             << "GET /a b HTTP/1.1\r\n\r\n"
+             << "GET / HTTP/1.1\r\n folded: header\r\n\r\n"
+             << "GET / HTTP/1.1\r\nNo colon\r\n\r\n"
+             << "GET / HTTP/1.1\r\nBad name: x\r\n\r\n"
+             << "POST / HTTP/1.1\r\nContent-Length: 5, 6\r\n\r\nhello"
+             << "POST / HTTP/1.1\r\nContent-Length: -1\r\n\r\n"
+             << "POST / HTTP/1.1\r\nContent-Length: 100000\r\n\r\n"
+             << "POST / HTTP/1.1\r\nTransfer-Encoding: gzip, chunked\r\n\r\n"
+             << "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n"
+             << "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabcX\r\n0\r\n\r\n"
+             << "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n1000\r\n"
+             << "GET /" + QByteArray( MAX_HEADER_SIZE, 'a' ) + " HTTP/1.1\r\n\r\n"
+             << "GET / HTTP/1.1\r\nCookie: " + QByteArray( MAX_HEADER_SIZE, 'c' ) + "\r\n\r\n";
+
+    return requests;
+}
+
+class TestHttpRequestParser : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void initTestCase();
+        void parsesCorpus();
+        void splitAtEveryOffset();
+        void byteByByte();
+        void randomSplits();
+        void fuzzedInput();
+        void randomBytes();
+        void limitsWithoutLineEnd();
+};
+
+void TestHttpRequestParser::initTestCase()
+{
+    qsrand( 20161104 );
+}
+
+void TestHttpRequestParser::parsesCorpus()
+{
+    ParseResult r = parseWhole( corpus()[4] );
+    QCOMPARE( (int) r.state, (int) HttpRequestParser::STATE_COMPLETE );
+    QCOMPARE( r.method, QByteArray( "POST" ) );
+    QCOMPARE( r.url, QByteArray( "/api/search" ) );
+    QCOMPARE( r.body, QByteArray( "{\"query\":\"love\"}\n" ) );
+    QCOMPARE( r.headers.size(), 2 );
+    QCOMPARE( r.headers[0].first, QByteArray( "content-type" ) );
+
+    r = parseWhole( corpus()[6] );
+    QCOMPARE( (int) r.state, (int) HttpRequestParser::STATE_COMPLETE );
+    QCOMPARE( r.body, QByteArray( "hello world" ) );
+
+    // Only the first pipelined request is consumed
+    r = parseWhole( corpus()[9] );
+    QCOMPARE( (int) r.state, (int) HttpRequestParser::STATE_COMPLETE );
+    QCOMPARE( r.body, QByteArray( "abc" ) );
+    QCOMPARE( corpus()[9].mid( r.consumed ), QByteArray( "GET /second HTTP/1.1\r\n\r\n" ) );
+
+    QCOMPARE( parseWhole( corpus()[10] ).errorCode, 505 );
+    QCOMPARE( parseWhole( corpus()[19] ).errorCode, 413 );
+    QCOMPARE( parseWhole( corpus()[20] ).errorCode, 501 );
+    QCOMPARE( parseWhole( corpus()[24] ).errorCode, 414 );
+    QCOMPARE( parseWhole( corpus()[25] ).errorCode, 431 );
+}
+
+void TestHttpRequestParser::splitAtEveryOffset()
+{
+    Q_FOREACH( const QByteArray& request, corpus() )
+    {
+        ParseResult whole = parseWhole( request );
+
+        for ( int i = 1; i < request.size(); i++ )
+        {
+            ParseResult split = parseSplit( request, QList<int>() << i );
+            QVERIFY2( split == whole, qPrintable( QString( "split at %1 of %2: %3, whole: %4" )
+                                                  .arg( i ).arg( QString::fromLatin1( request.left( 40 ) ) )
+                                                  .arg( split.toString() ).arg( whole.toString() ) ) );
+        }
+    }
+}
+
+void TestHttpRequestParser::byteByByte()
+{
+    Q_FOREACH( const QByteArray& request, corpus() )
+    {
+        QList<int> splits;
+
+        for ( int i = 1; i < request.size(); i++ )
+            splits.push_back( i );
+
+        ParseResult whole = parseWhole( request );
+        ParseResult split = parseSplit( request, splits );
+        QVERIFY2( split == whole, qPrintable( QString::fromLatin1( request.left( 40 ) ) ) );
+    }
+}
+
+void TestHttpRequestParser::randomSplits()
+{
+    Q_FOREACH( const QByteArray& request, corpus() )
+    {
+        ParseResult whole = parseWhole( request );
+
+        for ( int i = 0; i < 200; i++ )
+            QVERIFY( parseSplit( request, ::randomSplits( request.size() ) ) == whole );
+    }
+}
+
+void TestHttpRequestParser::fuzzedInput()
+{
+    QList<QByteArray> requests = corpus();
+    static const char interesting[] = "\r\n :;,0123456789abcdefABCDEF-\t";
+
+    for ( int i = 0; i < 5000; i++ )
+    {
+        QByteArray request = requests[ qrand() % requests.size() ];
+        int mutations = 1 + qrand() % 4;
+
+        for ( int m = 0; m < mutations && !request.isEmpty(); m++ )
+        {
+            int pos = qrand() % request.size();
+
+            switch ( qrand() % 4 )
+            {
+                case 0:
+                    request[pos] = (char) ( qrand() % 256 );
+                    break;
+
+                case 1:
+                    request[pos] = interesting[ qrand() % ( sizeof(interesting) - 1 ) ];
+                    break;
+
+                case 2:
+                    request.insert( pos, interesting[ qrand() % ( sizeof(interesting) - 1 ) ] );
+                    break;
+
+                default:
+                    request.remove( pos, 1 + qrand() % 4 );
+                    break;
+            }
+        }
+
+        ParseResult whole = parseWhole( request );
+
+        // Whatever the input is, the parser stays within the limits and replies with a valid code
+        QVERIFY( whole.consumed <= request.size() );
+        QVERIFY( whole.body.size() <= MAX_BODY_SIZE );
+
+        if ( whole.state == HttpRequestParser::STATE_ERROR )
+        {
+            bool valid = false;
+
+            for ( unsigned int c = 0; c < sizeof(VALID_ERROR_CODES) / sizeof(VALID_ERROR_CODES[0]); c++ )
+                valid = valid || whole.errorCode == VALID_ERROR_CODES[c];
+
+            QVERIFY2( valid, qPrintable( QString::number( whole.errorCode ) ) );
+        }
+
+        // And the result does not depend on how the data arrives
+        ParseResult split = parseSplit( request, ::randomSplits( request.size() ) );
+        QVERIFY2( split == whole, qPrintable( QString( "%1: %2, whole: %3" ).arg( QString::fromLatin1( request.toPercentEncoding() ) )
+                                              .arg( split.toString() ).arg( whole.toString() ) ) );
+    }
+}
+
+void TestHttpRequestParser::randomBytes()
+{
+    for ( int i = 0; i < 1000; i++ )
+    {
+        QByteArray data;
+        int size = qrand() % 2048;
+
+        for ( int b = 0; b < size; b++ )
+            data.append( (char) ( qrand() % 256 ) );
+
+        ParseResult whole = parseWhole( data );
+        QVERIFY( whole.consumed <= data.size() );
+        QVERIFY( whole.body.size() <= MAX_BODY_SIZE );
+        QVERIFY( parseSplit( data, ::randomSplits( data.size() ) ) == whole );
+    }
+}
+
+void TestHttpRequestParser::limitsWithoutLineEnd()
+{
+    // A client which never ends the line must not make the parser buffer without limit
+    HttpRequestParser parser( MAX_HEADER_SIZE, MAX_BODY_SIZE );
+    QByteArray junk( 64, 'x' );
+    int fed = 0;
+
+    while ( !parser.hasError() && fed <= MAX_HEADER_SIZE * 2 )
+    {
+        parser.feed( junk );
+        fed += junk.size();
+    }
+
+    QVERIFY( parser.hasError() );
+    QCOMPARE( parser.errorCode(), 414 );
+    QVERIFY( fed <= MAX_HEADER_SIZE + junk.size() );
+
+    // Same within the headers
+    parser.reset();
+    parser.feed( "GET / HTTP/1.1\r\nX-Long: " );
+    fed = 0;
+
+    while ( !parser.hasError() && fed <= MAX_HEADER_SIZE * 2 )
+    {
+        parser.feed( junk );
+        fed += junk.size();
+    }
+
+    QVERIFY( parser.hasError() );
+    QCOMPARE( parser.errorCode(), 431 );
+}
+
+QTEST_APPLESS_MAIN(TestHttpRequestParser)
+
+#include "tst_httprequestparser.moc"
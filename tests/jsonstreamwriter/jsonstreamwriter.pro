@@ -0,0 +1,12 @@
+include(../tests.pri)
+
+TARGET = tst_jsonstreamwriter
+
+QT += concurrent
+
+SOURCES += tst_jsonstreamwriter.cpp \
+    ../../src/jsonstreamwriter.cpp \
+    ../../src/actionhandler_webserver_stream.cpp
+
+HEADERS += ../../src/jsonstreamwriter.h \
+    ../../src/actionhandler_webserver_stream.h
@@ -0,0 +1,354 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtTest>
+#include <QtConcurrent>
+#include <QJsonDocument>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QElapsedTimer>
+
+#include "jsonstreamwriter.h"
+#include "actionhandler_webserver_stream.h"
+
+// Same as ActionHandler_WebServer_Stream uses
+static const int STREAM_CHUNK_SIZE = 16384;
+static const int STREAM_MAX_UNSENT = STREAM_CHUNK_SIZE * 4;
+
+// Rows written by the handler so far
+static QAtomicInt handlerRows;
+
+
+// Writes the search result the same way ActionHandler_WebServer_Socket::writeSong does,
+// with a short pause now and then like a database query would have
+static void writeRow( JsonStreamWriter& json, int i )
+{
+    json.beginObject();
+    json.member( "id", i );
+    json.member( "artist", QString( "Artist %1 \"quoted\"" ).arg( i % 50 ) );
+    json.member( "title", QString( "Song title number %1 with some length to it" ).arg( i ) );
+    json.member( "type", i % 3 ? "cdg" : "mp3" );
+    json.member( "rating", i % 5 );
+    json.member( "language", "English" );
+    json.endObject();
+}
+
+static void searchHandler( QJsonObject request, ActionHandler_WebServer_Stream * stream )
+{
+    int rows = request["rows"].toInt();
+    int pause = request["pause"].toInt();
+
+    stream->json().beginArray();
+
+    for ( int i = 0; i < rows; i++ )
+    {
+        writeRow( stream->json(), i );
+        handlerRows.fetchAndAddRelaxed( 1 );
+
+        if ( pause > 0 && i % 100 == 99 )
+            QThread::msleep( pause );
+
+        if ( !stream->rowWritten() )
+            return;
+    }
+
+    stream->json().endArray();
+}
+
+
+class TestJsonStreamWriter : public QObject
+{
+    Q_OBJECT
+
+    public slots:
+        // The connection side of the stream
+        void    streamData( QByteArray data );
+        void    streamFinished( QByteArray data );
+        void    streamAborted();
+
+    private slots:
+        void    init();
+        void    escaping_data();
+        void    escaping();
+        void    structure();
+        void    takeDataInParts();
+        void    streamedInChunks();
+        void    notStreamed();
+        void    slowClientBlocksHandler();
+
+    private:
+        // Starts the search handler in a worker thread, as the connection does
+        ActionHandler_WebServer_Stream * startStream( bool streamed, int rows, int pause );
+
+        // Chunks received by the connection side, and whether it acknowledges them as sent
+        QList<QByteArray>   m_chunks;
+        QByteArray          m_last;
+        bool                m_finished;
+        bool                m_aborted;
+        bool                m_ackChunks;
+        ActionHandler_WebServer_Stream *    m_stream;
+        QElapsedTimer       m_timer;
+        qint64              m_firstChunkTime;
+};
+
+void TestJsonStreamWriter::init()
+{
+    m_ackChunks = true;
+    m_stream = 0;
+}
+
+void TestJsonStreamWriter::streamData( QByteArray data )
+{
+    if ( m_chunks.isEmpty() )
+        m_firstChunkTime = m_timer.elapsed();
+
+    m_chunks.push_back( data );
+
+    if ( m_ackChunks )
+        m_stream->dataSent( data.size() );
+}
+
+void TestJsonStreamWriter::streamFinished( QByteArray data )
+{
+    m_last = data;
+    m_finished = true;
+}
+
+void TestJsonStreamWriter::streamAborted()
+{
+    m_aborted = true;
+}
+
+ActionHandler_WebServer_Stream * TestJsonStreamWriter::startStream( bool streamed, int rows, int pause )
+{
+    m_chunks.clear();
+    m_last.clear();
+    m_finished = false;
+    m_aborted = false;
+    m_firstChunkTime = -1;
+    handlerRows.store( 0 );
+
+    m_stream = new ActionHandler_WebServer_Stream( streamed );
+
+    connect( m_stream, SIGNAL(dataReady(QByteArray)), this, SLOT(streamData(QByteArray)) );
+    connect( m_stream, SIGNAL(finished(QByteArray)), this, SLOT(streamFinished(QByteArray)) );
+    connect( m_stream, SIGNAL(aborted()), this, SLOT(streamAborted()) );
+
+    QJsonObject request;
+    request["rows"] = rows;
+    request["pause"] = pause;
+
+    m_timer.start();
+    QtConcurrent::run( ActionHandler_WebServer_Stream::run, searchHandler, request, m_stream );
+
+    return m_stream;
+}
+
+void TestJsonStreamWriter::escaping_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<QByteArray>("json");
+
+    QTest::newRow("plain") << QString( "Yesterday" ) << QByteArray( "\"Yesterday\"" );
+    QTest::newRow("empty") << QString() << QByteArray( "\"\"" );
+    QTest::newRow("quotes") << QString( "Say \"hello\"" ) << QByteArray( "\"Say \\\"hello\\\"\"" );
+    QTest::newRow("backslash") << QString( "AC\\DC" ) << QByteArray( "\"AC\\\\DC\"" );
+    QTest::newRow("slash") << QString( "</script>" ) << QByteArray( "\"</script>\"" );
+    QTest::newRow("line breaks") << QString( "a\nb\rc\td" ) << QByteArray( "\"a\\nb\\rc\\td\"" );
+    QTest::newRow("control") << QString( QChar( 1 ) ) + QChar( 0x1F ) << QByteArray( "\"\\u0001\\u001f\"" );
+    QTest::newRow("nul") << QString( QChar( 0 ) ) << QByteArray( "\"\\u0000\"" );
+    QTest::newRow("cyrillic") << QString::fromUtf8( "Кино" ) << QByteArray( "\"Кино\"" );
+    QTest::newRow("cjk") << QString::fromUtf8( "歌" ) << QByteArray( "\"歌\"" );
+    QTest::newRow("surrogate pair") << QString::fromUtf8( "\xF0\x9F\x8E\xA4" ) << QByteArray( "\"\xF0\x9F\x8E\xA4\"" );
+}
+
+void TestJsonStreamWriter::escaping()
+{
+    QFETCH( QString, text );
+    QFETCH( QByteArray, json );
+
+    JsonStreamWriter writer;
+    writer.beginArray();
+    writer.value( text );
+    writer.endArray();
+
+    QByteArray data = writer.takeData();
+    QCOMPARE( data, "[" + json + "]" );
+
+    // And any JSON parser reads it back
+    QJsonParseError error;
+    QJsonDocument doc = QJsonDocument::fromJson( data, &error );
+
+    QCOMPARE( error.error, QJsonParseError::NoError );
+    QCOMPARE( doc.array().at( 0 ).toString(), text );
+}
+
+void TestJsonStreamWriter::structure()
+{
+    JsonStreamWriter writer;
+
+    writer.beginObject();
+    writer.member( "name", "value" );
+    writer.member( "count", -42 );
+    writer.name( "flag" );
+    writer.value( true );
+    writer.name( "off" );
+    writer.value( false );
+    writer.name( "empty" );
+    writer.beginArray();
+    writer.endArray();
+    writer.name( "emptyobj" );
+    writer.beginObject();
+    writer.endObject();
+    writer.name( "nested" );
+    writer.beginArray();
+    writer.value( 1 );
+    writer.beginArray();
+    writer.value( "x" );
+    writer.endArray();
+    writer.beginObject();
+    writer.member( "a", 2 );
+    writer.endObject();
+    writer.endArray();
+    writer.endObject();
+
+    QCOMPARE( writer.takeData(),
+              QByteArray( "{\"name\":\"value\",\"count\":-42,\"flag\":true,\"off\":false,\"empty\":[],\"emptyobj\":{},"
+                          "\"nested\":[1,[\"x\"],{\"a\":2}]}" ) );
+
+    // Nothing left after taking
+    QCOMPARE( writer.size(), 0 );
+    QVERIFY( writer.takeData().isEmpty() );
+}
+
+void TestJsonStreamWriter::takeDataInParts()
+{
+    // Taking the data out at any point doesn't change what is written
+    JsonStreamWriter whole, parts;
+    QByteArray joined;
+
+    whole.beginArray();
+    parts.beginArray();
+
+    for ( int i = 0; i < 1000; i++ )
+    {
+        writeRow( whole, i );
+        writeRow( parts, i );
+
+        if ( i % 7 == 0 )
+            joined += parts.takeData();
+    }
+
+    whole.endArray();
+    parts.endArray();
+    joined += parts.takeData();
+
+    QCOMPARE( joined, whole.takeData() );
+
+    QJsonParseError error;
+    QJsonArray rows = QJsonDocument::fromJson( joined, &error ).array();
+
+    QCOMPARE( error.error, QJsonParseError::NoError );
+    QCOMPARE( rows.size(), 1000 );
+    QCOMPARE( rows[999].toObject()["id"].toInt(), 999 );
+    QCOMPARE( rows[3].toObject()["artist"].toString(), QString( "Artist 3 \"quoted\"" ) );
+}
+
+void TestJsonStreamWriter::streamedInChunks()
+{
+    // 1000 rows with the handler taking ~10ms per 100 rows, like a database search
+    startStream( true, 1000, 10 );
+
+    QTRY_VERIFY_WITH_TIMEOUT( m_finished || m_aborted, 10000 );
+    qint64 total = m_timer.elapsed();
+
+    QVERIFY( m_finished );
+    QVERIFY( m_chunks.size() > 1 );
+
+    QByteArray all;
+    int largest = 0;
+
+    Q_FOREACH( const QByteArray& chunk, m_chunks )
+    {
+        // Each chunk is passed once it reaches the chunk size, so it's only over by the last row
+        QVERIFY( chunk.size() >= STREAM_CHUNK_SIZE );
+        QVERIFY( chunk.size() < STREAM_CHUNK_SIZE + 512 );
+
+        largest = qMax( largest, chunk.size() );
+        all += chunk;
+    }
+
+    all += m_last;
+
+    QJsonParseError error;
+    QJsonArray rows = QJsonDocument::fromJson( all, &error ).array();
+
+    QCOMPARE( error.error, QJsonParseError::NoError );
+    QCOMPARE( rows.size(), 1000 );
+
+    for ( int i = 0; i < rows.size(); i++ )
+        QCOMPARE( rows[i].toObject()["id"].toInt(), i );
+
+    qDebug( "1000 rows, %d bytes: first chunk after %lld ms, complete after %lld ms, %d chunks, largest %d bytes",
+            all.size(), (long long) m_firstChunkTime, (long long) total, m_chunks.size(), largest );
+
+    // The client gets the first part well before the whole response is ready
+    QVERIFY( m_firstChunkTime >= 0 );
+    QVERIFY( m_firstChunkTime < total );
+}
+
+void TestJsonStreamWriter::notStreamed()
+{
+    // HTTP/1.0 clients get the whole response at once
+    startStream( false, 1000, 0 );
+
+    QTRY_VERIFY_WITH_TIMEOUT( m_finished || m_aborted, 10000 );
+
+    QVERIFY( m_finished );
+    QVERIFY( m_chunks.isEmpty() );
+    QCOMPARE( QJsonDocument::fromJson( m_last ).array().size(), 1000 );
+}
+
+void TestJsonStreamWriter::slowClientBlocksHandler()
+{
+    // The client doesn't read anything, so nothing is acknowledged as sent
+    m_ackChunks = false;
+    startStream( true, 100000, 0 );
+
+    // The handler stops once the unsent data is over the limit, which is a few chunks
+    QTRY_VERIFY( m_chunks.size() * STREAM_CHUNK_SIZE > STREAM_MAX_UNSENT );
+    QTest::qWait( 200 );
+
+    int rows = handlerRows.load();
+    int chunks = m_chunks.size();
+
+    QVERIFY( chunks <= STREAM_MAX_UNSENT / STREAM_CHUNK_SIZE + 1 );
+    QVERIFY( rows < 100000 );
+    QVERIFY( !m_finished && !m_aborted );
+
+    // The connection is closed; the handler stops at once
+    m_stream->cancel();
+
+    QTRY_VERIFY( m_aborted );
+    QVERIFY( !m_finished );
+    QVERIFY( handlerRows.load() <= rows + 1 );
+}
+
+QTEST_GUILESS_MAIN(TestJsonStreamWriter)
+
+#include "tst_jsonstreamwriter.moc"
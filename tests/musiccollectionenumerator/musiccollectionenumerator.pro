@@ -0,0 +1,19 @@
+include(../tests.pri)
+
+TARGET = tst_musiccollectionenumerator
+
+# The settings header needs the GUI module, and the logger the widgets
+QT += gui widgets concurrent
+
+SOURCES += tst_musiccollectionenumerator.cpp \
+    ../../src/musiccollectionenumerator.cpp \
+    ../../src/settings.cpp \
+    ../../src/util.cpp \
+    ../../src/logger.cpp
+
+HEADERS += ../../src/musiccollectionenumerator.h
+
+INCLUDEPATH += $$PWD/../.. $$PWD/../../extralibs/include
+
+CONFIG += link_pkgconfig
+PKGCONFIG += uchardet
@@ -0,0 +1,317 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtTest>
+#include <QDir>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+
+#if defined (Q_OS_UNIX)
+    #include <utime.h>
+#endif
+
+#include "musiccollectionenumerator.h"
+#include "settings.h"
+#include "logger.h"
+#include "util.h"
+
+Settings * pSettings;
+
+
+class TestMusicCollectionEnumerator : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void    initTestCase();
+        void    cleanupTestCase();
+        void    init();
+        void    sameOrderAsEnumerateDirectory();
+        void    multipleDirectories();
+        void    unchangedDirectoryFromCache();
+        void    changedExtensionsIgnoreCache();
+        void    corruptedCache();
+        void    startupTiming();
+
+    private:
+        // Creates a small collection with subdirectories and files which are not music
+        static bool createCollection( const QString& root );
+
+        // Creates an empty file
+        static bool createFile( const QString& path );
+
+        // Sets the directory modification time, which is what the cache is validated with
+        static bool setModified( const QString& path, uint time );
+
+        static QString cacheFile();
+
+        QTemporaryDir   m_tempDir;
+        QStringList     m_extensions;
+        QString         m_first;
+        QString         m_second;
+};
+
+
+bool TestMusicCollectionEnumerator::createCollection( const QString &root )
+{
+    const char * files[] = { "a.mp3", "b.OGG", "notes.txt", "sub1/c.flac", "sub1/cover.jpg", "sub1/deeper/d.wav",
+                             "sub1/deeper/e.mp3", "sub2/f.mp3", "sub2/g.wma", "sub3/empty.txt", 0 };
+
+    for ( int i = 0; files[i]; i++ )
+    {
+        QString path = root + "/" + files[i];
+
+        if ( !QDir().mkpath( QFileInfo( path ).path() ) || !createFile( path ) )
+            return false;
+    }
+
+    return true;
+}
+
+bool TestMusicCollectionEnumerator::createFile( const QString &path )
+{
+    QFile f( path );
+    return f.open( QIODevice::WriteOnly );
+}
+
+bool TestMusicCollectionEnumerator::setModified( const QString &path, uint time )
+{
+#if defined (Q_OS_UNIX)
+    struct utimbuf times;
+    times.actime = time;
+    times.modtime = time;
+
+    return utime( QFile::encodeName( path ).constData(), &times ) == 0;
+#else
+    Q_UNUSED( path );
+    Q_UNUSED( time );
+    return false;
+#endif
+}
+
+QString TestMusicCollectionEnumerator::cacheFile()
+{
+    return pSettings->cacheDir + Util::separator() + "musiccollection.cache";
+}
+
+void TestMusicCollectionEnumerator::initTestCase()
+{
+    QVERIFY( m_tempDir.isValid() );
+
+    // Do not touch the player configuration
+    QStandardPaths::setTestMode( true );
+
+    Logger::init();
+    pSettings = new Settings();
+    pSettings->cacheDir = m_tempDir.path() + "/cache";
+
+    // Same as the music collection manager uses
+    m_extensions << "mp3" << "ogg" << "flac" << "wav" << "wma";
+
+    m_first = m_tempDir.path() + "/first";
+    m_second = m_tempDir.path() + "/second";
+
+    QVERIFY( createCollection( m_first ) );
+    QVERIFY( createCollection( m_second ) );
+}
+
+void TestMusicCollectionEnumerator::cleanupTestCase()
+{
+    delete pSettings;
+    pSettings = 0;
+}
+
+void TestMusicCollectionEnumerator::init()
+{
+    // Each test starts without the cache
+    QFile::remove( cacheFile() );
+}
+
+void TestMusicCollectionEnumerator::sameOrderAsEnumerateDirectory()
+{
+    // The music is played in this order, so it must not change from what the player used before
+    QStringList expected;
+    Util::enumerateDirectory( m_first, m_extensions, expected );
+
+    QCOMPARE( expected.size(), 7 );
+    QCOMPARE( MusicCollectionEnumerator::enumerate( QStringList() << m_first, m_extensions ), expected );
+
+    // The same from the cache
+    QVERIFY( QFile::exists( cacheFile() ) );
+    QCOMPARE( MusicCollectionEnumerator::enumerate( QStringList() << m_first, m_extensions ), expected );
+}
+
+void TestMusicCollectionEnumerator::multipleDirectories()
+{
+    QString single = m_tempDir.path() + "/single.mp3";
+    QVERIFY( createFile( single ) );
+
+    QStringList first, second;
+    Util::enumerateDirectory( m_first, m_extensions, first );
+    Util::enumerateDirectory( m_second, m_extensions, second );
+
+    // The directories are enumerated in parallel, but the files are in the order of the directories.
+    // A file might be used instead of a directory, and the missing ones are skipped.
+    QStringList directories;
+    directories << m_second << m_tempDir.path() + "/missing" << single << m_first;
+
+    QStringList expected = second;
+    expected << QFileInfo( single ).absoluteFilePath();
+    expected += first;
+
+    QCOMPARE( MusicCollectionEnumerator::enumerate( directories, m_extensions ), expected );
+    QCOMPARE( MusicCollectionEnumerator::enumerate( directories, m_extensions ), expected );
+}
+
+void TestMusicCollectionEnumerator::unchangedDirectoryFromCache()
+{
+#if !defined (Q_OS_UNIX)
+    QSKIP( "Needs utime() to keep the directory modification time" );
+#endif
+
+    QString root = m_tempDir.path() + "/cached";
+    QVERIFY( createCollection( root ) );
+
+    // The file is added without changing the directory time, which is only possible if done on purpose.
+    // So if the new file is not found, the directory was not listed again.
+    uint modified = QDateTime::currentDateTime().toTime_t() - 1000;
+    QVERIFY( setModified( root + "/sub1", modified ) );
+
+    QStringList before = MusicCollectionEnumerator::enumerate( QStringList() << root, m_extensions );
+    QCOMPARE( before.size(), 7 );
+
+    QVERIFY( createFile( root + "/sub1/added.mp3" ) );
+    QVERIFY( setModified( root + "/sub1", modified ) );
+
+    QCOMPARE( MusicCollectionEnumerator::enumerate( QStringList() << root, m_extensions ), before );
+
+    // Once the directory time changes, it is listed again, and the file is where a full enumeration has it
+    QVERIFY( setModified( root + "/sub1", modified + 10 ) );
+
+    QStringList expected;
+    Util::enumerateDirectory( root, m_extensions, expected );
+
+    QCOMPARE( expected.size(), 8 );
+    QCOMPARE( MusicCollectionEnumerator::enumerate( QStringList() << root, m_extensions ), expected );
+}
+
+void TestMusicCollectionEnumerator::changedExtensionsIgnoreCache()
+{
+#if !defined (Q_OS_UNIX)
+    QSKIP( "Needs utime() to keep the directory modification time" );
+#endif
+
+    QString root = m_tempDir.path() + "/extensions";
+    QVERIFY( createCollection( root ) );
+
+    uint modified = QDateTime::currentDateTime().toTime_t() - 1000;
+    QVERIFY( setModified( root, modified ) );
+
+    QStringList mp3 = MusicCollectionEnumerator::enumerate( QStringList() << root, QStringList() << "mp3" );
+    QCOMPARE( mp3.size(), 3 );
+
+    // The cached directories only have the files with the extensions they were listed with
+    QVERIFY( createFile( root + "/added.mp3" ) );
+    QVERIFY( setModified( root, modified ) );
+
+    QStringList expected;
+    Util::enumerateDirectory( root, m_extensions, expected );
+
+    QCOMPARE( MusicCollectionEnumerator::enumerate( QStringList() << root, m_extensions ), expected );
+    QVERIFY( expected.contains( QFileInfo( root + "/added.mp3" ).absoluteFilePath() ) );
+}
+
+void TestMusicCollectionEnumerator::corruptedCache()
+{
+    QStringList expected;
+    Util::enumerateDirectory( m_first, m_extensions, expected );
+
+    // Not a cache at all
+    QVERIFY( QDir().mkpath( pSettings->cacheDir ) );
+
+    {
+        QFile cache( cacheFile() );
+        QVERIFY( cache.open( QIODevice::WriteOnly ) );
+        cache.write( "not a cache" );
+    }
+
+    QCOMPARE( MusicCollectionEnumerator::enumerate( QStringList() << m_first, m_extensions ), expected );
+
+    // A cache cut in the middle of the entries
+    {
+        QFile cache( cacheFile() );
+        QVERIFY( cache.open( QIODevice::ReadWrite ) );
+        QVERIFY( cache.size() > 100 );
+        QVERIFY( cache.resize( cache.size() / 2 ) );
+    }
+
+    QCOMPARE( MusicCollectionEnumerator::enumerate( QStringList() << m_first, m_extensions ), expected );
+
+    // And it is written again correctly
+    QCOMPARE( MusicCollectionEnumerator::enumerate( QStringList() << m_first, m_extensions ), expected );
+}
+
+void TestMusicCollectionEnumerator::startupTiming()
+{
+    // 10000 songs in 100 album directories of 10 artists, with a lyrics file for each song
+    const int artists = 10, albums = 10, songs = 100;
+    QString root = m_tempDir.path() + "/large";
+
+    for ( int artist = 0; artist < artists; artist++ )
+    {
+        for ( int album = 0; album < albums; album++ )
+        {
+            QString path = QString( "%1/Artist %2/Album %3" ).arg( root ).arg( artist ).arg( album );
+            QVERIFY( QDir().mkpath( path ) );
+
+            for ( int song = 0; song < songs; song++ )
+            {
+                QVERIFY( createFile( QString( "%1/%2 - Song.mp3" ).arg( path ).arg( song ) ) );
+                QVERIFY( createFile( QString( "%1/%2 - Song.lrc" ).arg( path ).arg( song ) ) );
+            }
+        }
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QStringList expected;
+    Util::enumerateDirectory( root, m_extensions, expected );
+    qint64 serial = timer.elapsed();
+
+    timer.restart();
+    QStringList listed = MusicCollectionEnumerator::enumerate( QStringList() << root, m_extensions );
+    qint64 uncached = timer.elapsed();
+
+    timer.restart();
+    QStringList cached = MusicCollectionEnumerator::enumerate( QStringList() << root, m_extensions );
+    qint64 fromCache = timer.elapsed();
+
+    qDebug( "%d music files: Util::enumerateDirectory %lld ms, without the cache %lld ms, with the cache %lld ms",
+            expected.size(), (long long) serial, (long long) uncached, (long long) fromCache );
+
+    QCOMPARE( expected.size(), artists * albums * songs );
+    QCOMPARE( listed, expected );
+    QCOMPARE( cached, expected );
+}
+
+QTEST_GUILESS_MAIN(TestMusicCollectionEnumerator)
+
+#include "tst_musiccollectionenumerator.moc"
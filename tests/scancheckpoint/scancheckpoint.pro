@@ -0,0 +1,8 @@
+include(../tests.pri)
+
+TARGET = tst_scancheckpoint
+
+SOURCES += tst_scancheckpoint.cpp \
+    ../../src/scancheckpoint.cpp
+
+HEADERS += ../../src/scancheckpoint.h
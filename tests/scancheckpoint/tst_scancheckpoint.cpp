@@ -0,0 +1,187 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtTest>
+#include <QFile>
+#include <QSaveFile>
+#include <QTemporaryDir>
+
+#include "scancheckpoint.h"
+
+class TestScanCheckpoint : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void    initTestCase();
+        void    roundTrip();
+        void    missingFile();
+        void    rejectsTruncated();
+        void    interruptedWriteKeepsPrevious();
+
+    private:
+        QString checkpointFile() const { return m_tempDir.path() + "/scan.checkpoint"; }
+
+        QTemporaryDir   m_tempDir;
+};
+
+
+void TestScanCheckpoint::initTestCase()
+{
+    QVERIFY( m_tempDir.isValid() );
+}
+
+void TestScanCheckpoint::roundTrip()
+{
+    ScanCheckpoint checkpoint;
+    checkpoint.collections[ 1 ] = QByteArray( "first\0collection", 16 );
+    checkpoint.collections[ 5 ] = "second";
+    checkpoint.completedCollections << 5;
+    checkpoint.collectionId = 1;
+    checkpoint.frontier << "/music/A" << QString::fromUtf8( "/music/Кино" );
+
+    SongDatabaseScanner::SongDatabaseEntry entry;
+    entry.colidx = 1;
+    entry.artist = "ABBA";
+    entry.title = "Waterloo";
+    entry.filePath = "/music/A/Waterloo.cdg";
+    entry.musicPath = "/music/A/Waterloo.mp3";
+    entry.type = "CDG";
+    entry.language = "English";
+    entry.flags = 3;
+    checkpoint.pendingEntries.insert( entry.filePath, entry );
+
+    // Not processed yet, so only the path is known
+    SongDatabaseScanner::SongDatabaseEntry unprocessed;
+    unprocessed.colidx = 1;
+    unprocessed.filePath = "/music/A/Mamma Mia.kfn";
+    unprocessed.flags = 0;
+    checkpoint.pendingEntries.insert( unprocessed.filePath, unprocessed );
+
+    // Index state of the collection 5, which is only stored when the scan completes
+    SongDatabaseScanner::IndexState state;
+    state.version = 42;
+    state.etag = "\"5f3a-1c\"";
+    state.lastModified = "Sat, 17 Oct 2026 10:00:00 GMT";
+    checkpoint.indexStates[ 5 ] = state;
+    checkpoint.indexRemovedPaths << "http://music/B/Removed.kfn" << QString::fromUtf8( "http://music/B/Группа.kfn" );
+
+    QString errmsg;
+    QVERIFY2( checkpoint.save( checkpointFile(), errmsg ), qPrintable( errmsg ) );
+
+    ScanCheckpoint loaded;
+    QVERIFY2( loaded.load( checkpointFile(), errmsg ), qPrintable( errmsg ) );
+
+    QCOMPARE( loaded.collections, checkpoint.collections );
+    QCOMPARE( loaded.completedCollections, checkpoint.completedCollections );
+    QCOMPARE( loaded.collectionId, 1 );
+    QCOMPARE( loaded.frontier, checkpoint.frontier );
+    QCOMPARE( loaded.pendingEntries.size(), 2 );
+
+    SongDatabaseScanner::SongDatabaseEntry e = loaded.pendingEntries.value( entry.filePath );
+    QCOMPARE( e.colidx, 1 );
+    QCOMPARE( e.artist, entry.artist );
+    QCOMPARE( e.title, entry.title );
+    QCOMPARE( e.musicPath, entry.musicPath );
+    QCOMPARE( e.type, entry.type );
+    QCOMPARE( e.language, entry.language );
+    QCOMPARE( e.flags, 3 );
+
+    QVERIFY( loaded.pendingEntries.value( unprocessed.filePath ).type.isEmpty() );
+
+    QCOMPARE( loaded.indexStates.size(), 1 );
+    QCOMPARE( loaded.indexStates[ 5 ].version, (quint32) 42 );
+    QCOMPARE( loaded.indexStates[ 5 ].etag, state.etag );
+    QCOMPARE( loaded.indexStates[ 5 ].lastModified, state.lastModified );
+    QCOMPARE( loaded.indexRemovedPaths, checkpoint.indexRemovedPaths );
+}
+
+void TestScanCheckpoint::missingFile()
+{
+    ScanCheckpoint checkpoint;
+    QString errmsg;
+
+    // No checkpoint is not an error
+    QVERIFY( !checkpoint.load( m_tempDir.path() + "/nonexisting", errmsg ) );
+    QVERIFY( errmsg.isEmpty() );
+}
+
+void TestScanCheckpoint::rejectsTruncated()
+{
+    ScanCheckpoint checkpoint;
+    checkpoint.collections[ 1 ] = "settings";
+    checkpoint.collectionId = 1;
+    checkpoint.frontier << "/music/A" << "/music/B";
+
+    SongDatabaseScanner::SongDatabaseEntry entry;
+    entry.colidx = 1;
+    entry.filePath = "/music/A/song.kfn";
+    entry.flags = 0;
+    checkpoint.pendingEntries.insert( entry.filePath, entry );
+
+    SongDatabaseScanner::IndexState state;
+    state.version = 3;
+    checkpoint.indexStates[ 2 ] = state;
+    checkpoint.indexRemovedPaths << "/index/removed.kfn";
+
+    QString errmsg;
+    QVERIFY2( checkpoint.save( checkpointFile(), errmsg ), qPrintable( errmsg ) );
+
+    QFile f( checkpointFile() );
+    QVERIFY( f.open( QIODevice::ReadOnly ) );
+    QByteArray data = f.readAll();
+    f.close();
+
+    for ( int size = 0; size < data.size(); size++ )
+    {
+        QFile out( checkpointFile() );
+        QVERIFY( out.open( QIODevice::WriteOnly | QIODevice::Truncate ) );
+        out.write( data.left( size ) );
+        out.close();
+
+        ScanCheckpoint loaded;
+
+        if ( loaded.load( checkpointFile(), errmsg ) )
+            QFAIL( qPrintable( QString( "checkpoint truncated to %1 bytes was accepted" ).arg( size ) ) );
+    }
+}
+
+void TestScanCheckpoint::interruptedWriteKeepsPrevious()
+{
+    ScanCheckpoint checkpoint;
+    checkpoint.collections[ 1 ] = "settings";
+    checkpoint.frontier << "/music/A";
+
+    QString errmsg;
+    QVERIFY2( checkpoint.save( checkpointFile(), errmsg ), qPrintable( errmsg ) );
+
+    // The process is killed while the next checkpoint is being written (it is never committed)
+    {
+        QSaveFile fout( checkpointFile() );
+        QVERIFY( fout.open( QIODevice::WriteOnly ) );
+        fout.write( "SCANCHECKPOINT partially written" );
+    }
+
+    ScanCheckpoint loaded;
+    QVERIFY2( loaded.load( checkpointFile(), errmsg ), qPrintable( errmsg ) );
+    QCOMPARE( loaded.frontier, checkpoint.frontier );
+}
+
+QTEST_APPLESS_MAIN(TestScanCheckpoint)
+
+#include "tst_scancheckpoint.moc"
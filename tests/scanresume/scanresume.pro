@@ -0,0 +1,53 @@
+include(../tests.pri)
+
+TARGET = tst_scanresume
+
+# Drives the real scanner, so it needs the scanner, the database and the lyrics parsing (which measures
+# the text with the font metrics, hence the GUI module). The plugin manager and the action handler
+# are replaced by the stubs in the test.
+QT += gui widgets network concurrent
+
+SOURCES += tst_scanresume.cpp \
+    ../../src/songdatabasescanner.cpp \
+    ../../src/database.cpp \
+    ../../src/database_songinfo.cpp \
+    ../../src/database_statement.cpp \
+    ../../src/settings.cpp \
+    ../../src/currentstate.cpp \
+    ../../src/eventor.cpp \
+    ../../src/logger.cpp \
+    ../../src/util.cpp \
+    ../../src/karaokeplayable.cpp \
+    ../../src/karaokeplayable_file.cpp \
+    ../../src/karaokeplayable_zip.cpp \
+    ../../src/karaokeplayable_kfn.cpp \
+    ../../src/playerlyrics.cpp \
+    ../../src/playerlyricstext.cpp \
+    ../../src/playerlyrictext_line.cpp \
+    ../../src/karaokepainter.cpp \
+    ../../src/songqueueitem.cpp \
+    ../../src/collectionentry.cpp \
+    ../../src/collectionprovider.cpp \
+    ../../src/collectionproviderfs.cpp \
+    ../../src/collectionproviderhttp.cpp \
+    ../../src/collectionindex.cpp \
+    ../../src/scancheckpoint.cpp \
+    ../../src/languagedetectorcache.cpp \
+    ../../src/songpathpattern.cpp \
+    ../../src/threadwaiter.cpp
+
+HEADERS += ../../src/songdatabasescanner.h \
+    ../../src/database.h \
+    ../../src/eventor.h \
+    ../../src/currentstate.h \
+    ../../src/collectionprovider.h \
+    ../../src/collectionproviderhttp.h
+
+DEFINES += SQLITE_OMIT_LOAD_EXTENSION
+INCLUDEPATH += $$PWD/../.. $$PWD/../../extralibs/include
+
+LIBS += -L$$OUT_PWD/../../libkaraokelyrics/ -lkaraokelyrics
+PRE_TARGETDEPS += $$OUT_PWD/../../libkaraokelyrics/libkaraokelyrics.a
+
+CONFIG += link_pkgconfig
+PKGCONFIG += sqlite3 libzip uchardet
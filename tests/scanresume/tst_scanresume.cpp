@@ -0,0 +1,984 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtTest>
+#include <QDir>
+#include <QFile>
+#include <QAtomicInt>
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QGuiApplication>
+#include <QJsonObject>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <math.h>
+
+#include "songdatabasescanner.h"
+#include "scancheckpoint.h"
+#include "pluginmanager.h"
+#include "actionhandler.h"
+#include "currentstate.h"
+#include "database.h"
+#include "settings.h"
+#include "eventor.h"
+#include "logger.h"
+#include "songqueueitem.h"
+#include "util.h"
+
+#if defined (Q_OS_LINUX)
+    #include <unistd.h>
+    #include <sys/resource.h>
+    #include <sys/syscall.h>
+#endif
+
+// Size of the enumerated collection: artists, albums per artist and songs per album
+static const int COLLECTION_ARTISTS = 20;
+static const int COLLECTION_ALBUMS = 3;
+static const int COLLECTION_SONGS = 10;
+
+// Time spent detecting the language of a single song, so the scan could be stopped in the middle
+static const int DETECTION_DELAY = 2;
+
+// How long a scan is waited for, in milliseconds
+static const int SCAN_TIMEOUT = 60000;
+
+// Frame interval of the simulated renderer in frameTimingWithBusyThreads, in microseconds (60 fps)
+static const int FRAME_INTERVAL = 16667;
+
+// Collection IDs: the first one is scanned through its index, the second one is enumerated
+static const int INDEXED_COLLECTION = 1;
+static const int ENUMERATED_COLLECTION = 2;
+
+
+// Whether the calling thread was lowered by Util::lowerCurrentThreadPriority
+static bool currentThreadLowered()
+{
+#if defined (Q_OS_LINUX)
+    pid_t tid = syscall( SYS_gettid );
+
+    // The idle I/O class is 3, stored above the 13 bits of the priority level
+    return getpriority( PRIO_PROCESS, tid ) == 19 && ( syscall( SYS_ioprio_get, 1, tid ) >> 13 ) == 3;
+#else
+    return QThread::currentThread()->priority() == QThread::LowestPriority;
+#endif
+}
+
+//
+// Replaces the language detection plugin. It takes a while for each song, like the real one,
+// and counts the songs it was called for.
+//
+class StubLanguageDetector : public Interface_LanguageDetector
+{
+    public:
+        QString detectLanguage( const QByteArray& data )
+        {
+            m_calls.fetchAndAddRelaxed( 1 );
+
+            if ( currentThreadLowered() )
+                m_loweredCalls.fetchAndAddRelaxed( 1 );
+
+            QThread::msleep( DETECTION_DELAY );
+
+            return data.contains( "Second" ) ? "English" : "German";
+        }
+
+        QStringList languages()
+        {
+            return QStringList() << "English" << "German";
+        }
+
+        int     calls() const { return m_calls.load(); }
+        int     loweredCalls() const { return m_loweredCalls.load(); }
+        void    reset() { m_calls.store( 0 ); m_loweredCalls.store( 0 ); }
+
+    private:
+        QAtomicInt  m_calls;
+
+        // Calls made from a thread running at the lowered priority
+        QAtomicInt  m_loweredCalls;
+};
+
+static StubLanguageDetector stubLanguageDetector;
+
+//
+// Adds the round trip of a network filesystem to each directory listing
+//
+class SlowListingScanner : public SongDatabaseScanner
+{
+    public:
+        SlowListingScanner( int delay ) : m_delay( delay ) {}
+
+    protected:
+        void    listDirectory( const QString& path, QStringList& directories, QStringList& files )
+        {
+            QThread::msleep( m_delay );
+            SongDatabaseScanner::listDirectory( path, directories, files );
+        }
+
+    private:
+        int     m_delay;
+};
+
+//
+// Keeps a CPU busy, like a scanner thread parsing the lyrics, optionally at the scanner priority
+//
+class BusyThread : public QThread
+{
+    public:
+        BusyThread( bool lowered ) : m_lowered( lowered ) {}
+
+        void stop() { m_stop.store( 1 ); }
+
+    protected:
+        void run()
+        {
+            if ( m_lowered )
+                Util::lowerCurrentThreadPriority();
+
+            volatile double value = 0;
+
+            while ( m_stop.load() == 0 )
+            {
+                for ( int i = 0; i < 100000; i++ )
+                    value += i * 0.5;
+            }
+        }
+
+    private:
+        bool        m_lowered;
+        QAtomicInt  m_stop;
+};
+
+// The plugin manager and the action handler are stubbed out, so the test doesn't need the plugins nor the GUI
+PluginManager * pPluginManager;
+ActionHandler * pActionHandler;
+
+PluginManager::PluginManager( const QString& pluginPath )
+{
+    m_pluginPath = pluginPath;
+}
+
+Interface_LanguageDetector * PluginManager::loadLanguageDetector()
+{
+    return &stubLanguageDetector;
+}
+
+void PluginManager::releaseLanguageDetector()
+{
+}
+
+Interface_LanguageDetectorBatch * PluginManager::languageDetectorBatch()
+{
+    // So the scanner falls back to detecting one song at a time
+    return 0;
+}
+
+Interface_MediaPlayerPlugin * PluginManager::loadPitchChanger()
+{
+    return 0;
+}
+
+// Only called through the null pActionHandler, so it must not use the object
+void ActionHandler::error( QString message )
+{
+    qWarning( "ActionHandler error: %s", qPrintable( message ) );
+}
+
+
+class TestScanResume : public QObject
+{
+    Q_OBJECT
+
+    public slots:
+        void    scanFinished();
+        void    scanStatistics( QJsonObject stats );
+
+    private slots:
+        void    initTestCase();
+        void    cleanupTestCase();
+        void    stopAndResumeMatchesCleanScan_data();
+        void    stopAndResumeMatchesCleanScan();
+        void    boundedQueues_data();
+        void    boundedQueues();
+        void    rescanUsesKnownSongs();
+        void    parallelListing();
+        void    lowPriorityThreads();
+        void    pausesWhilePlaying();
+        void    frameTimingWithBusyThreads();
+
+    private:
+        // Scans the collections into a new database: first the indexed collection alone, then both of them
+        // (when the indexed collection is updated through the index delta). The second scan is stopped after
+        // the language of stopAfter songs is detected and resumed, unless stopAfter is negative.
+        void    scanSequence( int stopAfter, QStringList& songs );
+
+        // Runs a single scan, optionally stopping it the same way
+        void    runScan( int stopAfter );
+
+        // Database contents comparable between the scans
+        QStringList databaseSongs();
+
+        // Starts each test with a new database and scan state in the directory, and only the enumerated collection
+        bool    newEnumeratedDatabase( const QTemporaryDir& dir );
+
+        // Simulates rendering the given number of frames, and returns how late each one was, in microseconds
+        QList<qint64> renderFrames( int frames );
+
+        // Index version stored for the collection in the index state file, or 0 if none
+        quint32 storedIndexVersion( int id );
+
+        CollectionEntry collection( int id, const QString& root ) const;
+
+        QTemporaryDir   m_tempDir;
+        QString         m_indexedRoot;
+        QString         m_enumeratedRoot;
+        QStringList     m_expected;
+        bool            m_finished;
+
+        // Last statistics reported by the scanner
+        QJsonObject     m_stats;
+
+        // Collection of the enumerated songs in m_expected
+        QStringList     m_expectedEnumerated;
+
+        // If non-zero, the scans use SlowListingScanner with this delay (in milliseconds)
+        int             m_listingDelay;
+};
+
+
+void TestScanResume::scanFinished()
+{
+    m_finished = true;
+}
+
+void TestScanResume::scanStatistics( QJsonObject stats )
+{
+    m_stats = stats;
+}
+
+void TestScanResume::initTestCase()
+{
+    QVERIFY( m_tempDir.isValid() );
+    m_listingDelay = 0;
+
+    // Do not touch the player configuration and database
+    QStandardPaths::setTestMode( true );
+
+    Logger::init();
+
+    // Same as the headless scanner creates them
+    pEventor = new Eventor( 0 );
+    pSettings = new Settings();
+    pSettings->playerBackgroundType = Settings::BACKGROUND_TYPE_NONE;
+    pSettings->scannerLowPriority = false;
+    pSettings->scannerPauseWhilePlaying = false;
+    pSettings->scannerDiskOrder = false;
+    pCurrentState = new CurrentState( 0 );
+    pPluginManager = new PluginManager();
+    pDatabase = 0;
+
+    connect( pEventor, SIGNAL(scanCollectionFinished()), this, SLOT(scanFinished()), Qt::QueuedConnection );
+    connect( pEventor, SIGNAL(scanCollectionStatistics(QJsonObject)), this, SLOT(scanStatistics(QJsonObject)), Qt::QueuedConnection );
+
+    // The indexed collection: the full index has the version 1, and the delta changes it to the version 2
+    // removing one song and adding another. The files all exist, so the cleanup never removes them.
+    m_indexedRoot = m_tempDir.path() + "/indexed";
+    QVERIFY( QDir().mkpath( m_indexedRoot ) );
+
+    const char * indexfiles[] = { "a.lrc", "a.mp3", "b.lrc", "b.mp3", "c.lrc", "c.mp3", "d.lrc", "d.mp3", 0 };
+
+    for ( int i = 0; indexfiles[i]; i++ )
+    {
+        QFile f( m_indexedRoot + "/" + indexfiles[i] );
+        QVERIFY( f.open( QIODevice::WriteOnly ) );
+    }
+
+    QFile index( m_indexedRoot + "/index.dat" );
+    QVERIFY( index.open( QIODevice::WriteOnly ) );
+    index.write( "#version 1\n"
+                 "Artist A|Title A|a.lrc|a.mp3|LRC|English\n"
+                 "Artist B|Title B|b.lrc|b.mp3|LRC|English\n"
+                 "Artist C|Title C|c.lrc|c.mp3|LRC|German\n" );
+    index.close();
+
+    QFile delta( m_indexedRoot + "/index.delta" );
+    QVERIFY( delta.open( QIODevice::WriteOnly ) );
+    delta.write( "#delta 1 2\n"
+                 "-c.lrc|c.mp3\n"
+                 "+Artist D|Title D|d.lrc|d.mp3|LRC|German\n" );
+    delta.close();
+
+    // The enumerated collection: LRC lyrics with the music, each with different text so the language is
+    // detected for each of them
+    m_enumeratedRoot = m_tempDir.path() + "/enumerated";
+
+    for ( int artist = 0; artist < COLLECTION_ARTISTS; artist++ )
+    {
+        for ( int album = 0; album < COLLECTION_ALBUMS; album++ )
+        {
+            QString path = QString( "%1/Artist %2/Album %3" ).arg( m_enumeratedRoot ).arg( artist ).arg( album );
+            QVERIFY( QDir().mkpath( path ) );
+
+            for ( int song = 0; song < COLLECTION_SONGS; song++ )
+            {
+                QString name = QString( "%1/Artist %2 - Song %3-%4" ).arg( path ).arg( artist ).arg( album ).arg( song );
+
+                QFile lyrics( name + ".lrc" );
+                QVERIFY( lyrics.open( QIODevice::WriteOnly ) );
+                lyrics.write( QString( "[00:01.00]First line of the song %1 %2 %3\n[00:03.00]%4 line\n" )
+                              .arg( artist ).arg( album ).arg( song ).arg( song % 2 ? "Second" : "Last" ).toUtf8() );
+                lyrics.close();
+
+                QFile music( name + ".mp3" );
+                QVERIFY( music.open( QIODevice::WriteOnly ) );
+            }
+        }
+    }
+
+    // The reference scan, never stopped
+    scanSequence( -1, m_expected );
+
+    if ( QTest::currentTestFailed() )
+        return;
+
+    // Songs of both collections, without the one the delta removed
+    QCOMPARE( m_expected.size(), COLLECTION_ARTISTS * COLLECTION_ALBUMS * COLLECTION_SONGS + 3 );
+
+    Q_FOREACH( const QString& song, m_expected )
+    {
+        if ( song.startsWith( QString( "%1|" ).arg( ENUMERATED_COLLECTION ) ) )
+            m_expectedEnumerated.push_back( song );
+    }
+}
+
+void TestScanResume::cleanupTestCase()
+{
+    delete pDatabase;
+    pDatabase = 0;
+}
+
+void TestScanResume::stopAndResumeMatchesCleanScan_data()
+{
+    QTest::addColumn<int>( "stopAfter" );
+
+    // The submitter stores the songs in batches of 200, so the later stops have some of them in the database
+    QTest::newRow( "first song" ) << 1;
+    QTest::newRow( "first batch" ) << 150;
+    QTest::newRow( "second batch" ) << 300;
+    QTest::newRow( "near the end" ) << 500;
+}
+
+void TestScanResume::stopAndResumeMatchesCleanScan()
+{
+    QFETCH( int, stopAfter );
+
+    QStringList songs;
+    scanSequence( stopAfter, songs );
+
+    if ( QTest::currentTestFailed() )
+        return;
+
+    QCOMPARE( songs.size(), m_expected.size() );
+    QCOMPARE( songs, m_expected );
+}
+
+void TestScanResume::boundedQueues_data()
+{
+    QTest::addColumn<bool>( "diskOrder" );
+    QTest::addColumn<int>( "limit" );
+
+    QTest::newRow( "one entry" ) << false << 1;
+    QTest::newRow( "few entries" ) << false << 8;
+    QTest::newRow( "disk order" ) << true << 8;
+}
+
+void TestScanResume::boundedQueues()
+{
+    QFETCH( bool, diskOrder );
+    QFETCH( int, limit );
+
+    // The directory walk is much faster than the language detection, so without the limit the walker
+    // would queue the whole collection. Now it must wait for the processing threads instead.
+    pSettings->scannerDiskOrder = diskOrder;
+    pSettings->scannerProcessingQueueLimit = limit;
+    pSettings->scannerSubmittingQueueLimit = 0;
+
+    QStringList songs;
+    scanSequence( -1, songs );
+
+    pSettings->scannerDiskOrder = false;
+    pSettings->scannerProcessingQueueLimit = 5000;
+    pSettings->scannerSubmittingQueueLimit = 2000;
+
+    if ( QTest::currentTestFailed() )
+        return;
+
+    // Nothing is lost while the producers wait
+    QCOMPARE( songs, m_expected );
+
+    QJsonObject queues = m_stats["queues"].toObject();
+    int processingPeak = queues["processingPeak"].toInt();
+    int submittingPeak = queues["submittingPeak"].toInt();
+
+    qDebug( "Processing queue limit %d: largest processing queue %d, largest submitting queue %d",
+            limit, processingPeak, submittingPeak );
+
+    // In the disk order mode the whole directory is queued once the queue is below the limit
+    QVERIFY( processingPeak >= limit );
+    QVERIFY( processingPeak <= ( diskOrder ? limit - 1 + COLLECTION_SONGS : limit ) );
+
+    // The submitting queue limit is never below two database batches (of 200 entries)
+    QVERIFY( submittingPeak > 0 );
+    QVERIFY( submittingPeak <= 400 );
+}
+
+void TestScanResume::rescanUsesKnownSongs()
+{
+    QTemporaryDir dir;
+    QVERIFY( dir.isValid() );
+
+    pSettings->songdbFilename = dir.path() + "/karaoke.db";
+    pSettings->scanCheckpointFilename = dir.path() + "/scan.checkpoint";
+    pSettings->scanIndexStateFilename = dir.path() + "/index.state";
+    pSettings->cacheDir = dir.path();
+
+    delete pDatabase;
+    pDatabase = new Database( 0 );
+    QVERIFY( pDatabase->init() );
+
+    pSettings->collections.clear();
+    pSettings->collections[ ENUMERATED_COLLECTION ] = collection( ENUMERATED_COLLECTION, m_enumeratedRoot );
+
+    runScan( -1 );
+
+    if ( QTest::currentTestFailed() )
+        return;
+
+    const int songs = COLLECTION_ARTISTS * COLLECTION_ALBUMS * COLLECTION_SONGS;
+    QCOMPARE( stubLanguageDetector.calls(), songs );
+
+    // What the scanner did for each file before, and what it does now once per scan
+    QHash<QString, SongDatabaseScanner::KnownSongEntry> known;
+    QElapsedTimer timer;
+    timer.start();
+
+    QVERIFY( pDatabase->knownSongs( known ) );
+    qint64 preloadUsec = timer.nsecsElapsed() / 1000;
+
+    QCOMPARE( known.size(), songs );
+    timer.restart();
+
+    for ( QHash<QString, SongDatabaseScanner::KnownSongEntry>::const_iterator it = known.constBegin(); it != known.constEnd(); ++it )
+    {
+        Database_SongInfo info;
+        QVERIFY( pDatabase->songByPath( it.key(), info ) );
+        QCOMPARE( (qint64) info.id, it->id );
+        QVERIFY( it->complete );
+        QCOMPARE( it->collectionId, ENUMERATED_COLLECTION );
+    }
+
+    qint64 lookupUsec = timer.nsecsElapsed() / 1000;
+
+    qDebug( "%d known songs: one query %lld us, a query per file %lld us", songs, (long long) preloadUsec, (long long) lookupUsec );
+
+    // Change one song after it was stored. The timestamps in the database are in seconds.
+    QTest::qWait( 1100 );
+
+    QString changed = QString( "%1/Artist 3/Album 1/Artist 3 - Song 1-4.lrc" ).arg( m_enumeratedRoot );
+    QString original;
+
+    {
+        QFile lyrics( changed );
+        QVERIFY( lyrics.open( QIODevice::ReadWrite ) );
+        original = QString::fromUtf8( lyrics.readAll() );
+        QVERIFY( lyrics.seek( 0 ) );
+        lyrics.write( "[00:01.00]Changed lyrics for this song\n[00:03.00]Second line\n" );
+        lyrics.resize( lyrics.pos() );
+    }
+
+    // The rescan only processes the changed song; the others are skipped without touching the database
+    runScan( -1 );
+
+    // Restore the collection for the other tests before checking anything
+    {
+        QFile lyrics( changed );
+        QVERIFY( lyrics.open( QIODevice::WriteOnly | QIODevice::Truncate ) );
+        lyrics.write( original.toUtf8() );
+    }
+
+    if ( QTest::currentTestFailed() )
+        return;
+
+    QCOMPARE( stubLanguageDetector.calls(), 1 );
+
+    Database_SongInfo info;
+    QVERIFY( pDatabase->songByPath( changed, info ) );
+    QCOMPARE( info.language, QString( "English" ) );
+
+    delete pDatabase;
+    pDatabase = 0;
+}
+
+void TestScanResume::parallelListing()
+{
+    // 81 directories, each taking 20ms to list. The language detection is off so the listing is what takes time.
+    const int directories = 1 + COLLECTION_ARTISTS + COLLECTION_ARTISTS * COLLECTION_ALBUMS;
+    const int threads[] = { 1, 8 };
+    qint64 elapsed[2];
+    QStringList songs[2];
+
+    m_listingDelay = 20;
+
+    for ( int i = 0; i < 2; i++ )
+    {
+        QTemporaryDir dir;
+        QVERIFY( dir.isValid() );
+
+        pSettings->songdbFilename = dir.path() + "/karaoke.db";
+        pSettings->scanCheckpointFilename = dir.path() + "/scan.checkpoint";
+        pSettings->scanIndexStateFilename = dir.path() + "/index.state";
+        pSettings->cacheDir = dir.path();
+
+        delete pDatabase;
+        pDatabase = new Database( 0 );
+        QVERIFY( pDatabase->init() );
+
+        CollectionEntry col = collection( ENUMERATED_COLLECTION, m_enumeratedRoot );
+        col.scanThreads = threads[i];
+        col.detectLanguage = false;
+
+        pSettings->collections.clear();
+        pSettings->collections[ ENUMERATED_COLLECTION ] = col;
+
+        QElapsedTimer timer;
+        timer.start();
+
+        runScan( -1 );
+        elapsed[i] = timer.elapsed();
+
+        if ( QTest::currentTestFailed() )
+            break;
+
+        QCOMPARE( m_stats["directories"].toInt(), directories );
+        songs[i] = databaseSongs();
+    }
+
+    m_listingDelay = 0;
+    delete pDatabase;
+    pDatabase = 0;
+
+    if ( QTest::currentTestFailed() )
+        return;
+
+    qDebug( "Listing with 20ms latency: %lld ms with 1 thread, %lld ms with 8 threads", (long long) elapsed[0], (long long) elapsed[1] );
+
+    // Same songs either way
+    QCOMPARE( songs[0].size(), COLLECTION_ARTISTS * COLLECTION_ALBUMS * COLLECTION_SONGS );
+    QCOMPARE( songs[1], songs[0] );
+
+    // The serial listing alone takes over 1.6s; with 8 threads the tree depth (3 levels) limits it
+    QVERIFY( elapsed[0] >= directories * 20 );
+    QVERIFY2( elapsed[1] * 2 < elapsed[0], "parallel listing is not faster" );
+}
+
+void TestScanResume::lowPriorityThreads()
+{
+    QTemporaryDir dir;
+    QVERIFY( dir.isValid() );
+    QVERIFY( newEnumeratedDatabase( dir ) );
+
+    // The languages are detected in the processing threads, so the detector sees the priority they run at
+    pSettings->scannerLowPriority = true;
+    runScan( -1 );
+    pSettings->scannerLowPriority = false;
+
+    if ( QTest::currentTestFailed() )
+        return;
+
+    const int songs = COLLECTION_ARTISTS * COLLECTION_ALBUMS * COLLECTION_SONGS;
+    QCOMPARE( stubLanguageDetector.calls(), songs );
+    QCOMPARE( stubLanguageDetector.loweredCalls(), songs );
+
+    // Only the scanner threads are lowered, not the thread which started the scan
+    QVERIFY( !currentThreadLowered() );
+    QCOMPARE( databaseSongs(), m_expectedEnumerated );
+
+    // And the threads of the next scan start at the normal priority. It needs its own directory, as the
+    // language cache would otherwise skip the detection.
+    QTemporaryDir nextDir;
+    QVERIFY( nextDir.isValid() );
+    QVERIFY( newEnumeratedDatabase( nextDir ) );
+    runScan( -1 );
+
+    if ( QTest::currentTestFailed() )
+        return;
+
+    QCOMPARE( stubLanguageDetector.calls(), songs );
+    QCOMPARE( stubLanguageDetector.loweredCalls(), 0 );
+
+    delete pDatabase;
+    pDatabase = 0;
+}
+
+void TestScanResume::pausesWhilePlaying()
+{
+    QTemporaryDir dir;
+    QVERIFY( dir.isValid() );
+    QVERIFY( newEnumeratedDatabase( dir ) );
+
+    const int songs = COLLECTION_ARTISTS * COLLECTION_ALBUMS * COLLECTION_SONGS;
+
+    pSettings->scannerPauseWhilePlaying = true;
+    m_finished = false;
+    m_stats = QJsonObject();
+    stubLanguageDetector.reset();
+
+    SongDatabaseScanner * scanner = new SongDatabaseScanner();
+    bool started = scanner->startScan();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while ( started && stubLanguageDetector.calls() < 50 && timer.elapsed() < SCAN_TIMEOUT )
+        QTest::qWait( 10 );
+
+    // The scanner is connected to the same signals the player emits
+    emit pEventor->karaokeStarted( SongQueueItem() );
+
+    // A processing thread finishes the language detection batch it has started (up to 32 songs) before pausing
+    QTest::qWait( 300 );
+    int pausedCalls = stubLanguageDetector.calls();
+
+    // Nothing is processed while playing; this is also over the interval the statistics are reported at
+    QTest::qWait( 1000 );
+    int stillPausedCalls = stubLanguageDetector.calls();
+    bool reportedPaused = m_stats["paused"].toBool();
+    bool finishedWhilePaused = m_finished;
+
+    emit pEventor->karaokeStopped();
+    timer.restart();
+
+    while ( started && !m_finished && timer.elapsed() < SCAN_TIMEOUT )
+        QTest::qWait( 10 );
+
+    // Always stop the scanner and restore the setting, so the other tests are not affected if this one fails
+    bool finished = m_finished;
+
+    if ( !finished )
+        scanner->stopScan();
+
+    scanner->stopAndDelete();
+    pSettings->scannerPauseWhilePlaying = false;
+
+    QVERIFY( started );
+    QVERIFY( !finishedWhilePaused );
+    QVERIFY( pausedCalls < songs );
+    QCOMPARE( stillPausedCalls, pausedCalls );
+    QVERIFY( reportedPaused );
+
+    QVERIFY2( finished, "the scan did not complete after the playback stopped" );
+    QCOMPARE( stubLanguageDetector.calls(), songs );
+    QVERIFY( !m_stats["paused"].toBool() );
+    QCOMPARE( databaseSongs(), m_expectedEnumerated );
+
+    delete pDatabase;
+    pDatabase = 0;
+}
+
+void TestScanResume::frameTimingWithBusyThreads()
+{
+    // The renderer draws a frame every 16.7ms, and stutters when it is woken up late. Each configuration keeps
+    // twice as many threads busy as there are CPUs, so they compete with the renderer like a parsing scan does.
+    const int frames = 120;
+    const int busyThreads = qMax( 1, QThread::idealThreadCount() ) * 2;
+    const char * names[] = { "idle", "busy threads", "busy threads at scanner priority" };
+    qint64 p99[3];
+
+    for ( int config = 0; config < 3; config++ )
+    {
+        QList<BusyThread*> threads;
+
+        for ( int i = 0; config > 0 && i < busyThreads; i++ )
+        {
+            threads.push_back( new BusyThread( config == 2 ) );
+            threads.last()->start();
+        }
+
+        // Let the scheduler settle
+        QThread::msleep( 200 );
+
+        QList<qint64> lateness = renderFrames( frames );
+
+        Q_FOREACH( BusyThread * thread, threads )
+            thread->stop();
+
+        Q_FOREACH( BusyThread * thread, threads )
+        {
+            thread->wait();
+            delete thread;
+        }
+
+        QCOMPARE( lateness.size(), frames );
+        std::sort( lateness.begin(), lateness.end() );
+
+        qint64 total = 0;
+
+        Q_FOREACH( qint64 late, lateness )
+            total += late;
+
+        // Variance of the frame start, as the frames take the same time to render
+        qint64 mean = total / frames;
+        qint64 variance = 0;
+
+        Q_FOREACH( qint64 late, lateness )
+            variance += ( late - mean ) * ( late - mean );
+
+        p99[config] = lateness[ frames * 99 / 100 ];
+
+        qDebug( "Frames with %s: late by %lld us on average, stddev %.0f us, 99th percentile %lld us, max %lld us",
+                names[config], (long long) mean, sqrt( (double) variance / frames ), (long long) p99[config], (long long) lateness.last() );
+    }
+
+    // Only a measurement; the scheduling on a shared machine is too noisy for the figures to be compared.
+    // The loop must still have been able to render, though.
+    QVERIFY( p99[0] < FRAME_INTERVAL );
+}
+
+QList<qint64> TestScanResume::renderFrames( int frames )
+{
+    QList<qint64> lateness;
+    QElapsedTimer timer;
+    timer.start();
+
+    qint64 next = 0;
+
+    for ( int i = 0; i < frames; i++ )
+    {
+        next += FRAME_INTERVAL;
+        qint64 now = timer.nsecsElapsed() / 1000;
+
+        if ( now < next )
+            QThread::usleep( next - now );
+
+        lateness.push_back( qMax( (qint64) 0, timer.nsecsElapsed() / 1000 - next ) );
+
+        // Rendering the frame takes 2ms of CPU
+        qint64 renderEnd = timer.nsecsElapsed() + 2000000;
+        volatile double value = 0;
+
+        while ( timer.nsecsElapsed() < renderEnd )
+            value += 1;
+    }
+
+    return lateness;
+}
+
+bool TestScanResume::newEnumeratedDatabase( const QTemporaryDir& dir )
+{
+    pSettings->songdbFilename = dir.path() + "/karaoke.db";
+    pSettings->scanCheckpointFilename = dir.path() + "/scan.checkpoint";
+    pSettings->scanIndexStateFilename = dir.path() + "/index.state";
+    pSettings->cacheDir = dir.path();
+
+    delete pDatabase;
+    pDatabase = new Database( 0 );
+
+    if ( !pDatabase->init() )
+        return false;
+
+    pSettings->collections.clear();
+    pSettings->collections[ ENUMERATED_COLLECTION ] = collection( ENUMERATED_COLLECTION, m_enumeratedRoot );
+    return true;
+}
+
+void TestScanResume::scanSequence( int stopAfter, QStringList& songs )
+{
+    // Each sequence starts with its own database, scan state and language cache
+    QTemporaryDir dir;
+    QVERIFY( dir.isValid() );
+
+    pSettings->songdbFilename = dir.path() + "/karaoke.db";
+    pSettings->scanCheckpointFilename = dir.path() + "/scan.checkpoint";
+    pSettings->scanIndexStateFilename = dir.path() + "/index.state";
+    pSettings->cacheDir = dir.path();
+
+    delete pDatabase;
+    pDatabase = new Database( 0 );
+    QVERIFY( pDatabase->init() );
+
+    // The indexed collection alone: the full index is used
+    pSettings->collections.clear();
+    pSettings->collections[ INDEXED_COLLECTION ] = collection( INDEXED_COLLECTION, m_indexedRoot );
+
+    runScan( -1 );
+
+    if ( QTest::currentTestFailed() )
+        return;
+
+    QCOMPARE( storedIndexVersion( INDEXED_COLLECTION ), (quint32) 1 );
+
+    // Now both: the index delta is applied first, and then the other collection is enumerated
+    pSettings->collections[ ENUMERATED_COLLECTION ] = collection( ENUMERATED_COLLECTION, m_enumeratedRoot );
+
+    runScan( stopAfter );
+
+    if ( QTest::currentTestFailed() )
+        return;
+
+    if ( stopAfter >= 0 )
+    {
+        // The checkpoint has everything which wasn't stored yet, including the index delta results
+        // (which are only applied once the scan completes)
+        ScanCheckpoint checkpoint;
+        QString errmsg;
+
+        QVERIFY2( checkpoint.load( pSettings->scanCheckpointFilename, errmsg ), qPrintable( errmsg ) );
+        QVERIFY( checkpoint.completedCollections.contains( INDEXED_COLLECTION ) );
+        QVERIFY( checkpoint.collectionId == ENUMERATED_COLLECTION || !checkpoint.pendingEntries.isEmpty() );
+        QCOMPARE( checkpoint.indexStates.value( INDEXED_COLLECTION ).version, (quint32) 2 );
+        QCOMPARE( checkpoint.indexRemovedPaths, QStringList() << m_indexedRoot + "/c.lrc" );
+        QCOMPARE( storedIndexVersion( INDEXED_COLLECTION ), (quint32) 1 );
+
+        // Resume it with a new scanner, as if the player was restarted
+        runScan( -1 );
+
+        if ( QTest::currentTestFailed() )
+            return;
+    }
+
+    QVERIFY( !QFile::exists( pSettings->scanCheckpointFilename ) );
+    QCOMPARE( storedIndexVersion( INDEXED_COLLECTION ), (quint32) 2 );
+
+    songs = databaseSongs();
+
+    delete pDatabase;
+    pDatabase = 0;
+}
+
+void TestScanResume::runScan( int stopAfter )
+{
+    m_finished = false;
+    stubLanguageDetector.reset();
+
+    SongDatabaseScanner * scanner = m_listingDelay > 0 ? new SlowListingScanner( m_listingDelay ) : new SongDatabaseScanner();
+    QVERIFY( scanner->startScan() );
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while ( !m_finished && ( stopAfter < 0 || stubLanguageDetector.calls() < stopAfter ) && timer.elapsed() < SCAN_TIMEOUT )
+        QTest::qWait( 10 );
+
+    // The scanner is always stopped, so it doesn't keep using the database if the test fails
+    bool finished = m_finished;
+    bool stopped = finished || scanner->stopScan();
+    scanner->stopAndDelete();
+
+    if ( stopAfter < 0 )
+    {
+        QVERIFY2( finished, "the scan did not complete in time" );
+        return;
+    }
+
+    QVERIFY2( stopped, "the scan threads did not stop in time" );
+
+    // If the scan completed before it was stopped, there is nothing to resume, and the test is pointless
+    QVERIFY2( QFile::exists( pSettings->scanCheckpointFilename ), "the scan completed before it was stopped" );
+}
+
+QStringList TestScanResume::databaseSongs()
+{
+    QHash<QString, SongDatabaseScanner::KnownSongEntry> known;
+    QStringList songs;
+
+    if ( !pDatabase->knownSongs( known ) )
+        return songs;
+
+    for ( QHash<QString, SongDatabaseScanner::KnownSongEntry>::const_iterator it = known.constBegin(); it != known.constEnd(); ++it )
+    {
+        Database_SongInfo info;
+
+        if ( !pDatabase->songByPath( it.key(), info ) )
+            continue;
+
+        songs.push_back( QString( "%1|%2|%3|%4|%5|%6" ).arg( info.collectionid ).arg( info.filePath )
+                         .arg( info.artist ).arg( info.title ).arg( info.type ).arg( info.language ) );
+    }
+
+    songs.sort();
+    return songs;
+}
+
+quint32 TestScanResume::storedIndexVersion( int id )
+{
+    // Same format as SongDatabaseScanner::saveIndexState writes
+    QFile fin( pSettings->scanIndexStateFilename );
+
+    if ( !fin.open( QIODevice::ReadOnly ) )
+        return 0;
+
+    QDataStream dts( &fin );
+    QString header;
+    int version, count;
+
+    dts >> header >> version >> count;
+
+    for ( int i = 0; i < count && dts.status() == QDataStream::Ok; i++ )
+    {
+        int colid;
+        QString root, etag, lastModified;
+        quint32 indexVersion;
+
+        dts >> colid >> root >> indexVersion >> etag >> lastModified;
+
+        if ( colid == id && dts.status() == QDataStream::Ok )
+            return indexVersion;
+    }
+
+    return 0;
+}
+
+CollectionEntry TestScanResume::collection( int id, const QString &root ) const
+{
+    CollectionEntry entry;
+    entry.id = id;
+    entry.name = QString( "Collection %1" ).arg( id );
+    entry.type = CollectionProvider::TYPE_FILESYSTEM;
+    entry.rootPath = root;
+    entry.detectLanguage = true;
+    entry.artistTitleSeparator = " - ";
+    entry.scanThreads = 2;
+    return entry;
+}
+
+// The lyrics are measured with the font metrics, which need the GUI application (but not the display)
+int main( int argc, char *argv[] )
+{
+    if ( qgetenv( "QT_QPA_PLATFORM" ).isEmpty() )
+        qputenv( "QT_QPA_PLATFORM", "offscreen" );
+
+    QGuiApplication app( argc, argv );
+    app.setApplicationName( "tst_scanresume" );
+
+    TestScanResume test;
+    return QTest::qExec( &test, argc, argv );
+}
+
+#include "tst_scanresume.moc"
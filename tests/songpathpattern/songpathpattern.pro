@@ -0,0 +1,8 @@
+include(../tests.pri)
+
+TARGET = tst_songpathpattern
+
+SOURCES += tst_songpathpattern.cpp \
+    ../../src/songpathpattern.cpp
+
+HEADERS += ../../src/songpathpattern.h
@@ -0,0 +1,209 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtTest>
+#include <QElapsedTimer>
+
+#include "songpathpattern.h"
+
+// Number of paths matched in the cost test, as in a large collection
+static const int CORPUS_SIZE = 1000000;
+
+// Average cost of matching a path which is still negligible compared to reading the file, in microseconds
+static const int MAX_USEC_PER_PATH = 20;
+
+static const char * PATTERN_ALBUM_TRACK = "{artist}/{skip}/{skip} - {title}";
+static const char * PATTERN_SEPARATOR = "{artist} - {title}";
+
+
+class TestSongPathPattern : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void    extractsArtistAndTitle_data();
+        void    extractsArtistAndTitle();
+        void    rejectsInvalidPatterns_data();
+        void    rejectsInvalidPatterns();
+        void    patternsAreAppliedInOrder();
+        void    corpusCost();
+};
+
+
+void TestSongPathPattern::extractsArtistAndTitle_data()
+{
+    QTest::addColumn<QString>( "pattern" );
+    QTest::addColumn<QString>( "path" );
+    QTest::addColumn<bool>( "matched" );
+    QTest::addColumn<QString>( "artist" );
+    QTest::addColumn<QString>( "title" );
+
+    QTest::newRow( "artist/album/track - title" ) << PATTERN_ALBUM_TRACK << "/music/ABBA/Arrival/03 - Dancing Queen.mp3"
+                                                  << true << "ABBA" << "Dancing Queen";
+    QTest::newRow( "no track number" ) << PATTERN_ALBUM_TRACK << "/music/ABBA/Arrival/Dancing Queen.mp3"
+                                       << false << "" << "";
+    QTest::newRow( "separator in the title" ) << PATTERN_ALBUM_TRACK << "/music/AC-DC/Back in Black/01 - Hells Bells - Live.kfn"
+                                              << true << "AC-DC" << "Hells Bells - Live";
+    QTest::newRow( "windows path" ) << PATTERN_ALBUM_TRACK << "C:\\Karaoke\\Queen\\Greatest Hits\\11 - Bohemian Rhapsody.cdg"
+                                    << true << "Queen" << "Bohemian Rhapsody";
+    QTest::newRow( "dot in the artist" ) << PATTERN_ALBUM_TRACK << "/music/Mr. Big/Lean Into It/10 - To Be With You.zip"
+                                         << true << "Mr. Big" << "To Be With You";
+    QTest::newRow( "dot in the directory, no extension" ) << PATTERN_ALBUM_TRACK << "/music/Kino/Best.Of/01 - Gruppa krovi"
+                                                          << true << "Kino" << "Gruppa krovi";
+    QTest::newRow( "relative path" ) << PATTERN_ALBUM_TRACK << "ABBA/Arrival/03 - Dancing Queen.mp3"
+                                     << true << "ABBA" << "Dancing Queen";
+    QTest::newRow( "path too short" ) << PATTERN_ALBUM_TRACK << "Arrival/03 - Dancing Queen.mp3"
+                                      << false << "" << "";
+    QTest::newRow( "artist - title" ) << PATTERN_SEPARATOR << "/karaoke/Sia - Chandelier.mp3"
+                                      << true << "Sia" << "Chandelier";
+    QTest::newRow( "first separator splits" ) << PATTERN_SEPARATOR << "/karaoke/Guns N' Roses - Sweet Child O' Mine - Acoustic.mp3"
+                                              << true << "Guns N' Roses" << "Sweet Child O' Mine - Acoustic";
+    QTest::newRow( "placeholders do not cross directories" ) << PATTERN_SEPARATOR << "/karaoke/Sia/Chandelier.mp3"
+                                                             << false << "" << "";
+    QTest::newRow( "spaces are trimmed" ) << PATTERN_SEPARATOR << "/k/ Sia  -  Chandelier .mp3"
+                                          << true << "Sia" << "Chandelier";
+    QTest::newRow( "empty artist" ) << PATTERN_SEPARATOR << "/k/ - Title.mp3"
+                                    << false << "" << "";
+    QTest::newRow( "empty title" ) << PATTERN_SEPARATOR << "/k/Artist - .mp3"
+                                   << false << "" << "";
+    QTest::newRow( "non-latin" ) << "{artist}/{title}" << QString::fromUtf8( "/музыка/Кино/Группа крови.mp3" )
+                                 << true << QString::fromUtf8( "Кино" ) << QString::fromUtf8( "Группа крови" );
+    QTest::newRow( "regex characters are literal" ) << "[{artist}] {title}" << "/k/[Queen] Bohemian Rhapsody.mp3"
+                                                    << true << "Queen" << "Bohemian Rhapsody";
+    QTest::newRow( "literal text must be present" ) << "[{artist}] {title}" << "/k/Queen Bohemian Rhapsody.mp3"
+                                                    << false << "" << "";
+    QTest::newRow( "extension is removed first" ) << "{artist}/{title}.{skip}" << "/k/Queen/Bohemian.Rhapsody.mp3"
+                                                  << true << "Queen" << "Bohemian";
+}
+
+void TestSongPathPattern::extractsArtistAndTitle()
+{
+    QFETCH( QString, pattern );
+    QFETCH( QString, path );
+    QFETCH( bool, matched );
+    QFETCH( QString, artist );
+    QFETCH( QString, title );
+
+    SongPathPattern compiled;
+    QString errmsg;
+
+    QVERIFY2( compiled.compile( pattern, errmsg ), qPrintable( errmsg ) );
+
+    QString foundArtist, foundTitle;
+    QCOMPARE( compiled.match( path, foundArtist, foundTitle ), matched );
+
+    if ( matched )
+    {
+        QCOMPARE( foundArtist, artist );
+        QCOMPARE( foundTitle, title );
+    }
+}
+
+void TestSongPathPattern::rejectsInvalidPatterns_data()
+{
+    QTest::addColumn<QString>( "pattern" );
+
+    QTest::newRow( "empty" ) << "";
+    QTest::newRow( "no title" ) << "{artist}";
+    QTest::newRow( "no artist" ) << "{skip}/{title}";
+    QTest::newRow( "duplicate artist" ) << "{artist}/{artist} - {title}";
+    QTest::newRow( "unknown placeholder" ) << "{artist} - {name}";
+    QTest::newRow( "unterminated placeholder" ) << "{artist} - {title";
+}
+
+void TestSongPathPattern::rejectsInvalidPatterns()
+{
+    QFETCH( QString, pattern );
+
+    SongPathPattern compiled;
+    QString errmsg;
+
+    QVERIFY( !compiled.compile( pattern, errmsg ) );
+    QVERIFY( !errmsg.isEmpty() );
+}
+
+void TestSongPathPattern::patternsAreAppliedInOrder()
+{
+    // Same as the scanner does: the first matching pattern wins
+    QList<SongPathPattern> patterns;
+    QString errmsg;
+
+    Q_FOREACH( const QString& pattern, QStringList() << PATTERN_ALBUM_TRACK << PATTERN_SEPARATOR )
+    {
+        SongPathPattern compiled;
+        QVERIFY2( compiled.compile( pattern, errmsg ), qPrintable( errmsg ) );
+        patterns.push_back( compiled );
+    }
+
+    QString artist, title;
+    const QString path = "/music/Various/Hits 1999/Britney Spears - Baby One More Time.mp3";
+
+    // Both patterns match, but differently
+    QVERIFY( patterns[0].match( path, artist, title ) );
+    QCOMPARE( artist, QString( "Various" ) );
+    QCOMPARE( title, QString( "Baby One More Time" ) );
+
+    QVERIFY( patterns[1].match( path, artist, title ) );
+    QCOMPARE( artist, QString( "Britney Spears" ) );
+    QCOMPARE( title, QString( "Baby One More Time" ) );
+}
+
+void TestSongPathPattern::corpusCost()
+{
+    SongPathPattern albumTrack, separator;
+    QString errmsg;
+
+    QVERIFY2( albumTrack.compile( PATTERN_ALBUM_TRACK, errmsg ), qPrintable( errmsg ) );
+    QVERIFY2( separator.compile( PATTERN_SEPARATOR, errmsg ), qPrintable( errmsg ) );
+
+    // A thousand different paths of both layouts, matched in turn; every path matches one of the patterns
+    QStringList paths;
+
+    for ( int i = 0; i < 1000; i++ )
+    {
+        if ( i % 2 )
+            paths.push_back( QString( "/mnt/nas/karaoke/Artist %1/Album %2/%3 - Song title %4.mp3" ).arg( i / 10 ).arg( i % 10 ).arg( i % 20, 2, 10, QChar('0') ).arg( i ) );
+        else
+            paths.push_back( QString( "/mnt/nas/karaoke/Singles/Artist %1 - Song title %2.kfn" ).arg( i / 10 ).arg( i ) );
+    }
+
+    int matched = 0;
+    QString artist, title;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    for ( int i = 0; i < CORPUS_SIZE; i++ )
+    {
+        const QString& path = paths[ i % paths.size() ];
+
+        if ( albumTrack.match( path, artist, title ) || separator.match( path, artist, title ) )
+            matched++;
+    }
+
+    qint64 usec = timer.nsecsElapsed() / 1000;
+
+    qDebug( "%d paths matched in %lld ms, %.2f usec per path", CORPUS_SIZE, (long long) usec / 1000, (double) usec / CORPUS_SIZE );
+
+    QCOMPARE( matched, CORPUS_SIZE );
+    QVERIFY2( usec / CORPUS_SIZE < MAX_USEC_PER_PATH, qPrintable( QString( "%1 usec per path" ).arg( (double) usec / CORPUS_SIZE ) ) );
+}
+
+QTEST_APPLESS_MAIN(TestSongPathPattern)
+
+#include "tst_songpathpattern.moc"
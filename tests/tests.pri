@@ -0,0 +1,10 @@
+# Common settings for the unit tests; each test builds the player sources it needs directly.
+# Run them with "make check".
+CONFIG += warn_on console testcase
+CONFIG -= app_bundle
+QT += core testlib
+QT -= gui
+TEMPLATE = app
+
+INCLUDEPATH += $$PWD/../src
+DEPENDPATH += $$PWD/../src
@@ -0,0 +1,2 @@
+TEMPLATE = subdirs
+SUBDIRS += collectionindex scancheckpoint threadwaiter webserverratelimiter httprequestparser websocketframe scanresume collectionproviderhttp songpathpattern httppipelining gzipcompress webserverstaticcache jsonstreamwriter musiccollectionenumerator webserverworkers
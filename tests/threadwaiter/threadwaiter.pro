@@ -0,0 +1,8 @@
+include(../tests.pri)
+
+TARGET = tst_threadwaiter
+
+SOURCES += tst_threadwaiter.cpp \
+    ../../src/threadwaiter.cpp
+
+HEADERS += ../../src/threadwaiter.h
@@ -0,0 +1,168 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtTest>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QSemaphore>
+
+#include "threadwaiter.h"
+
+// How long a blocked thread is waited for in the tests, in milliseconds
+static const int STOP_TIMEOUT = 300;
+
+// How much longer than expected the tests tolerate on a busy machine, in milliseconds
+static const int SCHEDULING_SLACK = 700;
+
+//
+// Works like the scanner threads: does the work in short steps, checking the abort flag between them
+//
+class CooperativeThread : public QThread
+{
+    public:
+        CooperativeThread( QAtomicInt * abort ) : QThread( 0 )
+        {
+            m_abort = abort;
+        }
+
+        void run()
+        {
+            while ( !m_abort->load() )
+                QThread::msleep( 10 );
+        }
+
+    private:
+        QAtomicInt * m_abort;
+};
+
+//
+// Is blocked in something which cannot be cancelled, like a read from a hung network mount
+//
+class BlockedThread : public QThread
+{
+    public:
+        BlockedThread( QSemaphore * release ) : QThread( 0 )
+        {
+            m_release = release;
+        }
+
+        void run()
+        {
+            m_release->acquire();
+        }
+
+    private:
+        QSemaphore * m_release;
+};
+
+class TestThreadWaiter : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void cooperativeThreadsStopQuickly();
+        void blockedThreadIsReported();
+        void deadlineIsShared();
+};
+
+void TestThreadWaiter::cooperativeThreadsStopQuickly()
+{
+    QAtomicInt aborted( 0 );
+    QList< QThread * > threads;
+
+    for ( int i = 0; i < 5; i++ )
+    {
+        threads.push_back( new CooperativeThread( &aborted ) );
+        threads.last()->start();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    aborted = 1;
+    QList< QThread * > running = ThreadWaiter::waitAll( threads, 10000 );
+
+    QVERIFY( running.isEmpty() );
+    QVERIFY2( timer.elapsed() < SCHEDULING_SLACK, qPrintable( QString( "abort took %1 ms" ).arg( timer.elapsed() ) ) );
+
+    qDeleteAll( threads );
+}
+
+void TestThreadWaiter::blockedThreadIsReported()
+{
+    QAtomicInt aborted( 0 );
+    QSemaphore release;
+    QList< QThread * > threads;
+
+    threads.push_back( new CooperativeThread( &aborted ) );
+    threads.push_back( new BlockedThread( &release ) );
+    threads.push_back( new CooperativeThread( &aborted ) );
+
+    Q_FOREACH( QThread * thread, threads )
+        thread->start();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    aborted = 1;
+    QList< QThread * > running = ThreadWaiter::waitAll( threads, STOP_TIMEOUT );
+
+    QVERIFY( timer.elapsed() >= STOP_TIMEOUT - 10 );
+    QVERIFY2( timer.elapsed() < STOP_TIMEOUT + SCHEDULING_SLACK, qPrintable( QString( "waited %1 ms" ).arg( timer.elapsed() ) ) );
+    QCOMPARE( running.size(), 1 );
+    QCOMPARE( running.first(), threads[1] );
+    QVERIFY( threads[0]->isFinished() );
+    QVERIFY( threads[2]->isFinished() );
+
+    release.release();
+    QVERIFY( threads[1]->wait( 10000 ) );
+
+    qDeleteAll( threads );
+}
+
+void TestThreadWaiter::deadlineIsShared()
+{
+    QSemaphore release;
+    QList< QThread * > threads;
+
+    for ( int i = 0; i < 5; i++ )
+    {
+        threads.push_back( new BlockedThread( &release ) );
+        threads.last()->start();
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    QList< QThread * > running = ThreadWaiter::waitAll( threads, STOP_TIMEOUT );
+
+    // Not STOP_TIMEOUT per thread
+    QVERIFY2( timer.elapsed() < STOP_TIMEOUT + SCHEDULING_SLACK, qPrintable( QString( "waited %1 ms" ).arg( timer.elapsed() ) ) );
+    QCOMPARE( running, threads );
+
+    release.release( threads.size() );
+
+    Q_FOREACH( QThread * thread, threads )
+        QVERIFY( thread->wait( 10000 ) );
+
+    qDeleteAll( threads );
+}
+
+QTEST_APPLESS_MAIN(TestThreadWaiter)
+
+#include "tst_threadwaiter.moc"
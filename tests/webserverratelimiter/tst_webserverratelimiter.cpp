@@ -0,0 +1,148 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtTest>
+#include <QElapsedTimer>
+
+#include "webserverratelimiter.h"
+
+// Rate limit used in the tests, requests per second (so the burst is 10 requests)
+static const unsigned int RATE = 5;
+
+class TestWebServerRateLimiter : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void burstThenRate();
+        void abusiveClientIsCapped();
+        void zeroRateIsUnlimited();
+        void idleBucketsAreDropped();
+        void abusiveClientsDoNotSlowDownOthers();
+};
+
+void TestWebServerRateLimiter::burstThenRate()
+{
+    WebServerRateLimiter limiter;
+    int retry = 0;
+
+    for ( int i = 0; i < (int) RATE * 2; i++ )
+        QVERIFY( limiter.allow( "client", RATE, 1000, retry ) );
+
+    QVERIFY( !limiter.allow( "client", RATE, 1000, retry ) );
+    QCOMPARE( retry, 1 );
+
+    // One request worth of tokens is refilled in 1000 / RATE ms
+    QVERIFY( !limiter.allow( "client", RATE, 1000 + 1000 / RATE - 1, retry ) );
+    QVERIFY( limiter.allow( "client", RATE, 1000 + 1000 / RATE + 1, retry ) );
+}
+
+void TestWebServerRateLimiter::abusiveClientIsCapped()
+{
+    WebServerRateLimiter limiter;
+    int abusiveAllowed = 0, politeAllowed = 0, politeSent = 0;
+    int retry;
+
+    // The abusive client sends a request every millisecond for ten seconds, while the polite one
+    // from another address polls twice a second; both use a simulated clock
+    for ( qint64 now = 0; now < 10000; now++ )
+    {
+        if ( limiter.allow( "10.0.0.1/0", RATE, now, retry ) )
+            abusiveAllowed++;
+        else
+            QVERIFY( retry >= 1 );
+
+        if ( now % 500 == 0 )
+        {
+            politeSent++;
+
+            if ( limiter.allow( "10.0.0.2/0", RATE, now, retry ) )
+                politeAllowed++;
+        }
+    }
+
+    // The burst plus the rate over ten seconds
+    QVERIFY2( abusiveAllowed <= (int) RATE * 2 + (int) RATE * 10 + 1, qPrintable( QString::number( abusiveAllowed ) ) );
+    QVERIFY( abusiveAllowed >= (int) RATE * 10 );
+    QCOMPARE( politeAllowed, politeSent );
+}
+
+void TestWebServerRateLimiter::zeroRateIsUnlimited()
+{
+    WebServerRateLimiter limiter;
+    int retry;
+
+    for ( int i = 0; i < 10000; i++ )
+        QVERIFY( limiter.allow( "client", 0, 0, retry ) );
+
+    QCOMPARE( limiter.buckets(), 0 );
+}
+
+void TestWebServerRateLimiter::idleBucketsAreDropped()
+{
+    WebServerRateLimiter limiter;
+    int retry;
+
+    for ( int i = 0; i < 100; i++ )
+        limiter.allow( QString( "client%1" ).arg( i ), RATE, 1000, retry );
+
+    QCOMPARE( limiter.buckets(), 100 );
+
+    // Still active
+    limiter.allow( "client0", RATE, 50000, retry );
+    QCOMPARE( limiter.buckets(), 100 );
+
+    // All but the last used one are idle for over a minute
+    limiter.allow( "client1", RATE, 100000, retry );
+    QCOMPARE( limiter.buckets(), 2 );
+}
+
+void TestWebServerRateLimiter::abusiveClientsDoNotSlowDownOthers()
+{
+    WebServerRateLimiter limiter;
+    int retry;
+
+    // Many addresses hammering the server (each request is a separate client, so the buckets accumulate)
+    for ( int i = 0; i < 50000; i++ )
+        limiter.allow( QString( "10.%1.%2.%3/0" ).arg( i / 65536 ).arg( (i / 256) % 256 ).arg( i % 256 ), RATE, i / 10, retry );
+
+    QCOMPARE( limiter.buckets(), 50000 );
+
+    // The decision for the other clients stays fast, including the pass dropping the idle buckets
+    QElapsedTimer timer;
+    timer.start();
+    qint64 slowest = 0;
+
+    for ( int i = 0; i < 1000; i++ )
+    {
+        qint64 started = timer.nsecsElapsed();
+        QVERIFY( limiter.allow( QString( "polite%1/0" ).arg( i ), RATE, 200000 + i, retry ) );
+        slowest = qMax( slowest, timer.nsecsElapsed() - started );
+    }
+
+    QCOMPARE( limiter.buckets(), 1000 );
+
+    // Generous bounds, so this doesn't fail on a loaded machine; the web server thread handles
+    // all the connections, so a rate limit decision must never stall it
+    QVERIFY2( timer.elapsed() < 500, qPrintable( QString( "1000 decisions took %1 ms" ).arg( timer.elapsed() ) ) );
+    QVERIFY2( slowest < 200 * 1000000LL, qPrintable( QString( "slowest decision took %1 ns" ).arg( slowest ) ) );
+}
+
+QTEST_APPLESS_MAIN(TestWebServerRateLimiter)
+
+#include "tst_webserverratelimiter.moc"
@@ -0,0 +1,8 @@
+include(../tests.pri)
+
+TARGET = tst_webserverratelimiter
+
+SOURCES += tst_webserverratelimiter.cpp \
+    ../../src/webserverratelimiter.cpp
+
+HEADERS += ../../src/webserverratelimiter.h
@@ -0,0 +1,265 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+
+#include "webserverstaticcache.h"
+#include "settings.h"
+#include "logger.h"
+
+// Util only uses the settings for the cache directory, which is not used here
+Settings * pSettings;
+
+// Small enough for the test files to be on both sides
+static const qint64 MAX_MEMORY_FILE_SIZE = 4096;
+
+
+class TestWebServerStaticCache : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void    initTestCase();
+        void    init();
+
+        void    loadsFromDocumentRoot();
+        void    fallsBackToResources();
+        void    reloadsChangedFile();
+        void    largeFileServedFromDisk();
+        void    notModified_data();
+        void    notModified();
+        void    validatorHeaders();
+        void    httpDate();
+        void    cachedLookupCost();
+
+    private:
+        void    writeFile( const QString& path, const QByteArray& data );
+
+        QTemporaryDir   m_docRoot;
+        QTemporaryDir   m_resources;
+        QByteArray      m_css;
+};
+
+void TestWebServerStaticCache::initTestCase()
+{
+    Logger::init();
+
+    QVERIFY( m_docRoot.isValid() );
+    QVERIFY( m_resources.isValid() );
+
+    m_css = QByteArray( "body { background: url(background.jpg); font-family: sans-serif; }\n" ).repeated( 40 );
+}
+
+void TestWebServerStaticCache::init()
+{
+    writeFile( m_docRoot.path() + "/index.html", "<html><body>Document root</body></html>" );
+    writeFile( m_docRoot.path() + "/style.css", m_css );
+    writeFile( m_docRoot.path() + "/background.jpg", QByteArray( MAX_MEMORY_FILE_SIZE * 4, '\xAB' ) );
+    writeFile( m_resources.path() + "/index.html", "<html><body>Resources</body></html>" );
+    writeFile( m_resources.path() + "/karaoke.js", "function init() { return 1; }" );
+}
+
+void TestWebServerStaticCache::writeFile( const QString &path, const QByteArray &data )
+{
+    QFile f( path );
+    QVERIFY( f.open( QIODevice::WriteOnly | QIODevice::Truncate ) );
+    QCOMPARE( f.write( data ), (qint64) data.size() );
+}
+
+void TestWebServerStaticCache::loadsFromDocumentRoot()
+{
+    WebServerStaticCache cache( m_resources.path(), MAX_MEMORY_FILE_SIZE );
+    WebServerStaticFile file;
+
+    QVERIFY( cache.find( m_docRoot.path(), "/style.css", file ) );
+    QVERIFY( file.inMemory );
+    QCOMPARE( file.data, m_css );
+    QCOMPARE( file.type, QByteArray( "text/css" ) );
+    QVERIFY( file.etag.startsWith( '"' ) && file.etag.endsWith( '"' ) && file.etag.size() > 2 );
+
+    // Repetitive CSS is compressed once, at load time
+    QVERIFY( !file.gzipped.isEmpty() && file.gzipped.size() < file.data.size() );
+
+    // Last modified with the HTTP one second precision
+    QDateTime mtime = QFileInfo( m_docRoot.path() + "/style.css" ).lastModified().toUTC();
+    QCOMPARE( file.lastModified.toTime_t(), mtime.toTime_t() );
+    QCOMPARE( file.lastModified.time().msec(), 0 );
+
+    // Second lookup comes from the cache, with the same validators
+    WebServerStaticFile again;
+    QVERIFY( cache.find( m_docRoot.path(), "/style.css", again ) );
+    QCOMPARE( again.etag, file.etag );
+    QCOMPARE( again.lastModified, file.lastModified );
+
+    QVERIFY( !cache.find( m_docRoot.path(), "/missing.css", file ) );
+    QVERIFY( !cache.find( m_docRoot.path(), "/", file ) );
+}
+
+void TestWebServerStaticCache::fallsBackToResources()
+{
+    WebServerStaticCache cache( m_resources.path(), MAX_MEMORY_FILE_SIZE );
+    WebServerStaticFile file;
+
+    // The document root has priority
+    QVERIFY( cache.find( m_docRoot.path(), "/index.html", file ) );
+    QCOMPARE( file.data, QByteArray( "<html><body>Document root</body></html>" ) );
+
+    QVERIFY( cache.find( m_docRoot.path(), "/karaoke.js", file ) );
+    QCOMPARE( file.data, QByteArray( "function init() { return 1; }" ) );
+
+    QVERIFY( cache.find( QString(), "/index.html", file ) );
+    QCOMPARE( file.data, QByteArray( "<html><body>Resources</body></html>" ) );
+    QCOMPARE( file.type, QByteArray( "text/html" ) );
+}
+
+void TestWebServerStaticCache::reloadsChangedFile()
+{
+    WebServerStaticCache cache( m_resources.path(), MAX_MEMORY_FILE_SIZE );
+    WebServerStaticFile before, after;
+
+    QVERIFY( cache.find( m_docRoot.path(), "/style.css", before ) );
+
+    writeFile( m_docRoot.path() + "/style.css", "body { color: red; }\n" );
+
+    QVERIFY( cache.find( m_docRoot.path(), "/style.css", after ) );
+    QCOMPARE( after.data, QByteArray( "body { color: red; }\n" ) );
+    QVERIFY( after.etag != before.etag );
+
+    // The copy the client has cached before is not valid anymore
+    QVERIFY( !after.notModified( before.etag, QString() ) );
+    QVERIFY( after.notModified( after.etag, QString() ) );
+}
+
+void TestWebServerStaticCache::largeFileServedFromDisk()
+{
+    WebServerStaticCache cache( m_resources.path(), MAX_MEMORY_FILE_SIZE );
+    WebServerStaticFile file;
+
+    QVERIFY( cache.find( m_docRoot.path(), "/background.jpg", file ) );
+    QVERIFY( !file.inMemory );
+    QVERIFY( file.data.isEmpty() );
+    QVERIFY( file.gzipped.isEmpty() );
+    QCOMPARE( file.size, MAX_MEMORY_FILE_SIZE * 4 );
+    QCOMPARE( file.type, QByteArray( "image/jpeg" ) );
+    QCOMPARE( file.path, m_docRoot.path() + "/background.jpg" );
+
+    // ETag from the size and the modification time
+    QCOMPARE( file.etag, "\"" + QByteArray::number( file.size, 16 ) + "-" + QByteArray::number( (qint64) file.lastModified.toTime_t(), 16 ) + "\"" );
+}
+
+void TestWebServerStaticCache::notModified_data()
+{
+    QTest::addColumn<QByteArray>("ifNoneMatch");
+    QTest::addColumn<QString>("ifModifiedSince");
+    QTest::addColumn<bool>("notModified");
+
+    // The file in the test has ETag "abc123" and was modified at Sun, 06 Nov 1994 08:49:37 GMT
+    QTest::newRow("no validators") << QByteArray() << QString() << false;
+    QTest::newRow("etag match") << QByteArray( "\"abc123\"" ) << QString() << true;
+    QTest::newRow("etag in list") << QByteArray( "\"old\", \"abc123\"" ) << QString() << true;
+    QTest::newRow("etag any") << QByteArray( " * " ) << QString() << true;
+    QTest::newRow("weak etag match") << QByteArray( "W/\"abc123\"" ) << QString() << true;
+    QTest::newRow("etag mismatch") << QByteArray( "\"abc124\"" ) << QString() << false;
+    QTest::newRow("etag unquoted") << QByteArray( "abc123" ) << QString() << false;
+    QTest::newRow("same date") << QByteArray() << QString( "Sun, 06 Nov 1994 08:49:37 GMT" ) << true;
+    QTest::newRow("later date") << QByteArray() << QString( "Mon, 07 Nov 1994 00:00:00 GMT" ) << true;
+    QTest::newRow("earlier date") << QByteArray() << QString( "Sun, 06 Nov 1994 08:49:36 GMT" ) << false;
+    QTest::newRow("invalid date") << QByteArray() << QString( "yesterday" ) << false;
+
+    // If-None-Match takes precedence over If-Modified-Since
+    QTest::newRow("etag mismatch, same date") << QByteArray( "\"old\"" ) << QString( "Sun, 06 Nov 1994 08:49:37 GMT" ) << false;
+    QTest::newRow("etag match, earlier date") << QByteArray( "\"abc123\"" ) << QString( "Sun, 06 Nov 1994 08:49:36 GMT" ) << true;
+}
+
+void TestWebServerStaticCache::notModified()
+{
+    QFETCH( QByteArray, ifNoneMatch );
+    QFETCH( QString, ifModifiedSince );
+    QFETCH( bool, notModified );
+
+    WebServerStaticFile file;
+    file.etag = "\"abc123\"";
+    file.lastModified = QDateTime( QDate( 1994, 11, 6 ), QTime( 8, 49, 37 ), Qt::UTC );
+
+    QCOMPARE( file.notModified( ifNoneMatch, ifModifiedSince ), notModified );
+}
+
+void TestWebServerStaticCache::validatorHeaders()
+{
+    WebServerStaticCache cache( m_resources.path(), MAX_MEMORY_FILE_SIZE );
+    WebServerStaticFile html, css;
+
+    QVERIFY( cache.find( m_docRoot.path(), "/index.html", html ) );
+    QVERIFY( cache.find( m_docRoot.path(), "/style.css", css ) );
+
+    QByteArray headers = css.validatorHeaders();
+    QVERIFY( headers.contains( "ETag: " + css.etag + "\r\n" ) );
+    QVERIFY( headers.contains( "Last-Modified: " + WebServerStaticCache::toHttpDate( css.lastModified ) + "\r\n" ) );
+    QVERIFY( headers.contains( "Cache-Control: max-age=3600\r\n" ) );
+
+    // HTML is always revalidated
+    QVERIFY( html.validatorHeaders().contains( "Cache-Control: no-cache\r\n" ) );
+
+    // What the browser sends back from these headers makes the file not modified
+    QVERIFY( css.notModified( css.etag, QString() ) );
+    QVERIFY( css.notModified( QByteArray(), WebServerStaticCache::toHttpDate( css.lastModified ) ) );
+}
+
+void TestWebServerStaticCache::httpDate()
+{
+    QDateTime date( QDate( 1994, 11, 6 ), QTime( 8, 49, 37 ), Qt::UTC );
+
+    QCOMPARE( WebServerStaticCache::toHttpDate( date ), QByteArray( "Sun, 06 Nov 1994 08:49:37 GMT" ) );
+    QCOMPARE( WebServerStaticCache::fromHttpDate( "Sun, 06 Nov 1994 08:49:37 GMT" ), date );
+    QCOMPARE( WebServerStaticCache::fromHttpDate( " Sun, 06 Nov 1994 08:49:37 GMT " ), date );
+
+    // Always formatted in GMT, whatever the time zone of the value
+    QCOMPARE( WebServerStaticCache::toHttpDate( date.toOffsetFromUtc( 3 * 3600 ) ), QByteArray( "Sun, 06 Nov 1994 08:49:37 GMT" ) );
+
+    QVERIFY( !WebServerStaticCache::fromHttpDate( "06/11/1994 08:49:37" ).isValid() );
+}
+
+void TestWebServerStaticCache::cachedLookupCost()
+{
+    // Every static request looks the file up, so a cached lookup must be cheap compared to reading the file
+    WebServerStaticCache cache( m_resources.path(), MAX_MEMORY_FILE_SIZE );
+    WebServerStaticFile file;
+
+    QVERIFY( cache.find( m_docRoot.path(), "/style.css", file ) );
+
+    const int lookups = 20000;
+    QElapsedTimer timer;
+    timer.start();
+
+    for ( int i = 0; i < lookups; i++ )
+    {
+        if ( !cache.find( m_docRoot.path(), "/style.css", file ) || !file.notModified( file.etag, QString() ) )
+            QFAIL( "lookup failed" );
+    }
+
+    double usec = timer.nsecsElapsed() / 1000.0 / lookups;
+    qDebug( "Cached static lookup with a 304 check: %.2f us (%.0f lookups/s)", usec, 1000000.0 / usec );
+
+    QVERIFY2( usec < 200, "cached static lookup is too slow" );
+}
+
+QTEST_GUILESS_MAIN(TestWebServerStaticCache)
+
+#include "tst_webserverstaticcache.moc"
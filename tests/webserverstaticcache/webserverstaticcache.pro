@@ -0,0 +1,18 @@
+include(../tests.pri)
+
+TARGET = tst_webserverstaticcache
+
+# The settings header needs the GUI module, and the logger the widgets
+QT += gui widgets
+
+SOURCES += tst_webserverstaticcache.cpp \
+    ../../src/webserverstaticcache.cpp \
+    ../../src/util.cpp \
+    ../../src/logger.cpp
+
+HEADERS += ../../src/webserverstaticcache.h
+
+INCLUDEPATH += $$PWD/../.. $$PWD/../../extralibs/include
+
+CONFIG += link_pkgconfig
+PKGCONFIG += uchardet
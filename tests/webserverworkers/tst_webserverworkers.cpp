@@ -0,0 +1,554 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtTest>
+#include <QMap>
+#include <QTimer>
+#include <QThread>
+#include <QThreadPool>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtConcurrent>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QElapsedTimer>
+
+#include <algorithm>
+
+#include "httprequestparser.h"
+#include "actionhandler_webserver_stream.h"
+
+// How long the simulated database search takes, in milliseconds, and the rows it returns
+static const int SEARCH_DELAY = 100;
+static const int SEARCH_ROWS = 200;
+
+// Phones poll the status every 500ms; here more often, to have enough samples
+static const int STATUS_INTERVAL = 20;
+
+// How long each load runs, in milliseconds
+static const int LOAD_DURATION = 3000;
+
+
+// The database search, run the same way ActionHandler_WebServer_Socket::searchResults is
+static void searchHandler( QJsonObject request, ActionHandler_WebServer_Stream * stream )
+{
+    QThread::msleep( SEARCH_DELAY );
+
+    JsonStreamWriter& json = stream->json();
+    json.beginObject();
+    json.member( "url", request["url"].toString() );
+    json.name( "results" );
+    json.beginArray();
+
+    for ( int i = 0; i < SEARCH_ROWS; i++ )
+    {
+        json.beginObject();
+        json.member( "id", i );
+        json.member( "title", QString( "Song %1" ).arg( i ) );
+        json.endObject();
+
+        if ( !stream->rowWritten() )
+            return;
+    }
+
+    json.endArray();
+    json.endObject();
+}
+
+
+//
+// A connection handled the way ActionHandler_WebServer_Socket does it: the quick requests are answered
+// in the web server thread, the searches are dispatched to the worker pool (or run right away if there
+// is no pool), and the pipelined requests after a search wait until its response is sent.
+//
+class WorkerConnection : public QObject
+{
+    Q_OBJECT
+
+    public:
+        WorkerConnection( QTcpSocket * socket, QThreadPool * pool )
+        {
+            m_socket = socket;
+            m_pool = pool;
+            m_workerBusy = false;
+            m_closing = false;
+
+            connect( m_socket, SIGNAL(readyRead()), this, SLOT(readyRead()) );
+        }
+
+        ~WorkerConnection()
+        {
+            delete m_socket;
+        }
+
+    private slots:
+        void    readyRead()
+        {
+            m_buffer += m_socket->readAll();
+            handlePending();
+        }
+
+        void    streamFinished( QByteArray data )
+        {
+            bool async = m_workerBusy;
+            m_workerBusy = false;
+
+            reply( data );
+
+            if ( async )
+                handlePending();
+        }
+
+    private:
+        void    handlePending()
+        {
+            while ( !m_closing && !m_workerBusy && handleRequest() )
+                ;
+        }
+
+        bool    handleRequest()
+        {
+            int consumed = m_parser.feed( m_buffer );
+            m_buffer.remove( 0, consumed );
+
+            if ( m_parser.hasError() )
+            {
+                m_closing = true;
+                m_socket->disconnectFromHost();
+                return false;
+            }
+
+            if ( !m_parser.isComplete() )
+                return false;
+
+            QByteArray url = m_parser.url();
+            m_parser.reset();
+
+            if ( url.startsWith( "/api/search" ) )
+            {
+                QJsonObject request;
+                request["url"] = QString::fromUtf8( url );
+                dispatchToWorker( request );
+            }
+            else
+                reply( "{\"state\":\"playing\",\"url\":\"" + url + "\"}" );
+
+            return true;
+        }
+
+        void    dispatchToWorker( const QJsonObject& request )
+        {
+            ActionHandler_WebServer_Stream * stream = new ActionHandler_WebServer_Stream( false );
+            connect( stream, SIGNAL(finished(QByteArray)), this, SLOT(streamFinished(QByteArray)) );
+
+            if ( !m_pool )
+            {
+                ActionHandler_WebServer_Stream::run( searchHandler, request, stream );
+                return;
+            }
+
+            m_workerBusy = true;
+            QtConcurrent::run( m_pool, ActionHandler_WebServer_Stream::run, searchHandler, request, stream );
+        }
+
+        void    reply( const QByteArray& body )
+        {
+            m_socket->write( "HTTP/1.1 200 ok\r\n"
+                             "Content-Type: application/json\r\n"
+                             "Content-Length: " + QByteArray::number( body.size() ) + "\r\n"
+                             "\r\n" + body );
+        }
+
+        QTcpSocket *        m_socket;
+        QThreadPool *       m_pool;
+        HttpRequestParser   m_parser;
+        QByteArray          m_buffer;
+        bool                m_workerBusy;
+        bool                m_closing;
+};
+
+
+//
+// Web server running in its own thread, with the given number of workers (0 means no pool)
+//
+class WorkerServer : public QObject
+{
+    Q_OBJECT
+
+    public:
+        WorkerServer( int workers )
+        {
+            m_workers = workers;
+            m_pool.setMaxThreadCount( qMax( workers, 1 ) );
+            m_server = 0;
+        }
+
+        ~WorkerServer()
+        {
+            m_pool.waitForDone();
+        }
+
+    public slots:
+        // Called in the server thread; returns the port, or 0 if it failed
+        int     start()
+        {
+            m_server = new QTcpServer( this );
+            connect( m_server, SIGNAL(newConnection()), this, SLOT(newConnection()) );
+
+            return m_server->listen( QHostAddress::LocalHost ) ? m_server->serverPort() : 0;
+        }
+
+        void    stop()
+        {
+            // The workers emit to the connections, so they must be done first
+            m_pool.waitForDone();
+            qDeleteAll( m_connections );
+            m_connections.clear();
+
+            delete m_server;
+            m_server = 0;
+        }
+
+    private slots:
+        void    newConnection()
+        {
+            while ( m_server->hasPendingConnections() )
+                m_connections.push_back( new WorkerConnection( m_server->nextPendingConnection(), m_workers > 0 ? &m_pool : 0 ) );
+        }
+
+    private:
+        int             m_workers;
+        QThreadPool     m_pool;
+        QTcpServer *    m_server;
+        QList<WorkerConnection*>    m_connections;
+};
+
+
+//
+// A client sending requests over a persistent connection, and measuring the time until each response
+//
+class LoadClient : public QObject
+{
+    Q_OBJECT
+
+    public:
+        LoadClient( const QByteArray& url, int interval )
+        {
+            m_url = url;
+            m_interval = interval;
+            m_running = false;
+            errors = 0;
+
+            connect( &m_socket, SIGNAL(connected()), this, SLOT(sendRequest()) );
+            connect( &m_socket, SIGNAL(readyRead()), this, SLOT(readyRead()) );
+        }
+
+        void    start( quint16 port )
+        {
+            m_running = true;
+            m_socket.connectToHost( QHostAddress::LocalHost, port );
+        }
+
+        void    stop() { m_running = false; }
+
+        // Whether a request is sent and not answered yet
+        bool    waiting() const { return m_timer.isValid(); }
+
+        QList<qint64>       latencies;  // in microseconds
+        QList<QByteArray>   responses;
+        int                 errors;
+
+    private slots:
+        void    sendRequest()
+        {
+            if ( !m_running )
+                return;
+
+            m_timer.start();
+            m_socket.write( "GET " + m_url + " HTTP/1.1\r\nHost: localhost\r\n\r\n" );
+        }
+
+        void    readyRead()
+        {
+            m_buffer += m_socket.readAll();
+
+            while ( true )
+            {
+                int end = m_buffer.indexOf( "\r\n\r\n" );
+
+                if ( end == -1 )
+                    return;
+
+                QByteArray headers = m_buffer.left( end ).toLower();
+                int pos = headers.indexOf( "content-length: " );
+
+                if ( !headers.startsWith( "http/1.1 200" ) || pos == -1 )
+                {
+                    errors++;
+                    m_socket.abort();
+                    return;
+                }
+
+                int length = headers.mid( pos + 16, headers.indexOf( '\r', pos ) - pos - 16 ).toInt();
+
+                if ( m_buffer.size() < end + 4 + length )
+                    return;
+
+                latencies.push_back( m_timer.nsecsElapsed() / 1000 );
+                responses.push_back( m_buffer.mid( end + 4, length ) );
+                m_buffer.remove( 0, end + 4 + length );
+                m_timer.invalidate();
+
+                if ( m_interval > 0 )
+                    QTimer::singleShot( m_interval, this, SLOT(sendRequest()) );
+                else
+                    sendRequest();
+            }
+        }
+
+    private:
+        QByteArray      m_url;
+        int             m_interval;
+        bool            m_running;
+        QTcpSocket      m_socket;
+        QByteArray      m_buffer;
+        QElapsedTimer   m_timer;
+};
+
+
+class TestWebServerWorkers : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void    responsesStayInOrder_data();
+        void    responsesStayInOrder();
+        void    statusLatencyUnderSearchLoad();
+
+    private:
+        // Starts the server with the given number of workers in its own thread
+        WorkerServer *  startServer( int workers, QThread& thread, int& port );
+        void            stopServer( WorkerServer * server, QThread& thread );
+
+        // Runs the status pollers along with the clients searching all the time, and returns the status latencies
+        void            runLoad( int workers, QList<qint64>& statusLatencies, int& searches );
+
+        static qint64   percentile( const QList<qint64>& sorted, int percent );
+};
+
+
+WorkerServer * TestWebServerWorkers::startServer( int workers, QThread &thread, int &port )
+{
+    WorkerServer * server = new WorkerServer( workers );
+    server->moveToThread( &thread );
+    thread.start();
+
+    port = 0;
+    QMetaObject::invokeMethod( server, "start", Qt::BlockingQueuedConnection, Q_RETURN_ARG( int, port ) );
+    return server;
+}
+
+void TestWebServerWorkers::stopServer( WorkerServer *server, QThread &thread )
+{
+    QMetaObject::invokeMethod( server, "stop", Qt::BlockingQueuedConnection );
+    thread.quit();
+    thread.wait();
+    delete server;
+}
+
+qint64 TestWebServerWorkers::percentile( const QList<qint64> &sorted, int percent )
+{
+    return sorted.isEmpty() ? 0 : sorted[ ( sorted.size() - 1 ) * percent / 100 ];
+}
+
+void TestWebServerWorkers::responsesStayInOrder_data()
+{
+    QTest::addColumn<int>("workers");
+
+    QTest::newRow("no pool") << 0;
+    QTest::newRow("2 workers") << 2;
+}
+
+void TestWebServerWorkers::responsesStayInOrder()
+{
+    QFETCH( int, workers );
+
+    QThread thread;
+    int port;
+    WorkerServer * server = startServer( workers, thread, port );
+    QVERIFY( port != 0 );
+
+    // The status request is answered right away, but must wait for the search before it
+    QTcpSocket socket;
+    socket.connectToHost( QHostAddress::LocalHost, port );
+    QVERIFY( socket.waitForConnected( 5000 ) );
+
+    socket.write( "GET /api/search?1 HTTP/1.1\r\n\r\n"
+                  "GET /api/control/status HTTP/1.1\r\n\r\n"
+                  "GET /api/search?2 HTTP/1.1\r\n\r\n"
+                  "GET /api/queue/list HTTP/1.1\r\n\r\n" );
+
+    QByteArray data;
+    QElapsedTimer timer;
+    timer.start();
+
+    while ( data.count( "HTTP/1.1 200" ) < 4 && timer.elapsed() < 5000 )
+    {
+        if ( socket.waitForReadyRead( 100 ) )
+            data += socket.readAll();
+    }
+
+    stopServer( server, thread );
+
+    QList<QByteArray> bodies;
+    int pos = 0;
+
+    while ( ( pos = data.indexOf( "\r\n\r\n", pos ) ) != -1 )
+    {
+        int next = data.indexOf( "HTTP/1.1 ", pos );
+        bodies.push_back( data.mid( pos + 4, next == -1 ? -1 : next - pos - 4 ) );
+        pos += 4;
+    }
+
+    QCOMPARE( bodies.size(), 4 );
+
+    QStringList urls;
+
+    Q_FOREACH( const QByteArray& body, bodies )
+    {
+        QJsonParseError error;
+        QJsonObject obj = QJsonDocument::fromJson( body, &error ).object();
+
+        QCOMPARE( error.error, QJsonParseError::NoError );
+        urls.push_back( obj["url"].toString() );
+
+        if ( urls.last().startsWith( "/api/search" ) )
+            QCOMPARE( obj["results"].toArray().size(), SEARCH_ROWS );
+    }
+
+    QCOMPARE( urls, QStringList() << "/api/search?1" << "/api/control/status" << "/api/search?2" << "/api/queue/list" );
+}
+
+void TestWebServerWorkers::runLoad( int workers, QList<qint64> &statusLatencies, int &searches )
+{
+    QThread thread;
+    int port;
+    WorkerServer * server = startServer( workers, thread, port );
+    QVERIFY( port != 0 );
+
+    // Two phones searching all the time, and ten polling the status
+    QList<LoadClient*> searchers, pollers;
+
+    for ( int i = 0; i < 2; i++ )
+        searchers.push_back( new LoadClient( "/api/search?q=song", 0 ) );
+
+    for ( int i = 0; i < 10; i++ )
+        pollers.push_back( new LoadClient( "/api/control/status", STATUS_INTERVAL ) );
+
+    Q_FOREACH( LoadClient * client, searchers + pollers )
+        client->start( port );
+
+    QTest::qWait( LOAD_DURATION );
+
+    // Let the requests already sent complete
+    Q_FOREACH( LoadClient * client, searchers + pollers )
+        client->stop();
+
+    QElapsedTimer timer;
+    timer.start();
+
+    while ( timer.elapsed() < 5000 )
+    {
+        bool waiting = false;
+
+        Q_FOREACH( LoadClient * client, searchers + pollers )
+            waiting |= client->waiting();
+
+        if ( !waiting )
+            break;
+
+        QTest::qWait( 10 );
+    }
+
+    stopServer( server, thread );
+
+    statusLatencies.clear();
+    searches = 0;
+    int errors = 0;
+
+    Q_FOREACH( LoadClient * client, pollers )
+    {
+        statusLatencies += client->latencies;
+        errors += client->errors;
+    }
+
+    Q_FOREACH( LoadClient * client, searchers )
+    {
+        searches += client->responses.size();
+        errors += client->errors;
+
+        Q_FOREACH( const QByteArray& response, client->responses )
+            QCOMPARE( QJsonDocument::fromJson( response ).object()["results"].toArray().size(), SEARCH_ROWS );
+    }
+
+    qDeleteAll( searchers );
+    qDeleteAll( pollers );
+
+    QCOMPARE( errors, 0 );
+    std::sort( statusLatencies.begin(), statusLatencies.end() );
+}
+
+void TestWebServerWorkers::statusLatencyUnderSearchLoad()
+{
+    QList<qint64> inThread, pooled;
+    int inThreadSearches, pooledSearches;
+
+    runLoad( 0, inThread, inThreadSearches );
+
+    if ( QTest::currentTestFailed() )
+        return;
+
+    runLoad( 2, pooled, pooledSearches );
+
+    if ( QTest::currentTestFailed() )
+        return;
+
+    qDebug( "Status latency with the searches in the web server thread: p50 %lld us, p90 %lld us, p99 %lld us, max %lld us; %d polls, %d searches",
+            (long long) percentile( inThread, 50 ), (long long) percentile( inThread, 90 ), (long long) percentile( inThread, 99 ),
+            (long long) percentile( inThread, 100 ), inThread.size(), inThreadSearches );
+
+    qDebug( "Status latency with the searches in 2 workers: p50 %lld us, p90 %lld us, p99 %lld us, max %lld us; %d polls, %d searches",
+            (long long) percentile( pooled, 50 ), (long long) percentile( pooled, 90 ), (long long) percentile( pooled, 99 ),
+            (long long) percentile( pooled, 100 ), pooled.size(), pooledSearches );
+
+    QVERIFY( inThread.size() > 0 );
+    QVERIFY( pooled.size() > 0 );
+
+    // In the server thread a status poll waits for the search being handled, so it is typically
+    // half of the search late; with the workers it doesn't wait for the searches at all
+    QVERIFY( percentile( inThread, 50 ) >= SEARCH_DELAY * 1000 / 4 );
+    QVERIFY( percentile( pooled, 99 ) < SEARCH_DELAY * 1000 / 2 );
+
+    // And the two searches run at the same time
+    QVERIFY( pooledSearches > inThreadSearches );
+}
+
+QTEST_GUILESS_MAIN(TestWebServerWorkers)
+
+#include "tst_webserverworkers.moc"
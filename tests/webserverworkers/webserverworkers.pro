@@ -0,0 +1,14 @@
+include(../tests.pri)
+
+TARGET = tst_webserverworkers
+
+QT += network concurrent
+
+SOURCES += tst_webserverworkers.cpp \
+    ../../src/httprequestparser.cpp \
+    ../../src/jsonstreamwriter.cpp \
+    ../../src/actionhandler_webserver_stream.cpp
+
+HEADERS += ../../src/httprequestparser.h \
+    ../../src/jsonstreamwriter.h \
+    ../../src/actionhandler_webserver_stream.h
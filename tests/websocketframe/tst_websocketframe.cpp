@@ -0,0 +1,227 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QtTest>
+
+#include "websocketframe.h"
+
+// Same as the web server uses
+static const int MAX_PAYLOAD = 65536;
+
+// Builds the header of a client frame with the given length encoding, without the mask and payload
+static QByteArray frameHeader( int opcode, bool fin, quint64 length, bool masked = true )
+{
+    QByteArray header;
+    header.append( (char) ((fin ? 0x80 : 0) | opcode) );
+
+    char maskbit = masked ? 0x80 : 0;
+
+    if ( length < 126 )
+        header.append( (char) (maskbit | length) );
+    else if ( length < 65536 )
+    {
+        header.append( (char) (maskbit | 126) );
+        header.append( (char) ((length >> 8) & 0xFF) );
+        header.append( (char) (length & 0xFF) );
+    }
+    else
+    {
+        header.append( (char) (maskbit | 127) );
+
+        for ( int i = 7; i >= 0; i-- )
+            header.append( (char) ((length >> (i * 8)) & 0xFF) );
+    }
+
+    return header;
+}
+
+// Builds a masked client frame
+static QByteArray clientFrame( int opcode, const QByteArray& payload, bool fin = true )
+{
+    static const char mask[4] = { 0x37, (char) 0xFA, 0x21, 0x3D };
+
+    QByteArray frame = frameHeader( opcode, fin, payload.size() );
+    frame.append( mask, 4 );
+
+    for ( int i = 0; i < payload.size(); i++ )
+        frame.append( (char) (payload[i] ^ mask[ i % 4 ]) );
+
+    return frame;
+}
+
+class TestWebSocketFrame : public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void parsesMaskedFrame();
+        void extendedLengths_data();
+        void extendedLengths();
+        void incompleteAtEveryOffset();
+        void followingDataIsLeft();
+        void fragmentsAreReported();
+        void rejectsUnmasked();
+        void rejectsOversizedLength_data();
+        void rejectsOversizedLength();
+        void buildLengths_data();
+        void buildLengths();
+};
+
+void TestWebSocketFrame::parsesMaskedFrame()
+{
+    QByteArray data = clientFrame( WebSocketFrame::OPCODE_PING, "Hello" );
+    WebSocketFrame frame;
+    int size = 0;
+
+    QCOMPARE( frame.parse( data, MAX_PAYLOAD, size ), WebSocketFrame::RESULT_COMPLETE );
+    QCOMPARE( size, data.size() );
+    QVERIFY( frame.fin );
+    QCOMPARE( frame.opcode, (int) WebSocketFrame::OPCODE_PING );
+    QCOMPARE( frame.payload, QByteArray( "Hello" ) );
+}
+
+void TestWebSocketFrame::extendedLengths_data()
+{
+    QTest::addColumn<int>( "length" );
+
+    QTest::newRow( "empty" ) << 0;
+    QTest::newRow( "7-bit max" ) << 125;
+    QTest::newRow( "16-bit min" ) << 126;
+    QTest::newRow( "16-bit max" ) << 65535;
+    QTest::newRow( "64-bit" ) << MAX_PAYLOAD;
+}
+
+void TestWebSocketFrame::extendedLengths()
+{
+    QFETCH( int, length );
+
+    QByteArray payload( length, 'x' );
+    QByteArray data = clientFrame( WebSocketFrame::OPCODE_TEXT, payload );
+    WebSocketFrame frame;
+    int size = 0;
+
+    QCOMPARE( frame.parse( data, MAX_PAYLOAD, size ), WebSocketFrame::RESULT_COMPLETE );
+    QCOMPARE( size, data.size() );
+    QCOMPARE( frame.payload, payload );
+}
+
+void TestWebSocketFrame::incompleteAtEveryOffset()
+{
+    QByteArray data = clientFrame( WebSocketFrame::OPCODE_TEXT, QByteArray( 300, 'y' ) );
+
+    for ( int i = 0; i < data.size(); i++ )
+    {
+        WebSocketFrame frame;
+        int size = 0;
+
+        QCOMPARE( frame.parse( data.left( i ), MAX_PAYLOAD, size ), WebSocketFrame::RESULT_INCOMPLETE );
+    }
+}
+
+void TestWebSocketFrame::followingDataIsLeft()
+{
+    QByteArray first = clientFrame( WebSocketFrame::OPCODE_PING, "one" );
+    QByteArray data = first + clientFrame( WebSocketFrame::OPCODE_PONG, "two" );
+    WebSocketFrame frame;
+    int size = 0;
+
+    QCOMPARE( frame.parse( data, MAX_PAYLOAD, size ), WebSocketFrame::RESULT_COMPLETE );
+    QCOMPARE( size, first.size() );
+    QCOMPARE( frame.payload, QByteArray( "one" ) );
+
+    QCOMPARE( frame.parse( data.mid( size ), MAX_PAYLOAD, size ), WebSocketFrame::RESULT_COMPLETE );
+    QCOMPARE( frame.opcode, (int) WebSocketFrame::OPCODE_PONG );
+    QCOMPARE( frame.payload, QByteArray( "two" ) );
+}
+
+void TestWebSocketFrame::fragmentsAreReported()
+{
+    WebSocketFrame frame;
+    int size = 0;
+
+    QCOMPARE( frame.parse( clientFrame( WebSocketFrame::OPCODE_TEXT, "part", false ), MAX_PAYLOAD, size ), WebSocketFrame::RESULT_COMPLETE );
+    QVERIFY( !frame.fin );
+
+    QCOMPARE( frame.parse( clientFrame( WebSocketFrame::OPCODE_CONTINUATION, "rest" ), MAX_PAYLOAD, size ), WebSocketFrame::RESULT_COMPLETE );
+    QCOMPARE( frame.opcode, (int) WebSocketFrame::OPCODE_CONTINUATION );
+}
+
+void TestWebSocketFrame::rejectsUnmasked()
+{
+    WebSocketFrame frame;
+    int size = 0;
+
+    QCOMPARE( frame.parse( WebSocketFrame::build( WebSocketFrame::OPCODE_TEXT, "data" ), MAX_PAYLOAD, size ), WebSocketFrame::RESULT_INVALID );
+}
+
+void TestWebSocketFrame::rejectsOversizedLength_data()
+{
+    QTest::addColumn<quint64>( "length" );
+
+    QTest::newRow( "just above the limit" ) << (quint64) MAX_PAYLOAD + 1;
+    QTest::newRow( "above 32 bits" ) << Q_UINT64_C( 0x100000000 );
+    QTest::newRow( "would be negative as int" ) << Q_UINT64_C( 0x80000000 );
+    QTest::newRow( "largest valid" ) << Q_UINT64_C( 0x7FFFFFFFFFFFFFFF );
+    QTest::newRow( "most significant bit set" ) << Q_UINT64_C( 0x8000000000000000 );
+    QTest::newRow( "-14 as signed" ) << Q_UINT64_C( 0xFFFFFFFFFFFFFFF2 );
+}
+
+void TestWebSocketFrame::rejectsOversizedLength()
+{
+    QFETCH( quint64, length );
+
+    // Only the header and mask are there, which is enough to refuse the frame instead of waiting for the payload
+    QByteArray data = frameHeader( WebSocketFrame::OPCODE_PING, true, length ) + QByteArray( 4, 0 ) + QByteArray( 32, 'z' );
+    WebSocketFrame frame;
+    int size = -1;
+
+    QCOMPARE( frame.parse( data, MAX_PAYLOAD, size ), WebSocketFrame::RESULT_INVALID );
+    QCOMPARE( size, -1 );
+}
+
+void TestWebSocketFrame::buildLengths_data()
+{
+    QTest::addColumn<int>( "length" );
+    QTest::addColumn<int>( "headerSize" );
+
+    QTest::newRow( "125" ) << 125 << 2;
+    QTest::newRow( "126" ) << 126 << 4;
+    QTest::newRow( "65535" ) << 65535 << 4;
+    QTest::newRow( "65536" ) << 65536 << 10;
+}
+
+void TestWebSocketFrame::buildLengths()
+{
+    QFETCH( int, length );
+    QFETCH( int, headerSize );
+
+    QByteArray frame = WebSocketFrame::build( WebSocketFrame::OPCODE_TEXT, QByteArray( length, 'a' ) );
+
+    QCOMPARE( frame.size(), headerSize + length );
+    QCOMPARE( (unsigned char) frame[0], (unsigned char) (0x80 | WebSocketFrame::OPCODE_TEXT) );
+
+    // Server frames are not masked
+    QVERIFY( !(frame[1] & 0x80) );
+
+    // The header without the mask bit is the same as the client one
+    QCOMPARE( frame.left( headerSize ), frameHeader( WebSocketFrame::OPCODE_TEXT, true, length, false ) );
+}
+
+QTEST_APPLESS_MAIN(TestWebSocketFrame)
+
+#include "tst_websocketframe.moc"
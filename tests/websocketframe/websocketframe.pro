@@ -0,0 +1,8 @@
+include(../tests.pri)
+
+TARGET = tst_websocketframe
+
+SOURCES += tst_websocketframe.cpp \
+    ../../src/websocketframe.cpp
+
+HEADERS += ../../src/websocketframe.h
@@ -0,0 +1,417 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+
+#include <string.h>
+#include <zlib.h>
+
+#include "loadclient.h"
+#include "loadtest.h"
+
+LoadClient::LoadClient( LoadTest *test, int id )
+    : QObject()
+{
+    m_test = test;
+    m_id = id;
+    m_stopped = false;
+    m_requestActive = false;
+    m_request = REQUEST_LOGIN;
+    m_status = 0;
+    m_headerSize = 0;
+    m_contentLength = 0;
+    m_closeAfter = false;
+    m_bodySize = 0;
+
+    m_thinkTimer.setSingleShot( true );
+
+    connect( &m_thinkTimer, &QTimer::timeout, this, &LoadClient::sendNextRequest );
+    connect( &m_socket, &QTcpSocket::connected, this, &LoadClient::connected );
+    connect( &m_socket, &QTcpSocket::readyRead, this, &LoadClient::readyRead );
+    connect( &m_socket, SIGNAL(error(QAbstractSocket::SocketError)), this, SLOT(socketError(QAbstractSocket::SocketError)) );
+}
+
+void LoadClient::start()
+{
+    // Spread the start so all clients don't come at once
+    m_thinkTimer.start( qrand() % ( m_test->thinkTime + 1 ) );
+}
+
+void LoadClient::stop()
+{
+    m_stopped = true;
+    m_thinkTimer.stop();
+    m_socket.abort();
+}
+
+QString LoadClient::requestName( int request )
+{
+    switch ( request )
+    {
+        case REQUEST_LOGIN:
+            return "login";
+
+        case REQUEST_STATUS:
+            return "status";
+
+        case REQUEST_QUEUE:
+            return "queue";
+
+        case REQUEST_SEARCH:
+            return "search";
+
+        case REQUEST_BROWSE:
+            return "browse";
+
+        case REQUEST_ADDSONG:
+            return "addsong";
+
+        case REQUEST_DOWNLOAD:
+            return "download";
+    }
+
+    return "unknown";
+}
+
+void LoadClient::connected()
+{
+    if ( !m_pendingRequest.isEmpty() )
+    {
+        m_socket.write( m_pendingRequest );
+        m_pendingRequest.clear();
+    }
+}
+
+void LoadClient::sendNextRequest()
+{
+    if ( m_stopped )
+        return;
+
+    // Static files do not need the login
+    if ( !m_test->downloadUrl.isEmpty() )
+    {
+        sendRequest( REQUEST_DOWNLOAD, m_test->downloadUrl.toUtf8(), QByteArray() );
+        return;
+    }
+
+    QJsonObject params;
+
+    // The phone needs to log in first
+    if ( m_cookie.isEmpty() )
+    {
+        params["name"] = QString( "loadtest%1" ).arg( m_id );
+        sendRequest( REQUEST_LOGIN, "/api/auth/login", QJsonDocument( params ).toJson( QJsonDocument::Compact ) );
+        return;
+    }
+
+    Request request = chooseRequest();
+
+    switch ( request )
+    {
+        case REQUEST_SEARCH:
+            params["query"] = m_test->queries[ qrand() % m_test->queries.size() ];
+            sendRequest( request, "/api/search", QJsonDocument( params ).toJson( QJsonDocument::Compact ) );
+            break;
+
+        case REQUEST_BROWSE:
+            // Either the list of initials, or the artists by letter
+            if ( qrand() % 2 )
+                params["artist"] = QString( QChar( 'A' + qrand() % 26 ) );
+
+            sendRequest( request, "/api/browse", QJsonDocument( params ).toJson( QJsonDocument::Compact ) );
+            break;
+
+        case REQUEST_ADDSONG:
+            params["id"] = m_songIds[ qrand() % m_songIds.size() ];
+            sendRequest( request, "/api/addsong", QJsonDocument( params ).toJson( QJsonDocument::Compact ) );
+            break;
+
+        case REQUEST_QUEUE:
+            sendRequest( request, "/api/queue/list", "{}" );
+            break;
+
+        default:
+            sendRequest( REQUEST_STATUS, "/api/control/status", "{}" );
+            break;
+    }
+}
+
+LoadClient::Request LoadClient::chooseRequest()
+{
+    // The status is polled all the time while the control tab is open, the rest is user activity
+    int value = qrand() % 100;
+
+    if ( value < 60 )
+        return REQUEST_STATUS;
+
+    if ( value < 80 )
+        return REQUEST_QUEUE;
+
+    if ( value < 90 )
+        return REQUEST_SEARCH;
+
+    if ( value < 98 || !m_test->addSongs || m_songIds.isEmpty() )
+        return REQUEST_BROWSE;
+
+    return REQUEST_ADDSONG;
+}
+
+void LoadClient::sendRequest( Request request, const QByteArray &url, const QByteArray &body )
+{
+    QByteArray data = ( request == REQUEST_DOWNLOAD ? "GET " : "POST " ) + url + " HTTP/1.1\r\n"
+            + "Host: " + m_test->host.toLatin1() + ":" + QByteArray::number( m_test->port ) + "\r\n";
+
+    if ( request != REQUEST_DOWNLOAD )
+        data += "Content-Type: application/json; charset=UTF-8\r\n"
+                "Content-Length: " + QByteArray::number( body.size() ) + "\r\n";
+
+    // Like the browsers do, so the server compresses the replies as it would for the phones
+    if ( m_test->gzip )
+        data += "Accept-Encoding: gzip\r\n";
+
+    if ( !m_cookie.isEmpty() )
+        data += "Cookie: " + m_cookie + "\r\n";
+
+    data += "\r\n" + body;
+
+    m_request = request;
+    m_requestActive = true;
+    m_response.clear();
+    m_body.clear();
+    m_bodySize = 0;
+    m_headerSize = 0;
+    m_requestTime.start();
+
+    // Reconnect if the server closed the connection
+    if ( m_socket.state() == QAbstractSocket::ConnectedState )
+        m_socket.write( data );
+    else
+    {
+        m_pendingRequest = data;
+        reconnect();
+    }
+}
+
+void LoadClient::readyRead()
+{
+    m_response += m_socket.readAll();
+
+    if ( m_requestActive && parseResponse() )
+    {
+        // Undecodable body is an error even if the status is fine
+        bool success = decodeBody() && m_status >= 200 && m_status < 300;
+        requestFinished( success, m_status );
+    }
+}
+
+bool LoadClient::parseResponse()
+{
+    if ( m_headerSize == 0 )
+    {
+        int idx = m_response.indexOf( "\r\n\r\n" );
+
+        if ( idx == -1 )
+            return false;
+
+        QList<QByteArray> lines = m_response.left( idx ).split( '\n' );
+        QList<QByteArray> statusline = lines.takeFirst().trimmed().split( ' ' );
+
+        m_status = statusline.size() > 1 ? statusline[1].toInt() : 0;
+        m_contentLength = 0;
+        m_closeAfter = false;
+        m_contentEncoding.clear();
+
+        Q_FOREACH( const QByteArray& line, lines )
+        {
+            int colon = line.indexOf( ':' );
+
+            if ( colon == -1 )
+                continue;
+
+            QByteArray name = line.left( colon ).trimmed().toLower();
+            QByteArray value = line.mid( colon + 1 ).trimmed();
+
+            if ( name == "content-length" )
+                m_contentLength = value.toLongLong();
+            else if ( name == "transfer-encoding" && value.toLower().contains( "chunked" ) )
+                m_contentLength = -1;
+            else if ( name == "connection" && value.toLower().contains( "close" ) )
+                m_closeAfter = true;
+            else if ( name == "content-encoding" )
+                m_contentEncoding = value.toLower();
+            else if ( name == "set-cookie" && value.startsWith( "token=" ) )
+                m_cookie = value.left( value.indexOf( ';' ) );
+        }
+
+        m_headerSize = idx + 4;
+        m_response.remove( 0, m_headerSize );
+    }
+
+    // Large downloads are not kept in memory, so the load generator itself stays small
+    if ( m_contentLength >= 0 && m_request == REQUEST_DOWNLOAD )
+    {
+        qint64 size = qMin( m_contentLength - m_bodySize, (qint64) m_response.size() );
+
+        m_bodySize += size;
+        m_response.remove( 0, size );
+        return m_bodySize == m_contentLength;
+    }
+
+    if ( m_contentLength >= 0 )
+    {
+        if ( m_response.size() < m_contentLength )
+            return false;
+
+        m_body = m_response.left( m_contentLength );
+        m_response.remove( 0, m_contentLength );
+        return true;
+    }
+
+    // Chunked
+    while ( true )
+    {
+        int idx = m_response.indexOf( "\r\n" );
+
+        if ( idx == -1 )
+            return false;
+
+        int size = m_response.left( idx ).toInt( 0, 16 );
+
+        if ( size == 0 )
+        {
+            // Last chunk, followed by the empty line
+            if ( m_response.size() < idx + 4 )
+                return false;
+
+            m_response.remove( 0, idx + 4 );
+            return true;
+        }
+
+        if ( m_response.size() < idx + 2 + size + 2 )
+            return false;
+
+        m_body += m_response.mid( idx + 2, size );
+        m_response.remove( 0, idx + 2 + size + 2 );
+    }
+}
+
+// Decompresses the gzip data in place; returns false if it is not valid gzip
+static bool gunzip( QByteArray& data )
+{
+    z_stream stream;
+    memset( &stream, 0, sizeof(stream) );
+
+    // 16 + MAX_WBITS makes zlib expect the gzip header and trailer instead of the zlib ones
+    if ( inflateInit2( &stream, 16 + MAX_WBITS ) != Z_OK )
+        return false;
+
+    stream.next_in = (Bytef *) data.data();
+    stream.avail_in = data.size();
+
+    QByteArray decoded;
+    char buffer[16384];
+    int ret;
+
+    do
+    {
+        stream.next_out = (Bytef *) buffer;
+        stream.avail_out = sizeof(buffer);
+
+        ret = inflate( &stream, Z_NO_FLUSH );
+
+        // Z_BUF_ERROR here means the data is truncated
+        if ( ret != Z_OK && ret != Z_STREAM_END )
+            break;
+
+        decoded.append( buffer, sizeof(buffer) - stream.avail_out );
+    }
+    while ( ret != Z_STREAM_END );
+
+    inflateEnd( &stream );
+
+    if ( ret != Z_STREAM_END )
+        return false;
+
+    data = decoded;
+    return true;
+}
+
+bool LoadClient::decodeBody()
+{
+    bool compressed = !m_contentEncoding.isEmpty() && m_contentEncoding != "identity";
+
+    // Only counted, see parseResponse()
+    if ( m_request == REQUEST_DOWNLOAD && m_contentLength >= 0 )
+    {
+        m_test->bodyReceived( m_bodySize, m_bodySize, compressed, true );
+        return true;
+    }
+
+    qint64 received = m_body.size();
+
+    // We only ever ask for gzip, so anything else (or gzip when we didn't ask) is the server's fault
+    if ( compressed && ( !m_test->gzip || m_contentEncoding != "gzip" || !gunzip( m_body ) ) )
+    {
+        m_test->bodyReceived( received, 0, compressed, false );
+        return false;
+    }
+
+    m_test->bodyReceived( received, m_body.size(), compressed, true );
+    return true;
+}
+
+void LoadClient::requestFinished( bool success, int status )
+{
+    m_requestActive = false;
+    m_pendingRequest.clear();
+    m_test->requestCompleted( m_request, m_requestTime.nsecsElapsed() / 1000, success, status );
+
+    // Remember the songs we could add
+    if ( success && m_request == REQUEST_SEARCH )
+    {
+        QJsonArray results = QJsonDocument::fromJson( m_body ).array();
+
+        for ( int i = 0; i < results.size() && m_songIds.size() < 100; i++ )
+            m_songIds.append( results[i].toObject()["id"].toInt() );
+    }
+
+    // Retry the login later
+    if ( m_request == REQUEST_LOGIN && !success )
+        m_cookie.clear();
+
+    if ( m_closeAfter || !success )
+        m_socket.abort();
+
+    if ( !m_stopped )
+        m_thinkTimer.start( qrand() % ( 2 * m_test->thinkTime + 1 ) );
+}
+
+void LoadClient::socketError( QAbstractSocket::SocketError )
+{
+    // The server closing the idle connection is fine; we reconnect with the next request
+    if ( m_requestActive && !m_stopped )
+        requestFinished( false, 0 );
+}
+
+void LoadClient::reconnect()
+{
+    m_socket.abort();
+    m_socket.connectToHost( m_test->host, m_test->port );
+}
@@ -0,0 +1,115 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef LOADCLIENT_H
+#define LOADCLIENT_H
+
+#include <QTimer>
+#include <QObject>
+#include <QTcpSocket>
+#include <QElapsedTimer>
+#include <QStringList>
+
+class LoadTest;
+
+//
+// A simulated phone using the web interface: logs in, and then keeps sending the requests
+// in a mix similar to karaoke.js (mostly status polling, sometimes searching, browsing
+// and adding songs) over a persistent connection.
+//
+class LoadClient : public QObject
+{
+    Q_OBJECT
+
+    public:
+        // Request types, also used as statistics indexes
+        enum Request
+        {
+            REQUEST_LOGIN,
+            REQUEST_STATUS,
+            REQUEST_QUEUE,
+            REQUEST_SEARCH,
+            REQUEST_BROWSE,
+            REQUEST_ADDSONG,
+            REQUEST_DOWNLOAD,
+            REQUEST_TOTAL
+        };
+
+        LoadClient( LoadTest * test, int id );
+
+        void    start();
+        void    stop();
+
+        static QString requestName( int request );
+
+    private slots:
+        void    connected();
+        void    readyRead();
+        void    socketError( QAbstractSocket::SocketError error );
+        void    sendNextRequest();
+
+    private:
+        // Picks the next request according to the mix
+        Request chooseRequest();
+
+        void    sendRequest( Request request, const QByteArray& url, const QByteArray& body );
+
+        // Parses the response in m_response; returns true once it is complete
+        bool    parseResponse();
+
+        // Decodes the complete m_body according to its Content-Encoding; returns false if it couldn't
+        bool    decodeBody();
+
+        // The response is complete (or failed); schedules the next request
+        void    requestFinished( bool success, int status );
+
+        void    reconnect();
+
+        LoadTest    *   m_test;
+        int             m_id;
+        bool            m_stopped;
+
+        QTcpSocket      m_socket;
+        QTimer          m_thinkTimer;
+
+        // Login cookie
+        QByteArray      m_cookie;
+
+        // Song IDs seen in search results, for adding songs
+        QList<int>      m_songIds;
+
+        // Current request
+        Request         m_request;
+        QByteArray      m_pendingRequest;
+        QElapsedTimer   m_requestTime;
+        bool            m_requestActive;
+
+        // Response parsing
+        QByteArray      m_response;
+        int             m_status;
+        int             m_headerSize;
+        qint64          m_contentLength;    // -1 if chunked
+        bool            m_closeAfter;
+        QByteArray      m_contentEncoding;
+        QByteArray      m_body;
+
+        // Downloaded files are only counted, not kept, in m_bodySize
+        qint64          m_bodySize;
+};
+
+#endif // LOADCLIENT_H
@@ -0,0 +1,253 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QFile>
+
+#include <stdio.h>
+#include <algorithm>
+
+#if defined (Q_OS_LINUX)
+    #include <unistd.h>
+#endif
+
+#include "loadtest.h"
+
+LoadTest::LoadTest()
+    : QObject()
+{
+    host = "127.0.0.1";
+    port = 8000;
+    clients = 20;
+    duration = 30;
+    thinkTime = 500;
+    addSongs = false;
+    gzip = true;
+    serverPid = 0;
+    seed = 0;
+
+    m_responses = 0;
+    m_compressedResponses = 0;
+    m_decodeFailures = 0;
+    m_receivedBytes = 0;
+    m_decodedBytes = 0;
+    m_serverStats = false;
+    m_serverCpuStart = 0;
+    m_serverCpuEnd = 0;
+    m_serverRssStart = 0;
+    m_serverRssMax = 0;
+
+    m_latencies.resize( LoadClient::REQUEST_TOTAL );
+    m_errors.fill( 0, LoadClient::REQUEST_TOTAL );
+    m_rateLimited.fill( 0, LoadClient::REQUEST_TOTAL );
+
+    m_durationTimer.setSingleShot( true );
+    connect( &m_durationTimer, &QTimer::timeout, this, &LoadTest::stop );
+    connect( &m_sampleTimer, &QTimer::timeout, this, &LoadTest::sampleServer );
+}
+
+void LoadTest::start()
+{
+    printf( "Running %d clients against %s:%d for %d seconds, think time %d ms, gzip %s, seed %u\n",
+            clients, qPrintable(host), port, duration, thinkTime, gzip ? "on" : "off", seed );
+
+    // The clients only use qrand in this thread, so the same seed repeats the same random choices
+    qsrand( seed );
+
+    for ( int i = 0; i < clients; i++ )
+    {
+        LoadClient * client = new LoadClient( this, i );
+        m_clients.append( client );
+        client->start();
+    }
+
+    if ( !downloadUrl.isEmpty() )
+        printf( "Downloading %s\n", qPrintable( downloadUrl ) );
+
+    if ( serverPid > 0 )
+    {
+        m_serverStats = readServerStats( m_serverCpuStart, m_serverRssStart );
+
+        if ( m_serverStats )
+        {
+            m_serverRssMax = m_serverRssStart;
+            m_sampleTimer.start( 1000 );
+        }
+        else
+            fprintf( stderr, "Cannot read the statistics of process %lld, not reporting them\n", (long long) serverPid );
+    }
+
+    m_elapsed.start();
+    m_durationTimer.start( duration * 1000 );
+}
+
+void LoadTest::requestCompleted( int request, qint64 latencyUsec, bool success, int status )
+{
+    if ( success )
+        m_latencies[ request ].append( latencyUsec );
+    else if ( status == 429 )
+        m_rateLimited[ request ]++;
+    else
+        m_errors[ request ]++;
+}
+
+void LoadTest::bodyReceived( qint64 receivedSize, qint64 decodedSize, bool compressed, bool decoded )
+{
+    m_responses++;
+    m_receivedBytes += receivedSize;
+    m_decodedBytes += decodedSize;
+
+    if ( compressed )
+        m_compressedResponses++;
+
+    if ( !decoded )
+        m_decodeFailures++;
+}
+
+void LoadTest::sampleServer()
+{
+    qint64 rss;
+
+    if ( readServerStats( m_serverCpuEnd, rss ) )
+        m_serverRssMax = qMax( m_serverRssMax, rss );
+}
+
+bool LoadTest::readServerStats( qint64 &cpuTime, qint64 &residentSize )
+{
+#if defined (Q_OS_LINUX)
+    QFile statfile( QString( "/proc/%1/stat" ).arg( serverPid ) );
+    QFile statusfile( QString( "/proc/%1/status" ).arg( serverPid ) );
+
+    if ( !statfile.open( QIODevice::ReadOnly ) || !statusfile.open( QIODevice::ReadOnly ) )
+        return false;
+
+    // The process name in parentheses may contain spaces, so the fields are counted after it;
+    // utime and stime are the fields 14 and 15, in clock ticks
+    QByteArray stat = statfile.readAll();
+    QList<QByteArray> fields = stat.mid( stat.lastIndexOf( ')' ) + 2 ).split( ' ' );
+
+    if ( fields.size() < 13 )
+        return false;
+
+    cpuTime = ( fields[11].toLongLong() + fields[12].toLongLong() ) * 1000 / sysconf( _SC_CLK_TCK );
+    residentSize = 0;
+
+    Q_FOREACH( const QByteArray& line, statusfile.readAll().split( '\n' ) )
+    {
+        if ( line.startsWith( "VmRSS:" ) )
+            residentSize = line.mid( 6 ).trimmed().split( ' ' ).first().toLongLong();
+    }
+
+    return true;
+#else
+    Q_UNUSED( cpuTime );
+    Q_UNUSED( residentSize );
+    return false;
+#endif
+}
+
+void LoadTest::stop()
+{
+    m_sampleTimer.stop();
+
+    if ( m_serverStats )
+        sampleServer();
+
+    Q_FOREACH( LoadClient * client, m_clients )
+        client->stop();
+
+    printReport();
+
+    qDeleteAll( m_clients );
+    m_clients.clear();
+
+    emit finished();
+}
+
+// Returns the percentile of the sorted values, in milliseconds
+static double percentile( const QVector<qint64>& sorted, int pct )
+{
+    if ( sorted.isEmpty() )
+        return 0;
+
+    int idx = qMin( sorted.size() - 1, (int) ( (qint64) sorted.size() * pct / 100 ) );
+    return sorted[idx] / 1000.0;
+}
+
+void LoadTest::printReport()
+{
+    double seconds = m_elapsed.elapsed() / 1000.0;
+    QVector<qint64> all;
+    int errors = 0, ratelimited = 0;
+
+    printf( "\n%-8s %8s %8s %8s %8s %9s %9s %9s %9s\n", "request", "ok", "errors", "429", "req/s", "p50 ms", "p90 ms", "p99 ms", "max ms" );
+
+    for ( int i = 0; i < LoadClient::REQUEST_TOTAL; i++ )
+    {
+        QVector<qint64> sorted = m_latencies[i];
+        std::sort( sorted.begin(), sorted.end() );
+
+        all += sorted;
+        errors += m_errors[i];
+        ratelimited += m_rateLimited[i];
+
+        printf( "%-8s %8d %8d %8d %8.1f %9.1f %9.1f %9.1f %9.1f\n",
+                qPrintable( LoadClient::requestName( i ) ),
+                sorted.size(),
+                m_errors[i],
+                m_rateLimited[i],
+                sorted.size() / seconds,
+                percentile( sorted, 50 ),
+                percentile( sorted, 90 ),
+                percentile( sorted, 99 ),
+                percentile( sorted, 100 ) );
+    }
+
+    std::sort( all.begin(), all.end() );
+
+    printf( "%-8s %8d %8d %8d %8.1f %9.1f %9.1f %9.1f %9.1f\n",
+            "total",
+            all.size(),
+            errors,
+            ratelimited,
+            all.size() / seconds,
+            percentile( all, 50 ),
+            percentile( all, 90 ),
+            percentile( all, 99 ),
+            percentile( all, 100 ) );
+
+    printf( "\nResponses %d, compressed %d, undecodable %d; body received %.1f KB, decoded %.1f KB",
+            m_responses,
+            m_compressedResponses,
+            m_decodeFailures,
+            m_receivedBytes / 1024.0,
+            m_decodedBytes / 1024.0 );
+
+    if ( m_receivedBytes > 0 )
+        printf( " (%.0f%%)", m_decodedBytes * 100.0 / m_receivedBytes );
+
+    printf( "\n" );
+
+    if ( !downloadUrl.isEmpty() )
+        printf( "Download throughput %.1f MB/s\n", m_receivedBytes / seconds / ( 1024 * 1024 ) );
+
+    if ( m_serverStats )
+        printf( "Server process: CPU %.1f%% of one core, resident memory %.1f MB at start, %.1f MB max\n",
+                ( m_serverCpuEnd - m_serverCpuStart ) * 100.0 / m_elapsed.elapsed(),
+                m_serverRssStart / 1024.0,
+                m_serverRssMax / 1024.0 );
+}
@@ -0,0 +1,99 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#ifndef LOADTEST_H
+#define LOADTEST_H
+
+#include <QList>
+#include <QTimer>
+#include <QVector>
+#include <QObject>
+#include <QStringList>
+#include <QElapsedTimer>
+
+#include "loadclient.h"
+
+//
+// Runs the simulated clients against the web server for the specified time, collects the
+// request latencies and errors, and prints the report.
+//
+class LoadTest : public QObject
+{
+    Q_OBJECT
+
+    public:
+        LoadTest();
+
+        // Test parameters
+        QString         host;
+        quint16         port;
+        int             clients;
+        int             duration;       // seconds
+        int             thinkTime;      // average ms between the requests of a client
+        bool            addSongs;       // whether addsong requests are sent (they modify the queue)
+        bool            gzip;           // whether the clients accept gzip-compressed responses
+        QString         downloadUrl;    // if set, the clients only download this file instead of the API mix
+        qint64          serverPid;      // if set, the server process CPU and memory use is reported (Linux only)
+        uint            seed;           // random seed of the request mix and the think times
+        QStringList     queries;
+
+        void    start();
+
+        // Called by clients
+        void    requestCompleted( int request, qint64 latencyUsec, bool success, int status );
+        void    bodyReceived( qint64 receivedSize, qint64 decodedSize, bool compressed, bool decoded );
+
+    signals:
+        void    finished();
+
+    private slots:
+        void    stop();
+        void    sampleServer();
+
+    private:
+        void    printReport();
+
+        // Reads the server process CPU time in ms and the resident size in KB from /proc; false if unavailable
+        bool    readServerStats( qint64& cpuTime, qint64& residentSize );
+
+        QList<LoadClient*>  m_clients;
+        QTimer              m_durationTimer;
+        QElapsedTimer       m_elapsed;
+
+        // Per request type
+        QVector< QVector<qint64> >  m_latencies;
+        QVector<int>                m_errors;
+        QVector<int>                m_rateLimited;
+
+        // Response bodies, as received and after decoding
+        int             m_responses;
+        int             m_compressedResponses;
+        int             m_decodeFailures;
+        qint64          m_receivedBytes;
+        qint64          m_decodedBytes;
+
+        // Server process use, sampled every second
+        QTimer          m_sampleTimer;
+        bool            m_serverStats;
+        qint64          m_serverCpuStart;
+        qint64          m_serverCpuEnd;
+        qint64          m_serverRssStart;
+        qint64          m_serverRssMax;
+};
+
+#endif // LOADTEST_H
@@ -0,0 +1,95 @@
+/**************************************************************************
+ *  Spivak Karaoke PLayer - a free, cross-platform desktop karaoke player *
+ *  Copyright (C) 2015-2016 George Yunaev, support@ulduzsoft.com          *
+ *                                                                        *
+ *  This program is free software: you can redistribute it and/or modify  *
+ *  it under the terms of the GNU General Public License as published by  *
+ *  the Free Software Foundation, either version 3 of the License, or     *
+ *  (at your option) any later version.                                   *
+ *																	      *
+ *  This program is distributed in the hope that it will be useful,       *
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of        *
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         *
+ *  GNU General Public License for more details.                          *
+ *                                                                        *
+ *  You should have received a copy of the GNU General Public License     *
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>. *
+ **************************************************************************/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+
+#include <stdio.h>
+
+#include "loadtest.h"
+
+// Load generator for the player's built-in web server. Simulates the phones using the web interface
+// and reports the throughput, latency percentiles and errors per request type.
+int main( int argc, char *argv[] )
+{
+    QCoreApplication app( argc, argv );
+    QCoreApplication::setApplicationName( "webloadtest" );
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription( "Load generator for the Spivak web server" );
+    parser.addHelpOption();
+
+    QCommandLineOption hostOption( "host", "Web server address (default 127.0.0.1).", "address", "127.0.0.1" );
+    QCommandLineOption portOption( "port", "Web server port (default 8000).", "port", "8000" );
+    QCommandLineOption clientsOption( "clients", "Number of simulated clients (default 20).", "count", "20" );
+    QCommandLineOption durationOption( "duration", "Test duration in seconds (default 30).", "seconds", "30" );
+    QCommandLineOption thinkOption( "think", "Average time between the requests of a client in ms (default 500).", "ms", "500" );
+    QCommandLineOption queryOption( "query", "Search query to use; could be repeated.", "text" );
+    QCommandLineOption addsongOption( "addsong", "Also add songs found by searches into the queue (modifies the queue!)." );
+    QCommandLineOption nogzipOption( "no-gzip", "Do not accept gzip-compressed responses." );
+    QCommandLineOption downloadOption( "download", "Only download this file (such as /images/background.jpg) instead of using the API.", "url" );
+    QCommandLineOption pidOption( "pid", "Report the CPU and memory use of the player process with this ID (Linux only).", "pid" );
+    QCommandLineOption seedOption( "seed", "Random seed for the request mix, to repeat a previous test (default is random).", "number" );
+
+    parser.addOption( hostOption );
+    parser.addOption( portOption );
+    parser.addOption( clientsOption );
+    parser.addOption( durationOption );
+    parser.addOption( thinkOption );
+    parser.addOption( queryOption );
+    parser.addOption( addsongOption );
+    parser.addOption( nogzipOption );
+    parser.addOption( downloadOption );
+    parser.addOption( pidOption );
+    parser.addOption( seedOption );
+    parser.process( app );
+
+    LoadTest test;
+    test.host = parser.value( hostOption );
+    test.port = parser.value( portOption ).toUShort();
+    test.clients = parser.value( clientsOption ).toInt();
+    test.duration = parser.value( durationOption ).toInt();
+    test.thinkTime = parser.value( thinkOption ).toInt();
+    test.addSongs = parser.isSet( addsongOption );
+    test.gzip = !parser.isSet( nogzipOption );
+    test.downloadUrl = parser.value( downloadOption );
+    test.serverPid = parser.value( pidOption ).toLongLong();
+    test.queries = parser.values( queryOption );
+    test.seed = QDateTime::currentMSecsSinceEpoch() & 0xFFFFFFFF;
+
+    bool seedValid = true;
+
+    if ( parser.isSet( seedOption ) )
+        test.seed = parser.value( seedOption ).toUInt( &seedValid );
+
+    if ( test.queries.isEmpty() )
+        test.queries << "love" << "you" << "the" << "me" << "night" << "a";
+
+    if ( !seedValid || test.port == 0 || test.clients <= 0 || test.duration <= 0 || test.thinkTime < 0 || test.serverPid < 0
+         || ( !test.downloadUrl.isEmpty() && !test.downloadUrl.startsWith( '/' ) ) )
+    {
+        fprintf( stderr, "Invalid arguments\n" );
+        return 2;
+    }
+
+    QObject::connect( &test, &LoadTest::finished, &app, &QCoreApplication::quit );
+    test.start();
+
+    return app.exec();
+}
@@ -0,0 +1,22 @@
+TARGET = webloadtest
+CONFIG += warn_on console
+CONFIG -= app_bundle
+QT += core network
+QT -= gui
+TEMPLATE = app
+
+SOURCES += main.cpp \
+    loadclient.cpp \
+    loadtest.cpp
+
+HEADERS += loadclient.h \
+    loadtest.h
+
+# zlib for decoding the gzip-compressed responses; libzip needed by the player depends on it anyway
+unix:!mac: {
+    CONFIG += link_pkgconfig
+    PKGCONFIG += zlib
+} else: {
+    INCLUDEPATH += $$PWD/../../extralibs/include
+    LIBS += -L$$PWD/../../extralibs/lib -lz
+}